@@ -11,17 +11,22 @@
 
 #include <sd_page.h>
 #include <sd_pageiter.h>
+#include <sd_pagecache.h>
 #include <sd_index.h>
 #include <sd_indexiter.h>
 #include <sd_build.h>
 #include <sd_buildindex.h>
+#include <sd_blob.h>
 #include <sd_merge.h>
 #include <sd_iter.h>
 #include <sd_scheme.h>
 #include <sd_schemeiter.h>
+#include <sd_manifest.h>
+#include <sd_manifestiter.h>
 #include <sd_io.h>
 #include <sd_read.h>
 #include <sd_write.h>
+#include <sd_pipe.h>
 #include <sd_c.h>
 
 #endif
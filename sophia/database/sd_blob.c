@@ -0,0 +1,202 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+#include <libsv.h>
+#include <libsd.h>
+
+#define SD_BLOBFLUSH (1024 * 1024)
+
+void sd_blobinit(sdblob *b, char *path, uint32_t threshold)
+{
+	b->threshold = threshold;
+	b->path      = path;
+	b->id        = 0;
+	b->gc_id     = 0;
+	b->gc        = NULL;
+	b->complete  = 0;
+	ss_fileinit(&b->file, NULL);
+	ss_bufinit(&b->buf);
+	ss_bufinit(&b->stub);
+	ss_bufinit(&b->read);
+}
+
+void sd_blobcollect(sdblob *b, uint64_t id, ssfile *file)
+{
+	/* values of the log are moved to the new
+	 * one on the way */
+	b->gc_id = id;
+	b->gc    = file;
+}
+
+int sd_blobfree(sdblob *b, sr *r)
+{
+	int rcret = 0;
+	int rc;
+	ss_buffree(&b->buf, r->a);
+	ss_buffree(&b->stub, r->a);
+	ss_buffree(&b->read, r->a);
+	if (b->file.fd == -1)
+		return 0;
+	rc = ss_fileclose(&b->file);
+	if (ssunlikely(rc == -1)) {
+		sr_malfunction(r->e, "blob file '%s' close error: %s",
+		               ss_pathof(&b->file.path),
+		               strerror(errno));
+		rcret = -1;
+	}
+	/* remove log of the failed compaction */
+	if (! b->complete) {
+		rc = ss_vfsunlink(r->vfs, ss_pathof(&b->file.path));
+		if (ssunlikely(rc == -1)) {
+			sr_malfunction(r->e, "blob file '%s' unlink error: %s",
+			               ss_pathof(&b->file.path),
+			               strerror(errno));
+			rcret = -1;
+		}
+	}
+	return rcret;
+}
+
+static inline int
+sd_blobflush(sdblob *b, sr *r)
+{
+	uint32_t size = ss_bufused(&b->buf);
+	if (size == 0)
+		return 0;
+	sr_throttle(r, size);
+	int rc = ss_filewrite(&b->file, b->buf.s, size);
+	if (ssunlikely(rc == -1)) {
+		sr_malfunction(r->e, "blob file '%s' write error: %s",
+		               ss_pathof(&b->file.path),
+		               strerror(errno));
+		return -1;
+	}
+	ss_bufreset(&b->buf);
+	return 0;
+}
+
+static inline int
+sd_blobopen(sdblob *b, sr *r)
+{
+	b->id = sr_seq(r->seq, SR_NSNNEXT);
+	sspath path;
+	ss_path(&path, b->path, b->id, ".blob");
+	ss_fileinit(&b->file, r->vfs);
+	int rc = ss_filenew(&b->file, path.path, 0);
+	if (ssunlikely(rc == -1)) {
+		sr_malfunction(r->e, "blob file '%s' create error: %s",
+		               path.path, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+int sd_blobread(ssfile *file, sr *r, sdblobref *ref, ssbuf *buf)
+{
+	ss_bufreset(buf);
+	int rc = ss_bufensure(buf, r->a, ref->size);
+	if (ssunlikely(rc == -1))
+		return sr_oom_malfunction(r->e);
+	rc = ss_filepread(file, ref->offset, buf->s, ref->size);
+	if (ssunlikely(rc == -1)) {
+		sr_malfunction(r->e, "blob file '%s' read error: %s",
+		               ss_pathof(&file->path),
+		               strerror(errno));
+		return -1;
+	}
+	uint32_t crc = ss_crcp(r->crc, buf->s, ref->size, 0);
+	if (ssunlikely(crc != ref->crc)) {
+		sr_malfunction(r->e, "corrupted blob file '%s': bad value crc",
+		               ss_pathof(&file->path));
+		return -1;
+	}
+	ss_bufadvance(buf, ref->size);
+	return 0;
+}
+
+int sd_blobadd(sdblob *b, sr *r, sdbuildindex *index, char **v, uint8_t *flags)
+{
+	sfscheme *scheme = r->scheme;
+	char *doc = *v;
+	int rc;
+	if (*flags & SVBLOB) {
+		sdblobref *ref = sd_blobref(scheme, doc);
+		if (sslikely(ref->id != b->gc_id))
+			return sd_buildindex_addblob(index, r, ref->id, ref->size);
+		rc = sd_blobread(b->gc, r, ref, &b->read);
+		if (ssunlikely(rc == -1))
+			return -1;
+		doc = b->read.s;
+		*v = doc;
+		*flags &= ~SVBLOB;
+	}
+	uint32_t size = sf_size(scheme, doc);
+	if (b->threshold == 0 || size < b->threshold)
+		return 0;
+	if (*flags & SVDELETE)
+		return 0;
+
+	/* append document to the log */
+	if (b->file.fd == -1) {
+		rc = sd_blobopen(b, r);
+		if (ssunlikely(rc == -1))
+			return -1;
+	}
+	sdblobref ref = {
+		.id     = b->id,
+		.offset = b->file.size + ss_bufused(&b->buf),
+		.size   = size,
+		.crc    = ss_crcp(r->crc, doc, size, 0)
+	};
+	rc = ss_bufadd(&b->buf, r->a, doc, size);
+	if (ssunlikely(rc == -1))
+		return sr_oom_malfunction(r->e);
+	if (ss_bufused(&b->buf) >= SD_BLOBFLUSH) {
+		rc = sd_blobflush(b, r);
+		if (ssunlikely(rc == -1))
+			return -1;
+	}
+
+	/* replace document by the key part and
+	 * the reference */
+	uint32_t size_stub = sf_comparable_size(scheme, doc);
+	ss_bufreset(&b->stub);
+	rc = ss_bufensure(&b->stub, r->a, size_stub + sizeof(ref));
+	if (ssunlikely(rc == -1))
+		return sr_oom_malfunction(r->e);
+	sf_comparable_write(scheme, doc, b->stub.s);
+	memcpy(b->stub.s + size_stub, &ref, sizeof(ref));
+	ss_bufadvance(&b->stub, size_stub + sizeof(ref));
+	*v = b->stub.s;
+	*flags |= SVBLOB;
+	return sd_buildindex_addblob(index, r, ref.id, size);
+}
+
+int sd_blobcomplete(sdblob *b, sr *r, int sync)
+{
+	if (b->file.fd == -1)
+		return 0;
+	int rc = sd_blobflush(b, r);
+	if (ssunlikely(rc == -1))
+		return -1;
+	if (sync) {
+		rc = ss_filesync(&b->file);
+		if (ssunlikely(rc == -1)) {
+			sr_malfunction(r->e, "blob file '%s' sync error: %s",
+			               ss_pathof(&b->file.path),
+			               strerror(errno));
+			return -1;
+		}
+	}
+	b->complete = 1;
+	return 0;
+}
@@ -0,0 +1,88 @@
+#ifndef SD_BLOB_H_
+#define SD_BLOB_H_
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+/*
+	value log.
+
+	documents which size exceeds the threshold are appended
+	to a separate <id>.blob file during compaction. Page keeps
+	the document with key fields only, followed by the
+	reference to the value log.
+
+	every node index stores an amount of bytes it references
+	in each value log, which is used to track the live ratio
+	of the log.
+*/
+
+typedef struct sdblobref sdblobref;
+typedef struct sdblobstat sdblobstat;
+typedef struct sdblob sdblob;
+
+struct sdblobref {
+	uint64_t id;
+	uint64_t offset;
+	uint32_t size;
+	uint32_t crc;
+} sspacked;
+
+struct sdblobstat {
+	uint64_t id;
+	uint64_t size;
+} sspacked;
+
+struct sdblob {
+	uint32_t  threshold;
+	char     *path;
+	uint64_t  id;
+	ssfile    file;
+	ssbuf     buf;
+	ssbuf     stub;
+	ssbuf     read;
+	uint64_t  gc_id;
+	ssfile   *gc;
+	int       complete;
+};
+
+static inline sdblobref*
+sd_blobref(sfscheme *s, char *v) {
+	return (sdblobref*)(v + sf_size(s, v));
+}
+
+static inline uint32_t
+sd_blobsize(sfscheme *s, char *v, uint8_t flags)
+{
+	uint32_t size = sf_size(s, v);
+	if (flags & SVBLOB)
+		size += sizeof(sdblobref);
+	return size;
+}
+
+static inline sdblobstat*
+sd_indexblob(sdindex *i)
+{
+	/* value log usage is stored right before
+	 * the bloom filter */
+	if (i->h->blob == 0)
+		return NULL;
+	return (sdblobstat*)
+		((char*)i->h - (i->h->align +
+		               (i->h->count * sizeof(sdindexpage)) +
+		                i->h->bloom + i->h->blob));
+}
+
+void sd_blobinit(sdblob*, char*, uint32_t);
+void sd_blobcollect(sdblob*, uint64_t, ssfile*);
+int  sd_blobfree(sdblob*, sr*);
+int  sd_blobadd(sdblob*, sr*, sdbuildindex*, char**, uint8_t*);
+int  sd_blobcomplete(sdblob*, sr*, int);
+int  sd_blobread(ssfile*, sr*, sdblobref*, ssbuf*);
+
+#endif
@@ -18,7 +18,10 @@ void sd_buildinit(sdbuild *b)
 	ss_bufinit(&b->m);
 	ss_bufinit(&b->v);
 	ss_bufinit(&b->c);
+	ss_bufinit(&b->d);
 	b->compress = 0;
+	b->delta = 0;
+	b->prefix = 0;
 	b->compress_if = NULL;
 	b->crc = 0;
 	b->vmax = 0;
@@ -29,6 +32,7 @@ void sd_buildfree(sdbuild *b, sr *r)
 	ss_buffree(&b->m, r->a);
 	ss_buffree(&b->v, r->a);
 	ss_buffree(&b->c, r->a);
+	ss_buffree(&b->d, r->a);
 }
 
 void sd_buildreset(sdbuild *b)
@@ -36,6 +40,7 @@ void sd_buildreset(sdbuild *b)
 	ss_bufreset(&b->m);
 	ss_bufreset(&b->v);
 	ss_bufreset(&b->c);
+	ss_bufreset(&b->d);
 	b->vmax = 0;
 }
 
@@ -44,14 +49,19 @@ void sd_buildgc(sdbuild *b, sr *r, int wm)
 	ss_bufgc(&b->m, r->a, wm);
 	ss_bufgc(&b->v, r->a, wm);
 	ss_bufgc(&b->c, r->a, wm);
+	ss_bufgc(&b->d, r->a, wm);
 	b->vmax = 0;
 }
 
 int sd_buildbegin(sdbuild *b, sr *r, int crc,
+                  int delta,
+                  int prefix,
                   int compress,
                   ssfilterif *compress_if)
 {
 	b->crc = crc;
+	b->delta = delta;
+	b->prefix = prefix;
 	b->compress = compress;
 	b->compress_if = compress_if;
 	int rc;
@@ -63,7 +73,7 @@ int sd_buildbegin(sdbuild *b, sr *r, int crc,
 	h->lsnmin    = UINT64_MAX;
 	h->lsnmindup = UINT64_MAX;
 	h->tsmin     = UINT32_MAX;
-	h->reserve   = 0;
+	h->flags     = 0;
 	ss_bufadvance(&b->m, sizeof(sdpageheader));
 	return 0;
 }
@@ -71,7 +81,9 @@ int sd_buildbegin(sdbuild *b, sr *r, int crc,
 static inline int
 sd_buildadd_raw(sdbuild *b, sr *r, char *v, uint8_t flags)
 {
-	uint32_t size = sf_size(r->scheme, v);
+	/* separated document is followed by the
+	 * value log reference */
+	uint32_t size = sd_blobsize(r->scheme, v, flags);
 	int rc = ss_bufensure(&b->v, r->a, size);
 	if (ssunlikely(rc == -1))
 		return sr_oom(r->e);
@@ -83,7 +95,7 @@ sd_buildadd_raw(sdbuild *b, sr *r, char *v, uint8_t flags)
 
 int sd_buildadd(sdbuild *b, sr *r, char *v, uint8_t flags)
 {
-	uint32_t size = sf_size(r->scheme, v);
+	uint32_t size = sd_blobsize(r->scheme, v, flags);
 
 	/* store document offset */
 	int rc;
@@ -123,6 +135,84 @@ int sd_buildadd(sdbuild *b, sr *r, char *v, uint8_t flags)
 	return 0;
 }
 
+static inline int
+sd_builddelta(sdbuild *b, sr *r, ssbuf *dest)
+{
+	/* documents without offset table, every document
+	 * is stored without the key prefix shared with the
+	 * previous one */
+	sfscheme *s = r->scheme;
+	int var = sd_pagedelta_var(s);
+	assert(var != -1);
+	sdpageheader *h = sd_buildheader(b);
+	int rc = ss_bufensure(dest, r->a, ss_bufused(&b->v) +
+	                      sizeof(uint32_t) * h->count);
+	if (ssunlikely(rc == -1))
+		return -1;
+	uint32_t *offset = (uint32_t*)sd_pagebody(h);
+	char *prev = NULL;
+	uint32_t prev_size = 0;
+	uint32_t i;
+	for (i = 0; i < h->count; i++)
+	{
+		char *v = b->v.s + offset[i];
+		uint32_t size;
+		if (i + 1 < h->count)
+			size = offset[i + 1] - offset[i];
+		else
+			size = ss_bufused(&b->v) - offset[i];
+		uint32_t key_size;
+		char *key = sd_pagedelta_key(s, var, v, &key_size);
+		uint32_t shared = 0;
+		if (prev) {
+			uint32_t max = key_size < prev_size ? key_size : prev_size;
+			while (shared < max && key[shared] == prev[shared])
+				shared++;
+		}
+		memcpy(dest->p, &shared, sizeof(shared));
+		ss_bufadvance(dest, sizeof(shared));
+		uint32_t n = key - v;
+		memcpy(dest->p, v, n);
+		ss_bufadvance(dest, n);
+		n = size - n - shared;
+		memcpy(dest->p, key + shared, n);
+		ss_bufadvance(dest, n);
+		prev = key;
+		prev_size = key_size;
+	}
+	return 0;
+}
+
+static inline int
+sd_buildprefix(sdbuild *b, sr *r)
+{
+	/* insert key prefix array between the page
+	 * header and the offset table */
+	sfscheme *s = r->scheme;
+	uint32_t count = sd_buildheader(b)->count;
+	uint32_t size = sizeof(uint64_t) * count;
+	int rc = ss_bufensure(&b->m, r->a, size);
+	if (ssunlikely(rc == -1))
+		return -1;
+	char *start = b->m.s + sizeof(sdpageheader);
+	memmove(start + size, start, ss_bufused(&b->m) - sizeof(sdpageheader));
+	ss_bufadvance(&b->m, size);
+	sdpageheader *h = sd_buildheader(b);
+	h->flags |= SD_PAGEPREFIX;
+	uint64_t *prefix = sd_pageprefix(h);
+	uint32_t *offset = (uint32_t*)sd_pagebody(h);
+	uint32_t i;
+	for (i = 0; i < count; i++) {
+		char *v;
+		if (sf_schemefixed(s))
+			v = b->v.s + s->var_offset * i;
+		else
+			v = b->v.s + offset[i];
+		prefix[i] = sf_prefix(s, v);
+	}
+	return 0;
+}
+
 static inline int
 sd_buildcompress(sdbuild *b, sr *r)
 {
@@ -140,13 +230,19 @@ sd_buildcompress(sdbuild *b, sr *r)
 	rc = ss_filterstart(&f, &b->c);
 	if (ssunlikely(rc == -1))
 		goto error;
-	rc = ss_filternext(&f, &b->c, b->m.s + sizeof(sdpageheader),
-	                   ss_bufused(&b->m) - sizeof(sdpageheader));
-	if (ssunlikely(rc == -1))
-		goto error;
-	rc = ss_filternext(&f, &b->c, b->v.s, ss_bufused(&b->v));
-	if (ssunlikely(rc == -1))
-		goto error;
+	if (sd_buildheader(b)->flags & SD_PAGEDELTA) {
+		rc = ss_filternext(&f, &b->c, b->d.s, ss_bufused(&b->d));
+		if (ssunlikely(rc == -1))
+			goto error;
+	} else {
+		rc = ss_filternext(&f, &b->c, b->m.s + sizeof(sdpageheader),
+		                   ss_bufused(&b->m) - sizeof(sdpageheader));
+		if (ssunlikely(rc == -1))
+			goto error;
+		rc = ss_filternext(&f, &b->c, b->v.s, ss_bufused(&b->v));
+		if (ssunlikely(rc == -1))
+			goto error;
+	}
 	rc = ss_filtercomplete(&f, &b->c);
 	if (ssunlikely(rc == -1))
 		goto error;
@@ -159,6 +255,12 @@ error:
 
 int sd_buildend(sdbuild *b, sr *r)
 {
+	/* key prefixes, not used with custom comparator */
+	if (b->prefix && sd_buildheader(b)->count > 0 && !r->scheme->cmp) {
+		int rc = sd_buildprefix(b, r);
+		if (ssunlikely(rc == -1))
+			return sr_oom(r->e);
+	}
 	/* calculate data crc (non-compressed) */
 	sdpageheader *h = sd_buildheader(b);
 	uint32_t crc = 0;
@@ -167,6 +269,23 @@ int sd_buildend(sdbuild *b, sr *r)
 		crc = ss_crcp(r->crc, b->v.s, ss_bufused(&b->v), crc);
 	}
 	h->crcdata = crc;
+	/* delta encoding */
+	int delta = b->delta && h->count > 0;
+	if (delta) {
+		h->flags |= SD_PAGEDELTA;
+		ssbuf *dest = &b->c;
+		if (b->compress) {
+			dest = &b->d;
+		} else {
+			int rc = ss_bufensure(&b->c, r->a, sizeof(sdpageheader));
+			if (ssunlikely(rc == -1))
+				return sr_oom(r->e);
+			ss_bufadvance(&b->c, sizeof(sdpageheader));
+		}
+		int rc = sd_builddelta(b, r, dest);
+		if (ssunlikely(rc == -1))
+			return sr_oom(r->e);
+	}
 	/* compression */
 	if (b->compress) {
 		int rc = sd_buildcompress(b, r);
@@ -174,15 +293,15 @@ int sd_buildend(sdbuild *b, sr *r)
 			return -1;
 	}
 	/* update page header */
+	int encoded = delta || b->compress;
 	int total = ss_bufused(&b->m) + ss_bufused(&b->v);
 	h->sizeorigin = total - sizeof(sdpageheader);
-	h->size = h->sizeorigin;
-	if (b->compress)
+	if (encoded)
 		h->size = ss_bufused(&b->c) - sizeof(sdpageheader);
 	else
 		h->size = h->sizeorigin;
 	h->crc = ss_crcs(r->crc, h, sizeof(sdpageheader), 0);
-	if (b->compress)
+	if (encoded)
 		memcpy(b->c.s, h, sizeof(sdpageheader));
 	return 0;
 }
@@ -12,9 +12,11 @@
 typedef struct sdbuild sdbuild;
 
 struct sdbuild {
-	ssbuf       m, v, c;
+	ssbuf       m, v, c, d;
 	ssfilterif *compress_if;
 	int         compress;
+	int         delta;
+	int         prefix;
 	int         crc;
 	uint32_t    vmax;
 };
@@ -42,11 +44,11 @@ sd_buildmax(sdbuild *b, sr *r)
 	if (sf_schemefixed(r->scheme))
 		return b->v.s + (r->scheme->var_offset * (h->count - 1));
 	return b->v.s +
-	       *(uint32_t*)((char*)h + sizeof(sdpageheader) +
+	       *(uint32_t*)(sd_pagebody(h) +
 	                    (sizeof(uint32_t) * (h->count - 1)));
 }
 
-int sd_buildbegin(sdbuild*, sr*, int, int, ssfilterif*);
+int sd_buildbegin(sdbuild*, sr*, int, int, int, int, ssfilterif*);
 int sd_buildend(sdbuild*, sr*);
 int sd_buildadd(sdbuild*, sr*, char*, uint8_t);
 
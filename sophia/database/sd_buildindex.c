@@ -17,24 +17,32 @@ void sd_buildindex_init(sdbuildindex *i)
 {
 	ss_bufinit(&i->v);
 	ss_bufinit(&i->m);
+	ss_bufinit(&i->hash);
+	ss_bufinit(&i->blob);
 }
 
 void sd_buildindex_free(sdbuildindex *i, sr *r)
 {
 	ss_buffree(&i->v, r->a);
 	ss_buffree(&i->m, r->a);
+	ss_buffree(&i->hash, r->a);
+	ss_buffree(&i->blob, r->a);
 }
 
 void sd_buildindex_reset(sdbuildindex *i)
 {
 	ss_bufreset(&i->v);
 	ss_bufreset(&i->m);
+	ss_bufreset(&i->hash);
+	ss_bufreset(&i->blob);
 }
 
 void sd_buildindex_gc(sdbuildindex *i, sr *r, int wm)
 {
 	ss_bufgc(&i->v, r->a, wm);
 	ss_bufgc(&i->m, r->a, wm);
+	ss_bufgc(&i->hash, r->a, wm);
+	ss_bufgc(&i->blob, r->a, wm);
 }
 
 int sd_buildindex_begin(sdbuildindex *i)
@@ -53,13 +61,66 @@ int sd_buildindex_begin(sdbuildindex *i)
 	h->offset      = 0;
 	h->dupkeys     = 0;
 	h->dupmin      = UINT64_MAX;
+	h->bloom       = 0;
+	h->bloom_hashes = 0;
+	h->blob        = 0;
 	h->align       = 0;
 	sr_version_storage(&h->version);
 	return 0;
 }
 
-int sd_buildindex_end(sdbuildindex *i, sr *r, uint32_t align, uint64_t offset)
+static inline int
+sd_buildindex_bloom(sdbuildindex *i, sr *r, uint32_t bits_per_key)
 {
+	uint32_t keys = ss_bufused(&i->hash) / sizeof(uint32_t);
+	if (bits_per_key == 0 || keys == 0)
+		return 0;
+	sdindexheader *h = &i->build;
+	uint32_t size = ss_bloom_size(keys, bits_per_key);
+	int rc = ss_bufensure(&i->v, r->a, size);
+	if (ssunlikely(rc == -1))
+		return sr_oom(r->e);
+	h->bloom = size;
+	h->bloom_hashes = ss_bloom_hashes(bits_per_key);
+	h->size += size;
+	char *bloom = i->v.p;
+	memset(bloom, 0, size);
+	uint32_t *hash = (uint32_t*)i->hash.s;
+	uint32_t j = 0;
+	while (j < keys) {
+		ss_bloom_add(bloom, size, h->bloom_hashes, hash[j]);
+		j++;
+	}
+	ss_bufadvance(&i->v, size);
+	return 0;
+}
+
+static inline int
+sd_buildindex_blob(sdbuildindex *i, sr *r)
+{
+	uint32_t size = ss_bufused(&i->blob);
+	if (size == 0)
+		return 0;
+	int rc = ss_bufadd(&i->v, r->a, i->blob.s, size);
+	if (ssunlikely(rc == -1))
+		return sr_oom(r->e);
+	sdindexheader *h = &i->build;
+	h->blob  = size;
+	h->size += size;
+	return 0;
+}
+
+int sd_buildindex_end(sdbuildindex *i, sr *r, uint32_t bloom,
+                      uint32_t align, uint64_t offset)
+{
+	/* value log usage and bloom filter go
+	 * after the keys */
+	int rc = sd_buildindex_blob(i, r);
+	if (ssunlikely(rc == -1))
+		return -1;
+	rc = sd_buildindex_bloom(i, r, bloom);
+	if (ssunlikely(rc == -1))
+		return -1;
 	/* calculate index align for direct_io */
 	int size_meta  = sizeof(sdindexheader);
 	int size_align = 0;
@@ -70,7 +131,7 @@ int sd_buildindex_end(sdbuildindex *i, sr *r, uint32_t align, uint64_t offset)
 		                        ss_bufused(&i->m)) % align);
 		size_meta  += size_align;
 	}
-	int rc = ss_bufensure(&i->m, r->a, size_meta);
+	rc = ss_bufensure(&i->m, r->a, size_meta);
 	if (ssunlikely(rc == -1))
 		return sr_oom(r->e);
 	/* align */
@@ -145,3 +206,32 @@ int sd_buildindex_add(sdbuildindex *i, sr *r, sdbuild *b, uint64_t offset)
 	ss_bufadvance(&i->m, sizeof(sdindexpage));
 	return 0;
 }
+
+int sd_buildindex_addkey(sdbuildindex *i, sr *r, char *key)
+{
+	uint32_t hash = sf_hash(r->scheme, key);
+	int rc = ss_bufadd(&i->hash, r->a, &hash, sizeof(hash));
+	if (ssunlikely(rc == -1))
+		return sr_oom(r->e);
+	return 0;
+}
+
+int sd_buildindex_addblob(sdbuildindex *i, sr *r, uint64_t id, uint64_t size)
+{
+	sdblobstat *stat = (sdblobstat*)i->blob.s;
+	sdblobstat *end  = (sdblobstat*)i->blob.p;
+	for (; stat < end; stat++) {
+		if (stat->id == id) {
+			stat->size += size;
+			return 0;
+		}
+	}
+	sdblobstat add = {
+		.id   = id,
+		.size = size
+	};
+	int rc = ss_bufadd(&i->blob, r->a, &add, sizeof(add));
+	if (ssunlikely(rc == -1))
+		return sr_oom(r->e);
+	return 0;
+}
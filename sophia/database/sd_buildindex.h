@@ -13,6 +13,8 @@ typedef struct sdbuildindex sdbuildindex;
 
 struct sdbuildindex {
 	ssbuf         v, m;
+	ssbuf         hash;
+	ssbuf         blob;
 	sdindexheader build;
 };
 
@@ -21,7 +23,9 @@ void sd_buildindex_free(sdbuildindex*, sr*);
 void sd_buildindex_reset(sdbuildindex*);
 void sd_buildindex_gc(sdbuildindex*, sr*, int);
 int  sd_buildindex_begin(sdbuildindex*);
-int  sd_buildindex_end(sdbuildindex*, sr*, uint32_t, uint64_t);
+int  sd_buildindex_end(sdbuildindex*, sr*, uint32_t, uint32_t, uint64_t);
 int  sd_buildindex_add(sdbuildindex*, sr*, sdbuild*, uint64_t);
+int  sd_buildindex_addkey(sdbuildindex*, sr*, char*);
+int  sd_buildindex_addblob(sdbuildindex*, sr*, uint64_t, uint64_t);
 
 #endif
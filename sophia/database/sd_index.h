@@ -29,8 +29,16 @@ struct sdindexheader {
 	uint32_t  dupkeys;
 	uint64_t  dupmin;
 	uint16_t  align;
+	uint32_t  bloom;
+	uint8_t   bloom_hashes;
+	uint32_t  blob;
 } sspacked;
 
+/* storage version 2.2 header ends right after the
+ * align field */
+#define SD_INDEXHEADER_V22 \
+	__builtin_offsetof(sdindexheader, bloom)
+
 struct sdindexpage {
 	uint64_t offset;
 	uint32_t offsetindex;
@@ -85,6 +93,28 @@ sd_indexpage(sdindex *i, uint32_t pos)
 	return &index[pos];
 }
 
+static inline char*
+sd_indexbloom(sdindex *i)
+{
+	/* bloom filter is stored right before the page
+	 * index */
+	if (i->h->bloom == 0)
+		return NULL;
+	return (char*)i->h - (i->h->align +
+	                      (i->h->count * sizeof(sdindexpage)) +
+	                       i->h->bloom);
+}
+
+static inline int
+sd_indexbloom_has(sdindex *i, sfscheme *s, char *key)
+{
+	char *bloom = sd_indexbloom(i);
+	if (bloom == NULL)
+		return 1;
+	return ss_bloom_has(bloom, i->h->bloom, i->h->bloom_hashes,
+	                    sf_hash(s, key));
+}
+
 static inline sdindexpage*
 sd_indexmin(sdindex *i) {
 	return sd_indexpage(i, 0);
@@ -109,10 +139,38 @@ sd_indextotal(sdindex *i)
 	return sd_indexheader(i)->total;
 }
 
+static inline uint32_t
+sd_indexheader_size(sdindexheader *h)
+{
+	if (h->version.b == '2')
+		return SD_INDEXHEADER_V22;
+	return sizeof(sdindexheader);
+}
+
 static inline uint32_t
 sd_indexsize_ext(sdindexheader *h)
 {
-	return h->align + h->size + sizeof(sdindexheader);
+	/* size of the index stored in file */
+	return h->align + h->size + sd_indexheader_size(h);
+}
+
+static inline int
+sd_indexupgrade(sdindex *i, sr *r)
+{
+	/* append missing fields to the header read from
+	 * an older file: no bloom filter and no value
+	 * log usage */
+	sdindexheader *h =
+		(sdindexheader*)(i->i.p - SD_INDEXHEADER_V22);
+	if (h->version.b != '2')
+		return 0;
+	int size = sizeof(sdindexheader) - SD_INDEXHEADER_V22;
+	int rc = ss_bufensure(&i->i, r->a, size);
+	if (ssunlikely(rc == -1))
+		return sr_oom(r->e);
+	memset(i->i.p, 0, size);
+	ss_bufadvance(&i->i, size);
+	return 0;
 }
 
 static inline int
@@ -125,6 +183,9 @@ sd_indexcopy(sdindex *i, sr *r, sdindexheader *h)
 	char *start = (char*)h - (h->align + h->size);
 	memcpy(i->i.s, start, size);
 	ss_bufadvance(&i->i, size);
+	rc = sd_indexupgrade(i, r);
+	if (ssunlikely(rc == -1))
+		return -1;
 	i->h = sd_indexheader(i);
 	return 0;
 }
@@ -65,6 +65,7 @@ sd_ioflush_direct(sdio *s, sr *r, ssfile *f)
 	if (count == 0)
 		return 0;
 	uint32_t size  = count * s->size_page;
+	sr_throttle(r, size);
 	int rc = ss_filewrite(f, s->buf.s + s->size_align, size);
 	if (ssunlikely(rc == -1)) {
 		sr_malfunction(r->e, "file '%s' write error: %s",
@@ -110,6 +111,7 @@ int sd_iowrite(sdio *s, sr *r, ssfile *f, char *buf, int size)
 {
 	if (s->direct)
 		return sd_iowrite_direct(s, r, f, buf, size);
+	sr_throttle(r, size);
 	int rc;
 	rc = ss_filewrite(f, buf, size);
 	if (ssunlikely(rc == -1)) {
@@ -23,15 +23,37 @@ struct sditer {
 	sr            *r;
 } sspacked;
 
+static inline sdindexheader*
+sd_iterheader(sditer *i, char *end)
+{
+	/* index header ends at the given position, storage
+	 * version 2.2 header is shorter */
+	if (ssunlikely(end < i->map.p + SD_INDEXHEADER_V22))
+		return NULL;
+	sdindexheader *h =
+		(sdindexheader*)(end - sizeof(sdindexheader));
+	if ((char*)h >= i->map.p &&
+	    h->version.magic == SR_VERSION_MAGIC &&
+	    h->version.b != '2')
+		return h;
+	return (sdindexheader*)(end - SD_INDEXHEADER_V22);
+}
+
 static int
 sd_iternext_of(sditer *i, sdindexheader *index)
 {
-	if (ssunlikely(index == NULL))
-		return 0;
+	if (ssunlikely(index == NULL)) {
+		sr_malfunction(i->r->e, "corrupted db file '%s': bad index header",
+		               ss_pathof(&i->file->path));
+		i->corrupt = 1;
+		i->v = NULL;
+		return -1;
+	}
 
 	char *start = i->map.p + index->offset;
 
 	int sanity_check = 0;
+	sanity_check += (! sr_versionstorage_check(&index->version));
 	sanity_check += (start >= (char*)index);
 	sanity_check +=
 		((char*)index - start) != index->align + index->size;
@@ -46,7 +68,7 @@ sd_iternext_of(sditer *i, sdindexheader *index)
 	}
 
 	/* validate index crc */
-	uint32_t crc = ss_crcs(i->r->crc, index, sizeof(sdindexheader), 0);
+	uint32_t crc = ss_crcs(i->r->crc, index, sd_indexheader_size(index), 0);
 	if (index->crc != crc) {
 		sr_malfunction(i->r->e, "corrupted db file '%s': bad index crc",
 		               ss_pathof(&i->file->path));
@@ -65,7 +87,7 @@ int sd_iter_open(ssiter *i, sr *r, ssfile *file)
 	memset(ri, 0, sizeof(*ri));
 	ri->r = r;
 	ri->file = file;
-	if (ssunlikely(ri->file->size < sizeof(sdindexheader))) {
+	if (ssunlikely(ri->file->size < SD_INDEXHEADER_V22)) {
 		sr_malfunction(ri->r->e, "corrupted db file '%s': bad size",
 		               ss_pathof(&ri->file->path));
 		ri->corrupt = 1;
@@ -79,8 +101,7 @@ int sd_iter_open(ssiter *i, sr *r, ssfile *file)
 		return -1;
 	}
 	sdindexheader *header =
-		(sdindexheader*)((char*)ri->map.p +
-		          (ri->file->size - sizeof(sdindexheader)));
+		sd_iterheader(ri, (char*)ri->map.p + ri->file->size);
 	rc = sd_iternext_of(ri, header);
 	if (ssunlikely(rc == -1))
 		ss_vfsmunmap(r->vfs, &ri->map);
@@ -122,8 +143,7 @@ sd_iternext(ssiter *i)
 		ri->v = NULL;
 		return;
 	}
-	next = next - sizeof(sdindexheader);
-	sd_iternext_of(ri, (sdindexheader*)next);
+	sd_iternext_of(ri, sd_iterheader(ri, next));
 }
 
 ssiterif sd_iter =
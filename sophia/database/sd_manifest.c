@@ -0,0 +1,82 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+#include <libsv.h>
+#include <libsd.h>
+
+int sd_manifestbegin(sdmanifest *m, sr *r)
+{
+	int rc = ss_bufensure(&m->buf, r->a, sizeof(sdmanifestheader));
+	if (ssunlikely(rc == -1))
+		return sr_oom(r->e);
+	m->group = ss_bufused(&m->buf);
+	sdmanifestheader *h = (sdmanifestheader*)m->buf.p;
+	memset(h, 0, sizeof(sdmanifestheader));
+	ss_bufadvance(&m->buf, sizeof(sdmanifestheader));
+	return 0;
+}
+
+int sd_manifestadd(sdmanifest *m, sr *r, sdmanifestnode *n,
+                   sdindexheader *h, char *keys, char *blobs)
+{
+	int rc = ss_bufensure(&m->buf, r->a, sd_manifestnode_size(n));
+	if (ssunlikely(rc == -1))
+		return sr_oom(r->e);
+	sdmanifestnode *v = (sdmanifestnode*)m->buf.p;
+	*v = *n;
+	if (n->size_meta > 0) {
+		memcpy(sd_manifestnode_header(v), h, sizeof(sdindexheader));
+		memcpy(sd_manifestnode_keys(v), keys, n->size_min + n->size_max);
+		memcpy(sd_manifestnode_blobs(v), blobs, sd_manifestnode_blobsize(n));
+	}
+	ss_bufadvance(&m->buf, sd_manifestnode_size(n));
+	sdmanifestheader *hdr = (sdmanifestheader*)(m->buf.s + m->group);
+	hdr->count++;
+	return 0;
+}
+
+int sd_manifestcommit(sdmanifest *m, sr *r)
+{
+	sdmanifestheader *h = (sdmanifestheader*)(m->buf.s + m->group);
+	h->size = ss_bufused(&m->buf) - m->group - sizeof(sdmanifestheader);
+	h->crc  = sd_manifestcrc(r, h);
+	return 0;
+}
+
+int sd_manifestrecover(sdmanifest *m, sr *r, char *path)
+{
+	ssize_t size = ss_vfssize(r->vfs, path);
+	if (ssunlikely(size == -1))
+		goto error;
+	int rc = ss_bufensure(&m->buf, r->a, size);
+	if (ssunlikely(rc == -1))
+		return sr_oom(r->e);
+	ssfile file;
+	ss_fileinit(&file, r->vfs);
+	rc = ss_fileopen(&file, path, 0);
+	if (ssunlikely(rc == -1))
+		goto error;
+	rc = ss_filepread(&file, 0, m->buf.s, size);
+	if (ssunlikely(rc == -1)) {
+		ss_fileclose(&file);
+		goto error;
+	}
+	rc = ss_fileclose(&file);
+	if (ssunlikely(rc == -1))
+		goto error;
+	ss_bufadvance(&m->buf, size);
+	return 0;
+error:
+	sr_error(r->e, "manifest file '%s' error: %s",
+	         path, strerror(errno));
+	return -1;
+}
@@ -0,0 +1,112 @@
+#ifndef SD_MANIFEST_H_
+#define SD_MANIFEST_H_
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+/*
+	manifest file is a sequence of appended groups,
+	each group is written by a single write and
+	protected by its own crc.
+
+	ADD      - node is part of the repository, record is
+	           followed by the node index header, node key
+	           range and value log references
+	REMOVE   - node is no longer part of the repository
+	BEGIN    - compaction of the node is started and might
+	           leave its files in the directory
+	COMPLETE - compaction of the node is done
+*/
+
+typedef struct sdmanifestheader sdmanifestheader;
+typedef struct sdmanifestnode sdmanifestnode;
+typedef struct sdmanifest sdmanifest;
+
+#define SD_MANIFEST_ADD      1
+#define SD_MANIFEST_REMOVE   2
+#define SD_MANIFEST_BEGIN    3
+#define SD_MANIFEST_COMPLETE 4
+
+struct sdmanifestheader {
+	uint32_t crc;
+	uint32_t size;
+	uint32_t count;
+} sspacked;
+
+struct sdmanifestnode {
+	uint8_t  type;
+	uint64_t id;
+	uint64_t id_parent;
+	uint64_t size;
+	uint32_t size_meta;
+	uint16_t size_min;
+	uint16_t size_max;
+} sspacked;
+
+struct sdmanifest {
+	ssbuf    buf;
+	uint32_t group;
+};
+
+static inline void
+sd_manifestinit(sdmanifest *m) {
+	ss_bufinit(&m->buf);
+	m->group = 0;
+}
+
+static inline void
+sd_manifestfree(sdmanifest *m, sr *r) {
+	ss_buffree(&m->buf, r->a);
+}
+
+static inline void
+sd_manifestreset(sdmanifest *m) {
+	ss_bufreset(&m->buf);
+	m->group = 0;
+}
+
+static inline uint32_t
+sd_manifestcrc(sr *r, sdmanifestheader *h)
+{
+	return ss_crcs(r->crc, (char*)h + sizeof(h->crc),
+	               sizeof(sdmanifestheader) - sizeof(h->crc) + h->size, 0);
+}
+
+static inline uint32_t
+sd_manifestnode_size(sdmanifestnode *n) {
+	return sizeof(sdmanifestnode) + n->size_meta;
+}
+
+static inline sdindexheader*
+sd_manifestnode_header(sdmanifestnode *n) {
+	return (sdindexheader*)((char*)n + sizeof(sdmanifestnode));
+}
+
+static inline char*
+sd_manifestnode_keys(sdmanifestnode *n) {
+	return (char*)sd_manifestnode_header(n) + sizeof(sdindexheader);
+}
+
+static inline char*
+sd_manifestnode_blobs(sdmanifestnode *n) {
+	return sd_manifestnode_keys(n) + n->size_min + n->size_max;
+}
+
+static inline uint32_t
+sd_manifestnode_blobsize(sdmanifestnode *n) {
+	return n->size_meta - sizeof(sdindexheader) -
+	       n->size_min - n->size_max;
+}
+
+int sd_manifestbegin(sdmanifest*, sr*);
+int sd_manifestadd(sdmanifest*, sr*, sdmanifestnode*, sdindexheader*,
+                   char*, char*);
+int sd_manifestcommit(sdmanifest*, sr*);
+int sd_manifestrecover(sdmanifest*, sr*, char*);
+
+#endif
@@ -0,0 +1,22 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+#include <libsv.h>
+#include <libsd.h>
+
+ssiterif sd_manifestiter =
+{
+	.close   = sd_manifestiter_close,
+	.has     = sd_manifestiter_has,
+	.of      = sd_manifestiter_of,
+	.next    = sd_manifestiter_next
+};
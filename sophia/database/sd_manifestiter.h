@@ -0,0 +1,131 @@
+#ifndef SD_MANIFESTITER_H_
+#define SD_MANIFESTITER_H_
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+typedef struct sdmanifestiter sdmanifestiter;
+
+struct sdmanifestiter {
+	sdmanifest       *m;
+	sdmanifestheader *h;
+	uint32_t          pos;
+	char             *p;
+	int               corrupt;
+	sr               *r;
+} sspacked;
+
+static inline int
+sd_manifestiter_validate(sdmanifestheader *h)
+{
+	/* records are of variable size */
+	char *p   = (char*)h + sizeof(sdmanifestheader);
+	char *end = p + h->size;
+	uint32_t n = 0;
+	while (n < h->count) {
+		sdmanifestnode *v = (sdmanifestnode*)p;
+		if (ssunlikely(end - p < (int)sizeof(sdmanifestnode)))
+			return -1;
+		if (v->size_meta > 0) {
+			if (ssunlikely(v->size_meta < sizeof(sdindexheader) +
+			               v->size_min + v->size_max))
+				return -1;
+		}
+		if (ssunlikely((uint64_t)(end - p) < sd_manifestnode_size(v)))
+			return -1;
+		p += sd_manifestnode_size(v);
+		n++;
+	}
+	return (p == end) ? 0 : -1;
+}
+
+static inline int
+sd_manifestiter_group(sdmanifestiter *i, char *p)
+{
+	i->h   = NULL;
+	i->p   = NULL;
+	i->pos = 0;
+	for (;;) {
+		if (p == i->m->buf.p)
+			return 0;
+		/* validate group header, a partially written
+		 * group is treated as corruption */
+		sdmanifestheader *h = (sdmanifestheader*)p;
+		uint32_t left = i->m->buf.p - p;
+		if (ssunlikely(left < sizeof(sdmanifestheader) ||
+		               left - sizeof(sdmanifestheader) < h->size ||
+		               h->crc != sd_manifestcrc(i->r, h) ||
+		               sd_manifestiter_validate(h) == -1)) {
+			i->corrupt = 1;
+			return -1;
+		}
+		if (h->count > 0) {
+			i->h = h;
+			i->p = p + sizeof(sdmanifestheader);
+			return 1;
+		}
+		p += sizeof(sdmanifestheader);
+	}
+}
+
+static inline int
+sd_manifestiter_open(ssiter *i, sr *r, sdmanifest *m)
+{
+	sdmanifestiter *mi = (sdmanifestiter*)i->priv;
+	mi->m       = m;
+	mi->r       = r;
+	mi->corrupt = 0;
+	int rc = sd_manifestiter_group(mi, m->buf.s);
+	if (ssunlikely(rc == -1))
+		return -1;
+	return 0;
+}
+
+static inline void
+sd_manifestiter_close(ssiter *i ssunused)
+{ }
+
+static inline int
+sd_manifestiter_has(ssiter *i)
+{
+	sdmanifestiter *mi = (sdmanifestiter*)i->priv;
+	return mi->p != NULL;
+}
+
+static inline void*
+sd_manifestiter_of(ssiter *i)
+{
+	sdmanifestiter *mi = (sdmanifestiter*)i->priv;
+	return mi->p;
+}
+
+static inline void
+sd_manifestiter_next(ssiter *i)
+{
+	sdmanifestiter *mi = (sdmanifestiter*)i->priv;
+	if (ssunlikely(mi->p == NULL))
+		return;
+	char *next = mi->p + sd_manifestnode_size((sdmanifestnode*)mi->p);
+	mi->pos++;
+	if (mi->pos < mi->h->count) {
+		mi->p = next;
+		return;
+	}
+	sd_manifestiter_group(mi, next);
+}
+
+static inline int
+sd_manifestiter_iserror(ssiter *i)
+{
+	sdmanifestiter *mi = (sdmanifestiter*)i->priv;
+	return mi->corrupt;
+}
+
+extern ssiterif sd_manifestiter;
+
+#endif
@@ -25,15 +25,19 @@ int sd_mergeinit(sdmerge *m, sr *r, ssiter *i,
 	m->merge       = i;
 	m->processed   = 0;
 	m->current     = 0;
+	m->inflight    = 0;
 	m->limit       = 0;
 	m->resume      = 0;
 	uint32_t sizev = 0;
 	if (! sf_schemefixed(r->scheme))
 		sizev += sizeof(uint32_t);
+	uint32_t blob = 0;
+	if (conf->blob)
+		blob = conf->blob->threshold;
 	sd_indexinit(&m->index);
 	ss_iterinit(sv_writeiter, &m->i);
 	ss_iteropen(sv_writeiter, &m->i, r, i, upsert,
-	            (uint64_t)conf->size_page, sizev,
+	            (uint64_t)conf->size_page, sizev, blob,
 	            conf->expire,
 	            conf->timestamp,
 	            conf->vlsn);
@@ -51,7 +55,7 @@ sd_mergehas(sdmerge *m)
 {
 	if (! ss_iterhas(sv_writeiter, &m->i))
 		return 0;
-	if (m->current > m->limit)
+	if ((m->current + m->inflight) > m->limit)
 		return 0;
 	return 1;
 }
@@ -66,8 +70,9 @@ int sd_merge(sdmerge *m)
 	int rc = sd_buildindex_begin(m->build_index);
 	if (ssunlikely(rc == -1))
 		return -1;
-	m->current = 0;
-	m->limit   = 0;
+	m->current  = 0;
+	m->inflight = 0;
+	m->limit    = 0;
 	uint64_t processed = m->processed;
 	uint64_t left = (conf->size_stream - processed);
 	if (left >= (conf->size_node * 2)) {
@@ -81,10 +86,10 @@ int sd_merge(sdmerge *m)
 	return sd_mergehas(m);
 }
 
-int sd_mergepage(sdmerge *m, uint64_t offset)
+int sd_mergefill(sdmerge *m, sdbuild *build)
 {
 	sdmergeconf *conf = m->conf;
-	sd_buildreset(m->build);
+	sd_buildreset(build);
 	if (m->resume) {
 		m->resume = 0;
 		if (ssunlikely(! sv_writeiter_resume(&m->i)))
@@ -93,7 +98,9 @@ int sd_mergepage(sdmerge *m, uint64_t offset)
 	if (! sd_mergehas(m))
 		return 0;
 	int rc;
-	rc = sd_buildbegin(m->build, m->r, conf->checksum,
+	rc = sd_buildbegin(build, m->r, conf->checksum,
+	                   conf->delta,
+	                   conf->prefix,
 	                   conf->compression,
 	                   conf->compression_if);
 	if (ssunlikely(rc == -1))
@@ -104,11 +111,30 @@ int sd_mergepage(sdmerge *m, uint64_t offset)
 		uint8_t flags = sf_flags(m->r->scheme, v);
 		if (sv_writeiter_is_duplicate(&m->i))
 			flags |= SVDUP;
-		rc = sd_buildadd(m->build, m->r, v, flags);
+		if (conf->blob) {
+			rc = sd_blobadd(conf->blob, m->r, m->build_index, &v, &flags);
+			if (ssunlikely(rc == -1))
+				return -1;
+		}
+		rc = sd_buildadd(build, m->r, v, flags);
 		if (ssunlikely(rc == -1))
 			return -1;
+		if (conf->bloom && !(flags & SVDUP)) {
+			rc = sd_buildindex_addkey(m->build_index, m->r, v);
+			if (ssunlikely(rc == -1))
+				return -1;
+		}
 		ss_iternext(sv_writeiter, &m->i);
 	}
+	m->resume = 1;
+	return 1;
+}
+
+int sd_mergepage(sdmerge *m, uint64_t offset)
+{
+	int rc = sd_mergefill(m, m->build);
+	if (rc <= 0)
+		return rc;
 	rc = sd_buildend(m->build, m->r);
 	if (ssunlikely(rc == -1))
 		return -1;
@@ -116,7 +142,6 @@ int sd_mergepage(sdmerge *m, uint64_t offset)
 	if (ssunlikely(rc == -1))
 		return -1;
 	m->current = m->build_index->build.total;
-	m->resume  = 1;
 	return 1;
 }
 
@@ -126,7 +151,8 @@ int sd_mergeend(sdmerge *m, uint64_t offset)
 	uint32_t align = 0;
 	if (m->conf->direct_io)
 		align = m->conf->direct_io_page_size;
-	int rc = sd_buildindex_end(m->build_index, m->r, align, offset);
+	int rc = sd_buildindex_end(m->build_index, m->r, m->conf->bloom,
+	                           align, offset);
 	if (ssunlikely(rc == -1))
 		return -1;
 	rc = sd_indexcopy_buf(&m->index, m->r,
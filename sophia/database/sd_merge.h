@@ -19,6 +19,9 @@ struct sdmergeconf {
 	uint64_t    size_node;
 	uint32_t    size_page;
 	uint32_t    checksum;
+	uint32_t    delta;
+	uint32_t    prefix;
+	uint32_t    bloom;
 	uint32_t    expire;
 	uint32_t    timestamp;
 	uint32_t    compression;
@@ -26,6 +29,7 @@ struct sdmergeconf {
 	uint32_t    direct_io;
 	uint32_t    direct_io_page_size;
 	uint64_t    vlsn;
+	sdblob     *blob;
 };
 
 struct sdmerge {
@@ -38,6 +42,7 @@ struct sdmerge {
 	sdbuildindex *build_index;
 	uint64_t     processed;
 	uint64_t     current;
+	uint64_t     inflight;
 	uint64_t     limit;
 	int          resume;
 };
@@ -46,6 +51,7 @@ int sd_mergeinit(sdmerge*, sr*, ssiter*, sdbuild*, sdbuildindex*,
                  svupsert*, sdmergeconf*);
 int sd_mergefree(sdmerge*);
 int sd_merge(sdmerge*);
+int sd_mergefill(sdmerge*, sdbuild*);
 int sd_mergepage(sdmerge*, uint64_t);
 int sd_mergeend(sdmerge*, uint64_t);
 
@@ -0,0 +1,91 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+#include <libsv.h>
+#include <libsd.h>
+
+int sd_pagedelta_decode(sdpageheader *h, sr *r, char *src, uint32_t size,
+                        ssbuf *dest)
+{
+	sfscheme *s = r->scheme;
+	int var = sd_pagedelta_var(s);
+	if (ssunlikely(var == -1))
+		return -1;
+	ss_bufreset(dest);
+	int rc = ss_bufensure(dest, r->a, sizeof(sdpageheader) + h->sizeorigin);
+	if (ssunlikely(rc == -1))
+		return -1;
+	memcpy(dest->s, h, sizeof(sdpageheader));
+	uint32_t *offset = (uint32_t*)sd_pagebody((sdpageheader*)dest->s);
+	char *start = (char*)(offset + h->count);
+	char *p     = start;
+	char *end   = dest->s + sizeof(sdpageheader) + h->sizeorigin;
+	char *src_end = src + size;
+	uint32_t head = s->var_offset + (sizeof(sfvar) * s->var_count);
+	char *prev = NULL;
+	uint32_t prev_size = 0;
+	uint32_t i;
+	for (i = 0; i < h->count; i++)
+	{
+		uint32_t shared;
+		if (ssunlikely(src + sizeof(shared) + head > src_end ||
+		               p + head > end))
+			return -1;
+		memcpy(&shared, src, sizeof(shared));
+		src += sizeof(shared);
+		if (ssunlikely(shared > prev_size))
+			return -1;
+		offset[i] = p - start;
+
+		/* fixed fields and var table */
+		char *v = p;
+		memcpy(p, src, head);
+		p   += head;
+		src += head;
+
+		/* var fields preceding the key */
+		uint32_t key_size;
+		char *key = sd_pagedelta_key(s, var, v, &key_size);
+		uint32_t n = key - p;
+		if (ssunlikely(key_size < shared || src + n > src_end || key > end))
+			return -1;
+		memcpy(p, src, n);
+		p   += n;
+		src += n;
+
+		/* key, restore shared bytes from the previous one */
+		if (shared) {
+			memcpy(p, prev, shared);
+			p += shared;
+		}
+
+		/* rest of the document */
+		uint32_t total = sd_blobsize(s, v, sf_flags(s, v));
+		n = total - (key - v) - shared;
+		if (ssunlikely(src + n > src_end || p + n > end))
+			return -1;
+		memcpy(p, src, n);
+		p   += n;
+		src += n;
+		prev = key;
+		prev_size = key_size;
+	}
+	if (ssunlikely(p != end || src != src_end))
+		return -1;
+	if (h->flags & SD_PAGEPREFIX) {
+		uint64_t *prefix = sd_pageprefix((sdpageheader*)dest->s);
+		for (i = 0; i < h->count; i++)
+			prefix[i] = sf_prefix(s, start + offset[i]);
+	}
+	ss_bufadvance(dest, sizeof(sdpageheader) + h->sizeorigin);
+	return 0;
+}
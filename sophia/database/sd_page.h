@@ -12,6 +12,9 @@
 typedef struct sdpageheader sdpageheader;
 typedef struct sdpage sdpage;
 
+#define SD_PAGEDELTA  1
+#define SD_PAGEPREFIX 2
+
 struct sdpageheader {
 	uint32_t crc;
 	uint32_t crcdata;
@@ -23,7 +26,7 @@ struct sdpageheader {
 	uint64_t lsnmindup;
 	uint64_t lsnmax;
 	uint32_t tsmin;
-	uint32_t reserve;
+	uint32_t flags;
 } sspacked;
 
 struct sdpage {
@@ -35,11 +38,33 @@ sd_pageinit(sdpage *p, sdpageheader *h) {
 	p->h = h;
 }
 
+/*
+	key prefix array.
+
+	page header is followed by the sf_prefix() values
+	of the documents, which are searched before the
+	documents themselves.
+*/
+
+static inline uint64_t*
+sd_pageprefix(sdpageheader *h) {
+	return (uint64_t*)((char*)h + sizeof(sdpageheader));
+}
+
+static inline char*
+sd_pagebody(sdpageheader *h)
+{
+	char *ptr = (char*)h + sizeof(sdpageheader);
+	if (h->flags & SD_PAGEPREFIX)
+		ptr += sizeof(uint64_t) * h->count;
+	return ptr;
+}
+
 static inline char*
 sd_pagepointer(sdpage *p, sr *r, uint32_t pos)
 {
 	assert(pos < p->h->count);
-	char *ptr = (char*)p->h + sizeof(sdpageheader);
+	char *ptr = sd_pagebody(p->h);
 	if (sf_schemefixed(r->scheme))
 		return ptr + (r->scheme->var_offset * pos);
 	uint32_t *offset = (uint32_t*)ptr;
@@ -48,4 +73,39 @@ sd_pagepointer(sdpage *p, sr *r, uint32_t pos)
 	return ptr + (sizeof(uint32_t) * p->h->count) + offset[pos];
 }
 
+/*
+	delta encoded page.
+
+	offset table and key prefix array are omitted, every
+	document is preceded by the number of bytes its first
+	key part shares with the previous document and is
+	stored without them. Page is expanded to the regular
+	layout on read.
+*/
+
+static inline int
+sd_pagedelta_var(sfscheme *s)
+{
+	if (s->has_normalized)
+		return 0;
+	sffield *key = s->keys[0];
+	if (key->type == SS_STRING || key->type == SS_STRINGREV)
+		return key->position_ref;
+	return -1;
+}
+
+static inline char*
+sd_pagedelta_key(sfscheme *s, int pos, char *data, uint32_t *size)
+{
+	uint32_t offset = s->var_offset + (sizeof(sfvar) * s->var_count);
+	sfvar *v = sf_var(s, 0, data);
+	sfvar *end = v + pos;
+	for (; v < end; v++)
+		offset += v->size;
+	*size = v->size;
+	return data + offset;
+}
+
+int sd_pagedelta_decode(sdpageheader*, sr*, char*, uint32_t, ssbuf*);
+
 #endif
@@ -0,0 +1,178 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+#include <libsv.h>
+#include <libsd.h>
+
+ss_htsearch(sd_pagecache_search,
+            (sscast(t->i[pos], sdpagecachev, node)->id == ((uint64_t*)key)[0] &&
+             sscast(t->i[pos], sdpagecachev, node)->offset == ((uint64_t*)key)[1]))
+
+static inline uint32_t
+sd_pagecache_hash(uint64_t *key) {
+	return ss_fnv((char*)key, sizeof(uint64_t) * 2);
+}
+
+int sd_pagecache_init(sdpagecache *c, ssa *a)
+{
+	ss_spinlockinit(&c->lock);
+	ss_listinit(&c->list);
+	c->hand  = &c->list;
+	c->limit = 0;
+	c->used  = 0;
+	c->count = 0;
+	c->hit   = 0;
+	c->miss  = 0;
+	c->evict = 0;
+	c->a     = a;
+	return ss_htinit(&c->ht, a, 256);
+}
+
+void sd_pagecache_free(sdpagecache *c)
+{
+	sslist *i, *n;
+	ss_listforeach_safe(&c->list, i, n) {
+		sdpagecachev *v = sscast(i, sdpagecachev, link);
+		assert(v->refs == 0);
+		ss_free(c->a, v);
+	}
+	ss_htfree(&c->ht, c->a);
+	ss_spinlockfree(&c->lock);
+}
+
+static inline void
+sd_pagecache_remove(sdpagecache *c, sdpagecachev *v)
+{
+	uint64_t key[2] = { v->id, v->offset };
+	int pos = sd_pagecache_search(&c->ht, v->node.hash, (char*)key,
+	                              sizeof(key), NULL);
+	assert(c->ht.i[pos] == &v->node);
+	ss_htremove(&c->ht, pos);
+	ss_listunlink(&v->link);
+	c->used -= v->size;
+	c->count--;
+	c->evict++;
+	ss_free(c->a, v);
+}
+
+static inline void
+sd_pagecache_gc(sdpagecache *c, uint64_t size)
+{
+	/* clock eviction, pages which are currently in use
+	 * are skipped */
+	uint32_t scan = c->count * 2;
+	while (c->used + size > c->limit && scan > 0) {
+		sslist *next = c->hand->next;
+		if (next == &c->list)
+			next = next->next;
+		if (next == &c->list)
+			break;
+		sdpagecachev *v = sscast(next, sdpagecachev, link);
+		if (v->refs > 0 || v->clock) {
+			v->clock = 0;
+			c->hand = next;
+		} else {
+			c->hand = next->prev;
+			sd_pagecache_remove(c, v);
+		}
+		scan--;
+	}
+}
+
+void sd_pagecache_setlimit(sdpagecache *c, uint64_t limit)
+{
+	ss_spinlock(&c->lock);
+	c->limit = limit;
+	sd_pagecache_gc(c, 0);
+	ss_spinunlock(&c->lock);
+}
+
+void sd_pagecache_unref(sdpagecache *c, sdpagecachev *v)
+{
+	ss_spinlock(&c->lock);
+	assert(v->refs > 0);
+	v->refs--;
+	ss_spinunlock(&c->lock);
+}
+
+sdpagecachev*
+sd_pagecache_get(sdpagecache *c, uint64_t id, uint64_t offset)
+{
+	uint64_t key[2] = { id, offset };
+	uint32_t hash = sd_pagecache_hash(key);
+	ss_spinlock(&c->lock);
+	int pos = sd_pagecache_search(&c->ht, hash, (char*)key, sizeof(key), NULL);
+	if (c->ht.i[pos] == NULL) {
+		c->miss++;
+		ss_spinunlock(&c->lock);
+		return NULL;
+	}
+	sdpagecachev *v = sscast(c->ht.i[pos], sdpagecachev, node);
+	v->refs++;
+	v->clock = 1;
+	c->hit++;
+	ss_spinunlock(&c->lock);
+	return v;
+}
+
+sdpagecachev*
+sd_pagecache_add(sdpagecache *c, uint64_t id, uint64_t offset,
+                 char *page, uint32_t size)
+{
+	uint64_t key[2] = { id, offset };
+	uint32_t hash = sd_pagecache_hash(key);
+	if (ssunlikely(size > c->limit))
+		return NULL;
+	sdpagecachev *v = ss_malloc(c->a, sizeof(sdpagecachev) + size);
+	if (ssunlikely(v == NULL))
+		return NULL;
+	v->node.hash = hash;
+	v->id     = id;
+	v->offset = offset;
+	v->refs   = 1;
+	v->size   = size;
+	v->clock  = 1;
+	memcpy(sd_pagecachev_pointer(v), page, size);
+
+	ss_spinlock(&c->lock);
+	int pos = sd_pagecache_search(&c->ht, hash, (char*)key, sizeof(key), NULL);
+	if (ssunlikely(c->ht.i[pos] != NULL)) {
+		/* page has been added concurrently */
+		sdpagecachev *match = sscast(c->ht.i[pos], sdpagecachev, node);
+		match->refs++;
+		ss_spinunlock(&c->lock);
+		ss_free(c->a, v);
+		return match;
+	}
+	sd_pagecache_gc(c, size);
+	if (ssunlikely(c->used + size > c->limit)) {
+		ss_spinunlock(&c->lock);
+		ss_free(c->a, v);
+		return NULL;
+	}
+	if (ss_htisfull(&c->ht)) {
+		int rc = ss_htresize(&c->ht, c->a);
+		if (ssunlikely(rc == -1)) {
+			ss_spinunlock(&c->lock);
+			ss_free(c->a, v);
+			return NULL;
+		}
+	}
+	pos = sd_pagecache_search(&c->ht, hash, (char*)key, sizeof(key), NULL);
+	ss_htset(&c->ht, pos, &v->node);
+	/* insert right behind the clock hand */
+	ss_listappend(c->hand, &v->link);
+	c->used += size;
+	c->count++;
+	ss_spinunlock(&c->lock);
+	return v;
+}
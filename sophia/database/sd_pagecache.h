@@ -0,0 +1,58 @@
+#ifndef SD_PAGECACHE_H_
+#define SD_PAGECACHE_H_
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+typedef struct sdpagecachev sdpagecachev;
+typedef struct sdpagecache sdpagecache;
+
+struct sdpagecachev {
+	sshtnode node;
+	uint64_t id;
+	uint64_t offset;
+	uint32_t refs;
+	uint32_t size;
+	uint8_t  clock;
+	sslist   link;
+};
+
+struct sdpagecache {
+	ssspinlock lock;
+	ssht       ht;
+	sslist     list;
+	sslist    *hand;
+	uint64_t   limit;
+	uint64_t   used;
+	uint32_t   count;
+	uint64_t   hit;
+	uint64_t   miss;
+	uint64_t   evict;
+	ssa       *a;
+};
+
+static inline char*
+sd_pagecachev_pointer(sdpagecachev *v) {
+	return (char*)(v + 1);
+}
+
+static inline int
+sd_pagecache_enabled(sdpagecache *c) {
+	return c->limit > 0;
+}
+
+int  sd_pagecache_init(sdpagecache*, ssa*);
+void sd_pagecache_free(sdpagecache*);
+void sd_pagecache_setlimit(sdpagecache*, uint64_t);
+void sd_pagecache_unref(sdpagecache*, sdpagecachev*);
+sdpagecachev*
+sd_pagecache_get(sdpagecache*, uint64_t, uint64_t);
+sdpagecachev*
+sd_pagecache_add(sdpagecache*, uint64_t, uint64_t, char*, uint32_t);
+
+#endif
@@ -43,12 +43,39 @@ sd_pageiter_cmp(sdpageiter *i, sr *r, uint32_t pos)
 	return sf_compare(r->scheme, sd_pagepointer(i->page, i->r, pos), i->key);
 }
 
+static inline uint32_t
+sd_pageiter_prefix(uint64_t *prefix, uint32_t count, uint64_t key, int equal)
+{
+	/* branch-free bound search: first position which
+	 * prefix is greater (or equal) than the key */
+	uint64_t *base = prefix;
+	uint32_t n = count;
+	while (n > 1) {
+		uint32_t half = n / 2;
+		base = (base[half] < key || (equal && base[half] == key)) ?
+		       base + half : base;
+		n -= half;
+	}
+	return (base - prefix) + (*base < key || (equal && *base == key));
+}
+
 static inline int
 sd_pageiter_search(sdpageiter *i)
 {
+	sdpageheader *h = i->page->h;
 	int min = 0;
 	int mid = 0;
-	int max = i->page->h->count - 1;
+	int max = h->count - 1;
+	if (h->flags & SD_PAGEPREFIX) {
+		/* compare full keys only among the
+		 * documents with the same prefix */
+		uint64_t *prefix = sd_pageprefix(h);
+		uint64_t key = sf_prefix(i->r->scheme, i->key);
+		min = sd_pageiter_prefix(prefix, h->count, key, 0);
+		max = min - 1;
+		if (min < (int)h->count)
+			max += sd_pageiter_prefix(prefix + min, h->count - min, key, 1);
+	}
 	while (max >= min)
 	{
 		mid = min + (max - min) / 2;
@@ -0,0 +1,274 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+#include <libsv.h>
+#include <libsd.h>
+
+void sd_pipeinit(sdpipe *p, sr *r)
+{
+	p->r     = r;
+	p->pages = NULL;
+	p->iovv  = NULL;
+	p->count = 0;
+	p->used  = 0;
+	p->head  = 0;
+	p->tail  = 0;
+	p->next  = 0;
+	p->stop  = 0;
+	ss_mutexinit(&p->lock);
+	ss_condinit(&p->cond);
+	ss_condinit(&p->cond_done);
+	ss_threadpool_init(&p->tp);
+}
+
+static inline sdpipepage*
+sd_pipenext(sdpipe *p)
+{
+	sdpipepage *page = &p->pages[p->next];
+	if (page->state != SD_PIPEREADY)
+		return NULL;
+	page->state = SD_PIPEBUSY;
+	p->next = (p->next + 1) % p->count;
+	return page;
+}
+
+static inline void
+sd_pipeend(sdpipe *p, sdpipepage *page)
+{
+	/* page is owned by the caller, finish it
+	 * without holding the lock */
+	ss_mutexunlock(&p->lock);
+	int rc = sd_buildend(&page->build, p->r);
+	ss_mutexlock(&p->lock);
+	page->state = (rc == -1) ? SD_PIPEERROR : SD_PIPEDONE;
+}
+
+static void*
+sd_pipeworker(void *arg)
+{
+	ssthread *self = arg;
+	sdpipe *p = self->arg;
+	ss_mutexlock(&p->lock);
+	while (! p->stop) {
+		sdpipepage *page = sd_pipenext(p);
+		if (page == NULL) {
+			ss_condwait(&p->cond, &p->lock);
+			continue;
+		}
+		sd_pipeend(p, page);
+		ss_condsignal(&p->cond_done);
+	}
+	ss_mutexunlock(&p->lock);
+	return NULL;
+}
+
+int sd_pipeopen(sdpipe *p, int threads)
+{
+	sr *r = p->r;
+	p->count = threads * 2;
+	if (p->count < 2)
+		p->count = 2;
+	p->pages = ss_malloc(r->a, sizeof(sdpipepage) * p->count);
+	if (ssunlikely(p->pages == NULL))
+		goto oom;
+	p->iovv = ss_malloc(r->a, sizeof(struct iovec) * p->count * 2);
+	if (ssunlikely(p->iovv == NULL))
+		goto oom;
+	int i = 0;
+	while (i < p->count) {
+		sd_buildinit(&p->pages[i].build);
+		p->pages[i].size  = 0;
+		p->pages[i].state = SD_PIPEFREE;
+		i++;
+	}
+	/* merge thread finishes pages by itself
+	 * if workers could not be started */
+	int rc = ss_threadpool_new(&p->tp, r->a, threads, sd_pipeworker, p);
+	if (ssunlikely(rc == -1))
+		ss_threadpool_init(&p->tp);
+	return 0;
+oom:
+	if (p->pages) {
+		ss_free(r->a, p->pages);
+		p->pages = NULL;
+	}
+	p->count = 0;
+	return sr_oom_malfunction(r->e);
+}
+
+void sd_pipefree(sdpipe *p)
+{
+	sr *r = p->r;
+	ss_mutexlock(&p->lock);
+	p->stop = 1;
+	ss_condbroadcast(&p->cond);
+	ss_mutexunlock(&p->lock);
+	ss_threadpool_shutdown(&p->tp, r->a);
+	if (p->pages) {
+		int i = 0;
+		while (i < p->count) {
+			sd_buildfree(&p->pages[i].build, r);
+			i++;
+		}
+		ss_free(r->a, p->pages);
+		p->pages = NULL;
+	}
+	if (p->iovv) {
+		ss_free(r->a, p->iovv);
+		p->iovv = NULL;
+	}
+	ss_condfree(&p->cond);
+	ss_condfree(&p->cond_done);
+	ss_mutexfree(&p->lock);
+}
+
+static inline int
+sd_pipefill(sdpipe *p, sdmerge *m)
+{
+	sdpipepage *page = &p->pages[p->tail];
+	int rc = sd_mergefill(m, &page->build);
+	if (rc <= 0)
+		return rc;
+	/* account uncompressed size until the page is
+	 * written, to keep the node size limit */
+	page->size = ss_bufused(&page->build.m) +
+	             ss_bufused(&page->build.v);
+	m->inflight += page->size;
+	ss_mutexlock(&p->lock);
+	page->state = SD_PIPEREADY;
+	ss_condsignal(&p->cond);
+	ss_mutexunlock(&p->lock);
+	p->tail = (p->tail + 1) % p->count;
+	p->used++;
+	return 1;
+}
+
+static inline int
+sd_pipewait(sdpipe *p)
+{
+	sdpipepage *head = &p->pages[p->head];
+	ss_mutexlock(&p->lock);
+	for (;;) {
+		if (head->state == SD_PIPEREADY) {
+			/* no worker took the page yet */
+			sdpipepage *page = sd_pipenext(p);
+			assert(page == head);
+			sd_pipeend(p, page);
+			continue;
+		}
+		if (head->state != SD_PIPEBUSY)
+			break;
+		ss_condwait(&p->cond_done, &p->lock);
+	}
+	int rc = (head->state == SD_PIPEERROR) ? -1 : 0;
+	/* batch consecutive finished pages */
+	int count = 0;
+	if (rc == 0) {
+		int pos = p->head;
+		while (count < p->used && p->pages[pos].state == SD_PIPEDONE) {
+			pos = (pos + 1) % p->count;
+			count++;
+		}
+	}
+	ss_mutexunlock(&p->lock);
+	if (ssunlikely(rc == -1))
+		return -1;
+	return count;
+}
+
+static inline int
+sd_pipewrite(sdpipe *p, sdmerge *m, ssfile *file, sdio *io, int count)
+{
+	sr *r = p->r;
+	ssiov iov;
+	ss_iovinit(&iov, p->iovv, p->count * 2);
+	uint64_t start = sd_iosize(io, file);
+	uint64_t offset = start;
+	int pos = p->head;
+	int i = 0;
+	int rc;
+	while (i < count) {
+		sdpipepage *page = &p->pages[pos];
+		sdbuild *b = &page->build;
+		rc = sd_buildindex_add(m->build_index, r, b, offset);
+		if (ssunlikely(rc == -1))
+			return -1;
+		m->current   = m->build_index->build.total;
+		m->inflight -= page->size;
+		if (io->direct) {
+			rc = sd_writepage(r, file, io, b);
+			if (ssunlikely(rc == -1))
+				return -1;
+		} else
+		if (ss_bufused(&b->c) > 0) {
+			ss_iovadd(&iov, b->c.s, ss_bufused(&b->c));
+		} else {
+			ss_iovadd(&iov, b->m.s, ss_bufused(&b->m));
+			ss_iovadd(&iov, b->v.s, ss_bufused(&b->v));
+		}
+		if (ss_bufused(&b->c) > 0)
+			offset += ss_bufused(&b->c);
+		else
+			offset += ss_bufused(&b->m) + ss_bufused(&b->v);
+		pos = (pos + 1) % p->count;
+		i++;
+	}
+	if (ss_iovhas(&iov)) {
+		SS_INJECTION(r->i, SS_INJECTION_SD_BUILD_0,
+		             sr_malfunction(r->e, "%s", "error injection");
+		             return -1);
+		sr_throttle(r, offset - start);
+		rc = ss_filewritev(file, &iov);
+		if (ssunlikely(rc == -1)) {
+			sr_malfunction(r->e, "file '%s' write error: %s",
+			               ss_pathof(&file->path),
+			               strerror(errno));
+			return -1;
+		}
+	}
+	/* release written pages */
+	ss_mutexlock(&p->lock);
+	i = 0;
+	while (i < count) {
+		p->pages[p->head].state = SD_PIPEFREE;
+		p->head = (p->head + 1) % p->count;
+		p->used--;
+		i++;
+	}
+	ss_mutexunlock(&p->lock);
+	return 0;
+}
+
+int sd_pipemerge(sdpipe *p, sdmerge *m, ssfile *file, sdio *io)
+{
+	int eof = 0;
+	int rc;
+	for (;;) {
+		if (! eof && p->used < p->count) {
+			rc = sd_pipefill(p, m);
+			if (ssunlikely(rc == -1))
+				return -1;
+			if (rc == 0)
+				eof = 1;
+			continue;
+		}
+		if (p->used == 0)
+			break;
+		rc = sd_pipewait(p);
+		if (ssunlikely(rc == -1))
+			return -1;
+		rc = sd_pipewrite(p, m, file, io, rc);
+		if (ssunlikely(rc == -1))
+			return -1;
+	}
+	return 0;
+}
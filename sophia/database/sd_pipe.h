@@ -0,0 +1,58 @@
+#ifndef SD_PIPE_H_
+#define SD_PIPE_H_
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+/*
+	compaction write pipeline.
+
+	merge thread fills pages into a bounded ring,
+	pages are finished (crc and compression) by a pool of
+	threads and written back by the merge thread in
+	ring order, using a single write for every batch
+	of consecutive finished pages.
+*/
+
+typedef struct sdpipepage sdpipepage;
+typedef struct sdpipe sdpipe;
+
+#define SD_PIPEFREE  0
+#define SD_PIPEREADY 1
+#define SD_PIPEBUSY  2
+#define SD_PIPEDONE  3
+#define SD_PIPEERROR 4
+
+struct sdpipepage {
+	sdbuild  build;
+	uint32_t size;
+	int      state;
+};
+
+struct sdpipe {
+	sr           *r;
+	ssmutex       lock;
+	sscond        cond;
+	sscond        cond_done;
+	sdpipepage   *pages;
+	struct iovec *iovv;
+	int           count;
+	int           used;
+	int           head;
+	int           tail;
+	int           next;
+	int           stop;
+	ssthreadpool  tp;
+};
+
+void sd_pipeinit(sdpipe*, sr*);
+int  sd_pipeopen(sdpipe*, int);
+void sd_pipefree(sdpipe*);
+int  sd_pipemerge(sdpipe*, sdmerge*, ssfile*, sdio*);
+
+#endif
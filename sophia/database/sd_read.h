@@ -31,18 +31,52 @@ struct sdreadarg {
 	int         use_direct_io;
 	int         direct_io_page_size;
 	ssfilterif *compression_if;
+	sdpagecache *page_cache;
+	uint64_t    page_cache_id;
 	sr         *r;
 };
 
 struct sdread {
-	sdreadarg    ra;
-	sdindexpage *ref;
-	sdpage       page;
-	int          reads;
+	sdreadarg     ra;
+	sdindexpage  *ref;
+	sdpage        page;
+	sdpagecachev *page_cached;
+	int           reads;
 } sspacked;
 
+static inline void
+sd_read_unref(sdread *i)
+{
+	if (i->page_cached == NULL)
+		return;
+	sd_pagecache_unref(i->ra.page_cache, i->page_cached);
+	i->page_cached = NULL;
+}
+
 static inline int
-sd_read_page(sdread *i, sdindexpage *ref)
+sd_read_pagedelta(sdread *i)
+{
+	sdreadarg *arg = &i->ra;
+	sr *r = arg->r;
+	sdpageheader *h = i->page.h;
+	if (sslikely(! (h->flags & SD_PAGEDELTA)))
+		return 0;
+	uint32_t size = h->size;
+	if (arg->use_compression)
+		size = ss_bufused(arg->buf) - sizeof(sdpageheader);
+	int rc = sd_pagedelta_decode(h, r, (char*)h + sizeof(sdpageheader),
+	                             size, arg->buf_read);
+	if (ssunlikely(rc == -1)) {
+		sr_error(r->e, "db file '%s' page decode error",
+		         ss_pathof(&arg->file->path));
+		return -1;
+	}
+	sd_pageinit(&i->page, (sdpageheader*)arg->buf_read->s);
+	return 0;
+}
+
+static inline int
+sd_read_pagefile(sdread *i, sdindexpage *ref)
 {
 	sdreadarg *arg = &i->ra;
 	sr *r = arg->r;
@@ -96,18 +130,18 @@ sd_read_page(sdread *i, sdindexpage *ref)
 		}
 		ss_filterfree(&f);
 		sd_pageinit(&i->page, (sdpageheader*)arg->buf->s);
-		return 0;
+		return sd_read_pagedelta(i);
 	}
 
 	/* mmap */
 	if (arg->use_mmap) {
 		if (arg->use_mmap_copy) {
-			memcpy(arg->buf->s, arg->mmap->p + ref->offset, ref->sizeorigin);
+			memcpy(arg->buf->s, arg->mmap->p + ref->offset, ref->size);
 			sd_pageinit(&i->page, (sdpageheader*)(arg->buf->s));
 		} else {
 			sd_pageinit(&i->page, (sdpageheader*)(arg->mmap->p + ref->offset));
 		}
-		return 0;
+		return sd_read_pagedelta(i);
 	}
 
 	/* default */
@@ -119,6 +153,41 @@ sd_read_page(sdread *i, sdindexpage *ref)
 		return -1;
 	ss_bufadvance(arg->buf, ref->size);
 	sd_pageinit(&i->page, (sdpageheader*)page_pointer);
+	return sd_read_pagedelta(i);
+}
+
+static inline int
+sd_read_page(sdread *i, sdindexpage *ref)
+{
+	sdreadarg *arg = &i->ra;
+	sd_read_unref(i);
+
+	/* uncompressed mmap pages are accessed directly, so
+	 * only pread, decompression and delta decoding results
+	 * are cached */
+	sdpagecache *cache = arg->page_cache;
+	int cacheable = cache && sd_pagecache_enabled(cache) &&
+	                !arg->from_compaction;
+	if (cacheable && arg->use_mmap && !arg->use_compression) {
+		sdpageheader *h = (sdpageheader*)(arg->mmap->p + ref->offset);
+		cacheable = (h->flags & SD_PAGEDELTA) > 0;
+	}
+	if (! cacheable)
+		return sd_read_pagefile(i, ref);
+
+	sdpagecachev *v;
+	v = sd_pagecache_get(cache, arg->page_cache_id, ref->offset);
+	if (v == NULL) {
+		int rc = sd_read_pagefile(i, ref);
+		if (ssunlikely(rc == -1))
+			return -1;
+		v = sd_pagecache_add(cache, arg->page_cache_id, ref->offset,
+		                     (char*)i->page.h, ref->sizeorigin);
+		if (v == NULL)
+			return 0;
+	}
+	i->page_cached = v;
+	sd_pageinit(&i->page, (sdpageheader*)sd_pagecachev_pointer(v));
 	return 0;
 }
 
@@ -139,11 +208,10 @@ static inline void
 sd_read_next(ssiter*);
 
 static inline int
-sd_read_open(ssiter *iptr, sdreadarg *arg, char *key)
+sd_read_seek(ssiter *iptr, char *key, sdindexpage *current)
 {
 	sdread *i = (sdread*)iptr->priv;
-	i->reads = 0;
-	i->ra = *arg;
+	sdreadarg *arg = &i->ra;
 	ss_iterinit(sd_indexiter, arg->index_iter);
 	ss_iteropen(sd_indexiter, arg->index_iter, arg->r, arg->index,
 	            arg->o, key);
@@ -157,10 +225,18 @@ sd_read_open(ssiter *iptr, sdreadarg *arg, char *key)
 			return 0;
 		}
 	}
-	int rc = sd_read_openpage(i, key);
-	if (ssunlikely(rc == -1)) {
-		i->ref = NULL;
-		return -1;
+	int rc;
+	if (i->ref == current) {
+		/* page is already read */
+		ss_iterinit(sd_pageiter, arg->page_iter);
+		rc = ss_iteropen(sd_pageiter, arg->page_iter, arg->r,
+		                 &i->page, arg->o, key);
+	} else {
+		rc = sd_read_openpage(i, key);
+		if (ssunlikely(rc == -1)) {
+			i->ref = NULL;
+			return -1;
+		}
 	}
 	if (ssunlikely(! ss_iterhas(sd_pageiter, i->ra.page_iter))) {
 		sd_read_next(iptr);
@@ -169,10 +245,31 @@ sd_read_open(ssiter *iptr, sdreadarg *arg, char *key)
 	return rc;
 }
 
+static inline int
+sd_read_open(ssiter *iptr, sdreadarg *arg, char *key)
+{
+	sdread *i = (sdread*)iptr->priv;
+	i->reads = 0;
+	i->ra = *arg;
+	i->page_cached = NULL;
+	return sd_read_seek(iptr, key, NULL);
+}
+
+static inline int
+sd_read_reopen(ssiter *iptr, char *key)
+{
+	/* search for the next key, reuse current page
+	 * if the key belongs to it */
+	sdread *i = (sdread*)iptr->priv;
+	i->reads = 0;
+	return sd_read_seek(iptr, key, i->ref);
+}
+
 static inline void
 sd_read_close(ssiter *iptr)
 {
 	sdread *i = (sdread*)iptr->priv;
+	sd_read_unref(i);
 	i->ref = NULL;
 }
 
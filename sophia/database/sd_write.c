@@ -65,10 +65,12 @@ int sd_writepage(sr *r, ssfile *file, sdio *io, sdbuild *b)
 	if (ss_bufused(&b->c) > 0) {
 		/* compressed */
 		ss_iovadd(&iov, b->c.s, ss_bufused(&b->c));
+		sr_throttle(r, ss_bufused(&b->c));
 	} else {
 		/* uncompressed */
 		ss_iovadd(&iov, b->m.s, ss_bufused(&b->m));
 		ss_iovadd(&iov, b->v.s, ss_bufused(&b->v));
+		sr_throttle(r, ss_bufused(&b->m) + ss_bufused(&b->v));
 	}
 	rc = ss_filewritev(file, &iov);
 	if (ssunlikely(rc == -1)) {
@@ -16,6 +16,7 @@
 #include <se_document.h>
 #include <se_db.h>
 #include <se_tx.h>
+#include <se_batch.h>
 #include <se_cursor.h>
 #include <se_read.h>
 #include <se_recover.h>
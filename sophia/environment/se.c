@@ -39,7 +39,7 @@ se_worker(void *arg)
 		if (ssunlikely(rc == -1))
 			break;
 		if (ssunlikely(rc == 0))
-			ss_sleep(10000000); /* 10ms */
+			sc_wait(&e->scheduler);
 	}
 	sc_workerpool_push(&e->scheduler.wp, w);
 	return NULL;
@@ -119,6 +119,9 @@ se_destroy(so *o)
 	if (ssunlikely(rc == -1))
 		rcret = -1;
 	rc = so_pooldestroy(&e->tx);
+	if (ssunlikely(rc == -1))
+		rcret = -1;
+	rc = so_pooldestroy(&e->batch);
 	if (ssunlikely(rc == -1))
 		rcret = -1;
 	rc = so_pooldestroy(&e->confcursor_kv);
@@ -146,6 +149,9 @@ se_destroy(so *o)
 	sx_managerfree(&e->xm);
 	ss_vfsfree(&e->vfs);
 	si_cachepool_free(&e->cachepool);
+	sd_pagecache_free(&e->pagecache);
+	ss_ratefree(&e->rate);
+	sr_quotafree(&e->quota);
 	se_conffree(&e->conf);
 	ss_mutexfree(&e->apilock);
 
@@ -163,6 +169,13 @@ se_begin(so *o)
 	return se_txnew(e);
 }
 
+static void*
+se_batch(so *o)
+{
+	se *e = se_of(o);
+	return se_batchnew(e);
+}
+
 static void*
 se_cursor(so *o)
 {
@@ -185,7 +198,9 @@ static soif seif =
 	.upsert       = NULL,
 	.del          = NULL,
 	.get          = NULL,
+	.getmulti     = NULL,
 	.begin        = se_begin,
+	.batch        = se_batch,
 	.prepare      = NULL,
 	.commit       = NULL,
 	.cursor       = se_cursor,
@@ -209,6 +224,7 @@ so *se_new(void)
 	so_poolinit(&e->document, 1024);
 	so_poolinit(&e->cursor, 512);
 	so_poolinit(&e->tx, 512);
+	so_poolinit(&e->batch, 32);
 	so_poolinit(&e->confcursor, 2);
 	so_poolinit(&e->confcursor_kv, 1);
 	so_listinit(&e->db);
@@ -217,17 +233,22 @@ so *se_new(void)
 	sr_loginit(&e->log);
 	sr_errorinit(&e->error, &e->log);
 	sscrcf crc = ss_crc32c_function();
+	ss_rateinit(&e->rate);
+	sr_quotainit(&e->quota);
 	sr_init(&e->r, &e->status, &e->log, &e->error, &e->a, NULL,
 	        &e->vfs, &e->seq, NULL, NULL,
-	        &e->ei, NULL, crc, NULL);
+	        &e->ei, NULL, &e->rate, &e->quota, crc, NULL);
 	sy_init(&e->rep);
 	e->rep_conf = sy_conf(&e->rep);
 	sw_managerinit(&e->wm, &e->r);
 	e->wm_conf = sw_conf(&e->wm);
 	sr_statxm_init(&e->xm_stat);
 	sx_managerinit(&e->xm, &e->seq, &e->a);
-	si_cachepool_init(&e->cachepool, &e->r);
-	sc_init(&e->scheduler, &e->r, &e->wm);
+	rc = sd_pagecache_init(&e->pagecache, &e->a);
+	if (ssunlikely(rc == -1))
+		goto error;
+	si_cachepool_init(&e->cachepool, &e->pagecache, &e->r);
+	sc_init(&e->scheduler, &e->r, &e->quota, &e->wm);
 	return &e->o;
 error:
 	sr_statusfree(&e->status);
@@ -18,6 +18,7 @@ struct se {
 	sopool       document;
 	sopool       cursor;
 	sopool       tx;
+	sopool       batch;
 	sopool       confcursor;
 	sopool       confcursor_kv;
 	solist       db;
@@ -27,6 +28,9 @@ struct se {
 	ssa          a_oom;
 	ssa          a;
 	sicachepool  cachepool;
+	sdpagecache  pagecache;
+	ssrate       rate;
+	srquota      quota;
 	syconf      *rep_conf;
 	sy           rep;
 	swconf      *wm_conf;
@@ -0,0 +1,265 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+#include <libso.h>
+#include <libsv.h>
+#include <libsw.h>
+#include <libsd.h>
+#include <libsi.h>
+#include <libsx.h>
+#include <libsy.h>
+#include <libsc.h>
+#include <libse.h>
+
+static inline int
+se_batchwrite(sebatch *b, sedocument *o, uint8_t flags)
+{
+	se *e = se_of(&b->o);
+	sedb *db = se_cast(o->o.parent, sedb*, SEDB);
+
+	/* validate database status */
+	if (ssunlikely(! se_active(e)))
+		goto error;
+
+	/* create document */
+	int rc;
+	rc = se_document_validate(o, &db->o);
+	if (ssunlikely(rc == -1))
+		goto error;
+	rc = se_document_create(o, flags);
+	if (ssunlikely(rc == -1))
+		goto error;
+
+	svv *v = o->v;
+	sv_vref(v);
+	so_destroy(&o->o);
+
+	/* statements are only collected here, the
+	 * whole batch is applied on commit */
+	sebatchv bv = {
+		.db = db,
+		.v  = v
+	};
+	rc = ss_bufadd(&b->list, &e->a, &bv, sizeof(bv));
+	if (ssunlikely(rc == -1)) {
+		sv_vunref(db->r, v);
+		return sr_oom(&e->error);
+	}
+	return 0;
+error:
+	so_destroy(&o->o);
+	return -1;
+}
+
+static int
+se_batchset(so *o, so *v)
+{
+	sebatch *b = se_cast(o, sebatch*, SEBATCH);
+	sedocument *key = se_cast(v, sedocument*, SEDOCUMENT);
+	return se_batchwrite(b, key, 0);
+}
+
+static int
+se_batchupsert(so *o, so *v)
+{
+	sebatch *b = se_cast(o, sebatch*, SEBATCH);
+	sedocument *key = se_cast(v, sedocument*, SEDOCUMENT);
+	se *e = se_of(&b->o);
+	sedb *db = se_cast(v->parent, sedb*, SEDB);
+	if (! sf_upserthas(&db->scheme->upsert)) {
+		if (key->created <= 1)
+			so_destroy(v);
+		sr_error(&e->error, "%s", "upsert callback is not set");
+		return -1;
+	}
+	return se_batchwrite(b, key, SVUPSERT);
+}
+
+static int
+se_batchdelete(so *o, so *v)
+{
+	sebatch *b = se_cast(o, sebatch*, SEBATCH);
+	sedocument *key = se_cast(v, sedocument*, SEDOCUMENT);
+	return se_batchwrite(b, key, SVDELETE);
+}
+
+static inline void
+se_batchfree(so *o)
+{
+	assert(o->destroyed);
+	se *e = se_of(o);
+	sebatch *b = (sebatch*)o;
+	ss_buffree(&b->list, &e->a);
+	sv_logfree(&b->log, &e->r);
+	ss_free(&e->a, o);
+}
+
+static inline void
+se_batchunref(sebatch *b, sebatchv *from)
+{
+	sebatchv *end = (sebatchv*)b->list.p;
+	for (; from < end; from++)
+		sv_vunref(from->db->r, from->v);
+}
+
+static inline void
+se_batchend(sebatch *b, int rlb, int conflict)
+{
+	se *e = se_of(&b->o);
+	uint32_t count = ss_bufused(&b->list) / sizeof(sebatchv);
+	ss_bufreset(&b->list);
+	sv_logreset(&b->log, e->db.n);
+	sr_statxm(&e->xm_stat, b->start, count, rlb, conflict);
+	so_mark_destroyed(&b->o);
+	so_poolgc(&e->batch, &b->o);
+}
+
+static int
+se_batchdestroy(so *o)
+{
+	sebatch *b = se_cast(o, sebatch*, SEBATCH);
+	se_batchunref(b, (sebatchv*)b->list.s);
+	se_batchend(b, 1, 0);
+	return 0;
+}
+
+static int
+se_batchcommit(so *o)
+{
+	sebatch *b = se_cast(o, sebatch*, SEBATCH);
+	se *e = se_of(o);
+	if (ssunlikely(! se_active(e)))
+		return -1;
+	if (ssunlikely(ss_bufused(&b->list) == 0)) {
+		se_batchend(b, 0, 0);
+		return 0;
+	}
+	sebatchv *bv  = (sebatchv*)b->list.s;
+	sebatchv *end = (sebatchv*)b->list.p;
+
+	/* memory limit backpressure, unless the batch
+	 * only deletes (see se_dbwrite()) */
+	for (; bv < end; bv++) {
+		if (sv_vflags(bv->v, bv->db->r) & SVDELETE)
+			continue;
+		int rc = sc_quota(&e->scheduler);
+		if (ssunlikely(rc == -1)) {
+			se_batchunref(b, (sebatchv*)b->list.s);
+			se_batchend(b, 1, 0);
+			return -1;
+		}
+		break;
+	}
+
+	/* apply the batch as a single blind-write
+	 * transaction: one log record and one index
+	 * update per database (see se_txcommit()) */
+	sx x;
+	sx_txlock(&e->xm);
+	sx_begin(&e->xm, &x, SX_RW, &b->log, 0);
+	bv = (sebatchv*)b->list.s;
+	for (; bv < end; bv++) {
+		int rc = sx_set(&x, &bv->db->coindex, bv->v);
+		if (ssunlikely(rc == -1)) {
+			sx_rollback(&x);
+			sx_txunlock(&e->xm);
+			se_batchunref(b, bv + 1);
+			se_batchend(b, 1, 0);
+			return -1;
+		}
+	}
+	sxstate s = sx_prepare(&x, NULL, NULL);
+	if (ssunlikely(s != SX_PREPARE)) {
+		sx_rollback(&x);
+		sx_txunlock(&e->xm);
+		se_batchend(b, 1, 1);
+		return 1;
+	}
+	sx_commit(&x);
+	sxcommit c;
+	sx_commitbegin(&e->xm, &c, 0);
+	sx_gc(&x);
+	sx_txunlock(&e->xm);
+
+	/* wal write and multi-index write */
+	int rc = se_txapply(e, &b->log, &c, 0);
+	if (ssunlikely(rc == -1)) {
+		ssiter i;
+		ss_iterinit(ss_bufiter, &i);
+		ss_iteropen(ss_bufiter, &i, &b->log.buf, sizeof(svlogv));
+		for (; ss_iterhas(ss_bufiter, &i); ss_iternext(ss_bufiter, &i))
+		{
+			svlogv *lv = ss_iterof(ss_bufiter, &i);
+			sedb *db = (sedb*)se_dbmatch_id(e, lv->index_id);
+			assert(db != NULL);
+			sv_vunref(db->r, lv->v);
+		}
+	}
+	se_batchend(b, 0, 0);
+	return rc;
+}
+
+static soif sebatchif =
+{
+	.open         = NULL,
+	.destroy      = se_batchdestroy,
+	.free         = se_batchfree,
+	.document     = NULL,
+	.setstring    = NULL,
+	.setint       = NULL,
+	.getobject    = NULL,
+	.getstring    = NULL,
+	.getint       = NULL,
+	.set          = se_batchset,
+	.upsert       = se_batchupsert,
+	.del          = se_batchdelete,
+	.get          = NULL,
+	.getmulti     = NULL,
+	.begin        = NULL,
+	.batch        = NULL,
+	.prepare      = NULL,
+	.commit       = se_batchcommit,
+	.cursor       = NULL
+};
+
+so *se_batchnew(se *e)
+{
+	int cache;
+	sebatch *b = (sebatch*)so_poolpop(&e->batch);
+	if (! b) {
+		b = ss_malloc(&e->a, sizeof(sebatch));
+		cache = 0;
+	} else {
+		cache = 1;
+	}
+	if (ssunlikely(b == NULL)) {
+		sr_oom(&e->error);
+		return NULL;
+	}
+	so_init(&b->o, &se_o[SEBATCH], &sebatchif, &e->o, &e->o);
+	if (! cache) {
+		ss_bufinit(&b->list);
+		int rc = sv_loginit(&b->log, &e->r, e->db.n);
+		if (ssunlikely(rc == -1)) {
+			ss_free(&e->a, b);
+			return NULL;
+		}
+		sslist *i;
+		ss_listforeach(&e->db.list, i) {
+			sedb *db = (sedb*)sscast(i, so, link);
+			sv_loginit_index(&b->log, db->index->scheme.id, db->r);
+		}
+	}
+	b->start = ss_utime();
+	so_pooladd(&e->batch, &b->o);
+	return &b->o;
+}
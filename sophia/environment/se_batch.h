@@ -0,0 +1,29 @@
+#ifndef SE_BATCH_H_
+#define SE_BATCH_H_
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+typedef struct sebatchv sebatchv;
+typedef struct sebatch sebatch;
+
+struct sebatchv {
+	sedb *db;
+	svv  *v;
+};
+
+struct sebatch {
+	so o;
+	uint64_t start;
+	ssbuf list;
+	svlog log;
+};
+
+so *se_batchnew(se*);
+
+#endif
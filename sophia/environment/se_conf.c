@@ -164,13 +164,60 @@ se_confscheduler_run(srconf *c, srconfstmt *s)
 	return sc_ctl_call(&e->scheduler, vlsn);
 }
 
+static inline int
+se_confscheduler_ioset(srconfstmt *s, int64_t *value)
+{
+	se *e = s->ptr;
+	if (ssunlikely(s->valuetype != SS_I64)) {
+		sr_error(&e->error, "%s", "bad io limit value");
+		return -1;
+	}
+	*value = sscasti64(s->value);
+	if (ssunlikely(*value < 0)) {
+		sr_error(&e->error, "%s", "bad io limit value");
+		return -1;
+	}
+	return 0;
+}
+
+static inline int
+se_confscheduler_iolimit(srconf *c, srconfstmt *s)
+{
+	if (s->op != SR_WRITE)
+		return se_confv(c, s);
+	se *e = s->ptr;
+	int64_t limit;
+	if (ssunlikely(se_confscheduler_ioset(s, &limit) == -1))
+		return -1;
+	ss_rateset(&e->rate, limit, e->rate.burst);
+	return 0;
+}
+
+static inline int
+se_confscheduler_ioburst(srconf *c, srconfstmt *s)
+{
+	if (s->op != SR_WRITE)
+		return se_confv(c, s);
+	se *e = s->ptr;
+	int64_t burst;
+	if (ssunlikely(se_confscheduler_ioset(s, &burst) == -1))
+		return -1;
+	ss_rateset(&e->rate, e->rate.limit, burst);
+	return 0;
+}
+
 static inline srconf*
-se_confscheduler(se *e, srconf **pc, int serialize)
+se_confscheduler(se *e, seconfrt *rt, srconf **pc, int serialize)
 {
 	srconf *scheduler = *pc;
 	srconf *prev;
 	srconf *p = NULL;
 	sr_c(&p, pc, se_confv_offline, "threads", SS_U32, &e->conf.threads);
+	sr_C(&p, pc, se_confscheduler_iolimit, "io_limit", SS_U64, &rt->io_limit, 0, NULL);
+	sr_C(&p, pc, se_confscheduler_ioburst, "io_burst", SS_U64, &rt->io_burst, 0, NULL);
+	sr_C(&p, pc, se_confv, "io_written", SS_U64, &rt->io_written, SR_RO, NULL);
+	sr_C(&p, pc, se_confv, "io_throttle", SS_U64, &rt->io_throttle, SR_RO, NULL);
+	sr_C(&p, pc, se_confv, "io_throttle_wait", SS_U64, &rt->io_throttle_wait, SR_RO, NULL);
 	if (! serialize)
 		sr_c(&p, pc, se_confscheduler_run, "run", SS_FUNCTION, NULL);
 	prev = p;
@@ -203,6 +250,18 @@ se_conflog_gc(srconf *c, srconfstmt *s)
 	return sw_managergc(&e->wm);
 }
 
+static inline int
+se_conflog_wait(srconf *c, srconfstmt *s)
+{
+	if (s->op != SR_WRITE)
+		return se_confv(c, s);
+	se *e = s->ptr;
+	uint64_t lsn = 0;
+	if (s->valuetype == SS_I64)
+		lsn = sscasti64(s->value);
+	return sw_syncwait(&e->wm, lsn);
+}
+
 static inline srconf*
 se_conflog(se *e, seconfrt *rt, srconf **pc)
 {
@@ -213,12 +272,27 @@ se_conflog(se *e, seconfrt *rt, srconf **pc)
 	sr_c(&p, pc, se_confv_offline, "sync", SS_U32, &e->wm_conf->sync_on_write);
 	sr_c(&p, pc, se_confv_offline, "rotate_wm", SS_U32, &e->wm_conf->rotatewm);
 	sr_c(&p, pc, se_confv_offline, "rotate_sync", SS_U32, &e->wm_conf->sync_on_rotate);
+	sr_c(&p, pc, se_confv_offline, "async", SS_U32, &e->wm_conf->async);
+	sr_c(&p, pc, se_confv_offline, "async_interval", SS_U32, &e->wm_conf->async_interval);
+	sr_c(&p, pc, se_confv_offline, "async_wm", SS_U32, &e->wm_conf->async_wm);
+	sr_c(&p, pc, se_confv_offline, "recover_threads", SS_U32, &e->wm_conf->recover_threads);
 	sr_c(&p, pc, se_conflog_rotate, "rotate", SS_FUNCTION, NULL);
 	sr_c(&p, pc, se_conflog_gc, "gc", SS_FUNCTION, NULL);
+	sr_c(&p, pc, se_conflog_wait, "wait", SS_FUNCTION, NULL);
 	sr_C(&p, pc, se_confv, "files", SS_U32, &rt->log_files, SR_RO, NULL);
 	return sr_C(NULL, pc, NULL, "log", SS_UNDEF, log, SR_NS, NULL);
 }
 
+static inline int
+se_confxm_statreset(srconf *c, srconfstmt *s)
+{
+	if (s->op != SR_WRITE)
+		return se_confv(c, s);
+	se *e = s->ptr;
+	sr_statxm_reset(&e->xm_stat);
+	return 0;
+}
+
 static inline srconf*
 se_conftransaction(se *e ssunused, seconfrt *rt, srconf **pc)
 {
@@ -231,6 +305,10 @@ se_conftransaction(se *e ssunused, seconfrt *rt, srconf **pc)
 	sr_C(&p, pc, se_confv, "conflict", SS_U64, &rt->tx_stat.tx_conflict, SR_RO, NULL);
 	sr_C(&p, pc, se_confv, "lock", SS_U64, &rt->tx_stat.tx_lock, SR_RO, NULL);
 	sr_C(&p, pc, se_confv, "latency", SS_STRING, rt->tx_stat.tx_latency.sz, SR_RO, NULL);
+	sr_C(&p, pc, se_confv, "latency_p50", SS_U32, &rt->tx_stat.tx_latency_hist.p50, SR_RO, NULL);
+	sr_C(&p, pc, se_confv, "latency_p99", SS_U32, &rt->tx_stat.tx_latency_hist.p99, SR_RO, NULL);
+	sr_C(&p, pc, se_confv, "latency_p999", SS_U32, &rt->tx_stat.tx_latency_hist.p999, SR_RO, NULL);
+	sr_c(&p, pc, se_confxm_statreset, "latency_reset", SS_FUNCTION, NULL);
 	sr_C(&p, pc, se_confv, "log", SS_STRING, rt->tx_stat.tx_stmts.sz, SR_RO, NULL);
 	sr_C(&p, pc, se_confv, "vlsn", SS_U64, &rt->tx_vlsn, SR_RO, NULL);
 	sr_C(&p, pc, se_confv, "gc", SS_U32, &rt->tx_gc, SR_RO, NULL);
@@ -248,9 +326,98 @@ se_confmetric(se *e ssunused, seconfrt *rt, srconf **pc)
 	sr_C(&p, pc, se_confv, "dsn",  SS_U32, &rt->seq.dsn, SR_RO, NULL);
 	sr_C(&p, pc, se_confv, "bsn",  SS_U32, &rt->seq.bsn, SR_RO, NULL);
 	sr_C(&p, pc, se_confv, "lfsn", SS_U64, &rt->seq.lfsn, SR_RO, NULL);
+	sr_C(&p, pc, se_confv, "lsn_durable", SS_U64, &rt->lsn_durable, SR_RO, NULL);
 	return sr_C(NULL, pc, NULL, "metric", SS_UNDEF, metric, SR_NS, NULL);
 }
 
+static inline int
+se_confcache_limit(srconf *c, srconfstmt *s)
+{
+	if (s->op != SR_WRITE)
+		return se_confv(c, s);
+	se *e = s->ptr;
+	if (ssunlikely(s->valuetype != SS_I64)) {
+		sr_error(&e->error, "%s", "bad cache limit value");
+		return -1;
+	}
+	int64_t limit = sscasti64(s->value);
+	if (ssunlikely(limit < 0)) {
+		sr_error(&e->error, "%s", "bad cache limit value");
+		return -1;
+	}
+	sd_pagecache_setlimit(&e->pagecache, limit);
+	return 0;
+}
+
+static inline srconf*
+se_confcache(se *e ssunused, seconfrt *rt, srconf **pc)
+{
+	srconf *cache = *pc;
+	srconf *p = NULL;
+	sr_C(&p, pc, se_confcache_limit, "limit", SS_U64, &rt->cache_limit, 0, NULL);
+	sr_C(&p, pc, se_confv, "used", SS_U64, &rt->cache_used, SR_RO, NULL);
+	sr_C(&p, pc, se_confv, "pages", SS_U32, &rt->cache_pages, SR_RO, NULL);
+	sr_C(&p, pc, se_confv, "hit", SS_U64, &rt->cache_hit, SR_RO, NULL);
+	sr_C(&p, pc, se_confv, "miss", SS_U64, &rt->cache_miss, SR_RO, NULL);
+	sr_C(&p, pc, se_confv, "evict", SS_U64, &rt->cache_evict, SR_RO, NULL);
+	return sr_C(NULL, pc, NULL, "cache", SS_UNDEF, cache, SR_NS, NULL);
+}
+
+static inline int
+se_confmemory_limit(srconf *c, srconfstmt *s)
+{
+	if (s->op != SR_WRITE)
+		return se_confv(c, s);
+	se *e = s->ptr;
+	if (ssunlikely(s->valuetype != SS_I64)) {
+		sr_error(&e->error, "%s", "bad memory limit value");
+		return -1;
+	}
+	int64_t limit = sscasti64(s->value);
+	if (ssunlikely(limit < 0)) {
+		sr_error(&e->error, "%s", "bad memory limit value");
+		return -1;
+	}
+	e->quota.limit = limit;
+	/* stalled writers might be below the new limit */
+	sr_quotasignal(&e->quota);
+	return 0;
+}
+
+static inline int
+se_confmemory_limit_wm(srconf *c, srconfstmt *s)
+{
+	if (s->op != SR_WRITE)
+		return se_confv(c, s);
+	se *e = s->ptr;
+	if (ssunlikely(s->valuetype != SS_I64)) {
+		sr_error(&e->error, "%s", "bad memory watermark value");
+		return -1;
+	}
+	int64_t wm = sscasti64(s->value);
+	if (ssunlikely(wm <= 0 || wm > 100)) {
+		sr_error(&e->error, "%s", "bad memory watermark value");
+		return -1;
+	}
+	e->quota.limit_wm = wm;
+	return 0;
+}
+
+static inline srconf*
+se_confmemory(se *e, seconfrt *rt, srconf **pc)
+{
+	srconf *memory = *pc;
+	srconf *p = NULL;
+	sr_C(&p, pc, se_confmemory_limit, "limit", SS_U64, &rt->memory_limit, 0, NULL);
+	sr_C(&p, pc, se_confmemory_limit_wm, "limit_wm", SS_U32, &rt->memory_limit_wm, 0, NULL);
+	sr_c(&p, pc, se_confv, "stall_max", SS_U32, &e->quota.stall_max);
+	sr_C(&p, pc, se_confv, "used", SS_U64, &rt->memory_used, SR_RO, NULL);
+	sr_C(&p, pc, se_confv, "stall", SS_U64, &rt->memory_stall, SR_RO, NULL);
+	sr_C(&p, pc, se_confv, "stall_time", SS_U64, &rt->memory_stall_time, SR_RO, NULL);
+	sr_C(&p, pc, se_confv, "stall_error", SS_U64, &rt->memory_stall_error, SR_RO, NULL);
+	return sr_C(NULL, pc, NULL, "memory", SS_UNDEF, memory, SR_NS, NULL);
+}
+
 static inline int
 se_confdb_set(srconf *c ssunused, srconfstmt *s)
 {
@@ -380,6 +547,16 @@ se_confdb_gc(srconf *c, srconfstmt *s)
 	return sc_ctl_gc(&e->scheduler, db->index);
 }
 
+static inline int
+se_confdb_statreset(srconf *c, srconfstmt *s)
+{
+	if (s->op != SR_WRITE)
+		return se_confv(c, s);
+	sedb *db = c->value;
+	sr_statreset(&db->stat);
+	return 0;
+}
+
 static inline int
 se_confdb_expire(srconf *c, srconfstmt *s)
 {
@@ -488,9 +665,16 @@ se_confdb(se *e, seconfrt *rt ssunused, srconf **pc, int serialize)
 		sr_C(&p, pc, se_confv_dboffline, "node_size", SS_U64, &o->scheme->compaction.node_size, 0, o);
 		sr_C(&p, pc, se_confv_dboffline, "page_size", SS_U32, &o->scheme->compaction.node_page_size, 0, o);
 		sr_C(&p, pc, se_confv_dboffline, "page_checksum", SS_U32, &o->scheme->compaction.node_page_checksum, 0, o);
+		sr_C(&p, pc, se_confv_dboffline, "page_delta", SS_U32, &o->scheme->compaction.node_page_delta, 0, o);
+		sr_C(&p, pc, se_confv_dboffline, "page_prefix", SS_U32, &o->scheme->compaction.node_page_prefix, 0, o);
+		sr_C(&p, pc, se_confv_dboffline, "bloom_bits", SS_U32, &o->scheme->compaction.bloom_bits, 0, o);
 		sr_C(&p, pc, se_confv_dboffline, "expire_period", SS_U32, &o->scheme->compaction.expire_period, 0, o);
 		sr_C(&p, pc, se_confv_dboffline, "gc_wm", SS_U32, &o->scheme->compaction.gc_wm, 0, o);
 		sr_C(&p, pc, se_confv_dboffline, "gc_period", SS_U32, &o->scheme->compaction.gc_period, 0, o);
+		sr_C(&p, pc, se_confv_dboffline, "subcompactions", SS_U32, &o->scheme->compaction.subcompactions, 0, o);
+		sr_C(&p, pc, se_confv_dboffline, "pipeline", SS_U32, &o->scheme->compaction.pipeline, 0, o);
+		sr_C(&p, pc, se_confv_dboffline, "blob_threshold", SS_U32, &o->scheme->compaction.blob_threshold, 0, o);
+		sr_C(&p, pc, se_confv_dboffline, "blob_gc_wm", SS_U32, &o->scheme->compaction.blob_gc_wm, 0, o);
 		if (! serialize) {
 			sr_c(&p, pc, se_confdb_compaction, "compact", SS_FUNCTION, o);
 			sr_c(&p, pc, se_confdb_gc, "gc", SS_FUNCTION, o);
@@ -511,21 +695,34 @@ se_confdb(se *e, seconfrt *rt ssunused, srconf **pc, int serialize)
 		sr_C(&p, pc, se_confv, "field", SS_STRING, o->statrt.field.sz, SR_RO, NULL);
 		sr_C(&p, pc, se_confv, "set", SS_U64, &o->statrt.set, SR_RO, NULL);
 		sr_C(&p, pc, se_confv, "set_latency", SS_STRING, o->statrt.set_latency.sz, SR_RO, NULL);
+		sr_C(&p, pc, se_confv, "set_latency_p50", SS_U32, &o->statrt.set_latency_hist.p50, SR_RO, NULL);
+		sr_C(&p, pc, se_confv, "set_latency_p99", SS_U32, &o->statrt.set_latency_hist.p99, SR_RO, NULL);
+		sr_C(&p, pc, se_confv, "set_latency_p999", SS_U32, &o->statrt.set_latency_hist.p999, SR_RO, NULL);
 		sr_C(&p, pc, se_confv, "delete", SS_U64, &o->statrt.del, SR_RO, NULL);
 		sr_C(&p, pc, se_confv, "delete_latency", SS_STRING, o->statrt.del_latency.sz, SR_RO, NULL);
 		sr_C(&p, pc, se_confv, "upsert", SS_U64, &o->statrt.upsert, SR_RO, NULL);
 		sr_C(&p, pc, se_confv, "upsert_latency", SS_STRING, o->statrt.upsert_latency.sz, SR_RO, NULL);
 		sr_C(&p, pc, se_confv, "get", SS_U64, &o->statrt.get, SR_RO, NULL);
 		sr_C(&p, pc, se_confv, "get_latency", SS_STRING, o->statrt.get_latency.sz, SR_RO, NULL);
+		sr_C(&p, pc, se_confv, "get_latency_p50", SS_U32, &o->statrt.get_latency_hist.p50, SR_RO, NULL);
+		sr_C(&p, pc, se_confv, "get_latency_p99", SS_U32, &o->statrt.get_latency_hist.p99, SR_RO, NULL);
+		sr_C(&p, pc, se_confv, "get_latency_p999", SS_U32, &o->statrt.get_latency_hist.p999, SR_RO, NULL);
 		sr_C(&p, pc, se_confv, "get_read_disk", SS_STRING, o->statrt.get_read_disk.sz, SR_RO, NULL);
 		sr_C(&p, pc, se_confv, "get_read_cache", SS_STRING, o->statrt.get_read_cache.sz, SR_RO, NULL);
+		sr_C(&p, pc, se_confv, "get_bloom_skip", SS_U64, &o->rtp.bloom_skip, SR_RO, NULL);
+		sr_C(&p, pc, se_confv, "get_bloom_false", SS_U64, &o->rtp.bloom_false, SR_RO, NULL);
 		sr_C(&p, pc, se_confv, "pread", SS_U64, &o->statrt.pread, SR_RO, NULL);
 		sr_C(&p, pc, se_confv, "pread_latency", SS_STRING, o->statrt.pread_latency.sz, SR_RO, NULL);
 		sr_C(&p, pc, se_confv, "cursor", SS_U64, &o->statrt.cursor, SR_RO, NULL);
 		sr_C(&p, pc, se_confv, "cursor_latency", SS_STRING, o->statrt.cursor_latency.sz, SR_RO, NULL);
+		sr_C(&p, pc, se_confv, "cursor_latency_p50", SS_U32, &o->statrt.cursor_latency_hist.p50, SR_RO, NULL);
+		sr_C(&p, pc, se_confv, "cursor_latency_p99", SS_U32, &o->statrt.cursor_latency_hist.p99, SR_RO, NULL);
+		sr_C(&p, pc, se_confv, "cursor_latency_p999", SS_U32, &o->statrt.cursor_latency_hist.p999, SR_RO, NULL);
 		sr_C(&p, pc, se_confv, "cursor_read_disk", SS_STRING, o->statrt.cursor_read_disk.sz, SR_RO, NULL);
 		sr_C(&p, pc, se_confv, "cursor_read_cache", SS_STRING, o->statrt.cursor_read_cache.sz, SR_RO, NULL);
 		sr_C(&p, pc, se_confv, "cursor_ops", SS_STRING, o->statrt.cursor_ops.sz, SR_RO, NULL);
+		if (! serialize)
+			sr_c(&p, pc, se_confdb_statreset, "latency_reset", SS_FUNCTION, o);
 
 		/* scheduler */
 		srconf *scheduler = *pc;
@@ -538,6 +735,7 @@ se_confdb(se *e, seconfrt *rt ssunused, srconf **pc, int serialize)
 		srconf *index = *pc;
 		p = NULL;
 		sr_C(&p, pc, se_confv, "memory_used", SS_U64, &o->rtp.memory_used, SR_RO, NULL);
+		sr_C(&p, pc, se_confv, "index_memory_used", SS_U64, &o->rtp.index_memory_used, SR_RO, NULL);
 		sr_C(&p, pc, se_confv, "size", SS_U64, &o->rtp.total_node_size, SR_RO, NULL);
 		sr_C(&p, pc, se_confv, "size_uncompressed", SS_U64, &o->rtp.total_node_origin_size, SR_RO, NULL);
 		sr_C(&p, pc, se_confv, "count", SS_U64, &o->rtp.count, SR_RO, NULL);
@@ -546,6 +744,9 @@ se_confdb(se *e, seconfrt *rt ssunused, srconf **pc, int serialize)
 		sr_C(&p, pc, se_confv, "read_cache", SS_U64, &o->rtp.read_cache, SR_RO, NULL);
 		sr_C(&p, pc, se_confv, "node_count", SS_U32, &o->rtp.total_node_count, SR_RO, NULL);
 		sr_C(&p, pc, se_confv, "page_count", SS_U32, &o->rtp.total_page_count, SR_RO, NULL);
+		sr_C(&p, pc, se_confv, "blob_count", SS_U32, &o->rtp.blob_count, SR_RO, NULL);
+		sr_C(&p, pc, se_confv, "blob_size", SS_U64, &o->rtp.blob_size, SR_RO, NULL);
+		sr_C(&p, pc, se_confv, "blob_live", SS_U64, &o->rtp.blob_live, SR_RO, NULL);
 
 		/* scheme */
 		srconf *scheme = *pc;
@@ -568,6 +769,11 @@ se_confdb(se *e, seconfrt *rt ssunused, srconf **pc, int serialize)
 		sr_C(&p, pc, se_confv_dboffline, "sync", SS_U32, &o->scheme->sync, 0, o);
 		sr_C(&p, pc, se_confv_dboffline, "expire", SS_U32, &o->scheme->expire, 0, o);
 		sr_C(&p, pc, se_confv_dboffline, "compression", SS_STRINGPTR, &o->scheme->compression_sz, 0, o);
+		sr_C(&p, pc, se_confv_dboffline, "memtable", SS_STRINGPTR, &o->scheme->memtable_sz, 0, o);
+		sr_C(&p, pc, se_confv_dboffline, "memtable_arena", SS_U32, &o->scheme->memtable_arena, 0, o);
+		sr_C(&p, pc, se_confv_dboffline, "index_lazy", SS_U32, &o->scheme->index_lazy, 0, o);
+		sr_C(&p, pc, se_confv_dboffline, "index_cache", SS_U64, &o->scheme->index_cache, 0, o);
+		sr_C(&p, pc, se_confv_dboffline, "key_normalize", SS_U32, &o->scheme->key_normalize, 0, o);
 		sr_C(&p, pc, se_confdb_upsert, "comparator", SS_STRING, NULL, 0, o);
 		sr_C(&p, pc, se_confdb_upsertarg, "comparator_arg", SS_STRING, NULL, 0, o);
 		sr_C(&p, pc, se_confdb_upsert, "upsert", SS_STRING, NULL, 0, o);
@@ -656,6 +862,7 @@ se_confdebug(se *e, seconfrt *rt ssunused, srconf **pc)
 	sr_c(&p, pc, se_confv, "si_compaction_3", SS_U32, &e->ei.e[4]);
 	sr_c(&p, pc, se_confv, "si_compaction_4", SS_U32, &e->ei.e[5]);
 	sr_c(&p, pc, se_confv, "si_recover_0",    SS_U32, &e->ei.e[6]);
+	sr_c(&p, pc, se_confv, "si_compaction_5", SS_U32, &e->ei.e[7]);
 	sr_C(&prev, pc, NULL, "error_injection", SS_UNDEF, ei, SR_NS, NULL);
 	srconf *debug = prev;
 	return sr_C(NULL, pc, NULL, "debug", SS_UNDEF, debug, SR_NS, NULL);
@@ -667,9 +874,11 @@ se_confprepare(se *e, seconfrt *rt, srconf *c, int serialize)
 	srconf *pc = c;
 	srconf *sophia      = se_confsophia(e, rt, &pc);
 	srconf *backup      = se_confbackup(e, rt, &pc);
-	srconf *scheduler   = se_confscheduler(e, &pc, serialize);
+	srconf *scheduler   = se_confscheduler(e, rt, &pc, serialize);
 	srconf *transaction = se_conftransaction(e, rt, &pc);
 	srconf *metric      = se_confmetric(e, rt, &pc);
+	srconf *cache       = se_confcache(e, rt, &pc);
+	srconf *memory      = se_confmemory(e, rt, &pc);
 	srconf *log         = se_conflog(e, rt, &pc);
 	srconf *db          = se_confdb(e, rt, &pc, serialize);
 	srconf *debug       = se_confdebug(e, rt, &pc);
@@ -678,7 +887,9 @@ se_confprepare(se *e, seconfrt *rt, srconf *c, int serialize)
 	backup->next      = scheduler;
 	scheduler->next   = transaction;
 	transaction->next = metric;
-	metric->next      = log;
+	metric->next      = cache;
+	cache->next       = memory;
+	memory->next      = log;
 	log->next         = db;
 	if (! serialize)
 		db->next = debug;
@@ -705,6 +916,15 @@ se_confrt(se *e, seconfrt *rt)
 	rt->errors = e->error.errors;
 	ss_spinunlock(&e->error.lock);
 
+	/* scheduler */
+	ss_mutexlock(&e->rate.lock);
+	rt->io_limit         = e->rate.limit;
+	rt->io_burst         = e->rate.burst;
+	rt->io_written       = e->rate.total;
+	rt->io_throttle      = e->rate.wait_count;
+	rt->io_throttle_wait = e->rate.wait;
+	ss_mutexunlock(&e->rate.lock);
+
 	/* log */
 	rt->log_files = sw_managerfiles(&e->wm);
 
@@ -719,10 +939,31 @@ se_confrt(se *e, seconfrt *rt)
 	sr_seqlock(&e->seq);
 	rt->seq = e->seq;
 	sr_sequnlock(&e->seq);
+	rt->lsn_durable = sw_managerdurable(&e->wm);
+
+	/* cache */
+	ss_spinlock(&e->pagecache.lock);
+	rt->cache_limit = e->pagecache.limit;
+	rt->cache_used  = e->pagecache.used;
+	rt->cache_pages = e->pagecache.count;
+	rt->cache_hit   = e->pagecache.hit;
+	rt->cache_miss  = e->pagecache.miss;
+	rt->cache_evict = e->pagecache.evict;
+	ss_spinunlock(&e->pagecache.lock);
+
+	/* memory */
+	ss_mutexlock(&e->quota.lock);
+	rt->memory_limit       = e->quota.limit;
+	rt->memory_limit_wm    = e->quota.limit_wm;
+	rt->memory_stall       = e->quota.stall;
+	rt->memory_stall_time  = e->quota.stall_time;
+	rt->memory_stall_error = e->quota.stall_error;
+	ss_mutexunlock(&e->quota.lock);
+	rt->memory_used = sr_quotaused(&e->quota);
 
 	/* transaction */
-	sr_statxm_prepare(&e->xm_stat);
-	rt->tx_stat = e->xm_stat;
+	sr_statxm_copy(&e->xm_stat, &rt->tx_stat);
+	sr_statxm_prepare(&rt->tx_stat);
 	rt->tx_ro   = e->xm.count_rd;
 	rt->tx_rw   = e->xm.count_rw;
 	rt->tx_gc   = e->xm.count_gc;
@@ -734,7 +975,7 @@ static inline int
 se_confensure(seconf *c)
 {
 	se *e = (se*)c->env;
-	int confmax = 2048 + (e->db.n * 100) + c->threads;
+	int confmax = 2048 + (e->db.n * 160) + c->threads;
 	confmax *= sizeof(srconf);
 	if (sslikely(confmax <= c->confmax))
 		return 0;
@@ -749,11 +990,14 @@ se_confensure(seconf *c)
 
 int se_confserialize(seconf *c, ssbuf *buf)
 {
+	se *e = (se*)c->env;
+	se_apilock(&e->o);
 	int rc;
 	rc = se_confensure(c);
-	if (ssunlikely(rc == -1))
+	if (ssunlikely(rc == -1)) {
+		se_apiunlock(&e->o);
 		return -1;
-	se *e = (se*)c->env;
+	}
 	seconfrt rt;
 	se_confrt(e, &rt);
 	srconf *conf = c->conf;
@@ -769,7 +1013,9 @@ int se_confserialize(seconf *c, ssbuf *buf)
 		.ptr       = e,
 		.r         = &e->r
 	};
-	return sr_confexec(root, &stmt);
+	rc = sr_confexec(root, &stmt);
+	se_apiunlock(&e->o);
+	return rc;
 }
 
 static int
@@ -777,10 +1023,15 @@ se_confquery(se *e, int op, const char *path,
              sstype valuetype, void *value, int valuesize,
              int *size)
 {
+	/* configuration tree is shared, serialize
+	 * concurrent queries */
+	se_apilock(&e->o);
 	int rc;
 	rc = se_confensure(&e->conf);
-	if (ssunlikely(rc == -1))
+	if (ssunlikely(rc == -1)) {
+		se_apiunlock(&e->o);
 		return -1;
+	}
 	seconfrt rt;
 	se_confrt(e, &rt);
 	srconf *conf = e->conf.conf;
@@ -797,6 +1048,7 @@ se_confquery(se *e, int op, const char *path,
 		.r         = &e->r
 	};
 	rc = sr_confexec(root, &stmt);
+	se_apiunlock(&e->o);
 	if (size)
 		*size = stmt.valuesize;
 	return rc;
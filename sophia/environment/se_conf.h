@@ -23,10 +23,30 @@ struct seconfrt {
 	uint32_t backup_active;
 	uint32_t backup_last;
 	uint32_t backup_last_complete;
+	uint64_t io_limit;
+	uint64_t io_burst;
+	uint64_t io_written;
+	uint64_t io_throttle;
+	uint64_t io_throttle_wait;
 	/* log */
 	uint32_t log_files;
 	/* metric */
 	srseq    seq;
+	uint64_t lsn_durable;
+	/* cache */
+	uint64_t cache_limit;
+	uint64_t cache_used;
+	uint32_t cache_pages;
+	uint64_t cache_hit;
+	uint64_t cache_miss;
+	uint64_t cache_evict;
+	/* memory */
+	uint64_t memory_limit;
+	uint32_t memory_limit_wm;
+	uint64_t memory_used;
+	uint64_t memory_stall;
+	uint64_t memory_stall_time;
+	uint64_t memory_stall_error;
 	/* transaction */
 	srstatxm tx_stat;
 	uint32_t tx_ro;
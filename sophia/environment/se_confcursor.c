@@ -78,7 +78,9 @@ static soif seconfkvif =
 	.upsert       = NULL,
 	.del          = NULL,
 	.get          = NULL,
+	.getmulti     = NULL,
 	.begin        = NULL,
+	.batch        = NULL,
 	.prepare      = NULL,
 	.commit       = NULL,
 	.cursor       = NULL,
@@ -185,7 +187,9 @@ static soif seconfcursorif =
 	.upsert       = NULL,
 	.del          = NULL,
 	.get          = se_confcursor_get,
+	.getmulti     = NULL,
 	.begin        = NULL,
+	.batch        = NULL,
 	.prepare      = NULL,
 	.commit       = NULL,
 	.cursor       = NULL,
@@ -33,7 +33,9 @@ se_cursordestroy(so *o)
 {
 	secursor *c = se_cast(o, secursor*, SECURSOR);
 	se *e = se_of(&c->o);
+	sx_txlock(&e->xm);
 	sx_rollback(&c->t);
+	sx_txunlock(&e->xm);
 	if (c->cache)
 		si_cachepool_push(c->cache);
 	if (c->read_db) {
@@ -82,7 +84,9 @@ static soif secursorif =
 	.upsert       = NULL,
 	.del          = NULL,
 	.get          = se_cursorget,
+	.getmulti     = NULL,
 	.begin        = NULL,
+	.batch        = NULL,
 	.prepare      = NULL,
 	.commit       = NULL,
 	.cursor       = NULL,
@@ -46,10 +46,18 @@ se_dbscheme_init(sedb *db, char *name, int size)
 	scheme->compression_if        = &ss_nonefilter;
 	scheme->expire                = 0;
 	scheme->buf_gc_wm             = 1024 * 1024;
+	scheme->memtable              = SV_INDEXRB;
+	scheme->memtable_arena        = 0;
+	scheme->index_lazy            = 0;
+	scheme->index_cache           = 0;
+	scheme->key_normalize         = 0;
 	scheme->compression_sz =
 		ss_strdup(&e->a, scheme->compression_if->name);
 	if (ssunlikely(scheme->compression_sz == NULL))
 		goto error;
+	scheme->memtable_sz = ss_strdup(&e->a, "rbtree");
+	if (ssunlikely(scheme->memtable_sz == NULL))
+		goto error;
 	sf_upsertinit(&scheme->upsert);
 	sf_schemeinit(&scheme->scheme);
 	return 0;
@@ -94,6 +102,20 @@ se_dbscheme_set(sedb *db)
 			return sr_oom(&e->error);
 		}
 	}
+	/* normalized key */
+	if (s->key_normalize) {
+		if (s->scheme.cmp) {
+			sr_error(&e->error, "%s", "incompatible options: comparator "
+			         "and key_normalize");
+			return -1;
+		}
+		rc = sf_schemenormalize(&s->scheme, &e->a);
+		if (ssunlikely(rc == -1)) {
+			sr_error(&e->error, "%s", "key_normalize: field '_key' "
+			         "is already set");
+			return -1;
+		}
+	}
 	/* validate scheme and set keys */
 	rc = sf_schemevalidate(&s->scheme, &e->a);
 	if (ssunlikely(rc == -1)) {
@@ -113,6 +135,17 @@ se_dbscheme_set(sedb *db)
 		return -1;
 	}
 	s->compression = s->compression_if != &ss_nonefilter;
+	/* memory index */
+	if (strcmp(s->memtable_sz, "rbtree") == 0) {
+		s->memtable = SV_INDEXRB;
+	} else
+	if (strcmp(s->memtable_sz, "skiplist") == 0) {
+		s->memtable = SV_INDEXSKIPLIST;
+	} else {
+		sr_error(&e->error, "unknown memtable type '%s'",
+		         s->memtable_sz);
+		return -1;
+	}
 	/* path */
 	if (s->path == NULL) {
 		char path[1024];
@@ -130,10 +163,40 @@ se_dbscheme_set(sedb *db)
 	}
 	/* compaction settings */
 	sicompaction *c = &s->compaction;
+	/* value separation */
+	if (c->blob_threshold) {
+		if (sf_schemefixed(&s->scheme)) {
+			sr_error(&e->error, "%s", "blob_threshold requires a "
+			         "variable size field");
+			return -1;
+		}
+		if (sf_upserthas(&s->upsert)) {
+			sr_error(&e->error, "%s", "incompatible options: upsert "
+			         "and blob_threshold");
+			return -1;
+		}
+	}
+	/* page delta encoding */
+	if (c->node_page_delta) {
+		if (sd_pagedelta_var(&s->scheme) == -1) {
+			sr_error(&e->error, "%s", "page_delta requires a string "
+			         "key or key_normalize");
+			return -1;
+		}
+	}
 	/* convert periodic times from sec to usec */
 	c->gc_period_us     = c->gc_period * 1000000;
 	c->expire_period_us = c->expire_period * 1000000;
 
+	/* versions are allocated in the database arena, memory
+	 * quota accounts arena chunks instead of versions, since
+	 * a single live version keeps the whole chunk */
+	if (s->memtable_arena > 0) {
+		ss_aopen(&db->a, &ss_arenaa, &e->a, s->memtable_arena,
+		         &e->quota.used);
+		db->r->quota = NULL;
+	}
+
 	/* .. */
 	db->r->scheme = &s->scheme;
 	db->r->upsert = &s->upsert;
@@ -174,7 +237,6 @@ se_dbfree(sedb *db)
 	if (ssunlikely(rc == -1))
 		rcret = -1;
 	sf_limitfree(&db->limit, &e->a);
-	sr_statfree(&db->stat);
 	sx_indexfree(&db->coindex, &e->xm);
 	ss_aclose(&db->a);
 	so_mark_destroyed(&db->o);
@@ -200,8 +262,15 @@ se_dbwrite(sedb *db, sedocument *o, uint8_t flags)
 	if (ssunlikely(! se_active(e)))
 		goto error;
 
-	/* create document */
+	/* memory limit backpressure */
 	int rc;
+	if (! (flags & SVDELETE)) {
+		rc = sc_quota(&e->scheduler);
+		if (ssunlikely(rc == -1))
+			goto error;
+	}
+
+	/* create document */
 	rc = se_document_validate(o, &db->o);
 	if (ssunlikely(rc == -1))
 		goto error;
@@ -220,24 +289,30 @@ se_dbwrite(sedb *db, sedocument *o, uint8_t flags)
 		return -1;
 	sv_loginit_index(&log, db->index->scheme.id, db->r);
 
+	/* see se_txcommit() */
 	sx x;
+	sx_txlock(&e->xm);
 	sxstate state =
 		sx_set_autocommit(&e->xm, &db->coindex, &x, &log, v);
 	if (ssunlikely(state != SX_COMMIT)) {
 		/* rollback */
+		sx_txunlock(&e->xm);
 		sv_logfree(&log, db->r);
 		return 1;
 	}
 
+	sxcommit c;
+	sx_commitbegin(&e->xm, &c, 0);
+	sx_gc(&x);
+	sx_txunlock(&e->xm);
+
 	/* write wal and index */
-	rc = sc_commit(&e->scheduler, &log, 0, 0);
+	rc = se_txapply(e, &log, &c, 0);
 	if (ssunlikely(rc == -1)) {
 		svlogv *lv = sv_logat(&log, 0);
 		sv_vunref(db->r, lv->v);
 	}
 	sv_logfree(&log, db->r);
-
-	sx_gc(&x);
 	return rc;
 
 error:
@@ -290,8 +365,32 @@ se_dbget(so *o, so *v)
 {
 	sedb *db = se_cast(o, sedb*, SEDB);
 	sedocument *key = se_cast(v, sedocument*, SEDOCUMENT);
-	uint64_t vlsn = sr_seq(db->r->seq, SR_LSN);
-	return se_read(db, key, NULL, vlsn, NULL);
+	se *e = se_of(&db->o);
+	/* read the last fully applied commit, register
+	 * read-only transaction to keep versions of the
+	 * snapshot from being purged by compaction
+	 * (see se_readmulti()) */
+	svlog log;
+	sv_loginit(&log, &e->r, 0);
+	sx t;
+	sx_begin(&e->xm, &t, SX_RO, &log, UINT64_MAX);
+	so *ret = se_read(db, key, NULL, t.vlsn, NULL);
+	sx_txlock(&e->xm);
+	sx_rollback(&t);
+	sx_txunlock(&e->xm);
+	return ret;
+}
+
+static int
+se_dbgetmulti(so *o, so **v, int count)
+{
+	sedb *db = se_cast(o, sedb*, SEDB);
+	int i = 0;
+	while (i < count) {
+		se_cast(v[i], sedocument*, SEDOCUMENT);
+		i++;
+	}
+	return se_readmulti(db, (sedocument**)v, count);
 }
 
 static void*
@@ -317,7 +416,9 @@ static soif sedbif =
 	.upsert       = se_dbupsert,
 	.del          = se_dbdel,
 	.get          = se_dbget,
+	.getmulti     = se_dbgetmulti,
 	.begin        = NULL,
+	.batch        = NULL,
 	.prepare      = NULL,
 	.commit       = NULL,
 	.cursor       = NULL,
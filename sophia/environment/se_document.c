@@ -455,7 +455,9 @@ static soif sedocumentif =
 	.upsert       = NULL,
 	.del          = NULL,
 	.get          = NULL,
+	.getmulti     = NULL,
 	.begin        = NULL,
+	.batch        = NULL,
 	.prepare      = NULL,
 	.commit       = NULL,
 	.cursor       = NULL,
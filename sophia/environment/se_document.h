@@ -17,7 +17,7 @@ struct sedocument {
 	svv      *v;
 	ssorder   order;
 	int       orderset;
-	sfv       fields[8];
+	sfv       fields[16];
 	int       fields_count;
 	int       fields_count_keys;
 	void     *prefix;
@@ -31,5 +31,6 @@ sotype se_o[] =
 	{ 0x2FABCDE2L, "document"        },
 	{ 0x34591111L, "database"        },
 	{ 0x13491FABL, "transaction"     },
-	{ 0x45ABCDFAL, "cursor"          }
+	{ 0x45ABCDFAL, "cursor"          },
+	{ 0x2B1A5C07L, "batch"           }
 };
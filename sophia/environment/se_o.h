@@ -19,7 +19,8 @@ enum {
 	SEDOCUMENT,
 	SEDB,
 	SETX,
-	SECURSOR
+	SECURSOR,
+	SEBATCH
 };
 
 extern sotype se_o[];
@@ -31,7 +32,7 @@ se_cast_validate(void *ptr)
 {
 	so *o = ptr;
 	if ((char*)o->type >= (char*)&se_o[0] &&
-	    (char*)o->type <= (char*)&se_o[SECURSOR])
+	    (char*)o->type <= (char*)&se_o[SEBATCH])
 		return ptr;
 	return NULL;
 }
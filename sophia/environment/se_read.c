@@ -83,7 +83,9 @@ so *se_read(sedb *db, sedocument *o, sx *x, uint64_t vlsn,
 	if (x && o->order == SS_EQ) {
 		/* note: prefix is ignored during concurrent
 		 * index search */
+		sx_txlock(&e->xm);
 		int rc = sx_get(x, &db->coindex, o->v, &vup);
+		sx_txunlock(&e->xm);
 		if (ssunlikely(rc == -1 || rc == 2 /* delete */))
 			goto error;
 		if (rc == 1 && !sf_is(db->r->scheme, sv_vpointer(vup), SVUPSERT))
@@ -154,3 +156,109 @@ error:
 	return NULL;
 }
 
+
+static int
+se_readmulti_snapshot(sedb *db, sedocument **keys, int count, uint64_t vlsn)
+{
+	se *e = se_of(&db->o);
+	int i;
+
+	/* range, prefix and upsert reads are processed
+	 * one by one */
+	int batch = !sf_upserthas(&db->scheme->upsert);
+	for (i = 0; i < count; i++) {
+		sedocument *o = keys[i];
+		if (o->order != SS_EQ || o->prefix)
+			batch = 0;
+	}
+	if (! batch) {
+		for (i = 0; i < count; i++)
+			keys[i] = (sedocument*)se_read(db, keys[i], NULL, vlsn, NULL);
+		return 0;
+	}
+	if (ssunlikely(! se_active(e)))
+		goto error;
+
+	uint64_t start = ss_utime();
+
+	/* prepare keys */
+	int rc;
+	for (i = 0; i < count; i++) {
+		sedocument *o = keys[i];
+		rc = se_document_validate_ro(o, &db->o);
+		if (ssunlikely(rc == -1))
+			goto error;
+		rc = se_document_createkey(o);
+		if (ssunlikely(rc == -1))
+			goto error;
+	}
+	sireadkey *list = ss_malloc(&e->a, sizeof(sireadkey) * count);
+	if (ssunlikely(list == NULL)) {
+		sr_oom(&e->error);
+		goto error;
+	}
+	for (i = 0; i < count; i++) {
+		sireadkey *k = &list[i];
+		k->key        = sv_vpointer(keys[i]->v);
+		k->pos        = i;
+		k->rc         = 0;
+		k->read_disk  = 0;
+		k->read_cache = 0;
+		k->result     = NULL;
+	}
+	sicache *cache = si_cachepool_pop(&e->cachepool);
+	if (ssunlikely(cache == NULL)) {
+		ss_free(&e->a, list);
+		sr_oom(&e->error);
+		goto error;
+	}
+	sx_get_autocommit(&e->xm, &db->coindex);
+
+	/* do read */
+	siread rq;
+	si_readopen(&rq, db->index, cache, SS_EQ,
+	            vlsn, NULL, NULL, NULL, 0, 0, start);
+	rc = si_readmulti(&rq, list, count);
+	si_readclose(&rq);
+	si_cachepool_push(cache);
+
+	/* prepare results */
+	for (i = 0; i < count; i++) {
+		sireadkey *k = &list[i];
+		sedocument *ret = NULL;
+		if (rc == 0 && k->rc == 1) {
+			rq.result     = k->result;
+			rq.read_disk  = k->read_disk;
+			rq.read_cache = k->read_cache;
+			ret = (sedocument*)se_readresult(e, db, &rq);
+		}
+		if (ret == NULL && k->result)
+			sv_vunref(db->r, k->result);
+		so_destroy(&keys[k->pos]->o);
+		keys[k->pos] = ret;
+	}
+	ss_free(&e->a, list);
+	return rc;
+error:
+	for (i = 0; i < count; i++) {
+		so_destroy(&keys[i]->o);
+		keys[i] = NULL;
+	}
+	return -1;
+}
+
+int se_readmulti(sedb *db, sedocument **keys, int count)
+{
+	se *e = se_of(&db->o);
+	/* register read-only transaction to keep versions
+	 * of the snapshot from being purged by compaction */
+	svlog log;
+	sv_loginit(&log, &e->r, 0);
+	sx t;
+	sx_begin(&e->xm, &t, SX_RO, &log, UINT64_MAX);
+	int rc = se_readmulti_snapshot(db, keys, count, t.vlsn);
+	sx_txlock(&e->xm);
+	sx_rollback(&t);
+	sx_txunlock(&e->xm);
+	return rc;
+}
@@ -10,5 +10,6 @@
 */
 
 so *se_read(sedb*, sedocument*, sx*, uint64_t, sicache*);
+int se_readmulti(sedb*, sedocument**, int);
 
 #endif
@@ -20,14 +20,240 @@
 #include <libsc.h>
 #include <libse.h>
 
+/* log records are parsed by the recovering thread and
+ * accumulated into a batch, where they are grouped by
+ * database. A batch is applied by the replay workers:
+ * each database is written by a single thread in log order,
+ * different databases are written in parallel. */
+
+#define SE_RECOVER_BATCH 65536
+
+typedef struct serecover serecover;
+
+struct serecover {
+	se          *e;
+	svlog        log;
+	ssbuf        stmt;
+	uint64_t     lsn;
+	int          processed;
+	ssmutex      lock;
+	sscond       cond;
+	sscond       cond_done;
+	uint32_t     round;
+	int          next;
+	int          pending;
+	int          stop;
+	ssthreadpool tp;
+};
+
+static inline void
+se_recover_apply(serecover *r, svlogindex *li)
+{
+	si *index = li->r->ptr;
+	sitx x;
+	si_begin(&x, index);
+	si_write(&x, &r->log, li, 1);
+	si_commit(&x);
+}
+
+static inline int
+se_recover_applynext(serecover *r)
+{
+	svlogindex *li = NULL;
+	ss_mutexlock(&r->lock);
+	int count = r->e->db.n;
+	while (r->next < count) {
+		li = sv_logindex(&r->log, r->next);
+		r->next++;
+		if (li->count > 0)
+			break;
+		li = NULL;
+	}
+	ss_mutexunlock(&r->lock);
+	if (li == NULL)
+		return 0;
+	se_recover_apply(r, li);
+	ss_mutexlock(&r->lock);
+	r->pending--;
+	if (r->pending == 0)
+		ss_condsignal(&r->cond_done);
+	ss_mutexunlock(&r->lock);
+	return 1;
+}
+
+static void*
+se_recover_worker(void *arg)
+{
+	ssthread *self = arg;
+	serecover *r = self->arg;
+	uint32_t round = 0;
+	for (;;) {
+		ss_mutexlock(&r->lock);
+		while (r->round == round && !r->stop)
+			ss_condwait(&r->cond, &r->lock);
+		if (r->stop) {
+			ss_mutexunlock(&r->lock);
+			break;
+		}
+		round = r->round;
+		ss_mutexunlock(&r->lock);
+		while (se_recover_applynext(r));
+	}
+	return NULL;
+}
+
+static int
+se_recover_flush(serecover *r)
+{
+	se *e = r->e;
+	if (sv_logcount(&r->log) == 0)
+		return 0;
+	if (r->tp.n == 0) {
+		int id = 0;
+		while (id < e->db.n) {
+			svlogindex *li = sv_logindex(&r->log, id);
+			if (li->count > 0)
+				se_recover_apply(r, li);
+			id++;
+		}
+	} else {
+		int pending = 0;
+		int id = 0;
+		while (id < e->db.n) {
+			if (sv_logindex(&r->log, id)->count > 0)
+				pending++;
+			id++;
+		}
+		ss_mutexlock(&r->lock);
+		r->next = 0;
+		r->pending = pending;
+		r->round++;
+		ss_condbroadcast(&r->cond);
+		ss_mutexunlock(&r->lock);
+		/* take part in the replay */
+		while (se_recover_applynext(r));
+		ss_mutexlock(&r->lock);
+		while (r->pending > 0)
+			ss_condwait(&r->cond_done, &r->lock);
+		ss_mutexunlock(&r->lock);
+	}
+	sw_managerreplay(&e->wm, r->lsn);
+	sv_logreset(&r->log, e->db.n);
+	return 0;
+}
+
+static int
+se_recover_init(serecover *r, se *e)
+{
+	r->e         = e;
+	r->lsn       = 0;
+	r->processed = 0;
+	r->round     = 0;
+	r->next      = 0;
+	r->pending   = 0;
+	r->stop      = 0;
+	ss_bufinit(&r->stmt);
+	ss_mutexinit(&r->lock);
+	ss_condinit(&r->cond);
+	ss_condinit(&r->cond_done);
+	ss_threadpool_init(&r->tp);
+	int rc = sv_loginit(&r->log, &e->r, e->db.n);
+	if (ssunlikely(rc == -1))
+		return sr_oom_malfunction(&e->error);
+	sslist *i;
+	ss_listforeach(&e->db.list, i) {
+		sedb *db = (sedb*)sscast(i, so, link);
+		sv_loginit_index(&r->log, db->index->scheme.id, db->r);
+	}
+	/* no need in workers for a single database */
+	int threads = e->wm_conf->recover_threads;
+	if (threads > e->db.n)
+		threads = e->db.n;
+	if (threads <= 1)
+		return 0;
+	rc = ss_threadpool_new(&r->tp, &e->a, threads - 1,
+	                       se_recover_worker, r);
+	if (ssunlikely(rc == -1))
+		return sr_malfunction(&e->error, "failed to create recover thread: %s",
+		                      strerror(errno));
+	return 0;
+}
+
+static void
+se_recover_free(serecover *r)
+{
+	se *e = r->e;
+	if (r->tp.n) {
+		ss_mutexlock(&r->lock);
+		r->stop = 1;
+		ss_condbroadcast(&r->cond);
+		ss_mutexunlock(&r->lock);
+		ss_threadpool_shutdown(&r->tp, &e->a);
+	}
+	/* unref records which were not applied */
+	ssiter i;
+	ss_iterinit(ss_bufiter, &i);
+	ss_iteropen(ss_bufiter, &i, &r->log.buf, sizeof(svlogv));
+	for (; ss_iterhas(ss_bufiter, &i); ss_iternext(ss_bufiter, &i)) {
+		svlogv *lv = ss_iterof(ss_bufiter, &i);
+		sv_vunref(sv_logindex(&r->log, lv->index_id)->r, lv->v);
+	}
+	sv_logfree(&r->log, &e->r);
+	ss_buffree(&r->stmt, &e->a);
+	ss_condfree(&r->cond_done);
+	ss_condfree(&r->cond);
+	ss_mutexfree(&r->lock);
+}
+
+static inline void
+se_recover_stmtfree(serecover *r)
+{
+	ssiter i;
+	ss_iterinit(ss_bufiter, &i);
+	ss_iteropen(ss_bufiter, &i, &r->stmt, sizeof(svlogv));
+	for (; ss_iterhas(ss_bufiter, &i); ss_iternext(ss_bufiter, &i)) {
+		svlogv *lv = ss_iterof(ss_bufiter, &i);
+		sv_vunref(sv_logindex(&r->log, lv->index_id)->r, lv->v);
+	}
+	ss_bufreset(&r->stmt);
+}
+
+static inline int
+se_recover_stmtcommit(serecover *r, uint64_t lsn)
+{
+	se *e = r->e;
+	ssiter i;
+	ss_iterinit(ss_bufiter, &i);
+	ss_iteropen(ss_bufiter, &i, &r->stmt, sizeof(svlogv));
+	for (; ss_iterhas(ss_bufiter, &i); ss_iternext(ss_bufiter, &i)) {
+		svlogv *lv = ss_iterof(ss_bufiter, &i);
+		sr *dbr = sv_logindex(&r->log, lv->index_id)->r;
+		int rc = sv_logadd(&r->log, dbr, lv);
+		if (ssunlikely(rc == -1)) {
+			/* unref the rest of transaction */
+			for (; ss_iterhas(ss_bufiter, &i); ss_iternext(ss_bufiter, &i)) {
+				lv = ss_iterof(ss_bufiter, &i);
+				sv_vunref(sv_logindex(&r->log, lv->index_id)->r, lv->v);
+			}
+			ss_bufreset(&r->stmt);
+			return sr_oom_malfunction(&e->error);
+		}
+	}
+	ss_bufreset(&r->stmt);
+	if (lsn > r->lsn)
+		r->lsn = lsn;
+	if (sv_logcount(&r->log) >= SE_RECOVER_BATCH)
+		return se_recover_flush(r);
+	return 0;
+}
+
 static int
-se_recover_log(se *e, sw *log)
+se_recover_log(serecover *r, sw *log)
 {
-	so *tx = NULL;
+	se *e = r->e;
 	sedb *db = NULL;
 	ssiter i;
 	ss_iterinit(sw_iter, &i);
-	int processed = 0;
 	int rc = ss_iteropen(sw_iter, &i, &e->r, &log->file, 1);
 	if (ssunlikely(rc == -1))
 		return -1;
@@ -39,10 +265,6 @@ se_recover_log(se *e, sw *log)
 
 		/* reply transaction */
 		uint64_t lsn = UINT64_MAX;
-		tx = so_begin(&e->o);
-		if (ssunlikely(tx == NULL))
-			goto error;
-
 		while (ss_iteratorhas(&i)) {
 			v = ss_iteratorof(&i);
 			/* match a database */
@@ -56,36 +278,42 @@ se_recover_log(se *e, sw *log)
 			}
 			char *data = sw_vpointer(v);
 			lsn = sf_lsn(db->r->scheme, data);
-			so *o = so_document(&db->o);
-			if (ssunlikely(o == NULL))
-				goto rlb;
-			so_setstring(o, "raw", data, 0);
-			so_setstring(o, "log", log, 0);
-			
 			int flags = sf_flags(db->r->scheme, data);
-			if (flags == SVDELETE) {
-				rc = so_delete(tx, o);
-			} else
 			if (flags == SVUPSERT) {
-				rc = so_upsert(tx, o);
+				if (! sf_upserthas(&db->scheme->upsert)) {
+					sr_error(&e->error, "%s", "upsert callback is not set");
+					goto rlb;
+				}
 			} else {
-				assert(flags == 0);
-				rc = so_set(tx, o);
+				assert(flags == 0 || flags == SVDELETE);
 			}
-			if (ssunlikely(rc == -1))
+			/* replayed versions bypass the transaction
+			 * manager and go directly into the index */
+			svlogv lv;
+			sv_logvinit(&lv, db->index->scheme.id);
+			lv.v = sv_vbuildraw(db->r, data);
+			if (ssunlikely(lv.v == NULL)) {
+				sr_oom(&e->error);
 				goto rlb;
+			}
+			lv.v->log = log;
+			rc = ss_bufadd(&r->stmt, &e->a, &lv, sizeof(svlogv));
+			if (ssunlikely(rc == -1)) {
+				sv_vunref(db->r, lv.v);
+				sr_oom(&e->error);
+				goto rlb;
+			}
 			ss_gcmark(&log->gc, 1);
-			processed++;
-			if ((processed % 100000) == 0)
-				sr_log(&e->log, " %.1fM processed", processed / 1000000.0);
+			r->processed++;
+			if ((r->processed % 100000) == 0)
+				sr_log(&e->log, " %.1fM processed", r->processed / 1000000.0);
 			ss_iteratornext(&i);
 		}
 		if (ssunlikely(sw_iter_error(&i)))
 			goto rlb;
 
-		so_setint(tx, "lsn", lsn);
-		rc = so_commit(tx);
-		if (ssunlikely(rc != 0))
+		rc = se_recover_stmtcommit(r, lsn);
+		if (ssunlikely(rc == -1))
 			goto error;
 		rc = sw_iter_continue(&i);
 		if (ssunlikely(rc == -1))
@@ -94,17 +322,24 @@ se_recover_log(se *e, sw *log)
 			break;
 	}
 	ss_iteratorclose(&i);
-	return 0;
+	return se_recover_flush(r);
 rlb:
-	so_destroy(tx);
+	se_recover_stmtfree(r);
 error:
 	ss_iteratorclose(&i);
+	se_recover_flush(r);
 	return -1;
 }
 
 static inline int
 se_recover_logpool(se *e)
 {
+	serecover r;
+	int rc = se_recover_init(&r, e);
+	if (ssunlikely(rc == -1)) {
+		se_recover_free(&r);
+		return -1;
+	}
 	sr_log(&e->log, "loading journals '%s'", e->wm_conf->path);
 	uint32_t current = 1;
 	sslist *i;
@@ -112,12 +347,13 @@ se_recover_logpool(se *e)
 		sw *log = sscast(i, sw, link);
 		sr_log(&e->log, "(%" PRIu32 "/%" PRIu32 ") %020" PRIu64".log",
 		       current, e->wm.n, log->id);
-		int rc = se_recover_log(e, log);
+		rc = se_recover_log(&r, log);
 		if (ssunlikely(rc == -1))
-			return -1;
+			break;
 		current++;
 	}
-	return 0;
+	se_recover_free(&r);
+	return rc;
 }
 
 int se_recover(se *e)
@@ -30,8 +30,15 @@ se_txwrite(setx *t, sedocument *o, uint8_t flags)
 	if (ssunlikely(! se_active(e)))
 		goto error;
 
-	/* create document */
+	/* memory limit backpressure */
 	int rc;
+	if (! (flags & SVDELETE)) {
+		rc = sc_quota(&e->scheduler);
+		if (ssunlikely(rc == -1))
+			goto error;
+	}
+
+	/* create document */
 	rc = se_document_validate(o, &db->o);
 	if (ssunlikely(rc == -1))
 		goto error;
@@ -45,7 +52,9 @@ se_txwrite(setx *t, sedocument *o, uint8_t flags)
 	so_destroy(&o->o);
 
 	/* concurrent index only */
+	sx_txlock(&e->xm);
 	rc = sx_set(&t->t, &db->coindex, v);
+	sx_txunlock(&e->xm);
 	if (ssunlikely(rc == -1))
 		return -1;
 	return 0;
@@ -118,7 +127,9 @@ static inline void
 se_txend(setx *t, int rlb, int conflict)
 {
 	se *e = se_of(&t->o);
+	sx_txlock(&e->xm);
 	sx_gc(&t->t);
+	sx_txunlock(&e->xm);
 	uint32_t count = sv_logcount(&t->log);
 	sv_logreset(&t->log, e->db.n);
 	sr_statxm(&e->xm_stat, t->start, count, rlb, conflict);
@@ -130,7 +141,10 @@ static int
 se_txdestroy(so *o)
 {
 	setx *t = se_cast(o, setx*, SETX);
+	se *e = se_of(o);
+	sx_txlock(&e->xm);
 	sx_rollback(&t->t);
+	sx_txunlock(&e->xm);
 	se_txend(t, 1, 0);
 	return 0;
 }
@@ -155,6 +169,31 @@ se_txprepare(sx *x, svv *v, so *o, void *ptr)
 	return rc;
 }
 
+int se_txapply(se *e, svlog *log, sxcommit *c, int recover)
+{
+	/* write-ahead log and index are updated in the
+	 * commit order, without the transaction lock held.
+	 *
+	 * A next transaction writes its log records while
+	 * the previous one updates the index.
+	*/
+	sx_commitwait(&e->xm, c, SX_COMMITLOG);
+	int rc = sc_commitlog(&e->scheduler, log, c->lsn, recover);
+	sx_commitend(&e->xm, c, SX_COMMITLOG);
+
+	/* wait for the group log sync before the statements
+	 * become visible, commits do not wait in async mode */
+	swmanager *wm = &e->wm;
+	if (rc == 0 && !recover && wm->conf.sync_on_write && !wm->conf.async)
+		rc = sw_syncwait(wm, c->lsn);
+
+	sx_commitwait(&e->xm, c, SX_COMMITINDEX);
+	if (sslikely(rc == 0))
+		sc_commitindex(&e->scheduler, log, recover);
+	sx_commitend(&e->xm, c, SX_COMMITINDEX);
+	return rc;
+}
+
 static int
 se_txcommit(so *o)
 {
@@ -166,6 +205,12 @@ se_txcommit(so *o)
 	int recover = (status == SR_RECOVER);
 	int rc;
 
+	/* transaction prepare, commit and lsn assignment
+	 * must be atomic in respect to other transactions,
+	 * a concurrent prepare waits for committed but not
+	 * yet applied statements (see sx_commitsync()) */
+	sx_txlock(&e->xm);
+
 	/* prepare transaction */
 	if (t->t.state == SX_READY || t->t.state == SX_LOCK)
 	{
@@ -174,18 +219,22 @@ se_txcommit(so *o)
 		if (! recover) {
 			prepare = se_txprepare;
 			cache = si_cachepool_pop(&e->cachepool);
-			if (ssunlikely(cache == NULL))
+			if (ssunlikely(cache == NULL)) {
+				sx_txunlock(&e->xm);
 				return sr_oom(&e->error);
+			}
 		}
 		sxstate s = sx_prepare(&t->t, prepare, cache);
 		if (cache)
 			si_cachepool_push(cache);
 		if (s == SX_LOCK) {
+			sx_txunlock(&e->xm);
 			sr_statxm_lock(&e->xm_stat);
 			return 2;
 		}
 		if (s == SX_ROLLBACK) {
 			sx_rollback(&t->t);
+			sx_txunlock(&e->xm);
 			se_txend(t, 0, 1);
 			return 1;
 		}
@@ -194,9 +243,12 @@ se_txcommit(so *o)
 		sx_commit(&t->t);
 	}
 	assert(t->t.state == SX_COMMIT);
+	sxcommit c;
+	sx_commitbegin(&e->xm, &c, t->lsn);
+	sx_txunlock(&e->xm);
 
 	/* wal write and multi-index write */
-	rc = sc_commit(&e->scheduler, &t->log, t->lsn, recover);
+	rc = se_txapply(e, &t->log, &c, recover);
 	if (ssunlikely(rc == -1)) {
 		/* free the transaction log in case of
 		 * commit error */
@@ -230,8 +282,13 @@ static int64_t
 se_txget_int(so *o, const char *path)
 {
 	setx *t = se_cast(o, setx*, SETX);
-	if (strcmp(path, "deadlock") == 0)
-		return sx_deadlock(&t->t);
+	if (strcmp(path, "deadlock") == 0) {
+		se *e = se_of(o);
+		sx_txlock(&e->xm);
+		int rc = sx_deadlock(&t->t);
+		sx_txunlock(&e->xm);
+		return rc;
+	}
 	return -1;
 }
 
@@ -250,7 +307,9 @@ static soif setxif =
 	.upsert       = se_txupsert,
 	.del          = se_txdelete,
 	.get          = se_txget,
+	.getmulti     = NULL,
 	.begin        = NULL,
+	.batch        = NULL,
 	.prepare      = NULL,
 	.commit       = se_txcommit,
 	.cursor       = NULL
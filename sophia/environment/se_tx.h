@@ -20,5 +20,6 @@ struct setx {
 };
 
 so *se_txnew(se*);
+int se_txapply(se*, svlog*, sxcommit*, int);
 
 #endif
@@ -18,6 +18,7 @@ typedef struct sfv sfv;
 #define SVGET    4
 #define SVDUP    8
 #define SVBEGIN  16
+#define SVBLOB   32
 
 struct sfvar {
 	uint32_t size;
@@ -129,6 +130,90 @@ sf_fieldsize(sfscheme *s, int pos, char *data)
 	return sf_var(s, f->position_ref, data)->size;
 }
 
+/*
+	normalized key.
+
+	key parts are serialized into a single byte string
+	which memcmp order matches the scheme order: integers
+	are written big-endian, strings have zero bytes escaped
+	as 0x00 0xff and are terminated by 0x00 0x00, reverse
+	parts are bitwise inverted.
+*/
+
+static inline uint32_t
+sf_normalizesize(sfscheme *s, sfv *v)
+{
+	uint32_t size = 0;
+	int i;
+	for (i = 0; i < s->keys_count; i++) {
+		sffield *f = s->keys[i];
+		if (f->fixed_size) {
+			size += f->fixed_size;
+			continue;
+		}
+		sfv *part = &v[f->position];
+		size += part->size + 2;
+		char *p = part->pointer;
+		char *end = p + part->size;
+		while (p < end && (p = memchr(p, 0, end - p))) {
+			size++;
+			p++;
+		}
+	}
+	return size;
+}
+
+static inline uint32_t
+sf_normalizewrite(sfscheme *s, sfv *v, char *dest)
+{
+	unsigned char *p = (unsigned char*)dest;
+	int i;
+	for (i = 0; i < s->keys_count; i++) {
+		sffield *f = s->keys[i];
+		sfv *part = &v[f->position];
+		unsigned char mask = 0;
+		switch (f->type) {
+		case SS_STRINGREV:
+		case SS_U8REV:
+		case SS_U16REV:
+		case SS_U32REV:
+		case SS_U64REV:
+			mask = 0xff;
+			break;
+		default: break;
+		}
+		if (f->fixed_size) {
+			uint64_t value = 0;
+			if (sslikely(part->size > 0)) {
+				switch (f->fixed_size) {
+				case 1: value = *(uint8_t*)part->pointer;
+					break;
+				case 2: value = *(uint16_t*)part->pointer;
+					break;
+				case 4: value = sscastu32(part->pointer);
+					break;
+				case 8: value = sscastu64(part->pointer);
+					break;
+				}
+			}
+			int j = f->fixed_size;
+			while (j-- > 0)
+				*p++ = ((value >> (j * 8)) & 0xff) ^ mask;
+			continue;
+		}
+		unsigned char *c = (unsigned char*)part->pointer;
+		unsigned char *end = c + part->size;
+		for (; c < end; c++) {
+			*p++ = *c ^ mask;
+			if (ssunlikely(*c == 0))
+				*p++ = 0xff ^ mask;
+		}
+		*p++ = mask;
+		*p++ = mask;
+	}
+	return p - (unsigned char*)dest;
+}
+
 static inline int
 sf_writesize(sfscheme *s, sfv *v)
 {
@@ -140,6 +225,10 @@ sf_writesize(sfscheme *s, sfv *v)
 		sffield *f = s->fields[i];
 		if (f->fixed_size != 0)
 			continue;
+		if (f->normalized) {
+			sum += sizeof(sfvar) + sf_normalizesize(s, v);
+			continue;
+		}
 		sum += sizeof(sfvar)+ v[i].size;
 	}
 	return sum;
@@ -150,6 +239,12 @@ sf_write(sfscheme *s, sfv *v, char *dest)
 {
 	int var_value_offset =
 		s->var_offset + sizeof(sfvar) * s->var_count;
+	/* normalized key is stored first */
+	if (s->has_normalized) {
+		sfvar *var = sf_var(s, 0, dest);
+		var->size = sf_normalizewrite(s, v, dest + var_value_offset);
+		var_value_offset += var->size;
+	}
 	int i;
 	for (i = 0; i < s->fields_count; i++) {
 		sffield *f = s->fields[i];
@@ -160,6 +255,8 @@ sf_write(sfscheme *s, sfv *v, char *dest)
 				memset(dest + f->fixed_offset, 0, f->fixed_size);
 			continue;
 		}
+		if (f->normalized)
+			continue;
 		sfvar *var = sf_var(s, f->position_ref, dest);
 		var->size = v[i].size;
 		if (sslikely(v[i].size > 0))
@@ -175,12 +272,62 @@ sf_hash(sfscheme *s, char *data)
 	int i;
 	for (i = 0; i < s->keys_count; i++) {
 		uint32_t size;
-		char *field = sf_field(s, i, data, &size);
-		hash ^= ss_fnv(field, size);
+		char *field = sf_fieldptr(s, s->keys[i], data, &size);
+		hash = (hash * 16777619) ^ ss_fnv(field, size);
 	}
 	return hash;
 }
 
+/*
+	key prefix.
+
+	first eight bytes of the first key part as a
+	big-endian integer, which order matches the scheme
+	order. Different prefixes decide the comparison,
+	equal ones require full key compare.
+*/
+
+static inline uint64_t
+sf_prefixstring(char *data, uint32_t size)
+{
+	unsigned char *p = (unsigned char*)data;
+	uint64_t prefix = 0;
+	uint32_t i;
+	for (i = 0; i < 8; i++) {
+		prefix <<= 8;
+		if (i < size)
+			prefix |= p[i];
+	}
+	return prefix;
+}
+
+static inline uint64_t
+sf_prefix(sfscheme *s, char *data)
+{
+	if (ssunlikely(s->cmp))
+		return 0;
+	if (s->has_normalized)
+		return sf_prefixstring(data + s->offset_key,
+		                       sf_var(s, 0, data)->size);
+	sffield *f = s->keys[0];
+	uint32_t size;
+	char *ptr = sf_fieldptr(s, f, data, &size);
+	switch (f->type) {
+	case SS_U8:        return *(uint8_t*)ptr;
+	case SS_U8REV:     return ~(uint64_t)*(uint8_t*)ptr;
+	case SS_U16:       return *(uint16_t*)ptr;
+	case SS_U16REV:    return ~(uint64_t)*(uint16_t*)ptr;
+	case SS_U32:       return sscastu32(ptr);
+	case SS_U32REV:    return ~(uint64_t)sscastu32(ptr);
+	case SS_U64:       return sscastu64(ptr);
+	case SS_U64REV:    return ~sscastu64(ptr);
+	case SS_STRING:    return sf_prefixstring(ptr, size);
+	case SS_STRINGREV: return ~sf_prefixstring(ptr, size);
+	default: break;
+	}
+	return 0;
+}
+
 static inline int
 sf_comparable_size(sfscheme *s, char *data)
 {
@@ -190,7 +337,7 @@ sf_comparable_size(sfscheme *s, char *data)
 		sffield *f = s->fields[i];
 		if (f->fixed_size != 0)
 			continue;
-		if (f->key)
+		if (f->key || f->normalized)
 			sum += sf_fieldsize(s, i, data);
 		sum += sizeof(sfvar);
 	}
@@ -203,10 +350,16 @@ sf_comparable_write(sfscheme *s, char *src, char *dest)
 	int var_value_offset =
 		s->var_offset + sizeof(sfvar) * s->var_count;
 	memcpy(dest, src, s->var_offset);
+	if (s->has_normalized) {
+		sfvar *var = sf_var(s, 0, dest);
+		var->size = sf_var(s, 0, src)->size;
+		memcpy(dest + var_value_offset, src + var_value_offset, var->size);
+		var_value_offset += var->size;
+	}
 	int i;
 	for (i = 0; i < s->fields_count; i++) {
 		sffield *f = s->fields[i];
-		if (f->fixed_size != 0)
+		if (f->fixed_size != 0 || f->normalized)
 			continue;
 		sfvar *var = sf_var(s, f->position_ref, dest);
 		if (! f->key) {
@@ -120,7 +120,7 @@ sf_cmpu64_reverse(char *a, int asz ssunused, char *b, int bsz ssunused,
 }
 
 sshot int
-sf_compare(sfscheme *s, char *a, char *b)
+sf_compare_generic(sfscheme *s, char *a, char *b)
 {
 	sffield **part = s->keys;
 	sffield **last = part + s->keys_count;
@@ -139,6 +139,73 @@ sf_compare(sfscheme *s, char *a, char *b)
 	return 0;
 }
 
+static sshot int
+sf_compare_u32(sfscheme *s, char *a, char *b)
+{
+	return sf_cmpu32(a + s->offset_key, 0, b + s->offset_key, 0, NULL);
+}
+
+static sshot int
+sf_compare_u32rev(sfscheme *s, char *a, char *b)
+{
+	return sf_cmpu32_reverse(a + s->offset_key, 0, b + s->offset_key, 0, NULL);
+}
+
+static sshot int
+sf_compare_u64(sfscheme *s, char *a, char *b)
+{
+	return sf_cmpu64(a + s->offset_key, 0, b + s->offset_key, 0, NULL);
+}
+
+static sshot int
+sf_compare_u64rev(sfscheme *s, char *a, char *b)
+{
+	return sf_cmpu64_reverse(a + s->offset_key, 0, b + s->offset_key, 0, NULL);
+}
+
+static sshot int
+sf_compare_string(sfscheme *s, char *a, char *b)
+{
+	/* key is the first variable size field, its data
+	 * follows the var array */
+	return sf_cmpstring(a + s->offset_key, sf_var(s, 0, a)->size,
+	                    b + s->offset_key, sf_var(s, 0, b)->size, NULL);
+}
+
+static inline int
+sf_cmpfixed(sstype type, char *a, char *b)
+{
+	switch (type) {
+	case SS_U8:     return sf_cmpu8(a, 0, b, 0, NULL);
+	case SS_U8REV:  return sf_cmpu8_reverse(a, 0, b, 0, NULL);
+	case SS_U16:    return sf_cmpu16(a, 0, b, 0, NULL);
+	case SS_U16REV: return sf_cmpu16_reverse(a, 0, b, 0, NULL);
+	case SS_U32:    return sf_cmpu32(a, 0, b, 0, NULL);
+	case SS_U32REV: return sf_cmpu32_reverse(a, 0, b, 0, NULL);
+	case SS_U64:    return sf_cmpu64(a, 0, b, 0, NULL);
+	case SS_U64REV: return sf_cmpu64_reverse(a, 0, b, 0, NULL);
+	default: assert(0);
+	}
+	return 0;
+}
+
+static sshot int
+sf_compare_fixed(sfscheme *s, char *a, char *b)
+{
+	sffield **part = s->keys;
+	sffield **last = part + s->keys_count;
+	int rc;
+	while (part < last) {
+		sffield *key = *part;
+		rc = sf_cmpfixed(key->type, a + key->fixed_offset,
+		                 b + key->fixed_offset);
+		if (rc != 0)
+			return rc;
+		part++;
+	}
+	return 0;
+}
+
 sshot int
 sf_compareprefix(sfscheme *s, char *prefix, uint32_t prefixsize, char *key)
 {
@@ -162,10 +229,13 @@ void sf_schemeinit(sfscheme *s)
 	s->var_count  = 0;
 	s->cmp = NULL;
 	s->cmparg = NULL;
+	s->compare = sf_compare_generic;
+	s->offset_key = 0;
 	s->has_lsn = 0;
 	s->has_flags = 0;
 	s->has_timestamp = 0;
 	s->has_expire = 0;
+	s->has_normalized = 0;
 }
 
 void sf_schemefree(sfscheme *s, ssa *a)
@@ -285,12 +355,66 @@ sf_schemeset(sfscheme *s, sffield *f, char *opt)
 	} else
 	if (strncmp(opt, "expire", 6) == 0) {
 		f->expire = 1;
+	} else
+	if (strncmp(opt, "normalized", 10) == 0) {
+		f->normalized = 1;
 	} else {
 		return -1;
 	}
 	return 0;
 }
 
+static inline void
+sf_schemeset_compare(sfscheme *s)
+{
+	s->compare = sf_compare_generic;
+	s->offset_key = 0;
+	/* user comparator */
+	if (s->cmp)
+		return;
+	/* single memcmp over the normalized key */
+	if (s->has_normalized) {
+		s->offset_key = s->var_offset + sizeof(sfvar) * s->var_count;
+		s->compare = sf_compare_string;
+		return;
+	}
+	/* single key */
+	sffield *key = s->keys[0];
+	if (s->keys_count == 1) {
+		s->offset_key = key->fixed_offset;
+		switch (key->type) {
+		case SS_U32:
+			s->compare = sf_compare_u32;
+			return;
+		case SS_U32REV:
+			s->compare = sf_compare_u32rev;
+			return;
+		case SS_U64:
+			s->compare = sf_compare_u64;
+			return;
+		case SS_U64REV:
+			s->compare = sf_compare_u64rev;
+			return;
+		case SS_STRING:
+			if (key->position_ref != 0)
+				return;
+			s->offset_key = s->var_offset + sizeof(sfvar) * s->var_count;
+			s->compare = sf_compare_string;
+			return;
+		default:
+			break;
+		}
+	}
+	/* multi-part key of fixed size fields */
+	int i = 0;
+	while (i < s->keys_count) {
+		if (s->keys[i]->fixed_size == 0)
+			return;
+		i++;
+	}
+	s->compare = sf_compare_fixed;
+}
+
 int
 sf_schemevalidate(sfscheme *s, ssa *a)
 {
@@ -369,6 +493,14 @@ sf_schemevalidate(sfscheme *s, ssa *a)
 				return -1;
 			s->has_expire = 1;
 		}
+		/* normalized key */
+		if (f->normalized) {
+			if (f->type != SS_STRING || f->key)
+				return -1;
+			if (s->has_normalized)
+				return -1;
+			s->has_normalized = 1;
+		}
 		/* meta fields */
 
 		/* flags */
@@ -412,6 +544,11 @@ sf_schemevalidate(sfscheme *s, ssa *a)
 	}
 	s->var_offset = fixed_offset;
 
+	/* normalized key order is defined by the
+	 * encoding */
+	if (ssunlikely(s->has_normalized && s->cmp))
+		return -1;
+
 	/* validate keys */
 	if (ssunlikely(s->keys_count == 0))
 		return -1;
@@ -420,7 +557,9 @@ sf_schemevalidate(sfscheme *s, ssa *a)
 	if (ssunlikely(s->keys == NULL))
 		return -1;
 	memset(s->keys, 0, size);
-	int pos_var = 0;
+	/* normalized key is always the first variable
+	 * size field */
+	int pos_var = s->has_normalized;
 	i = 0;
 	while (i < s->fields_count) {
 		sffield *f = s->fields[i];
@@ -435,6 +574,9 @@ sf_schemevalidate(sfscheme *s, ssa *a)
 				return -1;
 			s->keys[f->position_key] = f;
 		}
+		if (f->normalized)
+			f->position_ref = 0;
+		else
 		if (f->fixed_size == 0)
 			f->position_ref = pos_var++;
 		i++;
@@ -446,6 +588,30 @@ sf_schemevalidate(sfscheme *s, ssa *a)
 			return -1;
 		i++;
 	}
+	sf_schemeset_compare(s);
+	return 0;
+}
+
+int sf_schemenormalize(sfscheme *s, ssa *a)
+{
+	/* add normalized key field, it is saved
+	 * along with the scheme */
+	sffield *f = sf_schemefind(s, "_key");
+	if (ssunlikely(f))
+		return -1;
+	f = sf_fieldnew(a, "_key");
+	if (ssunlikely(f == NULL))
+		return -1;
+	int rc = sf_fieldoptions(f, a, "string,normalized");
+	if (ssunlikely(rc == -1)) {
+		sf_fieldfree(f, a);
+		return -1;
+	}
+	rc = sf_schemeadd(s, a, f);
+	if (ssunlikely(rc == -1)) {
+		sf_fieldfree(f, a);
+		return -1;
+	}
 	return 0;
 }
 
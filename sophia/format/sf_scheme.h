@@ -14,6 +14,7 @@ typedef struct sfscheme sfscheme;
 
 typedef int (*sfcmpversionf)(char*, char*, void*);
 typedef int (*sfcmpf)(char*, int, char*, int, void*);
+typedef int (*sfcomparef)(sfscheme*, char*, char*);
 
 struct sffield {
 	sstype    type;
@@ -29,6 +30,7 @@ struct sffield {
 	int       key;
 	int       timestamp;
 	int       expire;
+	int       normalized;
 	sfcmpf    cmp;
 };
 
@@ -39,6 +41,8 @@ struct sfscheme {
 	int       keys_count;
 	sfcmpf    cmp;
 	void     *cmparg;
+	sfcomparef compare;
+	int       offset_key;
 	int       offset_expire;
 	int       offset_lsn;
 	int       offset_flags;
@@ -48,6 +52,7 @@ struct sfscheme {
 	int       has_flags;
 	int       has_timestamp;
 	int       has_expire;
+	int       has_normalized;
 };
 
 static inline sffield*
@@ -58,6 +63,7 @@ sf_fieldnew(ssa *a, char *name)
 		return NULL;
 	f->timestamp = 0;
 	f->expire = 0;
+	f->normalized = 0;
 	f->lsn = 0;
 	f->flags = 0;
 	f->key = 0;
@@ -106,6 +112,7 @@ void sf_schemeinit(sfscheme*);
 void sf_schemefree(sfscheme*, ssa*);
 int  sf_schemeadd(sfscheme*, ssa*, sffield*);
 int  sf_schemevalidate(sfscheme*, ssa*);
+int  sf_schemenormalize(sfscheme*, ssa*);
 int  sf_schemesave(sfscheme*, ssa*, ssbuf*);
 int  sf_schemeload(sfscheme*, ssa*, char*, int);
 
@@ -153,7 +160,15 @@ sf_schemefixed(sfscheme *s)
 	return s->var_count == 0;
 }
 
-int  sf_compare(sfscheme*, char*, char*);
+int  sf_compare_generic(sfscheme*, char*, char*);
 int  sf_compareprefix(sfscheme*, char*, uint32_t, char*);
 
+static inline int
+sf_compare(sfscheme *s, char *a, char *b)
+{
+	/* compare kernel is chosen by key layout
+	 * during scheme validation */
+	return s->compare(s, a, b);
+}
+
 #endif
@@ -12,7 +12,9 @@
 #include <si_scheme.h>
 #include <si_node.h>
 #include <si_nodeview.h>
+#include <si_manifest.h>
 #include <si_planner.h>
+#include <si_blob.h>
 #include <si.h>
 #include <si_gc.h>
 #include <si_cache.h>
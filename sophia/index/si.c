@@ -26,15 +26,23 @@ si *si_init(sr *r, so *object)
 		ss_free(r->a, i);
 		return NULL;
 	}
-	sd_cinit(&i->rdc);
 	ss_rbinit(&i->i);
 	ss_mutexinit(&i->lock);
+	ss_condinit(&i->cond);
+	i->writers      = 0;
+	i->writers_wait = 0;
 	si_schemeinit(&i->scheme);
+	si_manifestinit(&i->manifest, r);
 	ss_listinit(&i->link);
 	ss_listinit(&i->gc);
+	ss_listinit(&i->lru);
+	si_blobpool_init(&i->blob);
+	i->lru_used   = 0;
 	i->gc_count   = 0;
 	i->read_disk  = 0;
 	i->read_cache = 0;
+	i->bloom_skip  = 0;
+	i->bloom_false = 0;
 	i->backup     = 0;
 	i->n          = 0;
 	i->object     = object;
@@ -49,6 +57,25 @@ int si_open(si *i)
 ss_rbtruncate(si_truncate,
               si_nodefree(sscast(n, sinode, node), (sr*)arg, 0))
 
+int si_nodedrop(si *i, sinode *n)
+{
+	/* remove node delayed by compaction and complete
+	 * its compaction in the manifest */
+	uint64_t id = n->id;
+	int rcret = 0;
+	int rc = si_blobunref(&i->blob, &i->r, n);
+	if (ssunlikely(rc == -1))
+		rcret = -1;
+	rc = si_nodefree(n, &i->r, 1);
+	if (ssunlikely(rc == -1))
+		return -1;
+	rc = si_manifestmark(&i->manifest, &i->r, &i->scheme,
+	                     SD_MANIFEST_COMPLETE, id);
+	if (ssunlikely(rc == -1))
+		return -1;
+	return rcret;
+}
+
 int si_close(si *i)
 {
 	int rc_ret = 0;
@@ -56,7 +83,7 @@ int si_close(si *i)
 	sslist *p, *n;
 	ss_listforeach_safe(&i->gc, p, n) {
 		sinode *node = sscast(p, sinode, gc);
-		rc = si_nodefree(node, &i->r, 1);
+		rc = si_nodedrop(i, node);
 		if (ssunlikely(rc == -1))
 			rc_ret = -1;
 	}
@@ -65,29 +92,49 @@ int si_close(si *i)
 	if (i->i.root)
 		si_truncate(i->i.root, &i->r);
 	i->i.root = NULL;
-	sd_cfree(&i->rdc, &i->r);
 	si_plannerfree(&i->p, i->r.a);
+	rc = si_manifestfree(&i->manifest, &i->r);
+	if (ssunlikely(rc == -1))
+		rc_ret = -1;
+	rc = si_blobpool_free(&i->blob, &i->r);
+	if (ssunlikely(rc == -1))
+		rc_ret = -1;
 	ss_mutexfree(&i->lock);
+	ss_condfree(&i->cond);
 	si_schemefree(&i->scheme, &i->r);
 	ss_free(i->r.a, i);
 	return rc_ret;
 }
 
 ss_rbget(si_match,
-         sf_compare(scheme,
-                    sd_indexpage_min(&(sscast(n, sinode, node))->index,
-                                     sd_indexmin(&(sscast(n, sinode, node))->index)),
-                    key))
+         sf_compare(scheme, si_nodemin(sscast(n, sinode, node)), key))
+
+static inline void
+si_lruadd(si *i, sinode *n)
+{
+	if (! i->scheme.index_lazy || !si_nodeloaded(n))
+		return;
+	ss_listappend(&i->lru, &n->lru);
+	i->lru_used += ss_bufused(&n->index.i);
+}
+
+static inline void
+si_lruremove(si *i, sinode *n)
+{
+	if (ss_listempty(&n->lru))
+		return;
+	ss_listunlink(&n->lru);
+	ss_listinit(&n->lru);
+	i->lru_used -= ss_bufused(&n->index.i);
+}
 
 int si_insert(si *i, sinode *n)
 {
-	sdindexpage *min = sd_indexmin(&n->index);
 	ssrbnode *p = NULL;
-	int rc = si_match(&i->i, i->r.scheme,
-	                  sd_indexpage_min(&n->index, min),
-	                  min->sizemin, &p);
+	int rc = si_match(&i->i, i->r.scheme, si_nodemin(n), n->keys_min, &p);
 	assert(! (rc == 0 && p));
 	ss_rbset(&i->i, p, rc, &n->node);
+	si_lruadd(i, n);
 	i->n++;
 	return 0;
 }
@@ -95,6 +142,7 @@ int si_insert(si *i, sinode *n)
 int si_remove(si *i, sinode *n)
 {
 	ss_rbremove(&i->i, &n->node);
+	si_lruremove(i, n);
 	i->n--;
 	return 0;
 }
@@ -102,6 +150,45 @@ int si_remove(si *i, sinode *n)
 int si_replace(si *i, sinode *o, sinode *n)
 {
 	ss_rbreplace(&i->i, &o->node, &n->node);
+	si_lruremove(i, o);
+	si_lruadd(i, n);
+	return 0;
+}
+
+static inline void
+si_lruevict(si *i, sinode *n)
+{
+	/* unload page indexes of least recently used nodes,
+	 * which are not being compacted or read */
+	sslist *p, *next;
+	ss_listforeach_safe(&i->lru, p, next) {
+		if (i->lru_used <= i->scheme.index_cache)
+			break;
+		sinode *node = sscast(p, sinode, lru);
+		if (node == n || (node->flags & SI_LOCK))
+			continue;
+		if (si_noderefof(node) > 0)
+			continue;
+		si_lruremove(i, node);
+		si_nodeunload(node, &i->r);
+	}
+}
+
+int si_nodeuse(si *i, sinode *n)
+{
+	if (sslikely(si_nodeloaded(n))) {
+		if (! ss_listempty(&n->lru)) {
+			ss_listunlink(&n->lru);
+			ss_listappend(&i->lru, &n->lru);
+		}
+		return 0;
+	}
+	int rc = si_nodeload(n, &i->r, &i->scheme);
+	if (ssunlikely(rc == -1))
+		return -1;
+	si_lruadd(i, n);
+	if (i->scheme.index_cache > 0)
+		si_lruevict(i, n);
 	return 0;
 }
 
@@ -122,6 +209,7 @@ si_execute(si *i, sdc *c, siplan *plan, uint64_t vlsn)
 	case SI_COMPACTION:
 	case SI_GC:
 	case SI_EXPIRE:
+	case SI_BLOBGC:
 		rc = si_compaction(i, c, plan, vlsn);
 		break;
 	case SI_BACKUP:
@@ -129,7 +217,7 @@ si_execute(si *i, sdc *c, siplan *plan, uint64_t vlsn)
 		rc = si_backup(i, c, plan);
 		break;
 	case SI_NODEGC:
-		rc = si_nodefree(plan->node, &i->r, 1);
+		rc = si_nodedrop(i, plan->node);
 		break;
 	default:
 		assert(0);
@@ -13,16 +13,24 @@ typedef struct si si;
 
 struct si {
 	ssmutex    lock;
+	sscond     cond;
+	uint32_t   writers;
+	uint32_t   writers_wait;
 	siplanner  p;
 	ssrb       i;
 	int        n;
 	uint32_t   backup;
 	uint64_t   read_disk;
 	uint64_t   read_cache;
+	uint64_t   bloom_skip;
+	uint64_t   bloom_false;
 	uint32_t   gc_count;
 	sslist     gc;
-	sdc        rdc;
+	sslist     lru;
+	uint64_t   lru_used;
+	siblobpool blob;
 	sischeme   scheme;
+	simanifest manifest;
 	so        *object;
 	sr         r;
 	sslist     link;
@@ -38,6 +46,41 @@ si_unlock(si *i) {
 	ss_mutexunlock(&i->lock);
 }
 
+static inline void
+si_nodeleave(si *i, sinode *node)
+{
+	if (si_nodeleave_unlocked(node)) {
+		si_lock(i);
+		ss_condbroadcast(&i->cond);
+		si_unlock(i);
+	}
+}
+
+static inline void
+si_nodewait(si *i, sinode *node)
+{
+	/* wait for memory index readers of the node and
+	 * concurrent writers of the index to complete.
+	 *
+	 * Index lock must be held, it is released while
+	 * waiting. New writers are not admitted until
+	 * the wait is over (see si_begin()).
+	*/
+	i->writers_wait++;
+	for (;;) {
+		ss_spinlock(&node->reflock);
+		int busy = node->readers > 0;
+		node->readers_wait = busy;
+		ss_spinunlock(&node->reflock);
+		if (!busy && i->writers == 0)
+			break;
+		ss_condwait(&i->cond, &i->lock);
+	}
+	i->writers_wait--;
+	if (i->writers_wait == 0)
+		ss_condbroadcast(&i->cond);
+}
+
 static inline sr*
 si_r(si *i) {
 	return &i->r;
@@ -51,9 +94,11 @@ si_scheme(si *i) {
 si *si_init(sr*, so*);
 int si_open(si*);
 int si_close(si*);
+int si_nodedrop(si*, sinode*);
 int si_insert(si*, sinode*);
 int si_remove(si*, sinode*);
 int si_replace(si*, sinode*, sinode*);
+int si_nodeuse(si*, sinode*);
 int si_execute(si*, sdc*, siplan*, uint64_t);
 siplannerrc
 si_plan(si*, siplan*);
@@ -15,6 +15,26 @@
 #include <libsd.h>
 #include <libsi.h>
 
+static inline int
+si_backupwrite(sr *r, ssfile *file, char *buf, uint64_t size)
+{
+	/* write by chunks, so the i/o limit is
+	 * applied evenly */
+	uint64_t chunk = 1024 * 1024;
+	uint64_t pos = 0;
+	while (pos < size) {
+		uint64_t left = size - pos;
+		if (left > chunk)
+			left = chunk;
+		sr_throttle(r, left);
+		int rc = ss_filewrite(file, buf + pos, left);
+		if (ssunlikely(rc == -1))
+			return -1;
+		pos += left;
+	}
+	return 0;
+}
+
 static inline int
 si_backupend(si *index, sdc *c, siplan *plan)
 {
@@ -66,6 +86,7 @@ si_backupend(si *index, sdc *c, siplan *plan)
 		         dst, strerror(errno));
 		return -1;
 	}
+	sr_throttle(r, size);
 	rc = ss_filewrite(&file, c->c.s, size);
 	if (ssunlikely(rc == -1)) {
 		sr_error(r->e, "backup db file '%s' write error: %s",
@@ -88,6 +109,65 @@ si_backupend(si *index, sdc *c, siplan *plan)
 	return 0;
 }
 
+static inline int
+si_backupblob(si *index, sdc *c, char *dir, uint64_t id)
+{
+	sr *r = &index->r;
+	sspath path;
+	ss_path(&path, dir, id, ".blob");
+	/* value log is immutable and might be already
+	 * copied with another node */
+	if (ss_vfsexists(r->vfs, path.path))
+		return 0;
+	siblob *blob = si_blobmatch(&index->blob, id);
+	assert(blob != NULL);
+	ssfile file;
+	ss_fileinit(&file, r->vfs);
+	int rc = ss_filenew(&file, path.path, 0);
+	if (ssunlikely(rc == -1)) {
+		sr_error(r->e, "backup db file '%s' create error: %s",
+		         path.path, strerror(errno));
+		return -1;
+	}
+	/* copy by chunks */
+	uint64_t chunk = 1024 * 1024;
+	rc = ss_bufensure(&c->c, r->a, chunk);
+	if (ssunlikely(rc == -1)) {
+		ss_fileclose(&file);
+		return sr_oom(r->e);
+	}
+	uint64_t size = blob->file.size;
+	uint64_t pos = 0;
+	while (pos < size) {
+		uint64_t left = size - pos;
+		if (left > chunk)
+			left = chunk;
+		rc = ss_filepread(&blob->file, pos, c->c.s, left);
+		if (ssunlikely(rc == -1)) {
+			sr_error(r->e, "backup db file '%s' read error: %s",
+			         ss_pathof(&blob->file.path), strerror(errno));
+			ss_fileclose(&file);
+			return -1;
+		}
+		rc = si_backupwrite(r, &file, c->c.s, left);
+		if (ssunlikely(rc == -1)) {
+			sr_error(r->e, "backup db file '%s' write error: %s",
+			         path.path, strerror(errno));
+			ss_fileclose(&file);
+			return -1;
+		}
+		pos += left;
+	}
+	ss_fileadvise(&file, 0, 0, file.size);
+	rc = ss_fileclose(&file);
+	if (ssunlikely(rc == -1)) {
+		sr_error(r->e, "backup db file '%s' close error: %s",
+		         path.path, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
 int si_backup(si *index, sdc *c, siplan *plan)
 {
 	sr *r = &index->r;
@@ -101,8 +181,15 @@ int si_backup(si *index, sdc *c, siplan *plan)
 	         (uint32_t)plan->a,
 	         index->scheme.name);
 
+	/* open node file on first access */
+	si_lock(index);
+	int rc = si_nodeuse(index, node);
+	si_unlock(index);
+	if (ssunlikely(rc == -1))
+		return -1;
+
 	/* read origin file */
-	int rc = si_noderead(node, r, &c->c);
+	rc = si_noderead(node, r, &c->c);
 	if (ssunlikely(rc == -1))
 		return -1;
 
@@ -117,7 +204,7 @@ int si_backup(si *index, sdc *c, siplan *plan)
 		         path.path, strerror(errno));
 		return -1;
 	}
-	rc = ss_filewrite(&file, c->c.s, node->file.size);
+	rc = si_backupwrite(r, &file, c->c.s, node->file.size);
 	if (ssunlikely(rc == -1)) {
 		sr_error(r->e, "backup db file '%s' write error: %s",
 				 path.path, strerror(errno));
@@ -132,6 +219,15 @@ int si_backup(si *index, sdc *c, siplan *plan)
 		return -1;
 	}
 
+	/* copy value logs referenced by the node */
+	sdblobstat *stat = (sdblobstat*)node->blobs.s;
+	sdblobstat *end  = (sdblobstat*)node->blobs.p;
+	for (; stat < end; stat++) {
+		rc = si_backupblob(index, c, dst, stat->id);
+		if (ssunlikely(rc == -1))
+			return -1;
+	}
+
 	si_lock(index);
 	node->backup = plan->a;
 	si_nodeunlock(node);
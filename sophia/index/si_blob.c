@@ -0,0 +1,278 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+#include <libso.h>
+#include <libsv.h>
+#include <libsd.h>
+#include <libsi.h>
+
+void si_blobpool_init(siblobpool *p)
+{
+	ss_spinlockinit(&p->lock);
+	ss_bufinit(&p->list);
+	p->size = 0;
+	p->live = 0;
+}
+
+static inline int
+si_blobclose(siblob *b, sr *r)
+{
+	int rc = ss_fileclose(&b->file);
+	if (ssunlikely(rc == -1)) {
+		sr_malfunction(r->e, "blob file '%s' close error: %s",
+		               ss_pathof(&b->file.path),
+		               strerror(errno));
+	}
+	ss_free(r->a, b);
+	return rc;
+}
+
+int si_blobpool_free(siblobpool *p, sr *r)
+{
+	int rcret = 0;
+	siblob **list = (siblob**)p->list.s;
+	int count = si_blobcount(p);
+	int i = 0;
+	while (i < count) {
+		int rc = si_blobclose(list[i], r);
+		if (ssunlikely(rc == -1))
+			rcret = -1;
+		i++;
+	}
+	ss_buffree(&p->list, r->a);
+	ss_spinlockfree(&p->lock);
+	return rcret;
+}
+
+static inline int
+si_blobsearch(siblobpool *p, uint64_t id, int *pos)
+{
+	/* list is ordered by id */
+	siblob **list = (siblob**)p->list.s;
+	int min = 0;
+	int max = si_blobcount(p) - 1;
+	while (min <= max) {
+		int mid = min + (max - min) / 2;
+		if (list[mid]->id == id) {
+			*pos = mid;
+			return 1;
+		}
+		if (list[mid]->id < id)
+			min = mid + 1;
+		else
+			max = mid - 1;
+	}
+	*pos = min;
+	return 0;
+}
+
+siblob *si_blobmatch(siblobpool *p, uint64_t id)
+{
+	siblob *b = NULL;
+	int pos;
+	ss_spinlock(&p->lock);
+	if (si_blobsearch(p, id, &pos))
+		b = ((siblob**)p->list.s)[pos];
+	ss_spinunlock(&p->lock);
+	return b;
+}
+
+static inline int
+si_blobadd(siblobpool *p, sr *r, siblob *b)
+{
+	int rc = ss_bufensure(&p->list, r->a, sizeof(siblob*));
+	if (ssunlikely(rc == -1))
+		return -1;
+	int pos;
+	rc = si_blobsearch(p, b->id, &pos);
+	assert(rc == 0);
+	siblob **list = (siblob**)p->list.s;
+	memmove(&list[pos + 1], &list[pos],
+	        (si_blobcount(p) - pos) * sizeof(siblob*));
+	list[pos] = b;
+	ss_bufadvance(&p->list, sizeof(siblob*));
+	p->size += b->file.size;
+	return 0;
+}
+
+static inline siblob*
+si_blobopen(sr *r, sischeme *scheme, uint64_t id)
+{
+	siblob *b = ss_malloc(r->a, sizeof(siblob));
+	if (ssunlikely(b == NULL)) {
+		sr_oom_malfunction(r->e);
+		return NULL;
+	}
+	b->id   = id;
+	b->live = 0;
+	ss_fileinit(&b->file, r->vfs);
+	sspath path;
+	ss_path(&path, scheme->path, id, ".blob");
+	int rc = ss_fileopen(&b->file, path.path, 0);
+	if (ssunlikely(rc == -1)) {
+		sr_malfunction(r->e, "blob file '%s' open error: %s",
+		               path.path, strerror(errno));
+		ss_free(r->a, b);
+		return NULL;
+	}
+	return b;
+}
+
+int si_blobref(siblobpool *p, sr *r, sischeme *scheme, sinode *n)
+{
+	sdblobstat *stat = (sdblobstat*)n->blobs.s;
+	sdblobstat *end  = (sdblobstat*)n->blobs.p;
+	for (; stat < end; stat++) {
+		int pos;
+		ss_spinlock(&p->lock);
+		if (sslikely(si_blobsearch(p, stat->id, &pos))) {
+			siblob *b = ((siblob**)p->list.s)[pos];
+			b->live += stat->size;
+			p->live += stat->size;
+			ss_spinunlock(&p->lock);
+			continue;
+		}
+		ss_spinunlock(&p->lock);
+
+		/* first reference to the log */
+		siblob *b = si_blobopen(r, scheme, stat->id);
+		if (ssunlikely(b == NULL))
+			return -1;
+		b->live = stat->size;
+		ss_spinlock(&p->lock);
+		int rc = si_blobadd(p, r, b);
+		if (sslikely(rc == 0))
+			p->live += stat->size;
+		ss_spinunlock(&p->lock);
+		if (ssunlikely(rc == -1)) {
+			si_blobclose(b, r);
+			return sr_oom_malfunction(r->e);
+		}
+	}
+	return 0;
+}
+
+int si_blobunref(siblobpool *p, sr *r, sinode *n)
+{
+	int rcret = 0;
+	sdblobstat *stat = (sdblobstat*)n->blobs.s;
+	sdblobstat *end  = (sdblobstat*)n->blobs.p;
+	for (; stat < end; stat++) {
+		int pos;
+		ss_spinlock(&p->lock);
+		if (ssunlikely(! si_blobsearch(p, stat->id, &pos))) {
+			ss_spinunlock(&p->lock);
+			continue;
+		}
+		siblob **list = (siblob**)p->list.s;
+		siblob *b = list[pos];
+		assert(b->live >= stat->size);
+		b->live -= stat->size;
+		p->live -= stat->size;
+		if (b->live > 0) {
+			ss_spinunlock(&p->lock);
+			continue;
+		}
+		/* last reference, remove the log */
+		memmove(&list[pos], &list[pos + 1],
+		        (si_blobcount(p) - pos - 1) * sizeof(siblob*));
+		p->list.p -= sizeof(siblob*);
+		p->size -= b->file.size;
+		ss_spinunlock(&p->lock);
+		int rc = ss_vfsunlink(r->vfs, ss_pathof(&b->file.path));
+		if (ssunlikely(rc == -1)) {
+			sr_malfunction(r->e, "blob file '%s' unlink error: %s",
+			               ss_pathof(&b->file.path),
+			               strerror(errno));
+			rcret = -1;
+		}
+		rc = si_blobclose(b, r);
+		if (ssunlikely(rc == -1))
+			rcret = -1;
+	}
+	return rcret;
+}
+
+int si_blobread(siblobpool *p, sr *r, char *v, ssbuf *buf)
+{
+	/* log can not be removed while the node which
+	 * references it is being read */
+	sdblobref *ref = sd_blobref(r->scheme, v);
+	siblob *b = si_blobmatch(p, ref->id);
+	if (ssunlikely(b == NULL)) {
+		sr_malfunction(r->e, "blob file '%020" PRIu64 ".blob' is missing",
+		               ref->id);
+		return -1;
+	}
+	int rc = sd_blobread(&b->file, r, ref, buf);
+	if (ssunlikely(rc == -1))
+		return -1;
+	/* keep version flags of the reference */
+	uint8_t flags = sf_flags(r->scheme, v) & ~SVBLOB;
+	sf_flagsset(r->scheme, buf->s, flags);
+	return 0;
+}
+
+static inline int64_t
+si_blobprocess(char *name)
+{
+	/* id.blob */
+	char *s = name;
+	int64_t id = 0;
+	while (*s && *s != '.') {
+		if (ssunlikely(! isdigit(*s)))
+			return -1;
+		id = (id * 10) + *s - '0';
+		s++;
+	}
+	if (strcmp(s, ".blob") != 0)
+		return -1;
+	return id;
+}
+
+int si_blobrecover(siblobpool *p, sr *r, sischeme *scheme)
+{
+	/* remove logs which are not referenced by any node,
+	 * left by an interrupted compaction or gc */
+	DIR *dir = opendir(scheme->path);
+	if (ssunlikely(dir == NULL)) {
+		sr_malfunction(r->e, "directory '%s' open error: %s",
+		               scheme->path, strerror(errno));
+		return -1;
+	}
+	struct dirent *de;
+	while ((de = readdir(dir))) {
+		int64_t id = si_blobprocess(de->d_name);
+		if (id == -1)
+			continue;
+		if ((uint64_t)id > r->seq->nsn)
+			r->seq->nsn = id;
+		if (si_blobmatch(p, id))
+			continue;
+		sspath path;
+		ss_path(&path, scheme->path, id, ".blob");
+		int rc = ss_vfsunlink(r->vfs, path.path);
+		if (ssunlikely(rc == -1)) {
+			sr_malfunction(r->e, "blob file '%s' unlink error: %s",
+			               path.path, strerror(errno));
+			closedir(dir);
+			return -1;
+		}
+	}
+	closedir(dir);
+	if (si_blobcount(p) > 0 && sf_upserthas(&scheme->upsert)) {
+		sr_error(r->e, "%s", "incompatible options: upsert and "
+		         "separated values");
+		return -1;
+	}
+	return 0;
+}
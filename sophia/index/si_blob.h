@@ -0,0 +1,60 @@
+#ifndef SI_BLOB_H_
+#define SI_BLOB_H_
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+typedef struct siblob siblob;
+typedef struct siblobpool siblobpool;
+
+/*
+	value logs referenced by the nodes.
+
+	live is a sum of bytes referenced by nodes which are
+	in the index or waiting for gc. Log is removed as soon as
+	the last node referencing it is removed.
+*/
+
+struct siblob {
+	uint64_t id;
+	uint64_t live;
+	ssfile   file;
+};
+
+struct siblobpool {
+	ssspinlock lock;
+	ssbuf      list;
+	uint64_t   size;
+	uint64_t   live;
+};
+
+void    si_blobpool_init(siblobpool*);
+int     si_blobpool_free(siblobpool*, sr*);
+int     si_blobref(siblobpool*, sr*, sischeme*, sinode*);
+int     si_blobunref(siblobpool*, sr*, sinode*);
+siblob *si_blobmatch(siblobpool*, uint64_t);
+int     si_blobread(siblobpool*, sr*, char*, ssbuf*);
+int     si_blobrecover(siblobpool*, sr*, sischeme*);
+
+static inline int
+si_blobcount(siblobpool *p) {
+	return ss_bufused(&p->list) / sizeof(siblob*);
+}
+
+static inline int
+si_nodeblob_has(sinode *n, uint64_t id)
+{
+	sdblobstat *stat = (sdblobstat*)n->blobs.s;
+	sdblobstat *end  = (sdblobstat*)n->blobs.p;
+	for (; stat < end; stat++)
+		if (stat->id == id)
+			return 1;
+	return 0;
+}
+
+#endif
@@ -14,6 +14,7 @@ typedef struct sicachepool sicachepool;
 
 struct sicache {
 	uint64_t     nsn;
+	uint32_t     nsn_index;
 	int          open;
 	sinode      *node;
 	sdindexpage *ref;
@@ -23,13 +24,19 @@ struct sicache {
 	ssiter       index_iter;
 	ssbuf        buf_a;
 	ssbuf        buf_b;
+	ssbuf        buf_read;
+	ssbuf        buf_blob;
+	sdio         io;
+	svupsert     upsert;
 	sicache     *next;
 	sicachepool *pool;
 };
 
 struct sicachepool {
+	ssspinlock lock;
 	sicache *head;
 	int n;
+	sdpagecache *page_cache;
 	sr *r;
 };
 
@@ -38,6 +45,7 @@ si_cacheinit(sicache *c, sicachepool *pool)
 {
 	c->node = NULL;
 	c->nsn  = 0;
+	c->nsn_index = 0;
 	c->next = NULL;
 	c->pool = pool;
 	c->open = 0;
@@ -45,13 +53,23 @@ si_cacheinit(sicache *c, sicachepool *pool)
 	ss_iterinit(sd_read, &c->i);
 	ss_bufinit(&c->buf_a);
 	ss_bufinit(&c->buf_b);
+	ss_bufinit(&c->buf_read);
+	ss_bufinit(&c->buf_blob);
+	sd_ioinit(&c->io);
+	sv_upsertinit(&c->upsert);
 }
 
 static inline void
 si_cachefree(sicache *c)
 {
-	ss_buffree(&c->buf_a, c->pool->r->a);
-	ss_buffree(&c->buf_b, c->pool->r->a);
+	sr *r = c->pool->r;
+	ss_iterclose(sd_read, &c->i);
+	ss_buffree(&c->buf_a, r->a);
+	ss_buffree(&c->buf_b, r->a);
+	ss_buffree(&c->buf_read, r->a);
+	ss_buffree(&c->buf_blob, r->a);
+	sd_iofree(&c->io, r);
+	sv_upsertfree(&c->upsert, r);
 }
 
 static inline void
@@ -64,12 +82,15 @@ si_cachereset(sicache *c)
 	c->open   = 0;
 	c->node   = NULL;
 	c->nsn    = 0;
+	c->nsn_index = 0;
 }
 
 static inline int
 si_cachevalidate(sicache *c, sinode *n)
 {
-	if (sslikely(c->node == n && c->nsn == n->id))
+	/* page index might be reloaded since last access */
+	if (sslikely(c->node == n && c->nsn == n->id &&
+	             c->nsn_index == n->index_version))
 		return 0;
 	ss_iterclose(sd_read, &c->i);
 	ss_bufreset(&c->buf_a);
@@ -78,14 +99,17 @@ si_cachevalidate(sicache *c, sinode *n)
 	c->open = 0;
 	c->node = n;
 	c->nsn  = n->id;
+	c->nsn_index = n->index_version;
 	return 0;
 }
 
 static inline void
-si_cachepool_init(sicachepool *p, sr *r)
+si_cachepool_init(sicachepool *p, sdpagecache *page_cache, sr *r)
 {
+	ss_spinlockinit(&p->lock);
 	p->head = NULL;
 	p->n    = 0;
+	p->page_cache = page_cache;
 	p->r    = r;
 }
 
@@ -100,20 +124,24 @@ si_cachepool_free(sicachepool *p)
 		ss_free(p->r->a, c);
 		c = next;
 	}
+	ss_spinlockfree(&p->lock);
 }
 
 static inline sicache*
 si_cachepool_pop(sicachepool *p)
 {
 	sicache *c;
+	ss_spinlock(&p->lock);
 	if (sslikely(p->n > 0)) {
 		c = p->head;
 		p->head = c->next;
 		p->n--;
+		ss_spinunlock(&p->lock);
 		si_cachereset(c);
 		c->pool = p;
 		return c;
 	}
+	ss_spinunlock(&p->lock);
 	c = ss_malloc(p->r->a, sizeof(sicache));
 	if (ssunlikely(c == NULL))
 		return NULL;
@@ -125,9 +153,13 @@ static inline void
 si_cachepool_push(sicache *c)
 {
 	sicachepool *p = c->pool;
+	/* release page cache reference */
+	ss_iterclose(sd_read, &c->i);
+	ss_spinlock(&p->lock);
 	c->next = p->head;
 	p->head = c;
 	p->n++;
+	ss_spinunlock(&p->lock);
 }
 
 #endif
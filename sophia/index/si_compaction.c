@@ -58,9 +58,7 @@ si_redistribute(si *index, sr *r, sdc *c, sinode *node, ssbuf *result)
 		{
 			svv *v = ss_iterof(ss_bufiterref, &i);
 			v->next = NULL;
-			sdindexpage *page = sd_indexmin(&p->index);
-			rc = sf_compare(r->scheme, sv_vpointer(v),
-			                sd_indexpage_min(&p->index, page));
+			rc = sf_compare(r->scheme, sv_vpointer(v), si_nodemin(p));
 			if (ssunlikely(rc >= 0))
 				break;
 			sv_indexset(&prev->i0, r, v);
@@ -141,36 +139,63 @@ si_split(si *index, sdc *c, ssbuf *result,
          uint64_t  size_node,
          uint64_t  size_stream,
          uint32_t  stream,
-         uint64_t  vlsn)
+         uint64_t  vlsn,
+         siblob   *gc)
 {
 	sr *r = &index->r;
 	uint32_t timestamp = ss_timestamp();
 	int rc;
+	/* separate large values into a new value log,
+	 * references are tracked even if disabled */
+	sdblob blob;
+	sd_blobinit(&blob, index->scheme.path,
+	            index->scheme.compaction.blob_threshold);
+	if (gc)
+		sd_blobcollect(&blob, gc->id, &gc->file);
 	sdmergeconf mergeconf = {
 		.stream              = stream,
 		.size_stream         = size_stream,
 		.size_node           = size_node,
 		.size_page           = index->scheme.compaction.node_page_size,
 		.checksum            = index->scheme.compaction.node_page_checksum,
+		.delta               = index->scheme.compaction.node_page_delta,
+		.prefix              = index->scheme.compaction.node_page_prefix,
+		.bloom               = index->scheme.compaction.bloom_bits,
 		.expire              = index->scheme.expire,
 		.timestamp           = timestamp,
 		.compression         = index->scheme.compression,
 		.compression_if      = index->scheme.compression_if,
 		.direct_io           = index->scheme.direct_io,
 		.direct_io_page_size = index->scheme.direct_io_page_size,
-		.vlsn                = vlsn
+		.vlsn                = vlsn,
+		.blob                = &blob
 	};
 	sinode *n = NULL;
 	sdmerge merge;
 	rc = sd_mergeinit(&merge, r, i, &c->build, &c->build_index,
 	                  &c->upsert, &mergeconf);
-	if (ssunlikely(rc == -1))
+	if (ssunlikely(rc == -1)) {
+		sd_blobfree(&blob, r);
 		return -1;
+	}
+	/* overlap page compression with the merge */
+	uint32_t pipeline = index->scheme.compaction.pipeline;
+	sdpipe pipe;
+	sd_pipeinit(&pipe, r);
+	if (pipeline > 0) {
+		rc = sd_pipeopen(&pipe, pipeline);
+		if (ssunlikely(rc == -1)) {
+			sd_pipefree(&pipe);
+			sd_mergefree(&merge);
+			sd_blobfree(&blob, r);
+			return -1;
+		}
+	}
 	while ((rc = sd_merge(&merge)) > 0)
 	{
 		/* create new node */
 		uint64_t id = sr_seq(index->r.seq, SR_NSNNEXT);
-		n = si_nodenew(r, id, parent->id);
+		n = si_nodenew(r, &index->scheme, id, parent->id);
 		if (ssunlikely(n == NULL))
 			goto error;
 		rc = si_nodecreate(n, r, &index->scheme);
@@ -179,12 +204,16 @@ si_split(si *index, sdc *c, ssbuf *result,
 
 		/* write pages */
 		uint64_t offset;
-		offset = sd_iosize(&c->io, &n->file);
-		while ((rc = sd_mergepage(&merge, offset)) == 1) {
-			rc = sd_writepage(r, &n->file, &c->io, merge.build);
-			if (ssunlikely(rc == -1))
-				goto error;
+		if (pipeline > 0) {
+			rc = sd_pipemerge(&pipe, &merge, &n->file, &c->io);
+		} else {
 			offset = sd_iosize(&c->io, &n->file);
+			while ((rc = sd_mergepage(&merge, offset)) == 1) {
+				rc = sd_writepage(r, &n->file, &c->io, merge.build);
+				if (ssunlikely(rc == -1))
+					goto error;
+				offset = sd_iosize(&c->io, &n->file);
+			}
 		}
 		if (ssunlikely(rc == -1))
 			goto error;
@@ -206,6 +235,11 @@ si_split(si *index, sdc *c, ssbuf *result,
 				goto error;
 		}
 
+		/* keep node key range resident */
+		rc = si_nodekeys(n, r, &merge.index);
+		if (ssunlikely(rc == -1))
+			goto error;
+
 		/* add node to the list */
 		rc = ss_bufadd(result, index->r.a, &n, sizeof(sinode*));
 		if (ssunlikely(rc == -1)) {
@@ -217,40 +251,33 @@ si_split(si *index, sdc *c, ssbuf *result,
 	}
 	if (ssunlikely(rc == -1))
 		goto error;
+	/* value log must be durable before the nodes
+	 * which reference it */
+	rc = sd_blobcomplete(&blob, r, index->scheme.sync);
+	if (ssunlikely(rc == -1)) {
+		n = NULL;
+		goto error;
+	}
+	sd_pipefree(&pipe);
+	sd_blobfree(&blob, r);
 	return 0;
 error:
+	sd_pipefree(&pipe);
 	if (n)
 		si_nodefree(n, r, 0);
 	sd_mergefree(&merge);
 	si_splitfree(result, r);
+	sd_blobfree(&blob, r);
 	return -1;
 }
 
 static int
-si_merge(si *index, sdc *c, sinode *node,
-         uint64_t vlsn,
-         ssiter *stream,
-         uint64_t size_stream,
-         uint32_t n_stream)
+si_merge(si *index, sdc *c, sinode *node)
 {
 	sr *r = &index->r;
 	ssbuf *result = &c->a;
 	ssiter i;
-
-	/* begin compaction.
-	 *
-	 * Split merge stream into a number of
-	 * a new nodes.
-	 */
 	int rc;
-	rc = si_split(index, c, result,
-	              node, stream,
-	              index->scheme.compaction.node_size,
-	              size_stream,
-	              n_stream,
-	              vlsn);
-	if (ssunlikely(rc == -1))
-		return -1;
 
 	SS_INJECTION(r->i, SS_INJECTION_SI_COMPACTION_0,
 	             si_splitfree(result, r);
@@ -281,8 +308,23 @@ si_merge(si *index, sdc *c, sinode *node,
 		count++;
 	}
 
+	/* reference value logs of the new nodes */
+	ss_iterinit(ss_bufiterref, &i);
+	ss_iteropen(ss_bufiterref, &i, result, sizeof(sinode*));
+	while (ss_iterhas(ss_bufiterref, &i))
+	{
+		n = ss_iterof(ss_bufiterref, &i);
+		rc = si_blobref(&index->blob, r, &index->scheme, n);
+		if (ssunlikely(rc == -1)) {
+			si_splitfree(result, r);
+			return -1;
+		}
+		ss_iternext(ss_bufiterref, &i);
+	}
+
 	/* commit compaction changes */
 	si_lock(index);
+	si_nodewait(index, node);
 	svindex *j = si_nodeindex(node);
 	si_plannerremove(&index->p, node);
 	si_nodesplit(node);
@@ -290,6 +332,7 @@ si_merge(si *index, sdc *c, sinode *node,
 	case 0: /* delete */
 		si_remove(index, node);
 		si_redistribute_index(index, r, c, node);
+		sv_indexreset(j, r);
 		break;
 	case 1: /* self update */
 		n = *(sinode**)result->s;
@@ -321,13 +364,22 @@ si_merge(si *index, sdc *c, sinode *node,
 			si_insert(index, n);
 			si_plannerupdate(&index->p, n);
 		}
+		sv_indexreset(j, r);
 		break;
 	}
-	sv_indexinit(j);
+	sv_indexinit(j, j->type);
 	si_unlock(index);
 
 	/* compaction completion */
 
+	/* record new node set */
+	rc = si_manifestcommit(&index->manifest, r, &index->scheme,
+	                       node, result);
+	if (ssunlikely(rc == -1)) {
+		si_nodefree(node, r, 0);
+		return -1;
+	}
+
 	/* seal nodes */
 	ss_iterinit(ss_bufiterref, &i);
 	ss_iteropen(ss_bufiterref, &i, result, sizeof(sinode*));
@@ -361,15 +413,23 @@ si_merge(si *index, sdc *c, sinode *node,
 	             return -1);
 
 	/* gc node */
+	uint64_t id = node->id;
 	uint16_t refs = si_noderefof(node);
 	if (sslikely(refs == 0)) {
+		rc = si_blobunref(&index->blob, r, node);
+		if (ssunlikely(rc == -1)) {
+			si_nodefree(node, r, 1);
+			return -1;
+		}
 		rc = si_nodefree(node, r, 1);
 		if (ssunlikely(rc == -1))
 			return -1;
 	} else {
 		/* node concurrently being read, schedule for
-		 * delayed removal */
+		 * delayed removal, keep it until new nodes
+		 * are completed */
 		si_nodegc(node, r, &index->scheme);
+		si_noderef(node);
 		si_lock(index);
 		ss_listappend(&index->gc, &node->gc);
 		index->gc_count++;
@@ -395,6 +455,17 @@ si_merge(si *index, sdc *c, sinode *node,
 		ss_iternext(ss_bufiterref, &i);
 	}
 
+	/* directory matches the manifest again, unless
+	 * the node removal is delayed (see si_nodedrop()) */
+	if (sslikely(refs == 0)) {
+		rc = si_manifestmark(&index->manifest, r, &index->scheme,
+		                     SD_MANIFEST_COMPLETE, id);
+		if (ssunlikely(rc == -1))
+			return -1;
+	} else {
+		si_nodeunref(node);
+	}
+
 	/* unlock */
 	si_lock(index);
 	ss_iterinit(ss_bufiterref, &i);
@@ -409,39 +480,43 @@ si_merge(si *index, sdc *c, sinode *node,
 	return 0;
 }
 
-int si_compaction(si *index, sdc *c, siplan *plan, uint64_t vlsn)
+static inline int
+si_compactionprepare(si *index, sdc *c)
 {
-	sr *r = &index->r;
-	sinode *node = plan->node;
-	assert(node->flags & SI_LOCK);
-
-	si_lock(index);
-	svindex *vindex;
-	vindex = si_noderotate(node);
-	si_unlock(index);
+	/* prepare direct_io stream */
+	if (! index->scheme.direct_io)
+		return 0;
+	int rc = sd_ioprepare(&c->io, &index->r,
+	                      index->scheme.direct_io,
+	                      index->scheme.direct_io_page_size,
+	                      index->scheme.direct_io_buffer_size);
+	if (ssunlikely(rc == -1))
+		return sr_oom(index->r.e);
+	return 0;
+}
 
-	uint64_t size_stream = vindex->used;
+static int
+si_compactionrange(si *index, sdc *c, sinode *node, svindex *vindex,
+                   char *min, char *max,
+                   uint64_t size_stream,
+                   uint32_t n_stream,
+                   uint64_t vlsn,
+                   siblob *gc)
+{
+	/* merge and split keys of the node in range [min, max),
+	 * open bounds are NULL */
+	sr *r = &index->r;
 	ssiter vindex_iter;
 	ss_iterinit(sv_indexiter, &vindex_iter);
-	ss_iteropen(sv_indexiter, &vindex_iter, &index->r, vindex, SS_GTE, NULL);
-
-	/* prepare direct_io stream */
-	int rc;
-	if (index->scheme.direct_io) {
-		rc = sd_ioprepare(&c->io, r,
-		                  index->scheme.direct_io,
-		                  index->scheme.direct_io_page_size,
-		                  index->scheme.direct_io_buffer_size);
-		if (ssunlikely(rc == -1))
-			return sr_oom(r->e);
-	}
+	ss_iteropen(sv_indexiter, &vindex_iter, r, vindex, SS_GTE, min);
 
 	/* prepare for compaction */
 	svmerge merge;
 	sv_mergeinit(&merge);
-	rc = sv_mergeprepare(&merge, r, 1 + 1);
+	int rc = sv_mergeprepare(&merge, r, 1 + 1);
 	if (ssunlikely(rc == -1))
 		return -1;
+	sv_mergelimit(&merge, max);
 	svmergesrc *s;
 	s = sv_mergeadd(&merge, &vindex_iter);
 
@@ -469,16 +544,248 @@ int si_compaction(si *index, sdc *c, siplan *plan, uint64_t vlsn)
 		.r                   = r
 	};
 	ss_iterinit(sd_read, &s->src);
-	rc = ss_iteropen(sd_read, &s->src, &arg, NULL);
-	if (ssunlikely(rc == -1))
+	rc = ss_iteropen(sd_read, &s->src, &arg, min);
+	if (ssunlikely(rc == -1)) {
+		sv_mergefree(&merge, r->a);
 		return -1;
-	size_stream += sd_indextotal(&node->index);
+	}
 
+	/* begin compaction.
+	 *
+	 * Split merge stream into a number of
+	 * a new nodes.
+	 */
 	ssiter i;
 	ss_iterinit(sv_mergeiter, &i);
 	ss_iteropen(sv_mergeiter, &i, r, &merge, SS_GTE);
-	rc = si_merge(index, c, node, vlsn, &i, size_stream,
-	              sd_indexkeys(&node->index));
+	rc = si_split(index, c, &c->a, node, &i,
+	              index->scheme.compaction.node_size,
+	              size_stream,
+	              n_stream,
+	              vlsn, gc);
+	ss_iteratorclose(&s->src);
 	sv_mergefree(&merge, r->a);
 	return rc;
 }
+
+typedef struct sisubcompaction sisubcompaction;
+typedef struct sisubcompactionjob sisubcompactionjob;
+
+struct sisubcompaction {
+	sdc      *c;
+	sdc       cbuf;
+	char     *min;
+	char     *max;
+	uint64_t  size_stream;
+	uint32_t  n_stream;
+	int       rc;
+};
+
+struct sisubcompactionjob {
+	si              *index;
+	sinode          *node;
+	svindex         *vindex;
+	uint64_t         vlsn;
+	siblob          *gc;
+	ssmutex          lock;
+	int              next;
+	int              count;
+	sisubcompaction *list;
+};
+
+static inline int
+si_subcompaction_next(sisubcompactionjob *job)
+{
+	ss_mutexlock(&job->lock);
+	if (job->next == job->count) {
+		ss_mutexunlock(&job->lock);
+		return 0;
+	}
+	sisubcompaction *s = &job->list[job->next];
+	job->next++;
+	ss_mutexunlock(&job->lock);
+	s->rc = si_compactionprepare(job->index, s->c);
+	if (sslikely(s->rc == 0))
+		s->rc = si_compactionrange(job->index, s->c, job->node,
+		                           job->vindex,
+		                           s->min, s->max,
+		                           s->size_stream,
+		                           s->n_stream,
+		                           job->vlsn,
+		                           job->gc);
+	return 1;
+}
+
+static void*
+si_subcompaction_worker(void *arg)
+{
+	ssthread *self = arg;
+	sisubcompactionjob *job = self->arg;
+	while (si_subcompaction_next(job));
+	return NULL;
+}
+
+static inline int
+si_subcompaction_count(si *index, sinode *node, uint64_t size_stream)
+{
+	uint32_t threads = index->scheme.compaction.subcompactions;
+	if (threads <= 1)
+		return 1;
+	/* every range produces at least one node, do not
+	 * split streams smaller than a node */
+	uint64_t count = size_stream / index->scheme.compaction.node_size;
+	if (count > threads)
+		count = threads;
+	if (count > node->index.h->count)
+		count = node->index.h->count;
+	if (count == 0)
+		count = 1;
+	return count;
+}
+
+static int
+si_subcompaction(si *index, sdc *c, sinode *node, svindex *vindex,
+                 int count,
+                 uint64_t size_stream,
+                 uint32_t n_stream,
+                 uint64_t vlsn,
+                 siblob *gc)
+{
+	/* split node by page boundaries into a number of key
+	 * ranges, merge every range in a separate thread
+	 * and join results in key order */
+	sr *r = &index->r;
+	sisubcompactionjob job;
+	job.index  = index;
+	job.node   = node;
+	job.vindex = vindex;
+	job.vlsn   = vlsn;
+	job.gc     = gc;
+	job.next   = 0;
+	job.count  = count;
+	job.list   = ss_malloc(r->a, sizeof(sisubcompaction) * count);
+	if (ssunlikely(job.list == NULL))
+		return sr_oom_malfunction(r->e);
+	ss_mutexinit(&job.lock);
+
+	sdindex *index_node = &node->index;
+	uint32_t pages = index_node->h->count;
+	int j = 0;
+	while (j < count) {
+		sisubcompaction *s = &job.list[j];
+		uint32_t start = (uint64_t)pages * j / count;
+		uint32_t end   = (uint64_t)pages * (j + 1) / count;
+		s->min = NULL;
+		s->max = NULL;
+		if (j > 0)
+			s->min = sd_indexpage_min(index_node, sd_indexpage(index_node, start));
+		if (j < count - 1)
+			s->max = sd_indexpage_min(index_node, sd_indexpage(index_node, end));
+		s->size_stream = size_stream * (end - start) / pages;
+		s->n_stream = (uint64_t)n_stream * (end - start) / pages;
+		s->rc = 0;
+		s->c = c;
+		if (j > 0) {
+			sd_cinit(&s->cbuf);
+			s->c = &s->cbuf;
+		}
+		j++;
+	}
+
+	/* current thread takes part in the compaction */
+	ssthreadpool tp;
+	ss_threadpool_init(&tp);
+	int rc = ss_threadpool_new(&tp, r->a, count - 1,
+	                           si_subcompaction_worker, &job);
+	if (ssunlikely(rc == -1))
+		ss_threadpool_init(&tp);
+	while (si_subcompaction_next(&job));
+	ss_threadpool_shutdown(&tp, r->a);
+
+	/* join results */
+	int rcret = 0;
+	for (j = 0; j < count; j++) {
+		if (ssunlikely(job.list[j].rc == -1))
+			rcret = -1;
+	}
+	for (j = 1; j < count && rcret == 0; j++) {
+		sisubcompaction *s = &job.list[j];
+		rc = 0;
+		SS_INJECTION(r->i, SS_INJECTION_SI_COMPACTION_5,
+		             if (j == count - 1) rc = -1);
+		if (sslikely(rc == 0))
+			rc = ss_bufadd(&c->a, r->a, s->c->a.s, ss_bufused(&s->c->a));
+		if (ssunlikely(rc == -1)) {
+			sr_oom_malfunction(r->e);
+			rcret = -1;
+			break;
+		}
+		/* nodes are owned by the joined result now */
+		ss_bufreset(&s->c->a);
+	}
+	if (ssunlikely(rcret == -1)) {
+		/* failed ranges have already freed their nodes */
+		for (j = 0; j < count; j++) {
+			sisubcompaction *s = &job.list[j];
+			if (s->rc == 0)
+				si_splitfree(&s->c->a, r);
+			ss_bufreset(&s->c->a);
+		}
+	}
+	for (j = 1; j < count; j++)
+		sd_cfree(&job.list[j].cbuf, r);
+	ss_mutexfree(&job.lock);
+	ss_free(r->a, job.list);
+	return rcret;
+}
+
+int si_compaction(si *index, sdc *c, siplan *plan, uint64_t vlsn)
+{
+	sinode *node = plan->node;
+	assert(node->flags & SI_LOCK);
+
+	si_lock(index);
+	int rc = si_nodeuse(index, node);
+	if (ssunlikely(rc == -1)) {
+		si_unlock(index);
+		return -1;
+	}
+	svindex *vindex;
+	vindex = si_noderotate(node);
+	/* writers might still update the rotated index */
+	si_nodewait(index, node);
+	si_unlock(index);
+
+	/* new node files are about to be created */
+	rc = si_manifestmark(&index->manifest, &index->r, &index->scheme,
+	                     SD_MANIFEST_BEGIN, node->id);
+	if (ssunlikely(rc == -1))
+		return -1;
+
+	/* value log being collected */
+	siblob *gc = NULL;
+	if (plan->plan == SI_BLOBGC)
+		gc = si_blobmatch(&index->blob, plan->b);
+
+	uint64_t size_stream = vindex->used + sd_indextotal(&node->index);
+	uint32_t n_stream = sd_indexkeys(&node->index);
+
+	/* prefetch node data ahead of the merge */
+	if (index->scheme.compaction.pipeline > 0 &&
+	    !index->scheme.mmap && !index->scheme.direct_io)
+		ss_fileadvise(&node->file, SS_VFS_WILLNEED, 0, node->file.size);
+
+	int count = si_subcompaction_count(index, node, size_stream);
+	if (count > 1) {
+		rc = si_subcompaction(index, c, node, vindex, count,
+		                      size_stream, n_stream, vlsn, gc);
+	} else {
+		rc = si_compactionprepare(index, c);
+		if (sslikely(rc == 0))
+			rc = si_compactionrange(index, c, node, vindex, NULL, NULL,
+			                        size_stream, n_stream, vlsn, gc);
+	}
+	if (ssunlikely(rc == -1))
+		return -1;
+	return si_merge(index, c, node);
+}
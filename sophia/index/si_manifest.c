@@ -0,0 +1,211 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+#include <libso.h>
+#include <libsv.h>
+#include <libsd.h>
+#include <libsi.h>
+
+void si_manifestinit(simanifest *m, sr *r)
+{
+	ss_mutexinit(&m->lock);
+	ss_fileinit(&m->file, r->vfs);
+	sd_manifestinit(&m->m);
+}
+
+int si_manifestfree(simanifest *m, sr *r)
+{
+	int rc = 0;
+	if (m->file.fd != -1) {
+		rc = ss_fileclose(&m->file);
+		if (ssunlikely(rc == -1))
+			sr_malfunction(r->e, "manifest file '%s' close error: %s",
+			               ss_pathof(&m->file.path),
+			               strerror(errno));
+	}
+	sd_manifestfree(&m->m, r);
+	ss_mutexfree(&m->lock);
+	return rc;
+}
+
+int si_manifestrecover(simanifest *m, sr *r, sischeme *scheme)
+{
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/manifest", scheme->path);
+	if (! ss_vfsexists(r->vfs, path))
+		return 0;
+	sd_manifestreset(&m->m);
+	int rc = sd_manifestrecover(&m->m, r, path);
+	if (ssunlikely(rc == -1))
+		return -1;
+	return 1;
+}
+
+static inline int
+si_manifestadd(sdmanifest *m, sr *r, uint8_t type, sinode *n)
+{
+	/* added node keeps everything required to recover
+	 * it without opening the file */
+	sdmanifestnode v;
+	memset(&v, 0, sizeof(v));
+	v.type      = type;
+	v.id        = n->id;
+	v.id_parent = n->id_parent;
+	if (type != SD_MANIFEST_ADD)
+		return sd_manifestadd(m, r, &v, NULL, NULL, NULL);
+	v.size      = n->file.size;
+	v.size_min  = n->keys_min;
+	v.size_max  = ss_bufused(&n->keys) - n->keys_min;
+	v.size_meta = sizeof(sdindexheader) + ss_bufused(&n->keys) +
+	              ss_bufused(&n->blobs);
+	return sd_manifestadd(m, r, &v, &n->header, n->keys.s, n->blobs.s);
+}
+
+static inline int
+si_manifestappend(simanifest *m, sr *r, int sync)
+{
+	int rc = ss_filewrite(&m->file, m->m.buf.s, ss_bufused(&m->m.buf));
+	if (ssunlikely(rc == -1)) {
+		sr_malfunction(r->e, "manifest file '%s' write error: %s",
+		               ss_pathof(&m->file.path),
+		               strerror(errno));
+		return -1;
+	}
+	if (sync) {
+		rc = ss_filesync(&m->file);
+		if (ssunlikely(rc == -1)) {
+			sr_malfunction(r->e, "manifest file '%s' sync error: %s",
+			               ss_pathof(&m->file.path),
+			               strerror(errno));
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int si_manifestwrite(simanifest *m, sr *r, sischeme *scheme, ssbuf *nodes)
+{
+	/* write current node set into a new file and
+	 * atomically replace the previous manifest */
+	sd_manifestreset(&m->m);
+	int rc = sd_manifestbegin(&m->m, r);
+	if (ssunlikely(rc == -1))
+		goto oom;
+	ssiter i;
+	ss_iterinit(ss_bufiterref, &i);
+	ss_iteropen(ss_bufiterref, &i, nodes, sizeof(sinode*));
+	while (ss_iterhas(ss_bufiterref, &i)) {
+		sinode *n = ss_iterof(ss_bufiterref, &i);
+		rc = si_manifestadd(&m->m, r, SD_MANIFEST_ADD, n);
+		if (ssunlikely(rc == -1))
+			goto oom;
+		ss_iternext(ss_bufiterref, &i);
+	}
+	sd_manifestcommit(&m->m, r);
+
+	if (m->file.fd != -1) {
+		rc = ss_fileclose(&m->file);
+		if (ssunlikely(rc == -1)) {
+			sr_malfunction(r->e, "manifest file '%s' close error: %s",
+			               ss_pathof(&m->file.path),
+			               strerror(errno));
+			return -1;
+		}
+	}
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/manifest.incomplete", scheme->path);
+	if (ss_vfsexists(r->vfs, path)) {
+		rc = ss_vfsunlink(r->vfs, path);
+		if (ssunlikely(rc == -1)) {
+			sr_malfunction(r->e, "manifest file '%s' unlink error: %s",
+			               path, strerror(errno));
+			return -1;
+		}
+	}
+	ss_fileinit(&m->file, r->vfs);
+	rc = ss_filenew(&m->file, path, 0);
+	if (ssunlikely(rc == -1)) {
+		sr_malfunction(r->e, "manifest file '%s' create error: %s",
+		               path, strerror(errno));
+		return -1;
+	}
+	rc = si_manifestappend(m, r, scheme->sync);
+	if (ssunlikely(rc == -1))
+		return -1;
+	snprintf(path, sizeof(path), "%s/manifest", scheme->path);
+	rc = ss_filerename(&m->file, path);
+	if (ssunlikely(rc == -1)) {
+		sr_malfunction(r->e, "manifest file '%s' rename error: %s",
+		               ss_pathof(&m->file.path),
+		               strerror(errno));
+		return -1;
+	}
+	sd_manifestreset(&m->m);
+	return 0;
+oom:
+	sr_malfunction_set(r->e);
+	return -1;
+}
+
+int si_manifestcommit(simanifest *m, sr *r, sischeme *scheme,
+                      sinode *node, ssbuf *result)
+{
+	ss_mutexlock(&m->lock);
+	sd_manifestreset(&m->m);
+	int rc = sd_manifestbegin(&m->m, r);
+	if (ssunlikely(rc == -1))
+		goto error;
+	rc = si_manifestadd(&m->m, r, SD_MANIFEST_REMOVE, node);
+	if (ssunlikely(rc == -1))
+		goto error;
+	ssiter i;
+	ss_iterinit(ss_bufiterref, &i);
+	ss_iteropen(ss_bufiterref, &i, result, sizeof(sinode*));
+	while (ss_iterhas(ss_bufiterref, &i)) {
+		sinode *n = ss_iterof(ss_bufiterref, &i);
+		rc = si_manifestadd(&m->m, r, SD_MANIFEST_ADD, n);
+		if (ssunlikely(rc == -1))
+			goto error;
+		ss_iternext(ss_bufiterref, &i);
+	}
+	sd_manifestcommit(&m->m, r);
+	rc = si_manifestappend(m, r, scheme->sync);
+	ss_mutexunlock(&m->lock);
+	return rc;
+error:
+	ss_mutexunlock(&m->lock);
+	return -1;
+}
+
+int si_manifestmark(simanifest *m, sr *r, sischeme *scheme,
+                    uint8_t type, uint64_t id)
+{
+	sdmanifestnode v;
+	memset(&v, 0, sizeof(v));
+	v.type = type;
+	v.id   = id;
+	ss_mutexlock(&m->lock);
+	sd_manifestreset(&m->m);
+	int rc = sd_manifestbegin(&m->m, r);
+	if (ssunlikely(rc == -1))
+		goto error;
+	rc = sd_manifestadd(&m->m, r, &v, NULL, NULL, NULL);
+	if (ssunlikely(rc == -1))
+		goto error;
+	sd_manifestcommit(&m->m, r);
+	rc = si_manifestappend(m, r, scheme->sync);
+	ss_mutexunlock(&m->lock);
+	return rc;
+error:
+	ss_mutexunlock(&m->lock);
+	return -1;
+}
@@ -0,0 +1,27 @@
+#ifndef SI_MANIFEST_H_
+#define SI_MANIFEST_H_
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+typedef struct simanifest simanifest;
+
+struct simanifest {
+	ssmutex    lock;
+	ssfile     file;
+	sdmanifest m;
+};
+
+void si_manifestinit(simanifest*, sr*);
+int  si_manifestfree(simanifest*, sr*);
+int  si_manifestrecover(simanifest*, sr*, sischeme*);
+int  si_manifestwrite(simanifest*, sr*, sischeme*, ssbuf*);
+int  si_manifestcommit(simanifest*, sr*, sischeme*, sinode*, ssbuf*);
+int  si_manifestmark(simanifest*, sr*, sischeme*, uint8_t, uint64_t);
+
+#endif
@@ -16,7 +16,7 @@
 #include <libsd.h>
 #include <libsi.h>
 
-sinode *si_nodenew(sr *r, uint64_t id, uint64_t id_parent)
+sinode *si_nodenew(sr *r, sischeme *scheme, uint64_t id, uint64_t id_parent)
 {
 	sinode *n = (sinode*)ss_malloc(r->a, sizeof(sinode));
 	if (ssunlikely(n == NULL)) {
@@ -32,15 +32,23 @@ sinode *si_nodenew(sr *r, uint64_t id, uint64_t id_parent)
 	n->refs      = 0;
 	ss_spinlockinit(&n->reflock);
 	sd_indexinit(&n->index);
+	memset(&n->header, 0, sizeof(n->header));
+	ss_bufinit(&n->keys);
+	n->keys_min  = 0;
+	ss_bufinit(&n->blobs);
+	n->index_version = 0;
 	ss_fileinit(&n->file, r->vfs);
 	ss_mmapinit(&n->map);
 	ss_mmapinit(&n->map_swap);
-	sv_indexinit(&n->i0);
-	sv_indexinit(&n->i1);
+	n->readers   = 0;
+	n->readers_wait = 0;
+	sv_indexinit(&n->i0, scheme->memtable);
+	sv_indexinit(&n->i1, scheme->memtable);
 	ss_rbinitnode(&n->node);
 	ss_rqinitnode(&n->nodememory);
 	ss_listinit(&n->gc);
 	ss_listinit(&n->commit);
+	ss_listinit(&n->lru);
 	return n;
 }
 
@@ -49,9 +57,17 @@ ss_rbtruncate(si_nodegc_indexgc,
 
 int si_nodegc_index(sr *r, svindex *i)
 {
+	if (i->s) {
+		svskipnode *n = sv_skiplist_min(i->s);
+		while (n) {
+			si_gcvall(r, n->v);
+			n = n->next[0];
+		}
+		sv_skiplist_free(i->s, r);
+	}
 	if (i->i.root)
 		si_nodegc_indexgc(i->i.root, r);
-	sv_indexinit(i);
+	sv_indexinit(i, i->type);
 	return 0;
 }
 
@@ -86,7 +102,7 @@ si_nodeclose(sinode *n, sr *r, int gc)
 }
 
 static inline int
-si_noderecover(sinode *n, sr *r)
+si_noderecover(sinode *n, sr *r, int lazy)
 {
 	int rc;
 	ssiter i;
@@ -101,10 +117,36 @@ si_noderecover(sinode *n, sr *r)
 
 		sdindex index;
 		sd_indexinit(&index);
-		rc = sd_indexcopy(&index, r, h);
-		if (ssunlikely(rc == -1))
-			goto error;
-		n->index = index;
+		if (lazy && sd_indexheader_size(h) == sizeof(sdindexheader)) {
+			/* only read the key range from the mapped
+			 * index, page index is loaded on first access */
+			index.i.s = (char*)h - (h->align + h->size);
+			index.i.p = (char*)h + sizeof(sdindexheader);
+			index.h   = h;
+			rc = si_nodekeys(n, r, &index);
+			if (ssunlikely(rc == -1))
+				goto error;
+			sd_indexinit(&n->index);
+			n->index.h = &n->header;
+		} else {
+			/* older index header has to be upgraded
+			 * in memory first */
+			rc = sd_indexcopy(&index, r, h);
+			if (ssunlikely(rc == -1))
+				goto error;
+			rc = si_nodekeys(n, r, &index);
+			if (ssunlikely(rc == -1)) {
+				sd_indexfree(&index, r);
+				goto error;
+			}
+			if (lazy) {
+				sd_indexfree(&index, r);
+				sd_indexinit(&n->index);
+				n->index.h = &n->header;
+			} else {
+				n->index = index;
+			}
+		}
 
 		ss_iteratornext(&i);
 	}
@@ -136,7 +178,7 @@ int si_nodeopen(sinode *n, sr *r, sischeme *scheme, sspath *path)
 		               strerror(errno));
 		return -1;
 	}
-	rc = si_noderecover(n, r);
+	rc = si_noderecover(n, r, scheme->index_lazy);
 	if (ssunlikely(rc == -1))
 		return -1;
 	if (scheme->mmap) {
@@ -147,6 +189,31 @@ int si_nodeopen(sinode *n, sr *r, sischeme *scheme, sspath *path)
 	return 0;
 }
 
+int si_noderestore(sinode *n, sr *r, sspath *path, sdmanifestnode *v)
+{
+	/* recover node from the manifest record, file is
+	 * opened on first access (see si_nodeload()) */
+	ss_pathset(&n->file.path, "%s", path->path);
+	n->file.size = v->size;
+	uint32_t size = v->size_min + v->size_max;
+	int rc = ss_bufensure(&n->keys, r->a, size);
+	if (ssunlikely(rc == -1))
+		return sr_oom_malfunction(r->e);
+	memcpy(n->keys.p, sd_manifestnode_keys(v), size);
+	ss_bufadvance(&n->keys, size);
+	n->keys_min = v->size_min;
+	uint32_t size_blob = sd_manifestnode_blobsize(v);
+	if (size_blob > 0) {
+		rc = ss_bufadd(&n->blobs, r->a, sd_manifestnode_blobs(v), size_blob);
+		if (ssunlikely(rc == -1))
+			return sr_oom_malfunction(r->e);
+	}
+	n->header = *sd_manifestnode_header(v);
+	sd_indexinit(&n->index);
+	n->index.h = &n->header;
+	return 0;
+}
+
 int si_nodecreate(sinode *n, sr *r, sischeme *scheme)
 {
 	sspath path;
@@ -161,6 +228,140 @@ int si_nodecreate(sinode *n, sr *r, sischeme *scheme)
 	return 0;
 }
 
+static inline int
+si_nodeblobs(sinode *n, sr *r, sdindex *index)
+{
+	/* value logs referenced by the node */
+	ss_bufreset(&n->blobs);
+	sdblobstat *stat = sd_indexblob(index);
+	if (stat == NULL)
+		return 0;
+	int rc = ss_bufadd(&n->blobs, r->a, stat, index->h->blob);
+	if (ssunlikely(rc == -1))
+		return sr_oom_malfunction(r->e);
+	return 0;
+}
+
+int si_nodekeys(sinode *n, sr *r, sdindex *index)
+{
+	/* keep index header and node key range resident,
+	 * they are enough to route a key to the node */
+	sdindexpage *min = sd_indexmin(index);
+	sdindexpage *max = sd_indexmax(index);
+	ss_bufreset(&n->keys);
+	if (ssunlikely(min->sizemin == 0)) {
+		/* bootstrap node has a single empty page, keep
+		 * a zeroed key to compare against */
+		sfscheme *s = r->scheme;
+		int size = s->var_offset + s->fields_count * sizeof(sfvar);
+		int rc = ss_bufensure(&n->keys, r->a, size);
+		if (ssunlikely(rc == -1))
+			return sr_oom_malfunction(r->e);
+		memset(n->keys.s, 0, size);
+		ss_bufadvance(&n->keys, size);
+		n->keys_min = 0;
+		n->header = *index->h;
+		ss_bufreset(&n->blobs);
+		return 0;
+	}
+	int rc = ss_bufensure(&n->keys, r->a, min->sizemin + max->sizemax);
+	if (ssunlikely(rc == -1))
+		return sr_oom_malfunction(r->e);
+	memcpy(n->keys.p, sd_indexpage_min(index, min), min->sizemin);
+	ss_bufadvance(&n->keys, min->sizemin);
+	memcpy(n->keys.p, sd_indexpage_max(index, max), max->sizemax);
+	ss_bufadvance(&n->keys, max->sizemax);
+	n->keys_min = min->sizemin;
+	n->header = *index->h;
+	return si_nodeblobs(n, r, index);
+}
+
+static inline int
+si_nodefile(sinode *n, sr *r, sischeme *scheme)
+{
+	sspath path;
+	ss_pathset(&path, "%s", ss_pathof(&n->file.path));
+	uint64_t size = n->file.size;
+	int rc = ss_fileopen(&n->file, path.path, scheme->direct_io);
+	if (ssunlikely(rc == -1)) {
+		sr_malfunction(r->e, "db file '%s' open error: %s",
+		               path.path, strerror(errno));
+		return -1;
+	}
+	if (ssunlikely(n->file.size != size)) {
+		sr_malfunction(r->e, "corrupted db file '%s': size does not "
+		               "match manifest", path.path);
+		return -1;
+	}
+	if (scheme->mmap)
+		return si_nodemap(n, r);
+	return 0;
+}
+
+int si_nodeload(sinode *n, sr *r, sischeme *scheme)
+{
+	assert(! si_nodeloaded(n));
+	/* node recovered from manifest */
+	if (n->file.fd == -1) {
+		int rc = si_nodefile(n, r, scheme);
+		if (ssunlikely(rc == -1))
+			return -1;
+	}
+	sdindexheader *h = &n->header;
+	uint32_t size = sd_indexsize_ext(h);
+	if (ssunlikely(h->offset + size > n->file.size)) {
+		sr_malfunction(r->e, "corrupted db file '%s': bad index offset",
+		               ss_pathof(&n->file.path));
+		return -1;
+	}
+	sdindex index;
+	sd_indexinit(&index);
+	int rc = ss_bufensure(&index.i, r->a, size);
+	if (ssunlikely(rc == -1))
+		return sr_oom_malfunction(r->e);
+	/* use node mapping if possible, direct_io files
+	 * can not be read into unaligned buffer */
+	ssmmap map = n->map;
+	if (map.p == NULL) {
+		rc = ss_vfsmmap(r->vfs, &map, n->file.fd, n->file.size, 1);
+		if (ssunlikely(rc == -1)) {
+			sr_malfunction(r->e, "db file '%s' mmap error: %s",
+			               ss_pathof(&n->file.path),
+			               strerror(errno));
+			sd_indexfree(&index, r);
+			return -1;
+		}
+	}
+	memcpy(index.i.s, map.p + h->offset, size);
+	if (map.p != n->map.p)
+		ss_vfsmunmap(r->vfs, &map);
+	ss_bufadvance(&index.i, size);
+	rc = sd_indexupgrade(&index, r);
+	if (ssunlikely(rc == -1)) {
+		sd_indexfree(&index, r);
+		return -1;
+	}
+	index.h = sd_indexheader(&index);
+	if (ssunlikely(memcmp(index.h, h, sizeof(sdindexheader)) != 0)) {
+		sr_malfunction(r->e, "corrupted db file '%s': bad index header",
+		               ss_pathof(&n->file.path));
+		sd_indexfree(&index, r);
+		return -1;
+	}
+	n->index = index;
+	n->index_version++;
+	return 0;
+}
+
+void si_nodeunload(sinode *n, sr *r)
+{
+	assert(si_nodeloaded(n));
+	sd_indexfree(&n->index, r);
+	sd_indexinit(&n->index);
+	n->index.h = &n->header;
+	n->index_version++;
+}
+
 int si_nodemap(sinode *n, sr *r)
 {
 	int rc = ss_vfsmmap(r->vfs, &n->map, n->file.fd, n->file.size, 1);
@@ -188,6 +389,8 @@ int si_nodefree(sinode *n, sr *r, int gc)
 		}
 	}
 	sd_indexfree(&n->index, r);
+	ss_buffree(&n->keys, r->a);
+	ss_buffree(&n->blobs, r->a);
 	rc = si_nodeclose(n, r, gc);
 	if (ssunlikely(rc == -1))
 		rcret = -1;
@@ -30,8 +30,15 @@ struct sinode {
 	uint64_t   used;
 	uint32_t   backup;
 	uint16_t   refs;
+	uint32_t   readers;
+	uint32_t   readers_wait;
 	ssspinlock reflock;
 	sdindex    index;
+	sdindexheader header;
+	ssbuf      keys;
+	uint16_t   keys_min;
+	ssbuf      blobs;
+	uint32_t   index_version;
 	svindex    i0, i1;
 	ssfile     file;
 	ssmmap     map, map_swap;
@@ -39,14 +46,19 @@ struct sinode {
 	ssrqnode   nodememory;
 	sslist     gc;
 	sslist     commit;
+	sslist     lru;
 } sspacked;
 
-sinode *si_nodenew(sr*, uint64_t, uint64_t);
+sinode *si_nodenew(sr*, sischeme*, uint64_t, uint64_t);
 int si_nodeopen(sinode*, sr*, sischeme*, sspath*);
+int si_noderestore(sinode*, sr*, sspath*, sdmanifestnode*);
 int si_nodecreate(sinode*, sr*, sischeme*);
 int si_nodefree(sinode*, sr*, int);
 int si_nodemap(sinode*, sr*);
 int si_noderead(sinode*, sr*, ssbuf*);
+int si_nodekeys(sinode*, sr*, sdindex*);
+int si_nodeload(sinode*, sr*, sischeme*);
+void si_nodeunload(sinode*, sr*);
 int si_nodegc_index(sr*, svindex*);
 int si_nodegc(sinode*, sr*, sischeme*);
 int si_noderename_seal(sinode*, sr*, sischeme*);
@@ -96,6 +108,29 @@ si_noderefof(sinode *node)
 	return v;
 }
 
+/* memory index readers, which search the node
+ * without the index lock */
+static inline void
+si_nodeenter(sinode *node)
+{
+	ss_spinlock(&node->reflock);
+	node->readers++;
+	ss_spinunlock(&node->reflock);
+}
+
+static inline int
+si_nodeleave_unlocked(sinode *node)
+{
+	/* return 1 if the last reader has to wake
+	 * up the waiter (see si_nodeleave()) */
+	ss_spinlock(&node->reflock);
+	assert(node->readers > 0);
+	node->readers--;
+	int wakeup = node->readers == 0 && node->readers_wait;
+	ss_spinunlock(&node->reflock);
+	return wakeup;
+}
+
 static inline svindex*
 si_noderotate(sinode *node) {
 	node->flags |= SI_ROTATE;
@@ -107,7 +142,7 @@ si_nodeunrotate(sinode *node) {
 	assert((node->flags & SI_ROTATE) > 0);
 	node->flags &= ~SI_ROTATE;
 	node->i0 = node->i1;
-	sv_indexinit(&node->i1);
+	sv_indexinit(&node->i1, node->i1.type);
 }
 
 static inline svindex*
@@ -133,13 +168,26 @@ si_nodeof(ssrbnode *node) {
 	return sscast(node, sinode, node);
 }
 
+static inline int
+si_nodeloaded(sinode *node) {
+	return node->index.i.s != NULL;
+}
+
+static inline char*
+si_nodemin(sinode *node) {
+	return node->keys.s;
+}
+
+static inline char*
+si_nodemax(sinode *node) {
+	return node->keys.s + node->keys_min;
+}
+
 static inline int
 si_nodecmp(sinode *n, char *key, sfscheme *s)
 {
-	sdindexpage *min = sd_indexmin(&n->index);
-	sdindexpage *max = sd_indexmax(&n->index);
-	int l = sf_compare(s, sd_indexpage_min(&n->index, min), key);
-	int r = sf_compare(s, sd_indexpage_max(&n->index, max), key);
+	int l = sf_compare(s, si_nodemin(n), key);
+	int r = sf_compare(s, si_nodemax(n), key);
 	/* inside range */
 	if (l <= 0 && r >= 0)
 		return 0;
@@ -54,6 +54,8 @@ int si_plannertrace(siplan *p, uint32_t id, sstrace *t)
 		break;
 	case SI_NODEGC: plan = "node gc";
 		break;
+	case SI_BLOBGC: plan = "blob gc";
+		break;
 	case SI_BACKUP:
 	case SI_BACKUPEND: plan = "backup";
 		break;
@@ -114,18 +116,29 @@ match:
 	return SI_PMATCH;
 }
 
-static inline siplannerrc
-si_plannerpeek_memory(siplanner *p, siplan *plan)
+uint64_t si_plannerwm(siplanner *p)
 {
-	/* try to peek a node with a biggest in-memory index */
-
-	/* calculate peek wm */
+	/* in-memory index size, which makes node
+	 * ready for compaction */
 	si *index = (si*)p->i;
+	if (ssunlikely(index->n == 0))
+		return index->scheme.compaction.node_size;
 	double cache_per_node =
 		(double)index->scheme.compaction.cache /
 		(double)index->n;
 	if (cache_per_node >= index->scheme.compaction.node_size)
 		cache_per_node = index->scheme.compaction.node_size;
+	return cache_per_node;
+}
+
+static inline siplannerrc
+si_plannerpeek_memory(siplanner *p, siplan *plan)
+{
+	/* try to peek a node with a biggest in-memory index,
+	 * any non-empty one when memory limit is reached */
+	uint64_t cache_per_node = 1;
+	if (! plan->a)
+		cache_per_node = si_plannerwm(p);
 	sinode *n;
 	ssrqnode *pn = NULL;
 	while ((pn = ss_rqprev(&p->memory, pn))) {
@@ -201,6 +214,50 @@ match:
 	return SI_PMATCH;
 }
 
+static inline siplannerrc
+si_plannerpeek_blobgc(siplanner *p, siplan *plan)
+{
+	/* try to peek a node which references a value log
+	 * with the lowest live ratio below the watermark */
+	si *index = p->i;
+	siblobpool *pool = &index->blob;
+	siplannerrc rc = SI_PNONE;
+	sinode *match = NULL;
+	uint64_t match_ratio = plan->a;
+	ss_spinlock(&pool->lock);
+	siblob **list = (siblob**)pool->list.s;
+	int count = si_blobcount(pool);
+	int i = 0;
+	for (; i < count; i++) {
+		siblob *b = list[i];
+		if (ssunlikely(b->file.size == 0))
+			continue;
+		uint64_t ratio = (b->live * 100) / b->file.size;
+		if (ratio >= match_ratio)
+			continue;
+		ssrqnode *pn = NULL;
+		while ((pn = ss_rqprev(&p->memory, pn))) {
+			sinode *n = sscast(pn, sinode, nodememory);
+			if (! si_nodeblob_has(n, b->id))
+				continue;
+			if (n->flags & SI_LOCK) {
+				rc = SI_PRETRY;
+				continue;
+			}
+			match = n;
+			match_ratio = ratio;
+			plan->b = b->id;
+			break;
+		}
+	}
+	ss_spinunlock(&pool->lock);
+	if (match == NULL)
+		return rc;
+	si_nodelock(match);
+	plan->node = match;
+	return SI_PMATCH;
+}
+
 static inline siplannerrc
 si_plannerpeek_nodegc(siplanner *p, siplan *plan)
 {
@@ -234,6 +291,8 @@ si_planner(siplanner *p, siplan *plan)
 		return si_plannerpeek_gc(p, plan);
 	case SI_EXPIRE:
 		return si_plannerpeek_expire(p, plan);
+	case SI_BLOBGC:
+		return si_plannerpeek_blobgc(p, plan);
 	case SI_BACKUP:
 		return si_plannerpeek_backup(p, plan);
 	}
@@ -30,15 +30,20 @@ struct siplanner {
 #define SI_NODEGC     8
 #define SI_BACKUP     16
 #define SI_BACKUPEND  32
+#define SI_BLOBGC     64
 
 struct siplan {
 	int plan;
 	/* compaction:
+	 *   a: memory limit is reached
 	 * gc:
 	 *   a: lsn
 	 *   b: percent
 	 * expire:
 	 *   a: ttl
+	 * blobgc:
+	 *   a: percent
+	 *   b: value log id
 	 * nodegc:
 	 * backup:
 	 *   a: bsn
@@ -53,6 +58,7 @@ int si_plannerfree(siplanner*, ssa*);
 int si_plannertrace(siplan*, uint32_t, sstrace*);
 int si_plannerupdate(siplanner*, sinode*);
 int si_plannerremove(siplanner*, sinode*);
+uint64_t si_plannerwm(siplanner*);
 siplannerrc
 si_planner(siplanner*, siplan*);
 
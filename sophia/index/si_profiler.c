@@ -49,11 +49,21 @@ int si_profiler(siprofiler *p)
 		p->total_node_size += indexsize + n->index.h->total;
 		p->total_node_origin_size += indexsize + n->index.h->totalorigin;
 		p->total_page_count += n->index.h->count;
+		if (si_nodeloaded(n))
+			p->index_memory_used += ss_bufused(&n->index.i);
 
 		pn = ss_rbnext(&p->i->i, pn);
 	}
 	p->memory_used = memory_used;
 	p->read_disk  = p->i->read_disk;
 	p->read_cache = p->i->read_cache;
+	p->bloom_skip  = p->i->bloom_skip;
+	p->bloom_false = p->i->bloom_false;
+	siblobpool *blob = &p->i->blob;
+	ss_spinlock(&blob->lock);
+	p->blob_count = si_blobcount(blob);
+	p->blob_size  = blob->size;
+	p->blob_live  = blob->live;
+	ss_spinunlock(&blob->lock);
 	return 0;
 }
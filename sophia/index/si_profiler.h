@@ -17,10 +17,16 @@ struct siprofiler {
 	uint64_t  total_node_origin_size;
 	uint32_t  total_page_count;
 	uint64_t  memory_used;
+	uint64_t  index_memory_used;
 	uint64_t  count;
 	uint64_t  count_dup;
 	uint64_t  read_disk;
 	uint64_t  read_cache;
+	uint64_t  bloom_skip;
+	uint64_t  bloom_false;
+	uint32_t  blob_count;
+	uint64_t  blob_size;
+	uint64_t  blob_live;
 	si       *i;
 } sspacked;
 
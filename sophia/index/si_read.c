@@ -35,6 +35,8 @@ int si_readopen(siread *q, si *i, sicache *c, ssorder o,
 	q->read_start  = read_start;
 	q->read_disk   = 0;
 	q->read_cache  = 0;
+	q->bloom_skip  = 0;
+	q->bloom_false = 0;
 	q->upsert      = upsert;
 	q->upsert_eq   = 0;
 	q->result      = NULL;
@@ -51,7 +53,12 @@ int si_readopen(siread *q, si *i, sicache *c, ssorder o,
 
 int si_readclose(siread *q)
 {
-	si_unlock(q->index);
+	si *i = q->index;
+	i->read_disk  += q->read_disk;
+	i->read_cache += q->read_cache;
+	i->bloom_skip  += q->bloom_skip;
+	i->bloom_false += q->bloom_false;
+	si_unlock(i);
 	sv_mergefree(&q->merge, q->r->a);
 	return 0;
 }
@@ -59,6 +66,14 @@ int si_readclose(siread *q)
 static inline int
 si_readdup(siread *q, char *result)
 {
+	/* read separated value from the value log */
+	if (ssunlikely(sf_is(q->r->scheme, result, SVBLOB))) {
+		int rc = si_blobread(&q->index->blob, q->r, result,
+		                     &q->cache->buf_blob);
+		if (ssunlikely(rc == -1))
+			return -1;
+		result = q->cache->buf_blob.s;
+	}
 	q->result = sv_vbuildraw(q->r, result);
 	if (ssunlikely(q->result == NULL))
 		return sr_oom(q->r->e);
@@ -68,14 +83,10 @@ si_readdup(siread *q, char *result)
 static inline void
 si_readstat(siread *q, int cache, uint32_t reads)
 {
-	si *i = q->index;
-	if (cache) {
-		i->read_cache += reads;
+	if (cache)
 		q->read_cache += reads;
-	} else {
-		i->read_disk += reads;
+	else
 		q->read_disk += reads;
-	}
 }
 
 static inline int
@@ -105,26 +116,24 @@ si_getresult(siread *q, char *v, int compare)
 }
 
 static inline int
-si_getindex(siread *q, sinode *n)
+si_readconcurrent(siread *q)
 {
-	svindex *second;
-	svindex *first = si_nodeindex_priority(n, &second);
+	/* skiplist memory index is searched without
+	 * the index lock */
+	return q->index->scheme.memtable == SV_INDEXSKIPLIST;
+}
+
+static inline int
+si_getindex_search(siread *q, svindex *index)
+{
+	if (index->count == 0)
+		return 0;
 	ssiter i;
 	ss_iterinit(sv_indexiter, &i);
 	int rc;
-	if (first->count > 0) {
-		rc = ss_iteropen(sv_indexiter, &i, q->r, first, SS_GTE, q->key);
-		if (rc) {
-			goto result;
-		}
-	}
-	if (sslikely(second == NULL || !second->count))
-		return 0;
-	rc = ss_iteropen(sv_indexiter, &i, q->r, second, SS_GTE, q->key);
-	if (! rc) {
+	rc = ss_iteropen(sv_indexiter, &i, q->r, index, SS_GTE, q->key);
+	if (! rc)
 		return 0;
-	}
-result:;
 	si_readstat(q, 1, 1);
 	char *v = ss_iterof(sv_indexiter, &i);
 	assert(v != NULL);
@@ -134,21 +143,38 @@ result:;
 		if (visible == NULL)
 			return 0;
 	}
-	return si_getresult(q, v, 0);
+	return si_getresult(q, sv_vpointer(visible), 0);
+}
+
+static inline int
+si_getindex(siread *q, sinode *n)
+{
+	/* versions which are not visible for the reader
+	 * might shadow older ones in the rotated index */
+	svindex *second;
+	svindex *first = si_nodeindex_priority(n, &second);
+	int rc = si_getindex_search(q, first);
+	if (rc != 0 || second == NULL)
+		return rc;
+	return si_getindex_search(q, second);
 }
 
 static inline int
-si_getfile(siread *q, sinode *n, sicache *c)
+si_getfile(siread *q, sinode *n, sicache *c, int reopen)
 {
 	sischeme *scheme = &q->index->scheme;
 	int rc;
+	if (reopen) {
+		rc = sd_read_reopen(&c->i, q->key);
+		goto search;
+	}
 	/* choose compression type */
 	sdreadarg arg = {
 		.from_compaction     = 0,
-		.io                  = &q->index->rdc.io,
+		.io                  = &c->io,
 		.index               = &n->index,
 		.buf                 = &c->buf_a,
-		.buf_read            = &q->index->rdc.d,
+		.buf_read            = &c->buf_read,
 		.index_iter          = &c->index_iter,
 		.page_iter           = &c->page_iter,
 		.use_mmap            = scheme->mmap,
@@ -162,10 +188,14 @@ si_getfile(siread *q, sinode *n, sicache *c)
 		.o                   = SS_GTE,
 		.mmap                = &n->map,
 		.file                = &n->file,
+		.page_cache          = c->pool->page_cache,
+		.page_cache_id       = n->id,
 		.r                   = q->r
 	};
+	ss_iterclose(sd_read, &c->i);
 	ss_iterinit(sd_read, &c->i);
 	rc = ss_iteropen(sd_read, &c->i, &arg, q->key);
+search:;
 	int reads = sd_read_stat(&c->i);
 	si_readstat(q, 0, reads);
 	if (ssunlikely(rc <= 0))
@@ -181,13 +211,31 @@ si_getfile(siread *q, sinode *n, sicache *c)
 		vlsn = UINT64_MAX;
 	ssiter j;
 	ss_iterinit(sv_readiter, &j);
-	ss_iteropen(sv_readiter, &j, q->r, &i, &q->index->rdc.upsert, vlsn, 1);
+	ss_iteropen(sv_readiter, &j, q->r, &i, &c->upsert, vlsn, 1);
 	char *v = ss_iterof(sv_readiter, &j);
 	if (ssunlikely(v == NULL))
 		return 0;
 	return si_getresult(q, v, 1);
 }
 
+static inline int
+si_getbloom(siread *q, sinode *n)
+{
+	/* skip disk search if the key is definitely
+	 * not in the node */
+	if (sd_indexbloom_has(&n->index, q->r->scheme, q->key))
+		return 1;
+	q->bloom_skip++;
+	return 0;
+}
+
+static inline void
+si_getbloom_result(siread *q, sinode *n, int rc)
+{
+	if (rc == 0 && n->index.h->bloom)
+		q->bloom_false++;
+}
+
 static inline int
 si_get(siread *q)
 {
@@ -200,28 +248,240 @@ si_get(siread *q)
 	assert(node != NULL);
 
 	/* search in memory */
+	int concurrent = si_readconcurrent(q);
 	int rc;
-	rc = si_getindex(q, node);
-	if (rc != 0)
-		return rc;
+	if (! concurrent) {
+		rc = si_getindex(q, node);
+		if (rc != 0)
+			return rc;
+	}
+	/* load node page index on first access */
+	rc = si_nodeuse(q->index, node);
+	if (ssunlikely(rc == -1))
+		return -1;
+	if (!concurrent && !si_getbloom(q, node))
+		return 0;
 	sinodeview view;
 	si_nodeview_open(&view, node);
 	rc = si_cachevalidate(q->cache, node);
 	if (ssunlikely(rc == -1)) {
+		si_nodeview_close(&view);
 		sr_oom(q->r->e);
 		return -1;
 	}
+	if (concurrent)
+		si_nodeenter(node);
 	si_unlock(q->index);
 
+	if (concurrent) {
+		rc = si_getindex(q, node);
+		si_nodeleave(q->index, node);
+		if (rc != 0 || !si_getbloom(q, node))
+			goto done;
+	}
+
 	/* search on disk */
 	svmerge *m = &q->merge;
 	rc = sv_mergeprepare(m, q->r, 1);
 	assert(rc == 0);
 
-	rc = si_getfile(q, node, q->cache);
+	rc = si_getfile(q, node, q->cache, 0);
+	si_getbloom_result(q, node, rc);
+done:
+	si_lock(q->index);
+	si_nodeview_close(&view);
+	return rc;
+}
+
+static inline void
+si_getmulti_result(siread *q, sireadkey *k, int rc, int disk, int cache)
+{
+	k->rc          = rc;
+	k->read_disk  += q->read_disk - disk;
+	k->read_cache += q->read_cache - cache;
+	k->result      = q->result;
+	q->result      = NULL;
+}
 
+static inline int
+si_getmulti_index(siread *q, sinode *node, sireadkey *keys, int count)
+{
+	int disk = 0;
+	int j = 0;
+	while (j < count) {
+		sireadkey *k = &keys[j];
+		int read_disk  = q->read_disk;
+		int read_cache = q->read_cache;
+		q->key = k->key;
+		int rc = si_getindex(q, node);
+		si_getmulti_result(q, k, rc, read_disk, read_cache);
+		if (ssunlikely(rc == -1))
+			return -1;
+		if (rc == 0)
+			disk++;
+		j++;
+	}
+	return disk;
+}
+
+static inline int
+si_getmulti(siread *q, sinode *node, sireadkey *keys, int count)
+{
+	/* search in memory */
+	int concurrent = si_readconcurrent(q);
+	int rc;
+	int disk;
+	if (! concurrent) {
+		disk = si_getmulti_index(q, node, keys, count);
+		if (disk <= 0)
+			return disk;
+	}
+	rc = si_nodeuse(q->index, node);
+	if (ssunlikely(rc == -1))
+		return -1;
+
+	sinodeview view;
+	si_nodeview_open(&view, node);
+	rc = si_cachevalidate(q->cache, node);
+	if (ssunlikely(rc == -1)) {
+		si_nodeview_close(&view);
+		sr_oom(q->r->e);
+		return -1;
+	}
+	if (concurrent)
+		si_nodeenter(node);
+	si_unlock(q->index);
+
+	if (concurrent) {
+		disk = si_getmulti_index(q, node, keys, count);
+		si_nodeleave(q->index, node);
+		if (disk <= 0) {
+			rc = disk;
+			goto done;
+		}
+	}
+
+	/* search on disk, keys are sorted, so every
+	 * page is read only once */
+	svmerge *m = &q->merge;
+	rc = sv_mergeprepare(m, q->r, 1);
+	assert(rc == 0);
+	int reopen = 0;
+	int j = 0;
+	while (j < count) {
+		sireadkey *k = &keys[j];
+		j++;
+		if (k->rc != 0)
+			continue;
+		q->key = k->key;
+		if (! si_getbloom(q, node))
+			continue;
+		int read_disk  = q->read_disk;
+		int read_cache = q->read_cache;
+		rc = si_getfile(q, node, q->cache, reopen);
+		si_getbloom_result(q, node, rc);
+		si_getmulti_result(q, k, rc, read_disk, read_cache);
+		if (ssunlikely(rc == -1))
+			break;
+		reopen = 1;
+	}
+done:
 	si_lock(q->index);
 	si_nodeview_close(&view);
+	if (ssunlikely(rc == -1))
+		return -1;
+	return 0;
+}
+
+static inline int
+si_readprepare(siread *q)
+{
+	if (! q->index->scheme.direct_io)
+		return 0;
+	/* read cache can be shared between databases
+	 * with different direct_io settings */
+	sdio *io = &q->cache->io;
+	if (io->buf.s && io->size_page != q->index->scheme.direct_io_page_size) {
+		sd_iofree(io, q->r);
+		sd_ioinit(io);
+	}
+	int rc;
+	rc = sd_ioprepare(io, q->r,
+	                  q->index->scheme.direct_io,
+	                  q->index->scheme.direct_io_page_size,
+	                  q->index->scheme.direct_io_buffer_size);
+	if (ssunlikely(rc == -1))
+		return sr_oom(q->r->e);
+	return 0;
+}
+
+static void
+si_readmulti_sort(sr *r, sireadkey *keys, sireadkey *tmp, int count)
+{
+	if (count < 2)
+		return;
+	int half = count / 2;
+	si_readmulti_sort(r, keys, tmp, half);
+	si_readmulti_sort(r, keys + half, tmp, count - half);
+	int a = 0;
+	int b = half;
+	int pos = 0;
+	while (a < half && b < count) {
+		if (sf_compare(r->scheme, keys[b].key, keys[a].key) < 0)
+			tmp[pos++] = keys[b++];
+		else
+			tmp[pos++] = keys[a++];
+	}
+	while (a < half)
+		tmp[pos++] = keys[a++];
+	while (b < count)
+		tmp[pos++] = keys[b++];
+	memcpy(keys, tmp, sizeof(sireadkey) * count);
+}
+
+int si_readmulti(siread *q, sireadkey *keys, int count)
+{
+	assert(q->order == SS_EQ);
+	assert(q->upsert_eq == 0);
+	if (count == 0)
+		return 0;
+	int rc = si_readprepare(q);
+	if (ssunlikely(rc == -1))
+		return -1;
+
+	/* sort keys, so they could be routed to the
+	 * nodes and pages in order */
+	sireadkey *tmp = ss_malloc(q->r->a, sizeof(sireadkey) * count);
+	if (ssunlikely(tmp == NULL))
+		return sr_oom(q->r->e);
+	si_readmulti_sort(q->r, keys, tmp, count);
+	ss_free(q->r->a, tmp);
+
+	int pos = 0;
+	while (pos < count)
+	{
+		/* find node and all the keys which belong to it */
+		ssiter i;
+		ss_iterinit(si_iter, &i);
+		ss_iteropen(si_iter, &i, q->r, q->index, SS_GTE, keys[pos].key);
+		sinode *node = ss_iterof(si_iter, &i);
+		assert(node != NULL);
+		ss_iternext(si_iter, &i);
+		sinode *next = ss_iterof(si_iter, &i);
+		int end = pos + 1;
+		if (next == NULL) {
+			end = count;
+		} else {
+			char *min = si_nodemin(next);
+			while (end < count && sf_compare(q->r->scheme, keys[end].key, min) < 0)
+				end++;
+		}
+		rc = si_getmulti(q, node, keys + pos, end - pos);
+		if (ssunlikely(rc == -1))
+			break;
+		pos = end;
+	}
+	q->key = NULL;
 	return rc;
 }
 
@@ -245,10 +505,10 @@ si_rangefile(siread *q, sinode *n, svmerge *m)
 	sischeme *scheme = &q->index->scheme;
 	sdreadarg arg = {
 		.from_compaction     = 0,
-		.io                  = &q->index->rdc.io,
+		.io                  = &c->io,
 		.index               = &n->index,
 		.buf                 = &c->buf_a,
-		.buf_read            = &q->index->rdc.d,
+		.buf_read            = &c->buf_read,
 		.index_iter          = &c->index_iter,
 		.page_iter           = &c->page_iter,
 		.use_mmap            = scheme->mmap,
@@ -262,6 +522,8 @@ si_rangefile(siread *q, sinode *n, svmerge *m)
 		.o                   = q->order,
 		.mmap                = &n->map,
 		.file                = &n->file,
+		.page_cache          = c->pool->page_cache,
+		.page_cache_id       = n->id,
 		.r                   = q->r
 	};
 	ss_iterinit(sd_read, &c->i);
@@ -330,6 +592,9 @@ next_node:
 	}
 
 	/* read from file */
+	rc = si_nodeuse(q->index, node);
+	if (ssunlikely(rc == -1))
+		return -1;
 	rc = si_cachevalidate(q->cache, node);
 	if (ssunlikely(rc == -1)) {
 		sr_oom(q->r->e);
@@ -345,7 +610,7 @@ next_node:
 	ss_iteropen(sv_mergeiter, &j, q->r, m, q->order);
 	ssiter k;
 	ss_iterinit(sv_readiter, &k);
-	ss_iteropen(sv_readiter, &k, q->r, &j, &q->index->rdc.upsert, q->vlsn, 0);
+	ss_iteropen(sv_readiter, &k, q->r, &j, &q->cache->upsert, q->vlsn, 0);
 	char *v = ss_iterof(sv_readiter, &k);
 	if (ssunlikely(v == NULL)) {
 		sv_mergereset(&q->merge);
@@ -376,15 +641,9 @@ next_node:
 
 int si_read(siread *q)
 {
-	int rc;
-	if (q->index->scheme.direct_io) {
-		rc = sd_ioprepare(&q->index->rdc.io, q->r,
-		                  q->index->scheme.direct_io,
-		                  q->index->scheme.direct_io_page_size,
-		                  q->index->scheme.direct_io_buffer_size);
-		if (ssunlikely(rc == -1))
-			return sr_oom(q->r->e);
-	}
+	int rc = si_readprepare(q);
+	if (ssunlikely(rc == -1))
+		return -1;
 	switch (q->order) {
 	case SS_EQ:
 		return si_get(q);
@@ -410,6 +669,11 @@ int si_readcommited(si *index, sr *r, svv *v)
 	assert(node != NULL);
 
 	uint64_t lsn = sf_lsn(r->scheme, sv_vpointer(v));
+	if (lsn > node->index.h->lsnmax)
+		return 0;
+	/* on load error malfunction is set, apply the version */
+	if (ssunlikely(si_nodeuse(index, node) == -1))
+		return 0;
 
 	/* search index */
 	ss_iterinit(sd_indexiter, &i);
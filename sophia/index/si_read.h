@@ -9,8 +9,18 @@
  * BSD License
 */
 
+typedef struct sireadkey sireadkey;
 typedef struct siread siread;
 
+struct sireadkey {
+	char     *key;
+	uint32_t  pos;
+	int       rc;
+	int       read_disk;
+	int       read_cache;
+	svv      *result;
+};
+
 struct siread {
 	ssorder   order;
 	char     *key;
@@ -24,6 +34,8 @@ struct siread {
 	int       read_start;
 	int       read_disk;
 	int       read_cache;
+	int       bloom_skip;
+	int       bloom_false;
 	svv      *result;
 	sicache  *cache;
 	sr       *r;
@@ -36,6 +48,7 @@ int  si_readopen(siread*, si*, sicache*, ssorder,
                  char*, uint32_t, int, int);
 int  si_readclose(siread*);
 int  si_read(siread*);
+int  si_readmulti(siread*, sireadkey*, int);
 int  si_readcommited(si*, sr*, svv*);
 
 #endif
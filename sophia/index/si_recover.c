@@ -32,6 +32,19 @@
 
 	see: scheme recover
 	see: test/crash/durability.test.c
+
+	manifest
+
+	Each compaction appends BEGIN record before creating
+	new nodes, REMOVE/ADD group before sealing them and
+	COMPLETE record once they are completed. ADD records
+	keep node index header and key range, so recovery
+	builds the node set without reading the directory
+	and node files are opened on first access.
+
+	If any compaction is not completed or the manifest is
+	corrupted, nodes are recovered by scanning and
+	validating every file as described above.
 */
 
 #include <libss.h>
@@ -47,7 +60,7 @@ sinode *si_bootstrap(si *i, uint64_t parent)
 	sr *r = &i->r;
 	/* create node */
 	uint64_t id = sr_seq(r->seq, SR_NSNNEXT);
-	sinode *n = si_nodenew(r, id, parent);
+	sinode *n = si_nodenew(r, &i->scheme, id, parent);
 	if (ssunlikely(n == NULL))
 		return NULL;
 	int rc;
@@ -79,6 +92,8 @@ sinode *si_bootstrap(si *i, uint64_t parent)
 	}
 	rc = sd_buildbegin(&build, r,
 	                   i->scheme.compaction.node_page_checksum,
+	                   i->scheme.compaction.node_page_delta,
+	                   i->scheme.compaction.node_page_prefix,
 	                   i->scheme.compression,
 	                   i->scheme.compression_if);
 	if (ssunlikely(rc == -1))
@@ -95,7 +110,7 @@ sinode *si_bootstrap(si *i, uint64_t parent)
 	uint32_t align = 0;
 	if (i->scheme.direct_io)
 		align = i->scheme.direct_io_page_size;
-	rc = sd_buildindex_end(&build_index, r, align, sd_iosize(&io, &n->file));
+	rc = sd_buildindex_end(&build_index, r, 0, align, sd_iosize(&io, &n->file));
 	if (ssunlikely(rc == -1))
 		goto e1;
 
@@ -111,6 +126,9 @@ sinode *si_bootstrap(si *i, uint64_t parent)
 		if (ssunlikely(rc == -1))
 			goto e1;
 	}
+	rc = si_nodekeys(n, r, &index);
+	if (ssunlikely(rc == -1))
+		goto e1;
 	n->index = index;
 
 	sd_iofree(&io, r);
@@ -127,6 +145,21 @@ e0:
 	return NULL;
 }
 
+static inline int
+si_recovermanifest(si *index, sr *r, ssbuf *buf)
+{
+	ss_bufreset(buf);
+	ssrbnode *p = ss_rbmin(&index->i);
+	while (p) {
+		sinode *n = sscast(p, sinode, node);
+		int rc = ss_bufadd(buf, r->a, &n, sizeof(sinode*));
+		if (ssunlikely(rc == -1))
+			return sr_oom_malfunction(r->e);
+		p = ss_rbnext(&index->i, p);
+	}
+	return si_manifestwrite(&index->manifest, r, &index->scheme, buf);
+}
+
 static inline int
 si_deploy(si *i, sr *r, int create_directory)
 {
@@ -161,6 +194,12 @@ si_deploy(si *i, sr *r, int create_directory)
 	}
 	si_insert(i, n);
 	si_plannerupdate(&i->p, n);
+	ssbuf buf;
+	ss_bufinit(&buf);
+	rc = si_recovermanifest(i, r, &buf);
+	ss_buffree(&buf, r->a);
+	if (ssunlikely(rc == -1))
+		return -1;
 	return 1;
 }
 
@@ -242,7 +281,7 @@ si_trackdir(sitrack *track, sr *r, si *i)
 			 * incomplete compaction process */
 			head = si_trackget(track, id_parent);
 			if (sslikely(head == NULL)) {
-				head = si_nodenew(r, id_parent, UINT64_MAX);
+				head = si_nodenew(r, &i->scheme, id_parent, UINT64_MAX);
 				if (ssunlikely(head == NULL))
 					goto error;
 				head->recover = SI_RDB_UNDEF;
@@ -263,7 +302,7 @@ si_trackdir(sitrack *track, sr *r, si *i)
 			}
 			assert(rc == SI_RDB_DBSEAL);
 			/* recover 'sealed' node */
-			node = si_nodenew(r, id, id_parent);
+			node = si_nodenew(r, &i->scheme, id, id_parent);
 			if (ssunlikely(node == NULL))
 				goto error;
 			node->recover = SI_RDB_DBSEAL;
@@ -292,7 +331,7 @@ si_trackdir(sitrack *track, sr *r, si *i)
 
 
 		/* recover node */
-		node = si_nodenew(r, id, id_parent);
+		node = si_nodenew(r, &i->scheme, id, id_parent);
 		if (ssunlikely(node == NULL))
 			goto error;
 		node->recover = SI_RDB;
@@ -376,6 +415,144 @@ si_trackvalidate(sitrack *track, ssbuf *buf, sr *r, si *i)
 	return 0;
 }
 
+static int
+si_trackmanifest_cmp(const void *p1, const void *p2)
+{
+	sdmanifestnode *a = *(sdmanifestnode**)p1;
+	sdmanifestnode *b = *(sdmanifestnode**)p2;
+	if (a->id == b->id)
+		return (a->type > b->type) - (a->type < b->type);
+	return (a->id > b->id) ? 1 : -1;
+}
+
+static inline int
+si_trackmanifest_open(sitrack *track, sr *r, si *i, sdmanifestnode *v)
+{
+	if (ssunlikely(v->size_meta == 0 ||
+	               sd_manifestnode_blobsize(v) !=
+	               sd_manifestnode_header(v)->blob))
+		return 0;
+	sinode *node = si_nodenew(r, &i->scheme, v->id, v->id_parent);
+	if (ssunlikely(node == NULL))
+		return -1;
+	node->recover = SI_RDB;
+	sspath path;
+	ss_path(&path, i->scheme.path, v->id, ".db");
+	int rc = si_noderestore(node, r, &path, v);
+	if (ssunlikely(rc == -1)) {
+		si_nodefree(node, r, 0);
+		return -1;
+	}
+	si_trackset(track, node);
+	si_trackmetrics(track, node);
+	return 1;
+}
+
+static inline int
+si_trackmanifest(sitrack *track, ssbuf *buf, sr *r, si *i)
+{
+	sdmanifest *m = &i->manifest.m;
+	ssbuf live;
+	ss_bufinit(&live);
+	int rc = si_manifestrecover(&i->manifest, r, &i->scheme);
+	if (rc == 0)
+		return 0;
+	if (ssunlikely(rc == -1))
+		goto fallback;
+
+	/* order records by node id */
+	ss_bufreset(buf);
+	ssiter j;
+	ss_iterinit(sd_manifestiter, &j);
+	ss_iteropen(sd_manifestiter, &j, r, m);
+	while (ss_iteratorhas(&j)) {
+		sdmanifestnode *v = ss_iteratorof(&j);
+		rc = ss_bufadd(buf, r->a, &v, sizeof(sdmanifestnode*));
+		if (ssunlikely(rc == -1))
+			goto oom;
+		ss_iteratornext(&j);
+	}
+	if (ssunlikely(sd_manifestiter_iserror(&j)))
+		goto fallback;
+	int count = ss_bufused(buf) / sizeof(sdmanifestnode*);
+	qsort(buf->s, count, sizeof(sdmanifestnode*), si_trackmanifest_cmp);
+
+	/* match current node set */
+	sdmanifestnode **list = (sdmanifestnode**)buf->s;
+	int pos = 0;
+	while (pos < count) {
+		sdmanifestnode *add = NULL;
+		int remove = 0;
+		int begin = 0;
+		int complete = 0;
+		uint64_t id = list[pos]->id;
+		for (; pos < count && list[pos]->id == id; pos++) {
+			sdmanifestnode *v = list[pos];
+			si_tracknsn(track, v->id_parent);
+			switch (v->type) {
+			case SD_MANIFEST_ADD:
+				if (ssunlikely(add))
+					goto fallback;
+				add = v;
+				break;
+			case SD_MANIFEST_REMOVE:
+				remove++;
+				break;
+			case SD_MANIFEST_BEGIN:
+				begin++;
+				break;
+			case SD_MANIFEST_COMPLETE:
+				complete++;
+				break;
+			default:
+				goto fallback;
+			}
+		}
+		si_tracknsn(track, id);
+		/* compaction of the node has not been completed,
+		 * directory might contain its leftovers */
+		if (begin != complete)
+			goto fallback;
+		if (add == NULL || remove > 0)
+			continue;
+		rc = ss_bufadd(&live, r->a, &add, sizeof(sdmanifestnode*));
+		if (ssunlikely(rc == -1))
+			goto oom;
+	}
+
+	/* recover nodes */
+	ssiter k;
+	ss_iterinit(ss_bufiterref, &k);
+	ss_iteropen(ss_bufiterref, &k, &live, sizeof(sdmanifestnode*));
+	while (ss_iterhas(ss_bufiterref, &k)) {
+		sdmanifestnode *v = ss_iterof(ss_bufiterref, &k);
+		rc = si_trackmanifest_open(track, r, i, v);
+		if (ssunlikely(rc == -1))
+			goto error;
+		if (rc == 0)
+			goto fallback;
+		ss_iternext(ss_bufiterref, &k);
+	}
+	ss_buffree(&live, r->a);
+	sd_manifestreset(m);
+	return 1;
+fallback:
+	sr_log(r->log, "manifest file '%s/manifest' does not match "
+	       "repository, scanning directory", i->scheme.path);
+	sr_errorreset(r->e);
+	ss_buffree(&live, r->a);
+	sd_manifestreset(m);
+	si_trackfree(track, r);
+	si_trackinit(track);
+	return 0;
+oom:
+	sr_oom_malfunction(r->e);
+error:
+	ss_buffree(&live, r->a);
+	sd_manifestreset(m);
+	return -1;
+}
+
 static inline int
 si_recovercomplete(sitrack *track, sr *r, si *index, ssbuf *buf)
 {
@@ -405,6 +582,9 @@ si_recovercomplete(sitrack *track, sr *r, si *index, ssbuf *buf)
 		n->recover = SI_RDB;
 		si_insert(index, n);
 		si_plannerupdate(&index->p, n);
+		int rc = si_blobref(&index->blob, r, &index->scheme, n);
+		if (ssunlikely(rc == -1))
+			return -1;
 		ss_iternext(ss_bufiterref, &i);
 	}
 	return 0;
@@ -418,24 +598,36 @@ si_recoverindex(si *i, sr *r)
 	ssbuf buf;
 	ss_bufinit(&buf);
 	int rc;
-	rc = si_trackdir(&track, r, i);
-	if (ssunlikely(rc == -1))
-		goto error;
-	if (ssunlikely(track.count == 0))
-		return 1;
-	rc = si_trackvalidate(&track, &buf, r, i);
+	rc = si_trackmanifest(&track, &buf, r, i);
 	if (ssunlikely(rc == -1))
 		goto error;
+	if (rc == 0) {
+		rc = si_trackdir(&track, r, i);
+		if (ssunlikely(rc == -1))
+			goto error;
+		if (ssunlikely(track.count == 0)) {
+			ss_buffree(&buf, r->a);
+			return 1;
+		}
+		rc = si_trackvalidate(&track, &buf, r, i);
+		if (ssunlikely(rc == -1))
+			goto error;
+	}
 	rc = si_recovercomplete(&track, r, i, &buf);
 	if (ssunlikely(rc == -1))
 		goto error;
+	rc = si_recovermanifest(i, r, &buf);
+	if (ssunlikely(rc == -1)) {
+		ss_buffree(&buf, r->a);
+		return -1;
+	}
 	/* set actual metrics */
 	if (track.nsn > r->seq->nsn)
 		r->seq->nsn = track.nsn;
 	if (track.lsn > r->seq->lsn)
 		r->seq->lsn = track.lsn;
 	ss_buffree(&buf, r->a);
-	return 0;
+	return si_blobrecover(&i->blob, r, &i->scheme);
 error:
 	ss_buffree(&buf, r->a);
 	si_trackfree(&track, r);
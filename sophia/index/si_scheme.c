@@ -38,6 +38,13 @@ si_schemecompaction_init(sicompaction *c)
 	c->node_size          = 64 * 1024 * 1024;
 	c->node_page_size     = 128 * 1024;
 	c->node_page_checksum = 1;
+	c->node_page_delta    = 0;
+	c->node_page_prefix   = 0;
+	c->bloom_bits         = 10;
+	c->subcompactions     = 1;
+	c->pipeline          = 0;
+	c->blob_threshold     = 0;
+	c->blob_gc_wm         = 50;
 }
 
 void si_schemeinit(sischeme *s)
@@ -66,6 +73,10 @@ void si_schemefree(sischeme *s, sr *r)
 		ss_free(r->a, s->compression_sz);
 		s->compression_sz = NULL;
 	}
+	if (s->memtable_sz) {
+		ss_free(r->a, s->memtable_sz);
+		s->memtable_sz = NULL;
+	}
 	sf_schemefree(&s->scheme, r->a);
 }
 
@@ -17,11 +17,18 @@ struct sicompaction {
 	uint64_t node_size;
 	uint32_t node_page_size;
 	uint32_t node_page_checksum;
+	uint32_t node_page_delta;
+	uint32_t node_page_prefix;
+	uint32_t bloom_bits;
 	uint32_t expire_period;
 	uint64_t expire_period_us;
 	uint32_t gc_period;
 	uint64_t gc_period_us;
 	uint32_t gc_wm;
+	uint32_t subcompactions;
+	uint32_t pipeline;
+	uint32_t blob_threshold;
+	uint32_t blob_gc_wm;
 };
 
 struct sischeme {
@@ -39,6 +46,12 @@ struct sischeme {
 	uint32_t      compression;
 	char         *compression_sz;
 	ssfilterif   *compression_if;
+	uint32_t      memtable;
+	char         *memtable_sz;
+	uint32_t      memtable_arena;
+	uint32_t      index_lazy;
+	uint64_t      index_cache;
+	uint32_t      key_normalize;
 	uint32_t      buf_gc_wm;
 	sfupsert      upsert;
 	sfscheme      scheme;
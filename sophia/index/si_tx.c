@@ -19,18 +19,42 @@
 void si_begin(sitx *x, si *index)
 {
 	x->index = index;
+	x->concurrent = index->scheme.memtable == SV_INDEXSKIPLIST;
 	ss_listinit(&x->nodelist);
 	si_lock(index);
+	if (! x->concurrent)
+		return;
+	/* skiplist memory index is updated without the
+	 * index lock, compaction waits for the writers
+	 * before it changes the nodes (see si_nodewait()) */
+	while (index->writers_wait > 0)
+		ss_condwait(&index->cond, &index->lock);
+	index->writers++;
+	si_unlock(index);
 }
 
-void si_commit(sitx *x)
+int si_commit(sitx *x)
 {
-	/* reschedule nodes */
+	/* reschedule nodes, return number of nodes
+	 * ready for compaction */
+	if (x->concurrent)
+		si_lock(x->index);
+	uint64_t wm = si_plannerwm(&x->index->p);
+	int ready = 0;
 	sslist *i, *n;
 	ss_listforeach_safe(&x->nodelist, i, n) {
 		sinode *node = sscast(i, sinode, commit);
 		ss_listinit(&node->commit);
 		si_plannerupdate(&x->index->p, node);
+		if (node->used >= wm)
+			ready++;
+	}
+	if (x->concurrent) {
+		assert(x->index->writers > 0);
+		x->index->writers--;
+		if (x->index->writers == 0)
+			ss_condbroadcast(&x->index->cond);
 	}
 	si_unlock(x->index);
+	return ready;
 }
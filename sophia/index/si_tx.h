@@ -13,12 +13,13 @@ typedef struct sitx sitx;
 
 struct sitx {
 	int ro;
+	int concurrent;
 	sslist nodelist;
 	si *index;
 };
 
 void si_begin(sitx*, si*);
-void si_commit(sitx*);
+int  si_commit(sitx*);
 
 static inline void
 si_txtrack(sitx *x, sinode *n) {
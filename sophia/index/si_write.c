@@ -19,7 +19,8 @@
 static inline int si_set(sitx *x, svv *v)
 {
 	si *index = x->index;
-	/* match node */
+	/* match node, node tree is not changed while
+	 * concurrent writers are active (see si_begin()) */
 	ssiter i;
 	ss_iterinit(si_iter, &i);
 	ss_iteropen(si_iter, &i, &index->r, index, SS_GTE,
@@ -27,7 +27,9 @@ struct soif {
 	int      (*upsert)(so*, so*);
 	int      (*del)(so*, so*);
 	void    *(*get)(so*, so*);
+	int      (*getmulti)(so*, so**, int);
 	void    *(*begin)(so*);
+	void    *(*batch)(so*);
 	int      (*prepare)(so*);
 	int      (*commit)(so*);
 	void    *(*cursor)(so*);
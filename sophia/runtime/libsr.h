@@ -15,6 +15,7 @@
 #include <sr_status.h>
 #include <sr_stat.h>
 #include <sr_seq.h>
+#include <sr_quota.h>
 #include <sr.h>
 #include <sr_conf.h>
 
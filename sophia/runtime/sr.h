@@ -23,6 +23,8 @@ struct sr {
 	ssvfs *vfs;
 	ssinjection *i;
 	srstat *stat;
+	ssrate *rate;
+	srquota *quota;
 	sscrcf crc;
 	void *ptr;
 };
@@ -40,6 +42,8 @@ sr_init(sr *r,
         sfscheme *scheme,
         ssinjection *i,
         srstat *stat,
+        ssrate *rate,
+        srquota *quota,
         sscrcf crc,
         void *ptr)
 {
@@ -54,8 +58,16 @@ sr_init(sr *r,
 	r->upsert = upsert;
 	r->i      = i;
 	r->stat   = stat;
+	r->rate   = rate;
+	r->quota  = quota;
 	r->crc    = crc;
 	r->ptr    = ptr;
 }
 
+static inline void
+sr_throttle(sr *r, uint64_t size) {
+	if (r->rate)
+		ss_ratewait(r->rate, size);
+}
+
 #endif
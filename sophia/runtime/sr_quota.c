@@ -0,0 +1,44 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+
+int sr_quotawait(srquota *q, srerror *e)
+{
+	if (sslikely(! sr_quotahard(q)))
+		return 0;
+	uint64_t start = ss_utime();
+	uint64_t deadline = start + q->stall_max * 1000ULL;
+	uint64_t now = start;
+	ss_mutexlock(&q->lock);
+	q->stall++;
+	q->waiters++;
+	/* wait for compaction to free memory, recheck
+	 * usage at least every millisecond */
+	while (sr_quotahard(q) && now < deadline) {
+		uint64_t us = deadline - now;
+		if (us > 1000)
+			us = 1000;
+		ss_condtimedwait(&q->cond, &q->lock, us);
+		now = ss_utime();
+	}
+	q->waiters--;
+	q->stall_time += now - start;
+	int rc = 0;
+	if (sr_quotahard(q)) {
+		q->stall_error++;
+		rc = -1;
+	}
+	ss_mutexunlock(&q->lock);
+	if (ssunlikely(rc == -1))
+		sr_error(e, "%s", "memory limit reached, retry later");
+	return rc;
+}
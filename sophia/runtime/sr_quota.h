@@ -0,0 +1,109 @@
+#ifndef SR_QUOTA_H_
+#define SR_QUOTA_H_
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+/*
+	environment-wide memory budget for in-memory
+	documents.
+
+	soft watermark (limit_wm percent of the limit) makes
+	scheduler compact the largest nodes first, writers stall
+	above the hard limit for up to stall_max milliseconds
+	and then fail with a retryable error.
+*/
+
+typedef struct srquota srquota;
+
+struct srquota {
+	ssmutex  lock;
+	sscond   cond;
+	uint64_t limit;
+	uint32_t limit_wm;
+	uint32_t stall_max;
+	uint64_t used;
+	uint32_t waiters;
+	uint64_t stall;
+	uint64_t stall_time;
+	uint64_t stall_error;
+};
+
+static inline void
+sr_quotainit(srquota *q)
+{
+	ss_mutexinit(&q->lock);
+	ss_condinit(&q->cond);
+	q->limit       = 0;
+	q->limit_wm    = 80;
+	q->stall_max   = 1000;
+	q->used        = 0;
+	q->waiters     = 0;
+	q->stall       = 0;
+	q->stall_time  = 0;
+	q->stall_error = 0;
+}
+
+static inline void
+sr_quotafree(srquota *q)
+{
+	ss_condfree(&q->cond);
+	ss_mutexfree(&q->lock);
+}
+
+static inline void
+sr_quotaadd(srquota *q, uint32_t size)
+{
+	if (q)
+		ss_atomic_add(&q->used, size);
+}
+
+static inline void
+sr_quotasub(srquota *q, uint32_t size)
+{
+	if (q)
+		ss_atomic_sub(&q->used, size);
+}
+
+static inline uint64_t
+sr_quotaused(srquota *q)
+{
+	return ss_atomic_read(&q->used);
+}
+
+static inline int
+sr_quotasoft(srquota *q)
+{
+	uint64_t limit = q->limit;
+	if (sslikely(limit == 0))
+		return 0;
+	return sr_quotaused(q) >= (limit * q->limit_wm / 100);
+}
+
+static inline int
+sr_quotahard(srquota *q)
+{
+	uint64_t limit = q->limit;
+	if (sslikely(limit == 0))
+		return 0;
+	return sr_quotaused(q) >= limit;
+}
+
+static inline void
+sr_quotasignal(srquota *q)
+{
+	if (sslikely(q->waiters == 0))
+		return;
+	ss_mutexlock(&q->lock);
+	ss_condbroadcast(&q->cond);
+	ss_mutexunlock(&q->lock);
+}
+
+int sr_quotawait(srquota*, srerror*);
+
+#endif
@@ -19,11 +19,14 @@ struct srstatxm {
 	uint64_t tx_conflict;
 	uint64_t tx_lock;
 	ssavg    tx_latency;
+	sshist   tx_latency_hist;
 	ssavg    tx_stmts;
 };
 
+/* statistics are updated using relaxed atomics and
+ * aggregated on copy */
+
 struct srstat {
-	ssspinlock lock;
 	/* memory */
 	uint64_t v_count;
 	uint64_t v_allocated;
@@ -32,6 +35,7 @@ struct srstat {
 	/* set */
 	uint64_t set;
 	ssavg    set_latency;
+	sshist   set_latency_hist;
 	/* delete */
 	uint64_t del;
 	ssavg    del_latency;
@@ -43,12 +47,14 @@ struct srstat {
 	ssavg    get_read_disk;
 	ssavg    get_read_cache;
 	ssavg    get_latency;
+	sshist   get_latency_hist;
 	/* pread */
 	uint64_t pread;
 	ssavg    pread_latency;
 	/* cursor */
 	uint64_t cursor;
 	ssavg    cursor_latency;
+	sshist   cursor_latency_hist;
 	ssavg    cursor_read_disk;
 	ssavg    cursor_read_cache;
 	ssavg    cursor_ops;
@@ -72,29 +78,44 @@ sr_statxm(srstatxm *s, uint64_t start, uint32_t count,
           int rlb, int conflict)
 {
 	uint64_t diff = ss_utime() - start;
-	s->tx++;
-	s->tx_rlb += rlb;
-	s->tx_conflict += conflict;
+	ss_atomic_add(&s->tx, 1);
+	if (rlb)
+		ss_atomic_add(&s->tx_rlb, rlb);
+	if (conflict)
+		ss_atomic_add(&s->tx_conflict, conflict);
 	ss_avgupdate(&s->tx_stmts, count);
 	ss_avgupdate(&s->tx_latency, diff);
+	ss_histadd(&s->tx_latency_hist, diff);
 }
 
 static inline void
 sr_statxm_lock(srstatxm *s)
 {
-	s->tx_lock++;
+	ss_atomic_add(&s->tx_lock, 1);
 }
 
 static inline void
-sr_statinit(srstat *s)
+sr_statxm_copy(srstatxm *s, srstatxm *dest)
 {
-	memset(s, 0, sizeof(*s));
-	ss_spinlockinit(&s->lock);
+	dest->tx          = ss_atomic_read(&s->tx);
+	dest->tx_rlb      = ss_atomic_read(&s->tx_rlb);
+	dest->tx_conflict = ss_atomic_read(&s->tx_conflict);
+	dest->tx_lock     = ss_atomic_read(&s->tx_lock);
+	ss_avgcopy(&dest->tx_latency, &s->tx_latency);
+	ss_avgcopy(&dest->tx_stmts, &s->tx_stmts);
+	ss_histcopy(&dest->tx_latency_hist, &s->tx_latency_hist);
 }
 
 static inline void
-sr_statfree(srstat *s) {
-	ss_spinlockfree(&s->lock);
+sr_statxm_reset(srstatxm *s)
+{
+	ss_histreset(&s->tx_latency_hist);
+}
+
+static inline void
+sr_statinit(srstat *s)
+{
+	memset(s, 0, sizeof(*s));
 }
 
 static inline void
@@ -114,53 +135,59 @@ sr_statprepare(srstat *s)
 	ss_avgprepare(&s->cursor_ops);
 }
 
+static inline void
+sr_statv(srstat *s, uint32_t size)
+{
+	ss_atomic_add(&s->v_count, 1);
+	ss_atomic_add(&s->v_allocated, size);
+}
+
+static inline void
+sr_statvfree(srstat *s, uint32_t size)
+{
+	ss_atomic_sub(&s->v_count, 1);
+	ss_atomic_sub(&s->v_allocated, size);
+}
+
 static inline void
 sr_statfield(srstat *s, int size)
 {
-	ss_spinlock(&s->lock);
 	ss_avgupdate(&s->field, size);
-	ss_spinunlock(&s->lock);
 }
 
 static inline void
 sr_statset(srstat *s, uint64_t start)
 {
 	uint64_t diff = ss_utime() - start;
-	ss_spinlock(&s->lock);
-	s->set++;
+	ss_atomic_add(&s->set, 1);
 	ss_avgupdate(&s->set_latency, diff);
-	ss_spinunlock(&s->lock);
+	ss_histadd(&s->set_latency_hist, diff);
 }
 
 static inline void
 sr_statdelete(srstat *s, uint64_t start)
 {
 	uint64_t diff = ss_utime() - start;
-	ss_spinlock(&s->lock);
-	s->del++;
+	ss_atomic_add(&s->del, 1);
 	ss_avgupdate(&s->del_latency, diff);
-	ss_spinunlock(&s->lock);
 }
 
 static inline void
 sr_statupsert(srstat *s, uint64_t start)
 {
 	uint64_t diff = ss_utime() - start;
-	ss_spinlock(&s->lock);
-	s->upsert++;
+	ss_atomic_add(&s->upsert, 1);
 	ss_avgupdate(&s->upsert_latency, diff);
-	ss_spinunlock(&s->lock);
 }
 
 static inline void
 sr_statget(srstat *s, uint64_t diff, int read_disk, int read_cache)
 {
-	ss_spinlock(&s->lock);
-	s->get++;
+	ss_atomic_add(&s->get, 1);
 	ss_avgupdate(&s->get_read_disk, read_disk);
 	ss_avgupdate(&s->get_read_cache, read_cache);
 	ss_avgupdate(&s->get_latency, diff);
-	ss_spinunlock(&s->lock);
+	ss_histadd(&s->get_latency_hist, diff);
 }
 
 static inline void
@@ -169,31 +196,57 @@ sr_statpread(srstat *s, uint64_t start, int from_compaction)
 	if (from_compaction)
 		return;
 	uint64_t diff = ss_utime() - start;
-	ss_spinlock(&s->lock);
-	s->pread++;
+	ss_atomic_add(&s->pread, 1);
 	ss_avgupdate(&s->pread_latency, diff);
-	ss_spinunlock(&s->lock);
 }
 
 static inline void
 sr_statcursor(srstat *s, uint64_t start, int read_disk, int read_cache, int ops)
 {
 	uint64_t diff = ss_utime() - start;
-	ss_spinlock(&s->lock);
-	s->cursor++;
+	ss_atomic_add(&s->cursor, 1);
 	ss_avgupdate(&s->cursor_read_disk, read_disk);
 	ss_avgupdate(&s->cursor_read_cache, read_cache);
 	ss_avgupdate(&s->cursor_latency, diff);
 	ss_avgupdate(&s->cursor_ops, ops);
-	ss_spinunlock(&s->lock);
+	ss_histadd(&s->cursor_latency_hist, diff);
 }
 
 static inline void
 sr_statcopy(srstat *s, srstat *dest)
 {
-	ss_spinlock(&s->lock);
-	*dest = *s;
-	ss_spinunlock(&s->lock);
+	dest->v_count     = ss_atomic_read(&s->v_count);
+	dest->v_allocated = ss_atomic_read(&s->v_allocated);
+	dest->set         = ss_atomic_read(&s->set);
+	dest->del         = ss_atomic_read(&s->del);
+	dest->upsert      = ss_atomic_read(&s->upsert);
+	dest->get         = ss_atomic_read(&s->get);
+	dest->pread       = ss_atomic_read(&s->pread);
+	dest->cursor      = ss_atomic_read(&s->cursor);
+	ss_avgcopy(&dest->field, &s->field);
+	ss_avgcopy(&dest->set_latency, &s->set_latency);
+	ss_avgcopy(&dest->del_latency, &s->del_latency);
+	ss_avgcopy(&dest->upsert_latency, &s->upsert_latency);
+	ss_avgcopy(&dest->get_read_disk, &s->get_read_disk);
+	ss_avgcopy(&dest->get_read_cache, &s->get_read_cache);
+	ss_avgcopy(&dest->get_latency, &s->get_latency);
+	ss_avgcopy(&dest->pread_latency, &s->pread_latency);
+	ss_avgcopy(&dest->cursor_latency, &s->cursor_latency);
+	ss_avgcopy(&dest->cursor_read_disk, &s->cursor_read_disk);
+	ss_avgcopy(&dest->cursor_read_cache, &s->cursor_read_cache);
+	ss_avgcopy(&dest->cursor_ops, &s->cursor_ops);
+	ss_histcopy(&dest->set_latency_hist, &s->set_latency_hist);
+	ss_histcopy(&dest->get_latency_hist, &s->get_latency_hist);
+	ss_histcopy(&dest->cursor_latency_hist, &s->cursor_latency_hist);
+}
+
+static inline void
+sr_statreset(srstat *s)
+{
+	/* start a new latency percentiles window */
+	ss_histreset(&s->set_latency_hist);
+	ss_histreset(&s->get_latency_hist);
+	ss_histreset(&s->cursor_latency_hist);
 }
 
 #endif
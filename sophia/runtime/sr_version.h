@@ -15,7 +15,10 @@
 #define SR_VERSION_B         '2'
 
 #define SR_VERSION_STORAGE_A '2'
-#define SR_VERSION_STORAGE_B '2'
+#define SR_VERSION_STORAGE_B '3'
+
+/* oldest storage version which can be opened */
+#define SR_VERSION_STORAGE_B_MIN '2'
 
 #if defined(SOPHIA_BUILD)
 # define SR_VERSION_COMMIT SOPHIA_BUILD
@@ -67,7 +70,8 @@ sr_versionstorage_check(srversion *v)
 		return 0;
 	if (v->a != SR_VERSION_STORAGE_A)
 		return 0;
-	if (v->b != SR_VERSION_STORAGE_B)
+	if (v->b < SR_VERSION_STORAGE_B_MIN ||
+	    v->b > SR_VERSION_STORAGE_B)
 		return 0;
 	return 1;
 }
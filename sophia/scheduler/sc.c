@@ -18,9 +18,12 @@
 #include <libsy.h>
 #include <libsc.h>
 
-int sc_init(sc *s, sr *r, swmanager *wm)
+int sc_init(sc *s, sr *r, srquota *quota, swmanager *wm)
 {
 	ss_mutexinit(&s->lock);
+	ss_condinit(&s->cond);
+	s->idle                     = 0;
+	s->shutdown                 = 0;
 	/* task priorities */
 	s->prio[SC_QGC]             = 1;
 	s->prio[SC_QEXPIRE]         = 1;
@@ -36,9 +39,9 @@ int sc_init(sc *s, sr *r, swmanager *wm)
 	s->rotate                   = 0;
 	s->i                        = NULL;
 	s->count                    = 0;
-	s->rr                       = 0;
 	s->r                        = r;
 	s->wm                       = wm;
+	s->quota                    = quota;
 	ss_threadpool_init(&s->tp);
 	sc_workerpool_init(&s->wp);
 	return 0;
@@ -53,6 +56,7 @@ sc_prepare(scdb *db)
 	db->gc          = 0;
 	db->gc_time     = now;
 	db->backup      = 0;
+	db->ready       = 1;
 	return 0;
 }
 
@@ -84,10 +88,40 @@ int sc_run(sc *s, ssthreadf function, void *arg, int n)
 	return ss_threadpool_new(&s->tp, s->r->a, n, function, arg);
 }
 
+void sc_wait(sc *s)
+{
+	ss_mutexlock(&s->lock);
+	if (s->shutdown) {
+		ss_mutexunlock(&s->lock);
+		return;
+	}
+	int i = 0;
+	while (i < s->count) {
+		if (s->i[i].ready) {
+			ss_mutexunlock(&s->lock);
+			return;
+		}
+		i++;
+	}
+	/* sleep until a database is marked ready, periodically
+	 * recheck all databases for time-based work and for
+	 * nodes which were busy */
+	s->idle++;
+	int rc = ss_condtimedwait(&s->cond, &s->lock, SC_IDLE_TIMEOUT);
+	s->idle--;
+	if (rc == ETIMEDOUT)
+		sc_readyall(s);
+	ss_mutexunlock(&s->lock);
+}
+
 int sc_shutdown(sc *s)
 {
 	sr *r = s->r;
 	int rcret = 0;
+	ss_mutexlock(&s->lock);
+	s->shutdown = 1;
+	ss_condbroadcast(&s->cond);
+	ss_mutexunlock(&s->lock);
 	int rc = ss_threadpool_shutdown(&s->tp, r->a);
 	if (ssunlikely(rc == -1))
 		rcret = -1;
@@ -98,6 +132,7 @@ int sc_shutdown(sc *s)
 		ss_free(r->a, s->i);
 		s->i = NULL;
 	}
+	ss_condfree(&s->cond);
 	ss_mutexfree(&s->lock);
 	return rcret;
 }
@@ -24,6 +24,7 @@ struct scdb {
 	uint32_t  workers[SC_QMAX];
 	si       *index;
 	/* state */
+	uint32_t  ready;
 	uint32_t  expire;
 	uint64_t  expire_time;
 	uint64_t  gc_time;
@@ -42,8 +43,13 @@ struct sctask {
 	siplan    plan;
 };
 
+#define SC_IDLE_TIMEOUT 100000 /* 100ms */
+
 struct sc {
 	ssmutex       lock;
+	sscond        cond;
+	uint32_t      idle;
+	uint32_t      shutdown;
 	uint32_t      prio[SC_QMAX];
 	/* backup state */
 	uint32_t      backup_bsn;
@@ -54,21 +60,22 @@ struct sc {
 	char         *backup_path;
 	/* index */
 	int           rotate;
-	int           rr;
 	int           count;
 	scdb         *i;
 	/* pools */
 	ssthreadpool  tp;
 	scworkerpool  wp;
 	swmanager    *wm;
+	srquota      *quota;
 	sr           *r;
 };
 
-int sc_init(sc*, sr*, swmanager*);
+int sc_init(sc*, sr*, srquota*, swmanager*);
 int sc_set(sc*, uint32_t);
 int sc_setbackup(sc*, char*);
 int sc_run(sc*, ssthreadf, void*, int);
 int sc_shutdown(sc*);
+void sc_wait(sc*);
 
 static inline void
 sc_register(sc *s, si *index)
@@ -86,4 +93,51 @@ sc_of(sc *s, si *index)
 	return &s->i[pos];
 }
 
+static inline void
+sc_ready(sc *s, scdb *db)
+{
+	/* mark database as having work and wake up
+	 * an idle worker, called under lock */
+	db->ready = 1;
+	if (s->idle > 0)
+		ss_condsignal(&s->cond);
+}
+
+static inline void
+sc_readyall(sc *s)
+{
+	int i = 0;
+	while (i < s->count) {
+		s->i[i].ready = 1;
+		i++;
+	}
+	if (s->idle > 0)
+		ss_condbroadcast(&s->cond);
+}
+
+static inline void
+sc_wakeup(sc *s, si *index)
+{
+	scdb *db = sc_of(s, index);
+	if (db->ready)
+		return;
+	ss_mutexlock(&s->lock);
+	sc_ready(s, db);
+	ss_mutexunlock(&s->lock);
+}
+
+static inline int
+sc_quota(sc *s)
+{
+	srquota *q = s->quota;
+	if (sslikely(! sr_quotasoft(q)))
+		return 0;
+	/* memory pressure, let every database compact
+	 * its largest in-memory nodes */
+	ss_mutexlock(&s->lock);
+	sc_readyall(s);
+	ss_mutexunlock(&s->lock);
+	return sr_quotawait(q, s->r->e);
+}
+
 #endif
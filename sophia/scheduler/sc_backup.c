@@ -87,6 +87,7 @@ int sc_backupbegin(sc *s)
 		sc_task_backup(&s->i[i]);
 		i++;
 	}
+	sc_readyall(s);
 	ss_mutexunlock(&s->lock);
 	return 0;
 }
@@ -18,7 +18,7 @@
 #include <libsy.h>
 #include <libsc.h>
 
-int sc_commit(sc *s, svlog *log, uint64_t lsn, int recover)
+int sc_commitlog(sc *s, svlog *log, uint64_t lsn, int recover)
 {
 	/* write-ahead log */
 	swtx tl;
@@ -29,7 +29,11 @@ int sc_commit(sc *s, svlog *log, uint64_t lsn, int recover)
 		return -1;
 	}
 	sw_commit(&tl);
+	return 0;
+}
 
+int sc_commitindex(sc *s, svlog *log, int recover)
+{
 	/* index */
 	svlogindex *i   = (svlogindex*)log->index.s;
 	svlogindex *end = (svlogindex*)log->index.p;
@@ -40,7 +44,9 @@ int sc_commit(sc *s, svlog *log, uint64_t lsn, int recover)
 		sitx x;
 		si_begin(&x, index);
 		si_write(&x, log, i, recover);
-		si_commit(&x);
+		int rc = si_commit(&x);
+		if (rc > 0)
+			sc_wakeup(s, index);
 	}
 	return 0;
 }
@@ -9,6 +9,7 @@
  * BSD License
 */
 
-int sc_commit(sc*, svlog*, uint64_t, int);
+int sc_commitlog(sc*, svlog*, uint64_t, int);
+int sc_commitindex(sc*, svlog*, int);
 
 #endif
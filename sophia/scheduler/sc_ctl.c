@@ -23,6 +23,10 @@ int sc_ctl_call(sc *s, uint64_t vlsn)
 	int rc = sr_statusactive(s->r->status);
 	if (ssunlikely(rc == 0))
 		return 0;
+	/* explicit run rechecks every database */
+	ss_mutexlock(&s->lock);
+	sc_readyall(s);
+	ss_mutexunlock(&s->lock);
 	scworker *w = sc_workerpool_pop(&s->wp, s->r);
 	if (ssunlikely(w == NULL))
 		return -1;
@@ -42,6 +46,7 @@ int sc_ctl_compaction(sc *s, uint64_t vlsn, si *index)
 		return -1;
 	siplan plan = {
 		.plan = SI_COMPACTION,
+		.a    = sr_quotasoft(s->quota),
 		.node = NULL
 	};
 	rc = si_plan(index, &plan);
@@ -56,6 +61,7 @@ int sc_ctl_expire(sc *s, si *index)
 	ss_mutexlock(&s->lock);
 	scdb *db = sc_of(s, index);
 	sc_task_expire(db);
+	sc_ready(s, db);
 	ss_mutexunlock(&s->lock);
 	return 0;
 }
@@ -65,6 +71,7 @@ int sc_ctl_gc(sc *s, si *index)
 	ss_mutexlock(&s->lock);
 	scdb *db = sc_of(s, index);
 	sc_task_gc(db);
+	sc_ready(s, db);
 	ss_mutexunlock(&s->lock);
 	return 0;
 }
@@ -52,7 +52,7 @@ sc_execute(sctask *t, scworker *w, uint64_t vlsn)
 static inline int
 sc_plan(sc *s, sctask *task, int id)
 {
-	scdb *db = sc_current(s);
+	scdb *db = task->db;
 	uint32_t prio = s->prio[id];
 	if (db->workers[id] >= prio)
 		return SI_PRETRY;
@@ -90,13 +90,20 @@ sc_taskend(sc *s, sctask *t)
 		t->gc = 1;
 		break;
 	case SI_GC:
+	case SI_BLOBGC:
 		db->workers[SC_QGC]--;
 		t->gc = 1;
 		break;
 	}
 	if (t->rotate == 1)
 		s->rotate = 0;
+	/* finished task might unblock nodes, which were
+	 * busy during planning */
+	if (t->plan.plan)
+		sc_ready(s, db);
 	ss_mutexunlock(&s->lock);
+	/* wake up writers stalled by the memory limit */
+	sr_quotasignal(s->quota);
 	return 0;
 }
 
@@ -196,6 +203,14 @@ sc_do(sc *s, sctask *task)
 		task->plan.a = task->vlsn;
 		task->plan.b = c->gc_wm;
 		rc = sc_plan(s, task, SC_QGC);
+		if (rc == SI_PNONE) {
+			/* rewrite value logs after duplicates are
+			 * collected */
+			si_planinit(&task->plan);
+			task->plan.plan = SI_BLOBGC;
+			task->plan.a = c->blob_gc_wm;
+			rc = sc_plan(s, task, SC_QGC);
+		}
 		switch (rc) {
 		case SI_PMATCH:
 			db->workers[SC_QGC]++;
@@ -208,8 +223,10 @@ sc_do(sc *s, sctask *task)
 		}
 	}
 
-	/* compaction */
+	/* compaction, ignore node watermark under
+	 * memory pressure */
 	task->plan.plan = SI_COMPACTION;
+	task->plan.a = sr_quotasoft(s->quota);
 	rc = si_plan(db->index, &task->plan);
 	if (rc == SI_PMATCH)
 		return SI_PMATCH;
@@ -227,30 +244,65 @@ sc_periodic(sc *s, sctask *task)
 		s->rotate = 1;
 	}
 
-	scdb *db = task->db;
-	sicompaction *c = &db->index->scheme.compaction;
-
-	/* expire */
-	if (c->expire_period && db->expire == 0) {
-		if ((task->time - db->expire_time) >= c->expire_period_us)
-			sc_task_expire(db);
+	int i = 0;
+	while (i < s->count) {
+		scdb *db = &s->i[i];
+		sicompaction *c = &db->index->scheme.compaction;
+		/* expire */
+		if (c->expire_period && db->expire == 0) {
+			if ((task->time - db->expire_time) >= c->expire_period_us)
+				sc_task_expire(db);
+		}
+		/* gc */
+		if (c->gc_period && db->gc == 0) {
+			if ((task->time - db->gc_time) >= c->gc_period_us)
+				sc_task_gc(db);
+		}
+		i++;
 	}
-	/* gc */
-	if (c->gc_period && db->gc == 0) {
-		if ((task->time - db->gc_time) >= c->gc_period_us)
-			sc_task_gc(db);
+}
+
+static inline scdb*
+sc_peek(sc *s, scworker *w)
+{
+	/* start from the worker own database and steal
+	 * work from the others */
+	int pos = w->id % s->count;
+	int i = 0;
+	while (i < s->count) {
+		scdb *db = &s->i[pos];
+		if (db->ready)
+			return db;
+		pos++;
+		if (pos == s->count)
+			pos = 0;
+		i++;
 	}
+	return NULL;
 }
 
 static int
 sc_schedule(sc *s, sctask *task)
 {
-	int rc;
+	int rc = SI_PNONE;
 	ss_mutexlock(&s->lock);
-	task->db = sc_current(s);
+	if (ssunlikely(s->count == 0)) {
+		ss_mutexunlock(&s->lock);
+		return rc;
+	}
 	sc_periodic(s, task);
-	rc = sc_do(s, task);
-	sc_next(s);
+	scdb *db;
+	while ((db = sc_peek(s, task->w))) {
+		/* reset state before planning, so concurrent
+		 * commit could mark database again */
+		db->ready = 0;
+		task->db = db;
+		rc = sc_do(s, task);
+		if (rc == SI_PMATCH) {
+			sc_ready(s, db);
+			break;
+		}
+	}
 	ss_mutexunlock(&s->lock);
 	return rc;
 }
@@ -11,22 +11,11 @@
 
 int sc_step(sc*, scworker*, uint64_t);
 
-static inline scdb*
-sc_current(sc *s) {
-	return &s->i[s->rr];
-}
-
-static inline void
-sc_next(sc *s) {
-	s->rr++;
-	if (s->rr >= s->count)
-		s->rr = 0;
-}
-
 static inline void
 sc_task_expire(scdb *db)
 {
 	db->expire = 1;
+	db->ready  = 1;
 }
 
 static inline void
@@ -39,7 +28,8 @@ sc_task_expire_done(scdb *db, uint64_t now)
 static inline void
 sc_task_gc(scdb *db)
 {
-	db->gc = 1;
+	db->gc    = 1;
+	db->ready = 1;
 }
 
 static inline void
@@ -53,6 +43,7 @@ static inline void
 sc_task_backup(scdb *db)
 {
 	db->backup = 1;
+	db->ready  = 1;
 }
 
 static inline void
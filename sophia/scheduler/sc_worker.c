@@ -26,6 +26,7 @@ sc_workernew(sr *r, int id)
 		sr_oom_malfunction(r->e);
 		return NULL;
 	}
+	w->id = id;
 	snprintf(w->name, sizeof(w->name), "%d", id);
 	sd_cinit(&w->dc);
 	ss_listinit(&w->link);
@@ -13,6 +13,7 @@ typedef struct scworkerpool scworkerpool;
 typedef struct scworker scworker;
 
 struct scworker {
+	uint32_t id;
 	char name[16];
 	sstrace trace;
 	sdc dc;
@@ -57,10 +57,7 @@ SP_API void *sp_document(void *ptr)
 		sp_unsupported(o, __func__);
 		return NULL;
 	}
-	so *e = o->env;
-	se_apilock(e);
 	void *h = o->i->document(o);
-	se_apiunlock(e);
 	return h;
 }
 
@@ -85,15 +82,7 @@ SP_API int sp_destroy(void *ptr)
 		sp_unsupported(o, __func__);
 		return -1;
 	}
-	so *e = o->env;
-	int rc;
-	if (ssunlikely(e == o)) {
-		rc = o->i->destroy(o);
-		return rc;
-	}
-	se_apilock(e);
-	rc = o->i->destroy(o);
-	se_apiunlock(e);
+	int rc = o->i->destroy(o);
 	return rc;
 }
 
@@ -104,10 +93,7 @@ SP_API int sp_setstring(void *ptr, const char *path, const void *pointer, int si
 		sp_unsupported(o, __func__);
 		return -1;
 	}
-	so *e = o->env;
-	se_apilock(e);
 	int rc = o->i->setstring(o, path, (void*)pointer, size);
-	se_apiunlock(e);
 	return rc;
 }
 
@@ -118,10 +104,7 @@ SP_API int sp_setint(void *ptr, const char *path, int64_t v)
 		sp_unsupported(o, __func__);
 		return -1;
 	}
-	so *e = o->env;
-	se_apilock(e);
 	int rc = o->i->setint(o, path, v);
-	se_apiunlock(e);
 	return rc;
 }
 
@@ -132,10 +115,7 @@ SP_API void *sp_getobject(void *ptr, const char *path)
 		sp_unsupported(o, __func__);
 		return NULL;
 	}
-	so *e = o->env;
-	se_apilock(e);
 	void *h = o->i->getobject(o, path);
-	se_apiunlock(e);
 	return h;
 }
 
@@ -146,10 +126,7 @@ SP_API void *sp_getstring(void *ptr, const char *path, int *size)
 		sp_unsupported(o, __func__);
 		return NULL;
 	}
-	so *e = o->env;
-	se_apilock(e);
 	void *h = o->i->getstring(o, path, size);
-	se_apiunlock(e);
 	return h;
 }
 
@@ -160,10 +137,7 @@ SP_API int64_t sp_getint(void *ptr, const char *path)
 		sp_unsupported(o, __func__);
 		return -1;
 	}
-	so *e = o->env;
-	se_apilock(e);
 	int64_t rc = o->i->getint(o, path);
-	se_apiunlock(e);
 	return rc;
 }
 
@@ -175,10 +149,7 @@ SP_API int sp_set(void *ptr, void *ptr_arg)
 		sp_unsupported(o, __func__);
 		return -1;
 	}
-	so *e = o->env;
-	se_apilock(e);
 	int rc = o->i->set(o, v);
-	se_apiunlock(e);
 	return rc;
 }
 
@@ -190,10 +161,7 @@ SP_API int sp_upsert(void *ptr, void *ptr_arg)
 		sp_unsupported(o, __func__);
 		return -1;
 	}
-	so *e = o->env;
-	se_apilock(e);
 	int rc = o->i->upsert(o, v);
-	se_apiunlock(e);
 	return rc;
 }
 
@@ -205,10 +173,7 @@ SP_API int sp_delete(void *ptr, void *ptr_arg)
 		sp_unsupported(o, __func__);
 		return -1;
 	}
-	so *e = o->env;
-	se_apilock(e);
 	int rc = o->i->del(o, v);
-	se_apiunlock(e);
 	return rc;
 }
 
@@ -222,13 +187,25 @@ SP_API void *sp_get(void *ptr, void *ptr_arg)
 		sp_unsupported(o, __func__);
 		return NULL;
 	}
-	so *e = o->env;
-	se_apilock(e);
 	void *h = o->i->get(o, v);
-	se_apiunlock(e);
 	return h;
 }
 
+SP_API int sp_getmulti(void *ptr, void **documents, int count)
+{
+	so *o = sp_cast(ptr, __func__);
+	int i = 0;
+	while (i < count) {
+		sp_cast(documents[i], __func__);
+		i++;
+	}
+	if (ssunlikely(o->i->getmulti == NULL)) {
+		sp_unsupported(o, __func__);
+		return -1;
+	}
+	return o->i->getmulti(o, (so**)documents, count);
+}
+
 SP_API void *sp_cursor(void *ptr)
 {
 	so *o = sp_cast(ptr, __func__);
@@ -236,10 +213,7 @@ SP_API void *sp_cursor(void *ptr)
 		sp_unsupported(o, __func__);
 		return NULL;
 	}
-	so *e = o->env;
-	se_apilock(e);
 	void *h = o->i->cursor(o);
-	se_apiunlock(e);
 	return h;
 }
 
@@ -250,10 +224,18 @@ SP_API void *sp_begin(void *ptr)
 		sp_unsupported(o, __func__);
 		return NULL;
 	}
-	so *e = o->env;
-	se_apilock(e);
 	void *h = o->i->begin(o);
-	se_apiunlock(e);
+	return h;
+}
+
+SP_API void *sp_batch(void *ptr)
+{
+	so *o = sp_cast(ptr, __func__);
+	if (ssunlikely(o->i->batch == NULL)) {
+		sp_unsupported(o, __func__);
+		return NULL;
+	}
+	void *h = o->i->batch(o);
 	return h;
 }
 
@@ -264,10 +246,7 @@ SP_API int sp_prepare(void *ptr)
 		sp_unsupported(o, __func__);
 		return -1;
 	}
-	so *e = o->env;
-	se_apilock(e);
 	int rc = o->i->prepare(o);
-	se_apiunlock(e);
 	return rc;
 }
 
@@ -278,9 +257,6 @@ SP_API int sp_commit(void *ptr)
 		sp_unsupported(o, __func__);
 		return -1;
 	}
-	so *e = o->env;
-	se_apilock(e);
 	int rc = o->i->commit(o);
-	se_apiunlock(e);
 	return rc;
 }
@@ -35,8 +35,10 @@ SP_API int      sp_set(void*, void*);
 SP_API int      sp_upsert(void*, void*);
 SP_API int      sp_delete(void*, void*);
 SP_API void    *sp_get(void*, void*);
+SP_API int      sp_getmulti(void*, void**, int);
 SP_API void    *sp_cursor(void*);
 SP_API void    *sp_begin(void*);
+SP_API void    *sp_batch(void*);
 SP_API int      sp_prepare(void*);
 SP_API int      sp_commit(void*);
 
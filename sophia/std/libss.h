@@ -13,6 +13,7 @@
 #include <ss_macro.h>
 #include <ss_time.h>
 #include <ss_spinlock.h>
+#include <ss_atomic.h>
 #include <ss_list.h>
 #include <ss_path.h>
 #include <ss_iov.h>
@@ -24,6 +25,7 @@
 #include <ss_a.h>
 #include <ss_ooma.h>
 #include <ss_stda.h>
+#include <ss_arenaa.h>
 #include <ss_trace.h>
 #include <ss_gc.h>
 #include <ss_order.h>
@@ -34,8 +36,10 @@
 #include <ss_mutex.h>
 #include <ss_cond.h>
 #include <ss_thread.h>
+#include <ss_rate.h>
 #include <ss_rb.h>
 #include <ss_hash.h>
+#include <ss_bloom.h>
 #include <ss_ht.h>
 #include <ss_rq.h>
 #include <ss_filter.h>
@@ -46,5 +50,6 @@
 #include <ss_iter.h>
 #include <ss_bufiter.h>
 #include <ss_avg.h>
+#include <ss_hist.h>
 
 #endif
@@ -0,0 +1,176 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <libss.h>
+
+typedef struct ssarenachunk ssarenachunk;
+typedef struct ssarena ssarena;
+
+struct ssarenachunk {
+	ssarena *arena;
+	uint32_t size;
+	uint32_t used;
+	uint32_t refs;
+};
+
+struct ssarena {
+	ssspinlock lock;
+	ssa *a;
+	ssarenachunk *chunk;
+	uint32_t chunk_size;
+	uint32_t chunk_max;
+	uint64_t size;
+	uint64_t *used;
+};
+
+#define SS_ARENAA_CHUNK_MIN 4096
+
+/* every allocation is prefixed by a pointer to its chunk */
+#define SS_ARENAA_HEADER sizeof(ssarenachunk*)
+
+static inline int
+ss_arenaaopen(ssa *a, va_list args)
+{
+	ssarena *arena = (ssarena*)a->priv;
+	arena->a          = va_arg(args, ssa*);
+	arena->chunk_max  = va_arg(args, int);
+	arena->used       = va_arg(args, uint64_t*);
+	arena->chunk_size = SS_ARENAA_CHUNK_MIN;
+	if (arena->chunk_size > arena->chunk_max)
+		arena->chunk_size = arena->chunk_max;
+	arena->chunk      = NULL;
+	arena->size       = 0;
+	ss_spinlockinit(&arena->lock);
+	return 0;
+}
+
+static inline ssarenachunk*
+ss_arenaachunk(ssarena *arena, uint32_t size)
+{
+	ssarenachunk *c = ss_malloc(arena->a, sizeof(ssarenachunk) + size);
+	if (ssunlikely(c == NULL))
+		return NULL;
+	c->arena = arena;
+	c->size  = size;
+	c->used  = 0;
+	c->refs  = 1;
+	ss_atomic_add(&arena->size, sizeof(ssarenachunk) + size);
+	if (arena->used)
+		ss_atomic_add(arena->used, sizeof(ssarenachunk) + size);
+	return c;
+}
+
+static inline void
+ss_arenaaunref(ssarenachunk *c)
+{
+	if (__atomic_sub_fetch(&c->refs, 1, __ATOMIC_ACQ_REL) > 0)
+		return;
+	ssarena *arena = c->arena;
+	ss_atomic_sub(&arena->size, sizeof(ssarenachunk) + c->size);
+	if (arena->used)
+		ss_atomic_sub(arena->used, sizeof(ssarenachunk) + c->size);
+	ss_free(arena->a, c);
+}
+
+static inline int
+ss_arenaaclose(ssa *a)
+{
+	/* drop reference to the current chunk, chunks are
+	 * released when their last allocation is freed */
+	ssarena *arena = (ssarena*)a->priv;
+	if (arena->chunk)
+		ss_arenaaunref(arena->chunk);
+	arena->chunk = NULL;
+	ss_spinlockfree(&arena->lock);
+	return 0;
+}
+
+static inline void*
+ss_arenaaptr(ssarenachunk *c, uint32_t offset)
+{
+	char *ptr = (char*)c + sizeof(ssarenachunk) + offset;
+	*(ssarenachunk**)ptr = c;
+	return ptr + SS_ARENAA_HEADER;
+}
+
+sshot static inline void*
+ss_arenaamalloc(ssa *a, int size)
+{
+	ssarena *arena = (ssarena*)a->priv;
+	uint32_t aligned = SS_ARENAA_HEADER + ((size + 7) & ~7);
+	/* large allocations are placed into a separate chunk */
+	if (ssunlikely(aligned > arena->chunk_max / 4)) {
+		ssarenachunk *n = ss_arenaachunk(arena, aligned);
+		if (ssunlikely(n == NULL))
+			return NULL;
+		n->used = aligned;
+		return ss_arenaaptr(n, 0);
+	}
+	ss_spinlock(&arena->lock);
+	ssarenachunk *c = arena->chunk;
+	if (sslikely(c && (c->used + aligned) <= c->size)) {
+		uint32_t offset = c->used;
+		c->used += aligned;
+		ss_atomic_add(&c->refs, 1);
+		ss_spinunlock(&arena->lock);
+		return ss_arenaaptr(c, offset);
+	}
+	/* chunk size grows up to the limit, which keeps
+	 * overhead low for a small arena */
+	uint32_t chunk_size = arena->chunk_size;
+	if (chunk_size < aligned)
+		chunk_size = aligned;
+	ssarenachunk *n = ss_arenaachunk(arena, chunk_size);
+	if (ssunlikely(n == NULL)) {
+		ss_spinunlock(&arena->lock);
+		return NULL;
+	}
+	if (arena->chunk_size < arena->chunk_max) {
+		arena->chunk_size *= 2;
+		if (arena->chunk_size > arena->chunk_max)
+			arena->chunk_size = arena->chunk_max;
+	}
+	/* the arena keeps a reference to its current chunk */
+	n->used = aligned;
+	n->refs = 2;
+	arena->chunk = n;
+	ss_spinunlock(&arena->lock);
+	if (c)
+		ss_arenaaunref(c);
+	return ss_arenaaptr(n, 0);
+}
+
+static inline void*
+ss_arenaarealloc(ssa *a ssunused, void *ptr ssunused, int size ssunused)
+{
+	/* not supported */
+	return NULL;
+}
+
+sshot static inline void
+ss_arenaafree(ssa *a ssunused, void *ptr)
+{
+	char *p = (char*)ptr - SS_ARENAA_HEADER;
+	ss_arenaaunref(*(ssarenachunk**)p);
+}
+
+uint64_t ss_arenaa_size(ssa *a)
+{
+	ssarena *arena = (ssarena*)a->priv;
+	return ss_atomic_read(&arena->size);
+}
+
+ssaif ss_arenaa =
+{
+	.open    = ss_arenaaopen,
+	.close   = ss_arenaaclose,
+	.malloc  = ss_arenaamalloc,
+	.realloc = ss_arenaarealloc,
+	.free    = ss_arenaafree
+};
@@ -0,0 +1,26 @@
+#ifndef SS_ARENAA_H_
+#define SS_ARENAA_H_
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+/* thread-safe bump allocator, a chunk is released
+ * when all of its allocations are freed.
+ *
+ * ss_aopen(&a, &ss_arenaa, ssa *parent, int chunk_max,
+ *          uint64_t *used)
+ *
+ * optional used counter is updated by size of every
+ * allocated and released chunk.
+*/
+
+extern ssaif ss_arenaa;
+
+uint64_t ss_arenaa_size(ssa*);
+
+#endif
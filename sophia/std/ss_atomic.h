@@ -0,0 +1,30 @@
+#ifndef SS_ATOMIC_H_
+#define SS_ATOMIC_H_
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#define ss_atomic_load(ptr) \
+	__atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+
+#define ss_atomic_store(ptr, value) \
+	__atomic_store_n(ptr, value, __ATOMIC_RELEASE)
+
+#define ss_atomic_cas(ptr, expected, value) \
+	__sync_bool_compare_and_swap(ptr, expected, value)
+
+#define ss_atomic_add(ptr, value) \
+	__atomic_add_fetch(ptr, value, __ATOMIC_RELAXED)
+
+#define ss_atomic_sub(ptr, value) \
+	__atomic_sub_fetch(ptr, value, __ATOMIC_RELAXED)
+
+#define ss_atomic_read(ptr) \
+	__atomic_load_n(ptr, __ATOMIC_RELAXED)
+
+#endif
@@ -32,18 +32,41 @@ ss_avginit(ssavg *a)
 static inline void
 ss_avgupdate(ssavg *a, uint32_t v)
 {
-	a->count++;
-	a->total += v;
-	a->avg = (double)a->total / (double)a->count;
-	if (v < a->min)
-		a->min = v;
-	if (v > a->max)
-		a->max = v;
+	/* lock-free, average is calculated on prepare */
+	ss_atomic_add(&a->count, 1);
+	ss_atomic_add(&a->total, v);
+	uint32_t min = ss_atomic_read(&a->min);
+	while (v < min) {
+		if (__atomic_compare_exchange_n(&a->min, &min, v, 1,
+		                                __ATOMIC_RELAXED,
+		                                __ATOMIC_RELAXED))
+			break;
+	}
+	uint32_t max = ss_atomic_read(&a->max);
+	while (v > max) {
+		if (__atomic_compare_exchange_n(&a->max, &max, v, 1,
+		                                __ATOMIC_RELAXED,
+		                                __ATOMIC_RELAXED))
+			break;
+	}
+}
+
+static inline void
+ss_avgcopy(ssavg *dest, ssavg *a)
+{
+	dest->count = ss_atomic_read(&a->count);
+	dest->total = ss_atomic_read(&a->total);
+	dest->min   = ss_atomic_read(&a->min);
+	dest->max   = ss_atomic_read(&a->max);
+	dest->avg   = 0;
 }
 
 static inline void
 ss_avgprepare(ssavg *a)
 {
+	a->avg = 0;
+	if (a->count > 0)
+		a->avg = (double)a->total / (double)a->count;
 	snprintf(a->sz, sizeof(a->sz), "%"PRIu32" %"PRIu32" %.1f",
 	         a->min, a->max, a->avg);
 }
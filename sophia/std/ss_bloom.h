@@ -0,0 +1,66 @@
+#ifndef SS_BLOOM_H_
+#define SS_BLOOM_H_
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+/* bloom filter over a plain bit array, k probes are
+ * generated from a single hash using double hashing */
+
+static inline uint32_t
+ss_bloom_size(uint32_t keys, uint32_t bits_per_key)
+{
+	uint64_t bits = (uint64_t)keys * bits_per_key;
+	if (bits < 64)
+		bits = 64;
+	return (bits + 7) / 8;
+}
+
+static inline uint8_t
+ss_bloom_hashes(uint32_t bits_per_key)
+{
+	/* k = bits_per_key * ln(2) */
+	uint32_t k = (bits_per_key * 69) / 100;
+	if (k < 1)
+		k = 1;
+	if (k > 30)
+		k = 30;
+	return k;
+}
+
+static inline void
+ss_bloom_add(char *bloom, uint32_t size, uint8_t k, uint32_t hash)
+{
+	uint32_t bits  = size * 8;
+	uint32_t delta = (hash >> 17) | (hash << 15);
+	uint8_t i = 0;
+	while (i < k) {
+		uint32_t pos = hash % bits;
+		bloom[pos / 8] |= (1 << (pos % 8));
+		hash += delta;
+		i++;
+	}
+}
+
+static inline int
+ss_bloom_has(char *bloom, uint32_t size, uint8_t k, uint32_t hash)
+{
+	uint32_t bits  = size * 8;
+	uint32_t delta = (hash >> 17) | (hash << 15);
+	uint8_t i = 0;
+	while (i < k) {
+		uint32_t pos = hash % bits;
+		if ((bloom[pos / 8] & (1 << (pos % 8))) == 0)
+			return 0;
+		hash += delta;
+		i++;
+	}
+	return 1;
+}
+
+#endif
@@ -30,9 +30,26 @@ ss_condsignal(sscond *c) {
 	pthread_cond_signal(&c->c);
 }
 
+static inline void
+ss_condbroadcast(sscond *c) {
+	pthread_cond_broadcast(&c->c);
+}
+
 static inline void
 ss_condwait(sscond *c, ssmutex *m) {
 	pthread_cond_wait(&c->c, &m->m);
 }
 
+static inline int
+ss_condtimedwait(sscond *c, ssmutex *m, uint64_t us)
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	uint64_t at = now.tv_sec * 1000000ULL + now.tv_usec + us;
+	struct timespec ts;
+	ts.tv_sec  = at / 1000000;
+	ts.tv_nsec = (at % 1000000) * 1000;
+	return pthread_cond_timedwait(&c->c, &m->m, &ts);
+}
+
 #endif
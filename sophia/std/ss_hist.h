@@ -0,0 +1,108 @@
+#ifndef SS_HIST_H_
+#define SS_HIST_H_
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+/* log-linear histogram: values below 16 have exact
+ * buckets, every next power of two range is split into
+ * 16 linear sub-buckets (relative error < 6.25%) */
+
+#define SS_HIST_SUBBITS 4
+#define SS_HIST_SUB     (1 << SS_HIST_SUBBITS)
+#define SS_HIST_BUCKETS (SS_HIST_SUB * (32 - SS_HIST_SUBBITS + 1))
+
+typedef struct sshist sshist;
+
+struct sshist {
+	uint64_t count;
+	uint32_t p50, p99, p999;
+	uint64_t bucket[SS_HIST_BUCKETS];
+};
+
+static inline void
+ss_histinit(sshist *h)
+{
+	memset(h, 0, sizeof(*h));
+}
+
+static inline int
+ss_histindex(uint32_t v)
+{
+	if (v < SS_HIST_SUB)
+		return v;
+	int shift = (31 - __builtin_clz(v)) - SS_HIST_SUBBITS;
+	return (shift + 1) * SS_HIST_SUB + ((v >> shift) & (SS_HIST_SUB - 1));
+}
+
+static inline uint32_t
+ss_histvalue(int index)
+{
+	/* highest value of the bucket */
+	if (index < SS_HIST_SUB)
+		return index;
+	int shift = index / SS_HIST_SUB - 1;
+	uint64_t sub = SS_HIST_SUB + (index % SS_HIST_SUB) + 1;
+	return (uint32_t)((sub << shift) - 1);
+}
+
+static inline void
+ss_histadd(sshist *h, uint64_t v)
+{
+	if (ssunlikely(v > UINT32_MAX))
+		v = UINT32_MAX;
+	ss_atomic_add(&h->bucket[ss_histindex(v)], 1);
+}
+
+static inline void
+ss_histreset(sshist *h)
+{
+	int i = 0;
+	while (i < SS_HIST_BUCKETS) {
+		__atomic_store_n(&h->bucket[i], 0, __ATOMIC_RELAXED);
+		i++;
+	}
+}
+
+static inline uint32_t
+ss_histpercentile(uint64_t *bucket, uint64_t count, int permille)
+{
+	if (count == 0)
+		return 0;
+	uint64_t rank = (count * permille + 999) / 1000;
+	uint64_t sum = 0;
+	int i = 0;
+	while (i < SS_HIST_BUCKETS) {
+		sum += bucket[i];
+		if (sum >= rank)
+			return ss_histvalue(i);
+		i++;
+	}
+	return ss_histvalue(SS_HIST_BUCKETS - 1);
+}
+
+static inline void
+ss_histcopy(sshist *dest, sshist *h)
+{
+	/* calculate percentiles of the live histogram,
+	 * buckets are not copied */
+	uint64_t bucket[SS_HIST_BUCKETS];
+	uint64_t count = 0;
+	int i = 0;
+	while (i < SS_HIST_BUCKETS) {
+		bucket[i] = ss_atomic_read(&h->bucket[i]);
+		count += bucket[i];
+		i++;
+	}
+	dest->count = count;
+	dest->p50   = ss_histpercentile(bucket, count, 500);
+	dest->p99   = ss_histpercentile(bucket, count, 990);
+	dest->p999  = ss_histpercentile(bucket, count, 999);
+}
+
+#endif
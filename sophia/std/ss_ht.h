@@ -121,4 +121,20 @@ ss_htset(ssht *t, int pos, sshtnode *node)
 	t->i[pos] = node;
 }
 
+static inline void
+ss_htremove(ssht *t, int pos)
+{
+	assert(t->i[pos] != NULL);
+	t->i[pos] = NULL;
+	t->count--;
+	/* reinsert the rest of the collision chain */
+	pos = (pos + 1) % t->size;
+	while (t->i[pos] != NULL) {
+		sshtnode *node = t->i[pos];
+		t->i[pos] = NULL;
+		t->i[ss_htplace(t, node)] = node;
+		pos = (pos + 1) % t->size;
+	}
+}
+
 #endif
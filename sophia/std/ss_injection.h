@@ -18,6 +18,7 @@ typedef struct ssinjection ssinjection;
 #define SS_INJECTION_SI_COMPACTION_3 4
 #define SS_INJECTION_SI_COMPACTION_4 5
 #define SS_INJECTION_SI_RECOVER_0    6
+#define SS_INJECTION_SI_COMPACTION_5 7
 
 struct ssinjection {
 	uint32_t e[11];
@@ -0,0 +1,54 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <libss.h>
+
+static inline void
+ss_raterefill(ssrate *r, uint64_t now)
+{
+	uint64_t burst = ss_rateburst(r);
+	uint64_t diff = now - r->last;
+	r->last = now;
+	/* long idle period always fills the bucket */
+	if (diff >= 1000000ULL * 60) {
+		r->tokens = burst;
+		return;
+	}
+	r->tokens += diff * r->limit / 1000000;
+	if (r->tokens > (int64_t)burst)
+		r->tokens = burst;
+}
+
+void ss_ratewait(ssrate *r, uint64_t size)
+{
+	ss_mutexlock(&r->lock);
+	r->total += size;
+	if (r->limit == 0) {
+		ss_mutexunlock(&r->lock);
+		return;
+	}
+	uint64_t now = ss_utime();
+	ss_raterefill(r, now);
+	r->tokens -= size;
+	if (r->tokens >= 0) {
+		ss_mutexunlock(&r->lock);
+		return;
+	}
+	/* sleep until own part of the debt is repaid */
+	uint64_t deadline = now + (uint64_t)(-r->tokens) * 1000000 / r->limit;
+	uint32_t version = r->version;
+	r->wait_count++;
+	uint64_t current = now;
+	while (current < deadline && version == r->version) {
+		ss_condtimedwait(&r->cond, &r->lock, deadline - current);
+		current = ss_utime();
+	}
+	r->wait += current - now;
+	ss_mutexunlock(&r->lock);
+}
@@ -0,0 +1,80 @@
+#ifndef SS_RATE_H_
+#define SS_RATE_H_
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+/*
+	token bucket rate limiter.
+
+	bucket is refilled with limit bytes per second up to
+	burst bytes. writers take tokens in advance and sleep
+	while the bucket is in debt, so concurrent writers
+	are served in order of arrival.
+*/
+
+typedef struct ssrate ssrate;
+
+struct ssrate {
+	ssmutex  lock;
+	sscond   cond;
+	uint64_t limit;
+	uint64_t burst;
+	int64_t  tokens;
+	uint64_t last;
+	uint32_t version;
+	uint64_t total;
+	uint64_t wait;
+	uint64_t wait_count;
+};
+
+static inline void
+ss_rateinit(ssrate *r)
+{
+	ss_mutexinit(&r->lock);
+	ss_condinit(&r->cond);
+	r->limit      = 0;
+	r->burst      = 0;
+	r->tokens     = 0;
+	r->last       = 0;
+	r->version    = 0;
+	r->total      = 0;
+	r->wait       = 0;
+	r->wait_count = 0;
+}
+
+static inline void
+ss_ratefree(ssrate *r)
+{
+	ss_condfree(&r->cond);
+	ss_mutexfree(&r->lock);
+}
+
+static inline uint64_t
+ss_rateburst(ssrate *r) {
+	/* one second of writes by default */
+	return (r->burst > 0) ? r->burst : r->limit;
+}
+
+static inline void
+ss_rateset(ssrate *r, uint64_t limit, uint64_t burst)
+{
+	ss_mutexlock(&r->lock);
+	r->limit   = limit;
+	r->burst   = burst;
+	r->tokens  = ss_rateburst(r);
+	r->last    = ss_utime();
+	r->version++;
+	/* release writers waiting for the previous limit */
+	ss_condbroadcast(&r->cond);
+	ss_mutexunlock(&r->lock);
+}
+
+void ss_ratewait(ssrate*, uint64_t);
+
+#endif
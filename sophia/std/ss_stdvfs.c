@@ -104,16 +104,18 @@ ss_stdvfs_sync_file_range(ssvfs *f ssunused, int fd, uint64_t off, uint64_t size
 static int
 ss_stdvfs_advise(ssvfs *f ssunused, int fd, int hint, uint64_t off, uint64_t len)
 {
-	(void)hint;
 #if  defined(__APPLE__) || \
      defined(__FreeBSD__) || \
     (defined(__FreeBSD_kernel__) && defined(__GLIBC__)) || \
      defined(__DragonFly__)
 	(void)fd;
+	(void)hint;
 	(void)off;
 	(void)len;
 	return 0;
 #else
+	if (hint == SS_VFS_WILLNEED)
+		return posix_fadvise(fd, off, len, POSIX_FADV_WILLNEED);
 	return posix_fadvise(fd, off, len, POSIX_FADV_DONTNEED);
 #endif
 }
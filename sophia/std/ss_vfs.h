@@ -12,6 +12,9 @@
 typedef struct ssvfsif ssvfsif;
 typedef struct ssvfs ssvfs;
 
+#define SS_VFS_DONTNEED 0
+#define SS_VFS_WILLNEED 1
+
 struct ssvfsif {
 	int     (*init)(ssvfs*, va_list);
 	void    (*free)(ssvfs*);
@@ -3984,6 +3984,7 @@ ss_zstdfilter_next(ssfilter *f, ssbuf *dest, char *buf, int size)
 		sz = ZSTD_decompress(dest->p, ss_bufunused(dest), buf, size);
 		if (ssunlikely(ZSTD_isError(sz)))
 			return -1;
+		ss_bufadvance(dest, sz);
 		break;
 	}
 	return 0;
@@ -27,7 +27,13 @@ int sx_managerinit(sxmanager *m, srseq *seq, ssa *a)
 	m->count_gc = 0;
 	m->csn = 0;
 	m->gc  = NULL;
+	m->commit_seq = 0;
+	m->commit_lsn = 0;
+	memset(m->commit_stage, 0, sizeof(m->commit_stage));
 	ss_spinlockinit(&m->lock);
+	ss_mutexinit(&m->txlock);
+	ss_mutexinit(&m->commitlock);
+	ss_condinit(&m->commitcond);
 	ss_listinit(&m->indexes);
 	sx_vpool_init(&m->pool, a);
 	m->seq = seq;
@@ -39,6 +45,9 @@ int sx_managerfree(sxmanager *m)
 	assert(sx_count(m) == 0);
 	sx_vpool_free(&m->pool);
 	ss_spinlockfree(&m->lock);
+	ss_mutexfree(&m->txlock);
+	ss_mutexfree(&m->commitlock);
+	ss_condfree(&m->commitcond);
 	return 0;
 }
 
@@ -81,19 +90,80 @@ int sx_indexfree(sxindex *i, sxmanager *m)
 
 uint64_t sx_vlsn(sxmanager *m)
 {
+	uint64_t vlsn = sx_lsn(m);
 	ss_spinlock(&m->lock);
-	uint64_t vlsn;
 	if (sx_count(m) > 0) {
 		ssrbnode *node = ss_rbmin(&m->i);
 		sx *min = sscast(node, sx, node);
 		vlsn = min->vlsn;
-	} else {
-		vlsn = sr_seq(m->seq, SR_LSN);
 	}
 	ss_spinunlock(&m->lock);
 	return vlsn;
 }
 
+uint64_t sx_lsn(sxmanager *m)
+{
+	/* lsn of the last statement applied in the
+	 * commit order, later ones might not be
+	 * in the index yet */
+	ss_mutexlock(&m->commitlock);
+	uint64_t lsn;
+	if (m->commit_stage[SX_COMMITINDEX] == m->commit_seq)
+		lsn = sr_seq(m->seq, SR_LSN);
+	else
+		lsn = m->commit_lsn;
+	ss_mutexunlock(&m->commitlock);
+	return lsn;
+}
+
+void sx_commitbegin(sxmanager *m, sxcommit *c, uint64_t lsn)
+{
+	/* must be called with txlock held, the commit
+	 * order and lsn order are the same */
+	ss_mutexlock(&m->commitlock);
+	if (m->commit_stage[SX_COMMITINDEX] == m->commit_seq)
+		m->commit_lsn = sr_seq(m->seq, SR_LSN);
+	c->seq = ++m->commit_seq;
+	sr_seqlock(m->seq);
+	if (sslikely(lsn == 0)) {
+		lsn = sr_seqdo(m->seq, SR_LSNNEXT);
+	} else {
+		if (lsn > m->seq->lsn)
+			m->seq->lsn = lsn;
+	}
+	sr_sequnlock(m->seq);
+	c->lsn = lsn;
+	ss_mutexunlock(&m->commitlock);
+}
+
+void sx_commitwait(sxmanager *m, sxcommit *c, sxcommitstage stage)
+{
+	ss_mutexlock(&m->commitlock);
+	while (m->commit_stage[stage] != c->seq - 1)
+		ss_condwait(&m->commitcond, &m->commitlock);
+	ss_mutexunlock(&m->commitlock);
+}
+
+void sx_commitend(sxmanager *m, sxcommit *c, sxcommitstage stage)
+{
+	ss_mutexlock(&m->commitlock);
+	assert(m->commit_stage[stage] == c->seq - 1);
+	m->commit_stage[stage] = c->seq;
+	if (stage == SX_COMMITINDEX && c->lsn > m->commit_lsn)
+		m->commit_lsn = c->lsn;
+	ss_condbroadcast(&m->commitcond);
+	ss_mutexunlock(&m->commitlock);
+}
+
+void sx_commitsync(sxmanager *m)
+{
+	/* wait for every issued commit to be applied */
+	ss_mutexlock(&m->commitlock);
+	while (m->commit_stage[SX_COMMITINDEX] != m->commit_seq)
+		ss_condwait(&m->commitcond, &m->commitlock);
+	ss_mutexunlock(&m->commitlock);
+}
+
 ss_rbget(sx_matchtx, ss_cmp((sscast(n, sx, node))->id, sscastu64(key)))
 
 sx *sx_find(sxmanager *m, uint64_t id)
@@ -126,13 +196,12 @@ sxstate sx_begin(sxmanager *m, sx *x, sxtype type, svlog *log, uint64_t vlsn)
 	sx_promote(x, SX_READY);
 	x->type = type;
 	x->log_read = -1;
+	if (sslikely(vlsn == UINT64_MAX))
+		vlsn = sx_lsn(m);
 	sr_seqlock(m->seq);
 	x->csn = m->csn;
 	x->id = sr_seqdo(m->seq, SR_TSNNEXT);
-	if (sslikely(vlsn == UINT64_MAX))
-		x->vlsn = sr_seqdo(m->seq, SR_LSN);
-	else
-		x->vlsn = vlsn;
+	x->vlsn = vlsn;
 	sr_sequnlock(m->seq);
 	ss_spinlock(&m->lock);
 	ssrbnode *n = NULL;
@@ -167,8 +236,11 @@ static inline uint64_t
 sx_csn(sxmanager *m)
 {
 	uint64_t csn = UINT64_MAX;
-	if (m->count_rw == 0)
+	ss_spinlock(&m->lock);
+	if (m->count_rw == 0) {
+		ss_spinunlock(&m->lock);
 		return csn;
+	}
 	ssrbnode *p = ss_rbmin(&m->i);
 	sx *min = NULL;
 	while (p) {
@@ -180,7 +252,9 @@ sx_csn(sxmanager *m)
 		break;
 	}
 	assert(min != NULL);
-	return min->csn;
+	csn = min->csn;
+	ss_spinunlock(&m->lock);
+	return csn;
 }
 
 static inline void
@@ -272,6 +346,9 @@ sx_preparecb(sx *x, svlogv *v, uint64_t lsn, sxpreparef prepare, void *arg)
 		return 0;
 	if (prepare == NULL)
 		return 0;
+	/* statements committed before the prepare
+	 * must be visible to the index lookup */
+	sx_commitsync(x->manager);
 	sxindex *i = ((sxv*)v->ptr)->index;
 	if (prepare(x, v->v, i->object, arg))
 		return 1;
@@ -12,6 +12,7 @@
 typedef struct sxmanager sxmanager;
 typedef struct sxindex sxindex;
 typedef struct sx sx;
+typedef struct sxcommit sxcommit;
 
 typedef enum {
 	SX_UNDEF,
@@ -35,6 +36,12 @@ struct sxindex {
 	sslist    link;
 };
 
+typedef enum {
+	SX_COMMITLOG,
+	SX_COMMITINDEX,
+	SX_COMMITMAX
+} sxcommitstage;
+
 typedef int (*sxpreparef)(sx*, svv*, so*, void*);
 
 struct sx {
@@ -50,19 +57,40 @@ struct sx {
 	sxmanager *manager;
 };
 
+struct sxcommit {
+	uint64_t seq;
+	uint64_t lsn;
+};
+
 struct sxmanager {
 	ssspinlock  lock;
+	ssmutex     txlock;
 	sslist      indexes;
 	ssrb        i;
 	uint32_t    count_rd;
 	uint32_t    count_rw;
 	uint32_t    count_gc;
 	uint64_t    csn;
+	ssmutex     commitlock;
+	sscond      commitcond;
+	uint64_t    commit_seq;
+	uint64_t    commit_stage[SX_COMMITMAX];
+	uint64_t    commit_lsn;
 	sxv        *gc;
 	sxvpool     pool;
 	srseq      *seq;
 };
 
+static inline void
+sx_txlock(sxmanager *m) {
+	ss_mutexlock(&m->txlock);
+}
+
+static inline void
+sx_txunlock(sxmanager *m) {
+	ss_mutexunlock(&m->txlock);
+}
+
 int       sx_managerinit(sxmanager*, srseq*, ssa*);
 int       sx_managerfree(sxmanager*);
 int       sx_indexinit(sxindex*, sxmanager*, sr*, so*);
@@ -78,6 +106,11 @@ sxstate   sx_rollback(sx*);
 int       sx_set(sx*, sxindex*, svv*);
 int       sx_get(sx*, sxindex*, svv*, svv**);
 uint64_t  sx_vlsn(sxmanager*);
+uint64_t  sx_lsn(sxmanager*);
+void      sx_commitbegin(sxmanager*, sxcommit*, uint64_t);
+void      sx_commitwait(sxmanager*, sxcommit*, sxcommitstage);
+void      sx_commitend(sxmanager*, sxcommit*, sxcommitstage);
+void      sx_commitsync(sxmanager*);
 sxstate   sx_set_autocommit(sxmanager*, sxindex*, sx*, svlog*, svv*);
 sxstate   sx_get_autocommit(sxmanager*, sxindex*);
 
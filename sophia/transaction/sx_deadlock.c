@@ -58,6 +58,7 @@ int sx_deadlock(sx *t)
 	sxmanager *m = t->manager;
 	sslist mark;
 	ss_listinit(&mark);
+	ss_spinlock(&m->lock);
 	ssiter i;
 	ss_iterinit(ss_bufiter, &i);
 	ss_iteropen(ss_bufiter, &i, &t->log->buf, sizeof(svlogv));
@@ -74,10 +75,12 @@ int sx_deadlock(sx *t)
 		int rc = sx_deadlock_in(m, &mark, t, p);
 		if (ssunlikely(rc)) {
 			sx_deadlock_unmark(&mark);
+			ss_spinunlock(&m->lock);
 			return 1;
 		}
 		ss_iternext(ss_bufiter, &i);
 	}
 	sx_deadlock_unmark(&mark);
+	ss_spinunlock(&m->lock);
 	return 0;
 }
@@ -16,8 +16,10 @@
 ss_rbtruncate(sv_indextruncate,
               sv_vfree((sr*)arg, sscast(n, svv, node)))
 
-int sv_indexinit(svindex *i)
+int sv_indexinit(svindex *i, uint8_t type)
 {
+	i->type   = type;
+	i->s      = NULL;
 	i->lsnmin = UINT64_MAX;
 	i->count  = 0;
 	i->used   = 0;
@@ -27,12 +29,30 @@ int sv_indexinit(svindex *i)
 
 int sv_indexfree(svindex *i, sr *r)
 {
+	if (i->s) {
+		svskipnode *n = sv_skiplist_min(i->s);
+		while (n) {
+			sv_vfree(r, n->v);
+			n = n->next[0];
+		}
+		sv_skiplist_free(i->s, r);
+		i->s = NULL;
+	}
 	if (i->i.root)
 		sv_indextruncate(i->i.root, r);
 	ss_rbinit(&i->i);
 	return 0;
 }
 
+void sv_indexreset(svindex *i, sr *r)
+{
+	/* free index structure, values are referenced
+	 * by other indexes */
+	if (i->s)
+		sv_skiplist_free(i->s, r);
+	sv_indexinit(i, i->type);
+}
+
 static inline svv*
 sv_vset(svv *head, svv *v, sr *r)
 {
@@ -64,6 +84,19 @@ sv_vset(svv *head, svv *v, sr *r)
 svv*
 sv_indexget(svindex *i, sr *r, svindexpos *p, svv *v)
 {
+	if (i->type == SV_INDEXSKIPLIST) {
+		p->node = NULL;
+		p->rc = 1;
+		if (i->s == NULL)
+			return NULL;
+		int eq;
+		svskipnode *n;
+		n = sv_skiplist_gte(i->s, r, sv_vpointer(v), &eq);
+		if (! eq)
+			return NULL;
+		p->rc = 0;
+		return sv_skipnode_v(n);
+	}
 	p->rc = sv_indexmatch(&i->i, r->scheme, sv_vpointer(v), 0,
 	                      &p->node);
 	if (p->rc == 0 && p->node)
@@ -71,8 +104,30 @@ sv_indexget(svindex *i, sr *r, svindexpos *p, svv *v)
 	return NULL;
 }
 
+static inline int
+sv_indexupdate_skiplist(svindex *i, sr *r, svv *v)
+{
+	/* skiplist is created on first write, writers of
+	 * the index are serialized by the commit order */
+	if (i->s == NULL) {
+		svskiplist *s = sv_skiplist_new(r);
+		if (ssunlikely(s == NULL))
+			return sr_oom_malfunction(r->e);
+		ss_atomic_store(&i->s, s);
+	}
+	int rc = sv_skiplist_set(i->s, r, v);
+	if (ssunlikely(rc == -1))
+		return sr_oom_malfunction(r->e);
+	return 0;
+}
+
 int sv_indexupdate(svindex *i, sr *r, svindexpos *p, svv *v)
 {
+	if (i->type == SV_INDEXSKIPLIST) {
+		int rc = sv_indexupdate_skiplist(i, r, v);
+		if (ssunlikely(rc == -1))
+			return -1;
+	} else
 	if (p->rc == 0 && p->node) {
 		svv *head = sscast(p->node, svv, node);
 		svv *update = sv_vset(head, v, r);
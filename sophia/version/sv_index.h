@@ -17,18 +17,44 @@ struct svindexpos {
 	int rc;
 };
 
+#define SV_INDEXRB       0
+#define SV_INDEXSKIPLIST 1
+
 struct svindex {
 	ssrb i;
+	svskiplist *s;
+	uint8_t type;
 	uint32_t count;
 	uint32_t used;
 	uint64_t lsnmin;
 } sspacked;
 
-ss_rbget(sv_indexmatch,
-         sf_compare(scheme, sv_vpointer(sscast(n, svv, node)), key))
+static inline int
+sv_indexmatch(ssrb *t, sfscheme *scheme, char *key,
+              int keysize ssunused,
+              ssrbnode **match)
+{
+	uint64_t prefix = sf_prefix(scheme, key);
+	ssrbnode *n = t->root;
+	*match = NULL;
+	int rc = 0;
+	while (n) {
+		*match = n;
+		rc = sv_vcompare(sscast(n, svv, node), scheme, prefix, key);
+		switch (rc) {
+		case  0: return 0;
+		case -1: n = n->r;
+			break;
+		case  1: n = n->l;
+			break;
+		}
+	}
+	return rc;
+}
 
-int  sv_indexinit(svindex*);
+int  sv_indexinit(svindex*, uint8_t);
 int  sv_indexfree(svindex*, sr*);
+void sv_indexreset(svindex*, sr*);
 int  sv_indexupdate(svindex*, sr*, svindexpos*, svv*);
 svv *sv_indexget(svindex*, sr*, svindexpos*, svv*);
 
@@ -37,8 +63,7 @@ sv_indexset(svindex *i, sr *r, svv *v)
 {
 	svindexpos pos;
 	sv_indexget(i, r, &pos, v);
-	sv_indexupdate(i, r, &pos, v);
-	return 0;
+	return sv_indexupdate(i, r, &pos, v);
 }
 
 #endif
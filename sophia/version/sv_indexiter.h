@@ -12,20 +12,85 @@
 typedef struct svindexiter svindexiter;
 
 struct svindexiter {
-	svindex  *index;
-	ssrbnode *v;
-	svv      *vcur;
-	ssorder   order;
+	svindex    *index;
+	ssrbnode   *v;
+	svskiplist *s;
+	svskipnode *sv;
+	svv        *vcur;
+	ssorder     order;
+	sr         *r;
 } sspacked;
 
+static inline int
+sv_indexiter_open_skiplist(svindexiter *ii, char *key)
+{
+	ii->s = ss_atomic_load(&ii->index->s);
+	if (ii->s == NULL)
+		return 0;
+	int eq = 0;
+	switch (ii->order) {
+	case SS_LT:
+	case SS_LTE:
+		if (ssunlikely(key == NULL)) {
+			ii->sv = sv_skiplist_lt(ii->s, ii->r, NULL);
+			break;
+		}
+		ii->sv = sv_skiplist_gte(ii->s, ii->r, key, &eq);
+		if (eq && ii->order == SS_LTE)
+			break;
+		ii->sv = sv_skiplist_lt(ii->s, ii->r, key);
+		break;
+	case SS_GT:
+	case SS_GTE:
+		if (ssunlikely(key == NULL)) {
+			ii->sv = sv_skiplist_min(ii->s);
+			break;
+		}
+		ii->sv = sv_skiplist_gte(ii->s, ii->r, key, &eq);
+		if (eq && ii->order == SS_GT)
+			ii->sv = sv_skipnode_next(ii->sv, 0);
+		break;
+	default: assert(0);
+	}
+	if (ii->sv)
+		ii->vcur = sv_skipnode_v(ii->sv);
+	return eq;
+}
+
+static inline void
+sv_indexiter_next_skiplist(svindexiter *ii)
+{
+	switch (ii->order) {
+	case SS_LT:
+	case SS_LTE:
+		ii->sv = sv_skiplist_lt(ii->s, ii->r, sv_vpointer(sv_skipnode_v(ii->sv)));
+		break;
+	case SS_GT:
+	case SS_GTE:
+		ii->sv = sv_skipnode_next(ii->sv, 0);
+		break;
+	default: assert(0);
+	}
+	if (sslikely(ii->sv)) {
+		ii->vcur = sv_skipnode_v(ii->sv);
+	} else {
+		ii->vcur = NULL;
+	}
+}
+
 static inline int
 sv_indexiter_open(ssiter *i, sr *r, svindex *index, ssorder o, char *key)
 {
 	svindexiter *ii = (svindexiter*)i->priv;
 	ii->index = index;
 	ii->order = o;
+	ii->r     = r;
 	ii->v     = NULL;
+	ii->s     = NULL;
+	ii->sv    = NULL;
 	ii->vcur  = NULL;
+	if (index->type == SV_INDEXSKIPLIST)
+		return sv_indexiter_open_skiplist(ii, key);
 	int rc;
 	int eq = 0;
 	switch (ii->order) {
@@ -86,14 +151,14 @@ static inline int
 sv_indexiter_has(ssiter *i)
 {
 	svindexiter *ii = (svindexiter*)i->priv;
-	return ii->v != NULL;
+	return ii->vcur != NULL;
 }
 
 static inline void*
 sv_indexiter_of(ssiter *i)
 {
 	svindexiter *ii = (svindexiter*)i->priv;
-	if (ssunlikely(ii->v == NULL))
+	if (ssunlikely(ii->vcur == NULL))
 		return NULL;
 	return sv_vpointer(ii->vcur);
 }
@@ -102,14 +167,17 @@ static inline void
 sv_indexiter_next(ssiter *i)
 {
 	svindexiter *ii = (svindexiter*)i->priv;
-	if (ssunlikely(ii->v == NULL))
+	if (ssunlikely(ii->vcur == NULL))
 		return;
-	assert(ii->vcur != NULL);
 	svv *v = ii->vcur->next;
 	if (v) {
 		ii->vcur = v;
 		return;
 	}
+	if (ii->s) {
+		sv_indexiter_next_skiplist(ii);
+		return;
+	}
 	switch (ii->order) {
 	case SS_LT:
 	case SS_LTE:
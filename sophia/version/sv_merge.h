@@ -21,12 +21,21 @@ struct svmergesrc {
 struct svmerge {
 	svmergesrc reserve[16];
 	ssbuf buf;
+	char *limit;
 };
 
 static inline void
 sv_mergeinit(svmerge *m)
 {
 	ss_bufinit_reserve(&m->buf, m->reserve, sizeof(m->reserve));
+	m->limit = NULL;
+}
+
+static inline void
+sv_mergelimit(svmerge *m, char *key)
+{
+	/* stop forward iteration on the first key >= limit */
+	m->limit = key;
 }
 
 static inline int
@@ -79,6 +79,9 @@ sv_mergeiter_gt(svmergeiter *i)
 	}
 	if (ssunlikely(min == NULL))
 		return;
+	if (ssunlikely(i->merge->limit &&
+	               sf_compare(i->r->scheme, minv, i->merge->limit) >= 0))
+		return;
 	i->v = min;
 }
 
@@ -0,0 +1,179 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+#include <libsv.h>
+
+svskiplist *sv_skiplist_new(sr *r)
+{
+	svskiplist *s = ss_malloc(r->a, sizeof(svskiplist));
+	if (ssunlikely(s == NULL))
+		return NULL;
+	memset(s, 0, sizeof(*s));
+	return s;
+}
+
+void sv_skiplist_free(svskiplist *s, sr *r)
+{
+	svskipnode *n = s->head[0];
+	while (n) {
+		svskipnode *next = n->next[0];
+		ss_free(r->a, n);
+		n = next;
+	}
+	ss_free(r->a, s);
+}
+
+static inline uint32_t
+sv_skiplist_height(svskiplist *s)
+{
+	uint32_t x = ss_atomic_add(&s->seed, 1);
+	x ^= x >> 16;
+	x *= 0x85ebca6bU;
+	x ^= x >> 13;
+	x *= 0xc2b2ae35U;
+	x ^= x >> 16;
+	/* p = 1/4 */
+	uint32_t height = 1;
+	while (height < SV_SKIPLIST_HEIGHT && (x & 3) == 0) {
+		height++;
+		x >>= 2;
+	}
+	return height;
+}
+
+static inline svskipnode**
+sv_skiplist_link(svskiplist *s, svskipnode *prev, int level) {
+	if (prev == NULL)
+		return &s->head[level];
+	return &prev->next[level];
+}
+
+static inline svskipnode*
+sv_skiplist_find(svskiplist *s, sr *r, uint64_t prefix, char *key,
+                 svskipnode **prev,
+                 svskipnode **next)
+{
+	svskipnode *p = NULL;
+	svskipnode *n = NULL;
+	int rc = 1;
+	int level = SV_SKIPLIST_HEIGHT - 1;
+	while (level >= 0) {
+		n = sv_skiplist_next(s, p, level);
+		while (n) {
+			rc = sv_skipnode_compare(n, r, prefix, key);
+			if (rc >= 0)
+				break;
+			p = n;
+			n = sv_skiplist_next(s, p, level);
+		}
+		prev[level] = p;
+		next[level] = n;
+		level--;
+	}
+	if (n && rc == 0)
+		return n;
+	return NULL;
+}
+
+static inline void
+sv_skiplist_chain(svskipnode *n, sr *r, svv *v)
+{
+	uint64_t lsn = sv_vlsn(v, r);
+	for (;;) {
+		svv *head = sv_skipnode_v(n);
+		assert(sv_vlsn(head, r) != lsn);
+		/* default */
+		if (sslikely(sv_vlsn(head, r) < lsn)) {
+			v->next = head;
+			if (! ss_atomic_cas(&n->v, head, v))
+				continue;
+			sf_flagsset(r->scheme, sv_vpointer(head),
+			            sv_vflags(head, r) | SVDUP);
+			return;
+		}
+		/* redistribution (starting from highest lsn), older
+		 * versions are inserted only during recovery and
+		 * compaction, while writers are excluded */
+		svv *prev = head;
+		svv *c = head->next;
+		while (c) {
+			assert(sv_vlsn(c, r) != lsn);
+			if (sv_vlsn(c, r) < lsn)
+				break;
+			prev = c;
+			c = c->next;
+		}
+		v->next = c;
+		sf_flagsset(r->scheme, sv_vpointer(v),
+		            sv_vflags(v, r) | SVDUP);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		prev->next = v;
+		return;
+	}
+}
+
+int sv_skiplist_set(svskiplist *s, sr *r, svv *v)
+{
+	char *key = sv_vpointer(v);
+	svskipnode *prev[SV_SKIPLIST_HEIGHT];
+	svskipnode *next[SV_SKIPLIST_HEIGHT];
+	svskipnode *n = NULL;
+	uint32_t height = 0;
+
+	/* link the node at the bottom level, which makes
+	 * it visible for readers */
+	for (;;) {
+		svskipnode *match;
+		match = sv_skiplist_find(s, r, v->prefix, key, prev, next);
+		if (match) {
+			if (n)
+				ss_free(r->a, n);
+			sv_skiplist_chain(match, r, v);
+			return 0;
+		}
+		if (n == NULL) {
+			height = sv_skiplist_height(s);
+			n = ss_malloc(r->a, sizeof(svskipnode) +
+			              sizeof(svskipnode*) * height);
+			if (ssunlikely(n == NULL))
+				return -1;
+			n->v = v;
+			n->prefix = v->prefix;
+			n->height = height;
+		}
+		n->next[0] = next[0];
+		if (ss_atomic_cas(sv_skiplist_link(s, prev[0], 0), next[0], n))
+			break;
+	}
+
+	/* raise list height */
+	for (;;) {
+		uint32_t current = ss_atomic_load(&s->height);
+		if (current >= height)
+			break;
+		if (ss_atomic_cas(&s->height, current, height))
+			break;
+	}
+
+	/* link upper levels */
+	uint32_t level = 1;
+	while (level < height) {
+		n->next[level] = next[level];
+		if (ss_atomic_cas(sv_skiplist_link(s, prev[level], level),
+		                  next[level], n)) {
+			level++;
+			continue;
+		}
+		sv_skiplist_find(s, r, v->prefix, key, prev, next);
+	}
+	return 0;
+}
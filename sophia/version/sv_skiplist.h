@@ -0,0 +1,123 @@
+#ifndef SV_SKIPLIST_H_
+#define SV_SKIPLIST_H_
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+/* Skiplist memtable.
+ *
+ * Nodes are never removed from the list, so readers can
+ * traverse it without locking, while writers link new
+ * nodes level by level using compare-and-swap. Every node
+ * holds a version chain of a single key, ordered by lsn.
+*/
+
+#define SV_SKIPLIST_HEIGHT 12
+
+typedef struct svskipnode svskipnode;
+typedef struct svskiplist svskiplist;
+
+struct svskipnode {
+	svv        *v;
+	uint64_t    prefix;
+	uint32_t    height;
+	svskipnode *next[];
+};
+
+struct svskiplist {
+	uint32_t    height;
+	uint32_t    seed;
+	svskipnode *head[SV_SKIPLIST_HEIGHT];
+};
+
+svskiplist *sv_skiplist_new(sr*);
+void        sv_skiplist_free(svskiplist*, sr*);
+int         sv_skiplist_set(svskiplist*, sr*, svv*);
+
+static inline svv*
+sv_skipnode_v(svskipnode *n) {
+	return ss_atomic_load(&n->v);
+}
+
+static inline svskipnode*
+sv_skipnode_next(svskipnode *n, int level) {
+	return ss_atomic_load(&n->next[level]);
+}
+
+static inline svskipnode*
+sv_skiplist_next(svskiplist *s, svskipnode *prev, int level) {
+	if (prev == NULL)
+		return ss_atomic_load(&s->head[level]);
+	return sv_skipnode_next(prev, level);
+}
+
+static inline int
+sv_skipnode_compare(svskipnode *n, sr *r, uint64_t prefix, char *key)
+{
+	/* node key never changes, so the prefix is kept
+	 * along with the node */
+	if (n->prefix != prefix)
+		return (n->prefix < prefix) ? -1 : 1;
+	return sf_compare(r->scheme, sv_vpointer(sv_skipnode_v(n)), key);
+}
+
+static inline svskipnode*
+sv_skiplist_min(svskiplist *s) {
+	return ss_atomic_load(&s->head[0]);
+}
+
+/* find first node >= key */
+static inline svskipnode*
+sv_skiplist_gte(svskiplist *s, sr *r, char *key, int *eq)
+{
+	uint64_t prefix = sf_prefix(r->scheme, key);
+	svskipnode *prev = NULL;
+	svskipnode *n = NULL;
+	int rc = 1;
+	int level = ss_atomic_load(&s->height) - 1;
+	while (level >= 0) {
+		n = sv_skiplist_next(s, prev, level);
+		while (n) {
+			rc = sv_skipnode_compare(n, r, prefix, key);
+			if (rc >= 0)
+				break;
+			prev = n;
+			n = sv_skiplist_next(s, prev, level);
+		}
+		if (n && rc == 0)
+			break;
+		level--;
+	}
+	*eq = (n && rc == 0);
+	return n;
+}
+
+/* find last node < key, or the last node if key
+ * is not set */
+static inline svskipnode*
+sv_skiplist_lt(svskiplist *s, sr *r, char *key)
+{
+	uint64_t prefix = 0;
+	if (key)
+		prefix = sf_prefix(r->scheme, key);
+	svskipnode *prev = NULL;
+	int level = ss_atomic_load(&s->height) - 1;
+	while (level >= 0) {
+		svskipnode *n = sv_skiplist_next(s, prev, level);
+		while (n) {
+			if (key && sv_skipnode_compare(n, r, prefix, key) >= 0)
+				break;
+			prev = n;
+			n = sv_skiplist_next(s, prev, level);
+		}
+		level--;
+	}
+	return prev;
+}
+
+#endif
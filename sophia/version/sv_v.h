@@ -15,6 +15,7 @@ struct svv {
 	uint16_t refs;
 	void    *log;
 	svv     *next;
+	uint64_t prefix;
 	ssrbnode node;
 } sspacked;
 
@@ -58,11 +59,10 @@ sv_vbuild(sr *r, sfv *fields)
 	memset(&v->node, 0, sizeof(v->node));
 	char *ptr = sv_vpointer(v);
 	sf_write(r->scheme, fields, ptr);
+	v->prefix = sf_prefix(r->scheme, ptr);
 	/* update runtime statistics */
-	ss_spinlock(&r->stat->lock);
-	r->stat->v_count++;
-	r->stat->v_allocated += sizeof(svv) + size;
-	ss_spinunlock(&r->stat->lock);
+	sr_statv(r->stat, sizeof(svv) + size);
+	sr_quotaadd(r->quota, sizeof(svv) + size);
 	return v;
 }
 
@@ -78,11 +78,10 @@ sv_vbuildraw(sr *r, char *src)
 	v->next  = NULL;
 	memset(&v->node, 0, sizeof(v->node));
 	memcpy(sv_vpointer(v), src, size);
+	v->prefix = sf_prefix(r->scheme, src);
 	/* update runtime statistics */
-	ss_spinlock(&r->stat->lock);
-	r->stat->v_count++;
-	r->stat->v_allocated += sizeof(svv) + size;
-	ss_spinunlock(&r->stat->lock);
+	sr_statv(r->stat, sizeof(svv) + size);
+	sr_quotaadd(r->quota, sizeof(svv) + size);
 	return v;
 }
 
@@ -97,12 +96,8 @@ sv_vunref(sr *r, svv *v)
 	if (sslikely(--v->refs == 0)) {
 		uint32_t size = sv_vsize(v, r);
 		/* update runtime statistics */
-		ss_spinlock(&r->stat->lock);
-		assert(r->stat->v_count > 0);
-		assert(r->stat->v_allocated >= size);
-		r->stat->v_count--;
-		r->stat->v_allocated -= size;
-		ss_spinunlock(&r->stat->lock);
+		sr_statvfree(r->stat, size);
+		sr_quotasub(r->quota, size);
 		ss_free(r->av, v);
 		return 1;
 	}
@@ -119,6 +114,16 @@ sv_vfree(sr *r, svv *v)
 	}
 }
 
+static inline int
+sv_vcompare(svv *v, sfscheme *scheme, uint64_t prefix, char *key)
+{
+	/* decide by the cached key prefix first, which
+	 * avoids reading the document */
+	if (v->prefix != prefix)
+		return (v->prefix < prefix) ? -1 : 1;
+	return sf_compare(scheme, sv_vpointer(v), key);
+}
+
 static inline svv*
 sv_vvisible(svv *v, sr *r, uint64_t vlsn) {
 	while (v && sv_vlsn(v, r) > vlsn)
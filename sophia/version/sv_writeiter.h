@@ -16,6 +16,7 @@ struct svwriteiter {
 	uint64_t  limit;
 	uint64_t  size;
 	uint32_t  sizev;
+	uint32_t  blob;
 	uint32_t  expire;
 	uint32_t  now;
 	int       next;
@@ -71,6 +72,17 @@ sv_writeiter_upsert(svwriteiter *i)
 	return 0;
 }
 
+static inline uint32_t
+sv_writeiter_size(svwriteiter *i, char *v)
+{
+	/* separated value is replaced by a reference
+	 * in the page */
+	uint32_t size = sf_size(i->r->scheme, v);
+	if (i->blob && size >= i->blob)
+		return sf_comparable_size(i->r->scheme, v);
+	return size;
+}
+
 static inline void
 sv_writeiter_next(ssiter *i)
 {
@@ -115,7 +127,7 @@ sv_writeiter_next(ssiter *i)
 				im->prevlsn = lsn;
 				continue;
 			}
-			im->size += im->sizev + sf_size(im->r->scheme, v);
+			im->size += im->sizev + sv_writeiter_size(im, v);
 			/* upsert (track first statement start) */
 			if (sf_flagsequ(flags, SVUPSERT))
 				im->upsert = 1;
@@ -149,6 +161,7 @@ static inline int
 sv_writeiter_open(ssiter *i, sr *r, ssiter *merge, svupsert *u,
                   uint64_t limit,
                   uint32_t sizev,
+                  uint32_t blob,
                   uint32_t expire,
                   uint32_t timestamp,
                   uint64_t vlsn)
@@ -159,6 +172,7 @@ sv_writeiter_open(ssiter *i, sr *r, ssiter *merge, svupsert *u,
 	im->limit   = limit;
 	im->size    = 0;
 	im->sizev   = sizev;
+	im->blob    = blob;
 	im->expire  = expire;
 	im->now     = timestamp;
 	im->vlsn    = vlsn;
@@ -204,7 +218,7 @@ sv_writeiter_resume(ssiter *i)
 	im->prevlsn = sf_lsn(im->r->scheme, im->v);
 	im->next    = 1;
 	im->upsert  = 0;
-	im->size    = im->sizev + sf_size(im->r->scheme, im->v);
+	im->size    = im->sizev + sv_writeiter_size(im, im->v);
 	return 1;
 }
 
@@ -96,6 +96,93 @@ error:
 	return NULL;
 }
 
+static inline int
+sw_filesync(swmanager *p, sw *l)
+{
+	int rc = ss_filesync(&l->file);
+	if (ssunlikely(rc == -1)) {
+		sr_malfunction(p->r->e, "log file '%s' sync error: %s",
+		               ss_pathof(&l->file.path),
+		               strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+static inline void
+sw_asyncswap(swmanager *p)
+{
+	/* take records buffered so far, lock must be held */
+	assert(ss_bufused(&p->async_flush) == 0);
+	ssbuf buf = p->async_flush;
+	p->async_flush = p->async;
+	p->async = buf;
+}
+
+static inline int
+sw_asyncwrite(swmanager *p, sw *l)
+{
+	int size = ss_bufused(&p->async_flush);
+	if (size == 0)
+		return 0;
+	int rc = ss_filewrite(&l->file, p->async_flush.s, size);
+	ss_bufreset(&p->async_flush);
+	if (ssunlikely(rc == -1)) {
+		sr_malfunction(p->r->e, "log file '%s' write error: %s",
+		               ss_pathof(&l->file.path),
+		               strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+static void*
+sw_flusher(void *arg)
+{
+	ssthread *self = arg;
+	swmanager *p = self->arg;
+	ss_mutexlock(&p->synclock);
+	while (! p->async_stop)
+	{
+		if (! p->async_kick)
+			ss_condtimedwait(&p->async_cond, &p->synclock,
+			                 p->conf.async_interval * 1000ULL);
+		p->async_kick = 0;
+		if (p->lsn_synced >= p->lsn_written || p->sync_error)
+			continue;
+		if (p->sync_leader) {
+			/* log rotation is in progress */
+			ss_condwait(&p->synccond, &p->synclock);
+			continue;
+		}
+		p->sync_leader = 1;
+		ss_mutexunlock(&p->synclock);
+
+		/* write and sync records buffered by
+		 * committed transactions */
+		ss_spinlock(&p->lock);
+		sw *l = sscast(p->list.prev, sw, link);
+		sw_asyncswap(p);
+		ss_mutexlock(&p->synclock);
+		uint64_t lsn = p->lsn_written;
+		ss_mutexunlock(&p->synclock);
+		ss_spinunlock(&p->lock);
+		int rc = sw_asyncwrite(p, l);
+		if (sslikely(rc == 0))
+			rc = sw_filesync(p, l);
+
+		ss_mutexlock(&p->synclock);
+		p->sync_leader = 0;
+		if (sslikely(rc == 0))
+			p->lsn_synced = lsn;
+		else
+			p->sync_error = 1;
+		ss_condbroadcast(&p->synccond);
+	}
+	ss_mutexunlock(&p->synclock);
+	return NULL;
+}
+
 int sw_managerinit(swmanager *p, sr *r)
 {
 	ss_spinlockinit(&p->lock);
@@ -104,6 +191,18 @@ int sw_managerinit(swmanager *p, sr *r)
 	p->n    = 0;
 	p->r    = r;
 	p->gc   = 1;
+	ss_mutexinit(&p->synclock);
+	ss_condinit(&p->synccond);
+	p->sync_leader = 0;
+	p->sync_error  = 0;
+	p->lsn_written = 0;
+	p->lsn_synced  = 0;
+	ss_bufinit(&p->async);
+	ss_bufinit(&p->async_flush);
+	ss_condinit(&p->async_cond);
+	p->async_kick = 0;
+	p->async_stop = 0;
+	ss_threadpool_init(&p->async_thread);
 	struct iovec *iov =
 		ss_malloc(r->a, sizeof(struct iovec) * 1021);
 	if (ssunlikely(iov == NULL))
@@ -186,6 +285,13 @@ int sw_manageropen(swmanager *p)
 		if (ssunlikely(rc == -1))
 			return -1;
 	}
+	if (p->conf.async) {
+		rc = ss_threadpool_new(&p->async_thread, p->r->a, 1,
+		                       sw_flusher, p);
+		if (ssunlikely(rc == -1))
+			return sr_malfunction(p->r->e, "failed to create log flusher thread: %s",
+			                      strerror(errno));
+	}
 	return 0;
 }
 
@@ -197,28 +303,56 @@ int sw_managerrotate(swmanager *p)
 	sw *l = sw_new(p, lfsn);
 	if (ssunlikely(l == NULL))
 		return -1;
+
+	/* take group commit leadership, so the sync leader
+	 * would only have to care about the latest log file */
+	ss_mutexlock(&p->synclock);
+	while (p->sync_leader)
+		ss_condwait(&p->synccond, &p->synclock);
+	p->sync_leader = 1;
+	ss_mutexunlock(&p->synclock);
+
 	sw *log = NULL;
+	uint64_t lsn;
 	ss_spinlock(&p->lock);
 	if (p->n)
 		log = sscast(p->list.prev, sw, link);
 	ss_listappend(&p->list, &l->link);
 	p->n++;
+	/* buffered records belong to the previous log file */
+	sw_asyncswap(p);
+	ss_mutexlock(&p->synclock);
+	lsn = p->lsn_written;
+	ss_mutexunlock(&p->synclock);
 	ss_spinunlock(&p->lock);
+
+	int rc = 0;
+	int synced = 0;
 	if (log) {
 		assert(log->file.fd != -1);
-		if (p->conf.sync_on_rotate) {
-			int rc = ss_filesync(&log->file);
-			if (ssunlikely(rc == -1)) {
-				sr_malfunction(p->r->e, "log file '%s' sync error: %s",
-				               ss_pathof(&log->file.path),
-				               strerror(errno));
-				return -1;
-			}
+		rc = sw_asyncwrite(p, log);
+		if (sslikely(rc == 0) && (p->conf.sync_on_rotate ||
+		                          p->conf.sync_on_write ||
+		                          p->conf.async)) {
+			rc = sw_filesync(p, log);
+			if (sslikely(rc == 0))
+				synced = 1;
+		}
+		if (sslikely(rc == 0)) {
+			ss_fileadvise(&log->file, 0, 0, log->file.size);
+			ss_gccomplete(&log->gc);
 		}
-		ss_fileadvise(&log->file, 0, 0, log->file.size);
-		ss_gccomplete(&log->gc);
 	}
-	return 0;
+
+	ss_mutexlock(&p->synclock);
+	p->sync_leader = 0;
+	if (synced && lsn > p->lsn_synced)
+		p->lsn_synced = lsn;
+	if (ssunlikely(rc == -1))
+		p->sync_error = 1;
+	ss_condbroadcast(&p->synccond);
+	ss_mutexunlock(&p->synclock);
+	return rc;
 }
 
 int sw_managerrotate_ready(swmanager *p)
@@ -237,6 +371,28 @@ int sw_managershutdown(swmanager *p)
 {
 	int rcret = 0;
 	int rc;
+	if (p->async_thread.n) {
+		ss_mutexlock(&p->synclock);
+		p->async_stop = 1;
+		ss_condsignal(&p->async_cond);
+		ss_mutexunlock(&p->synclock);
+		rc = ss_threadpool_shutdown(&p->async_thread, p->r->a);
+		if (ssunlikely(rc == -1))
+			rcret = -1;
+		/* flush records written after the last
+		 * flusher round */
+		if (p->n) {
+			ss_spinlock(&p->lock);
+			sw *l = sscast(p->list.prev, sw, link);
+			sw_asyncswap(p);
+			ss_spinunlock(&p->lock);
+			rc = sw_asyncwrite(p, l);
+			if (sslikely(rc == 0))
+				rc = sw_filesync(p, l);
+			if (ssunlikely(rc == -1))
+				rcret = -1;
+		}
+	}
 	if (p->n) {
 		sslist *i, *n;
 		ss_listforeach_safe(&p->list, i, n) {
@@ -249,6 +405,11 @@ int sw_managershutdown(swmanager *p)
 	if (p->iov.v)
 		ss_free(p->r->a, p->iov.v);
 	sw_conffree(&p->conf, p->r->a);
+	ss_buffree(&p->async, p->r->a);
+	ss_buffree(&p->async_flush, p->r->a);
+	ss_condfree(&p->async_cond);
+	ss_condfree(&p->synccond);
+	ss_mutexfree(&p->synclock);
 	ss_spinlockfree(&p->lock);
 	return rcret;
 }
@@ -318,6 +479,31 @@ int sw_managerfiles(swmanager *p)
 	return n;
 }
 
+uint64_t sw_managerdurable(swmanager *p)
+{
+	ss_mutexlock(&p->synclock);
+	uint64_t lsn = p->lsn_synced;
+	ss_mutexunlock(&p->synclock);
+	return lsn;
+}
+
+void sw_managerreplay(swmanager *p, uint64_t lsn)
+{
+	sr_seqlock(p->r->seq);
+	if (lsn > p->r->seq->lsn)
+		p->r->seq->lsn = lsn;
+	sr_sequnlock(p->r->seq);
+	if (! p->conf.enable)
+		return;
+	/* replayed records are already on disk */
+	ss_mutexlock(&p->synclock);
+	if (lsn > p->lsn_written)
+		p->lsn_written = lsn;
+	if (lsn > p->lsn_synced)
+		p->lsn_synced = lsn;
+	ss_mutexunlock(&p->synclock);
+}
+
 int sw_managercopy(swmanager *p, char *dest, ssbuf *buf)
 {
 	sslist list;
@@ -363,6 +549,7 @@ int sw_managercopy(swmanager *p, char *dest, ssbuf *buf)
 			return -1;
 		}
 		ss_bufadvance(buf, l->file.size);
+		sr_throttle(p->r, l->file.size);
 		rc = ss_filewrite(&file, buf->s, l->file.size);
 		if (ssunlikely(rc == -1)) {
 			sr_error(p->r->e, "log file '%s' write error: %s",
@@ -403,16 +590,22 @@ int sw_begin(swmanager *p, swtx *t, uint64_t lsn, int recover)
 		return 0;
 	assert(p->n > 0);
 	sw *l = sscast(p->list.prev, sw, link);
-	ss_mutexlock(&l->filelock);
-	t->svp = ss_filesvp(&l->file);
 	t->l = l;
 	t->p = p;
+	if (p->conf.async) {
+		/* records are appended to the in-memory log
+		 * buffer, the file is written by the flusher */
+		t->svp = ss_bufused(&p->async);
+		return 0;
+	}
+	ss_mutexlock(&l->filelock);
+	t->svp = ss_filesvp(&l->file);
 	return 0;
 }
 
 int sw_commit(swtx *t)
 {
-	if (t->p->conf.enable)
+	if (t->p->conf.enable && !t->p->conf.async)
 		ss_mutexunlock(&t->l->filelock);
 	ss_spinunlock(&t->p->lock);
 	return 0;
@@ -421,6 +614,9 @@ int sw_commit(swtx *t)
 int sw_rollback(swtx *t)
 {
 	int rc = 0;
+	if (t->p->conf.enable && t->p->conf.async) {
+		t->p->async.p = t->p->async.s + t->svp;
+	} else
 	if (t->p->conf.enable) {
 		rc = ss_filerlb(&t->l->file, t->svp);
 		if (ssunlikely(rc == -1))
@@ -448,6 +644,35 @@ sw_writeadd(swmanager *p, swtx *t, svlog *vlog, swv *lv, svlogv *logv)
 	logv->v->log = t->l;
 }
 
+static inline int
+sw_writeiov(swmanager *p, sw *l)
+{
+	if (p->conf.async) {
+		int size = 0;
+		int i = 0;
+		while (i < p->iov.iovc)
+			size += p->iov.v[i++].iov_len;
+		int rc = ss_bufensure(&p->async, p->r->a, size);
+		if (ssunlikely(rc == -1))
+			return sr_oom_malfunction(p->r->e);
+		i = 0;
+		while (i < p->iov.iovc) {
+			memcpy(p->async.p, p->iov.v[i].iov_base, p->iov.v[i].iov_len);
+			ss_bufadvance(&p->async, p->iov.v[i].iov_len);
+			i++;
+		}
+		return 0;
+	}
+	int rc = ss_filewritev(&l->file, &p->iov);
+	if (ssunlikely(rc == -1)) {
+		sr_malfunction(p->r->e, "log file '%s' write error: %s",
+		               ss_pathof(&l->file.path),
+		               strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
 static inline int
 sw_writestmt(swtx *t, svlog *vlog)
 {
@@ -469,13 +694,9 @@ sw_writestmt(swtx *t, svlog *vlog)
 	assert(stmt != NULL);
 	swv lv;
 	sw_writeadd(t->p, t, vlog, &lv, stmt);
-	int rc = ss_filewritev(&t->l->file, &p->iov);
-	if (ssunlikely(rc == -1)) {
-		sr_malfunction(p->r->e, "log file '%s' write error: %s",
-		               ss_pathof(&t->l->file.path),
-		               strerror(errno));
+	int rc = sw_writeiov(p, t->l);
+	if (ssunlikely(rc == -1))
 		return -1;
-	}
 	ss_gcmark(&t->l->gc, 1);
 	ss_iovreset(&p->iov);
 	return 0;
@@ -505,13 +726,9 @@ sw_writestmt_multi(swtx *t, svlog *vlog)
 	for (; ss_iterhas(ss_bufiter, &i); ss_iternext(ss_bufiter, &i))
 	{
 		if (ssunlikely(! ss_iovensure(&p->iov, 2))) {
-			rc = ss_filewritev(&l->file, &p->iov);
-			if (ssunlikely(rc == -1)) {
-				sr_malfunction(p->r->e, "log file '%s' write error: %s",
-				               ss_pathof(&l->file.path),
-				               strerror(errno));
+			rc = sw_writeiov(p, l);
+			if (ssunlikely(rc == -1))
 				return -1;
-			}
 			ss_iovreset(&p->iov);
 			lvp = 0;
 		}
@@ -526,13 +743,9 @@ sw_writestmt_multi(swtx *t, svlog *vlog)
 		lvp++;
 	}
 	if (sslikely(ss_iovhas(&p->iov))) {
-		rc = ss_filewritev(&l->file, &p->iov);
-		if (ssunlikely(rc == -1)) {
-			sr_malfunction(p->r->e, "log file '%s' write error: %s",
-			               ss_pathof(&l->file.path),
-			               strerror(errno));
+		rc = sw_writeiov(p, l);
+		if (ssunlikely(rc == -1))
 			return -1;
-		}
 		ss_iovreset(&p->iov);
 	}
 	ss_gcmark(&l->gc, sv_logcount_write(vlog));
@@ -556,6 +769,16 @@ int sw_write(swtx *t, svlog *vlog)
 			sr *r = sv_logindex(vlog, v->index_id)->r;
 			sf_lsnset(r->scheme, sv_vpointer(v->v), t->lsn);
 		}
+		/* replayed records are already on disk */
+		if (t->recover && t->p->conf.enable) {
+			swmanager *p = t->p;
+			ss_mutexlock(&p->synclock);
+			if (t->lsn > p->lsn_written)
+				p->lsn_written = t->lsn;
+			if (t->lsn > p->lsn_synced)
+				p->lsn_synced = t->lsn;
+			ss_mutexunlock(&p->synclock);
+		}
 		return 0;
 	}
 
@@ -569,15 +792,78 @@ int sw_write(swtx *t, svlog *vlog)
 	if (ssunlikely(rc == -1))
 		return -1;
 
-	/* sync */
-	if (t->p->conf.sync_on_write) {
-		rc = ss_filesync(&t->l->file);
-		if (ssunlikely(rc == -1)) {
-			sr_malfunction(t->p->r->e, "log file '%s' sync error: %s",
-			               ss_pathof(&t->l->file.path),
-			               strerror(errno));
-			return -1;
-		}
+	/* sync is postponed until sw_syncwait() */
+	swmanager *p = t->p;
+	ss_mutexlock(&p->synclock);
+	p->lsn_written = t->lsn;
+	if (p->conf.async && ss_bufused(&p->async) >= (int)p->conf.async_wm) {
+		p->async_kick = 1;
+		ss_condsignal(&p->async_cond);
 	}
+	ss_mutexunlock(&p->synclock);
 	return 0;
 }
+
+static inline int
+sw_syncto(swmanager *p, uint64_t lsn)
+{
+	/* group commit.
+	 *
+	 * Wait until every record up to the lsn
+	 * become durable. First waiter becomes a leader and
+	 * syncs the log file on behalf of the whole group,
+	 * followers are woken up when the leader finishes.
+	 *
+	 * synclock must be held by the caller.
+	*/
+	int rc = 0;
+	while (p->lsn_synced < lsn)
+	{
+		if (ssunlikely(p->sync_error))
+			return sr_malfunction(p->r->e, "%s", "log sync error");
+		if (p->sync_leader) {
+			ss_condwait(&p->synccond, &p->synclock);
+			continue;
+		}
+		if (p->conf.async) {
+			/* ask flusher to start a new round */
+			p->async_kick = 1;
+			ss_condsignal(&p->async_cond);
+			ss_condwait(&p->synccond, &p->synclock);
+			continue;
+		}
+		p->sync_leader = 1;
+		uint64_t lsn_group = p->lsn_written;
+		ss_mutexunlock(&p->synclock);
+
+		/* log rotation is not possible while leader
+		 * is active */
+		ss_spinlock(&p->lock);
+		sw *l = sscast(p->list.prev, sw, link);
+		ss_spinunlock(&p->lock);
+		rc = sw_filesync(p, l);
+
+		ss_mutexlock(&p->synclock);
+		p->sync_leader = 0;
+		if (sslikely(rc == 0))
+			p->lsn_synced = lsn_group;
+		else
+			p->sync_error = 1;
+		ss_condbroadcast(&p->synccond);
+		if (ssunlikely(rc == -1))
+			break;
+	}
+	return rc;
+}
+
+int sw_syncwait(swmanager *p, uint64_t lsn)
+{
+	if (ssunlikely(! p->conf.enable))
+		return 0;
+	ss_mutexlock(&p->synclock);
+	if (lsn == 0 || lsn > p->lsn_written)
+		lsn = p->lsn_written;
+	int rc = sw_syncto(p, lsn);
+	ss_mutexunlock(&p->synclock);
+	return rc;
+}
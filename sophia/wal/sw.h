@@ -30,6 +30,18 @@ struct swmanager {
 	int        gc;
 	int        n;
 	ssiov      iov;
+	ssmutex    synclock;
+	sscond     synccond;
+	int        sync_leader;
+	int        sync_error;
+	uint64_t   lsn_written;
+	uint64_t   lsn_synced;
+	ssbuf      async;
+	ssbuf      async_flush;
+	sscond     async_cond;
+	int        async_kick;
+	int        async_stop;
+	ssthreadpool async_thread;
 	sr        *r;
 };
 
@@ -55,10 +67,13 @@ int sw_managergc_enable(swmanager*, int);
 int sw_managergc(swmanager*);
 int sw_managerfiles(swmanager*);
 int sw_managercopy(swmanager*, char*, ssbuf*);
+uint64_t sw_managerdurable(swmanager*);
+void sw_managerreplay(swmanager*, uint64_t);
 
 int sw_begin(swmanager*, swtx*, uint64_t, int);
 int sw_commit(swtx*);
 int sw_rollback(swtx*);
 int sw_write(swtx*, svlog*);
+int sw_syncwait(swmanager*, uint64_t);
 
 #endif
@@ -20,6 +20,10 @@ void sw_confinit(swconf *c)
 	c->rotatewm       = 500000;
 	c->sync_on_write  = 0;
 	c->sync_on_rotate = 1;
+	c->async          = 0;
+	c->async_interval = 10;
+	c->async_wm       = 1 * 1024 * 1024;
+	c->recover_threads = 4;
 }
 
 void sw_conffree(swconf *c, ssa *a)
@@ -17,6 +17,10 @@ struct swconf {
 	uint32_t  sync_on_rotate;
 	uint32_t  sync_on_write;
 	uint32_t  rotatewm;
+	uint32_t  async;
+	uint32_t  async_interval;
+	uint32_t  async_wm;
+	uint32_t  recover_threads;
 };
 
 void sw_confinit(swconf*);
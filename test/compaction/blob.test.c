@@ -0,0 +1,281 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <sophia.h>
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+#include <libsv.h>
+#include <libsd.h>
+#include <libst.h>
+
+#define BLOB_COUNT 400
+#define BLOB_SIZE  2048
+
+static void*
+blob_env(int threshold, int node_size)
+{
+	void *env = sp_env();
+	t( env != NULL );
+	t( sp_setstring(env, "sophia.path", st_r.conf->sophia_dir, 0) == 0 );
+	t( sp_setint(env, "scheduler.threads", 0) == 0 );
+	t( sp_setstring(env, "log.path", st_r.conf->log_dir, 0) == 0 );
+	t( sp_setint(env, "log.sync", 0) == 0 );
+	t( sp_setint(env, "log.rotate_sync", 0) == 0 );
+	t( sp_setstring(env, "db", "test", 0) == 0 );
+	t( sp_setstring(env, "db.test.path", st_r.conf->db_dir, 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "key", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme.key", "u32,key(0)", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "value", 0) == 0 );
+	t( sp_setint(env, "db.test.sync", 0) == 0 );
+	t( sp_setint(env, "db.test.compaction.cache", 0) == 0 );
+	t( sp_setint(env, "db.test.compaction.blob_threshold", threshold) == 0 );
+	if (node_size > 0) {
+		t( sp_setint(env, "db.test.compaction.node_size", node_size) == 0 );
+		t( sp_setint(env, "db.test.compaction.page_size", 1024) == 0 );
+	}
+	t( sp_open(env) == 0 );
+	return env;
+}
+
+static inline int
+blob_size(uint32_t key)
+{
+	/* every fourth value is not separated */
+	if ((key % 4) == 0)
+		return 16;
+	return BLOB_SIZE;
+}
+
+static void
+blob_set(void *env, uint32_t from, uint32_t to, int version)
+{
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	char value[BLOB_SIZE];
+	uint32_t key = from;
+	while (key < to) {
+		memset(value, key + version, sizeof(value));
+		void *o = sp_document(db);
+		t( o != NULL );
+		t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+		t( sp_setstring(o, "value", value, blob_size(key)) == 0 );
+		t( sp_set(db, o) == 0 );
+		key++;
+	}
+	t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+}
+
+static void
+blob_gcrun(void *env)
+{
+	t( sp_setint(env, "db.test.compaction.gc", 0) == 0 );
+	int i = 0;
+	while (i < 16) {
+		t( sp_setint(env, "scheduler.run", 0) != -1 );
+		i++;
+	}
+	t( sp_getint(env, "db.test.scheduler.gc") == 0 );
+}
+
+static void
+blob_check(void *o, uint32_t key, int version)
+{
+	char value[BLOB_SIZE];
+	memset(value, key + version, sizeof(value));
+	int size = 0;
+	char *ptr = sp_getstring(o, "value", &size);
+	t( size == blob_size(key) );
+	t( memcmp(ptr, value, size) == 0 );
+}
+
+static void
+blob_get(void *env, void *tx, uint32_t from, uint32_t to, int version)
+{
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	uint32_t key = from;
+	while (key < to) {
+		void *o = sp_document(db);
+		t( o != NULL );
+		t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+		o = sp_get((tx) ? tx : db, o);
+		t( o != NULL );
+		blob_check(o, key, version);
+		sp_destroy(o);
+		key++;
+	}
+}
+
+static void
+blob_cursor(void *env, uint32_t split, int version_a, int version_b)
+{
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	void *c = sp_cursor(env);
+	t( c != NULL );
+	void *o = sp_document(db);
+	uint32_t key = 0;
+	while ((o = sp_get(c, o))) {
+		t( *(uint32_t*)sp_getstring(o, "key", NULL) == key );
+		blob_check(o, key, (key < split) ? version_a : version_b);
+		key++;
+	}
+	t( key == BLOB_COUNT );
+	t( sp_destroy(c) == 0 );
+}
+
+static void
+blob_separate(void)
+{
+	void *env = blob_env(1024, 0);
+	blob_set(env, 0, BLOB_COUNT, 0);
+	t( sp_getint(env, "db.test.index.blob_count") == 1 );
+	int64_t size = sp_getint(env, "db.test.index.blob_size");
+	/* separated documents keep the key part along with the value */
+	int64_t size_doc = size / ((BLOB_COUNT / 4) * 3);
+	t( size == size_doc * (BLOB_COUNT / 4) * 3 );
+	t( size_doc > BLOB_SIZE && size_doc < BLOB_SIZE + 64 );
+	t( sp_getint(env, "db.test.index.blob_live") == size );
+	/* pages keep only keys and references */
+	t( sp_getint(env, "db.test.index.size") < size / 4 );
+	blob_get(env, NULL, 0, BLOB_COUNT, 0);
+	blob_cursor(env, 0, 0, 0);
+	t( sp_destroy(env) == 0 );
+
+	/* recover */
+	env = blob_env(1024, 0);
+	t( sp_getint(env, "db.test.index.blob_count") == 1 );
+	t( sp_getint(env, "db.test.index.blob_live") == size );
+	blob_get(env, NULL, 0, BLOB_COUNT, 0);
+	blob_cursor(env, 0, 0, 0);
+	t( sp_destroy(env) == 0 );
+
+	/* references are kept with separation disabled */
+	env = blob_env(0, 0);
+	blob_set(env, 0, 4, 1);
+	t( sp_getint(env, "db.test.index.blob_count") == 1 );
+	t( sp_getint(env, "db.test.index.blob_live") == size - size_doc * 3 );
+	blob_get(env, NULL, 0, 4, 1);
+	blob_get(env, NULL, 4, BLOB_COUNT, 0);
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+blob_snapshot(void)
+{
+	void *env = blob_env(1024, 0);
+	blob_set(env, 0, BLOB_COUNT, 0);
+	void *tx = sp_begin(env);
+	t( tx != NULL );
+	blob_set(env, 0, BLOB_COUNT, 1);
+	/* older versions still reference the first log */
+	t( sp_getint(env, "db.test.index.blob_count") == 2 );
+	blob_get(env, tx, 0, BLOB_COUNT, 0);
+	blob_get(env, NULL, 0, BLOB_COUNT, 1);
+	t( sp_destroy(tx) == 0 );
+
+	/* duplicates gc drops the log */
+	blob_gcrun(env);
+	t( sp_getint(env, "db.test.index.count_dup") == 0 );
+	t( sp_getint(env, "db.test.index.blob_count") == 1 );
+	blob_cursor(env, 0, 1, 1);
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+blob_gc(void)
+{
+	void *env = blob_env(1024, 0);
+	blob_set(env, 0, BLOB_COUNT, 0);
+	int64_t size = sp_getint(env, "db.test.index.blob_size");
+	uint32_t split = (BLOB_COUNT / 4) * 3;
+	blob_set(env, 0, split, 1);
+	t( sp_getint(env, "db.test.index.blob_count") == 2 );
+	t( sp_getint(env, "db.test.index.blob_size") == size * 2 - size / 4 );
+	t( sp_getint(env, "db.test.index.blob_live") == size );
+
+	/* live ratio of the first log is 25% */
+	blob_gcrun(env);
+	t( sp_getint(env, "db.test.index.blob_count") == 2 );
+	t( sp_getint(env, "db.test.index.blob_size") == size );
+	t( sp_getint(env, "db.test.index.blob_live") == size );
+	blob_get(env, NULL, 0, split, 1);
+	blob_get(env, NULL, split, BLOB_COUNT, 0);
+	blob_cursor(env, split, 1, 0);
+	t( sp_destroy(env) == 0 );
+
+	/* unreferenced log is removed on recovery */
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/%020d.blob",
+	         st_r.conf->db_dir, 1000000);
+	int fd = open(path, O_CREAT|O_RDWR, 0644);
+	t( fd != -1 );
+	t( close(fd) == 0 );
+	env = blob_env(1024, 0);
+	t( exists(st_r.conf->db_dir, "00000000000001000000.blob") == 0 );
+	t( sp_getint(env, "db.test.index.blob_count") == 2 );
+	blob_cursor(env, split, 1, 0);
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+blob_split(void)
+{
+	void *env = blob_env(1024, 16 * 1024);
+	blob_set(env, 0, BLOB_COUNT, 0);
+	t( sp_getint(env, "db.test.index.node_count") > 1 );
+	t( sp_getint(env, "db.test.index.blob_count") == 1 );
+	int64_t live = sp_getint(env, "db.test.index.blob_live");
+	uint32_t split = (BLOB_COUNT / 4) * 3;
+	blob_set(env, 0, split, 1);
+	t( sp_getint(env, "db.test.index.blob_live") == live );
+	t( sp_getint(env, "db.test.index.blob_size") > live );
+
+	/* nodes referencing the first log are rewritten */
+	blob_gcrun(env);
+	t( sp_getint(env, "db.test.index.blob_live") == live );
+	t( sp_getint(env, "db.test.index.blob_size") == live );
+	blob_cursor(env, split, 1, 0);
+	t( sp_destroy(env) == 0 );
+
+	env = blob_env(1024, 16 * 1024);
+	t( sp_getint(env, "db.test.index.blob_live") == live );
+	blob_get(env, NULL, 0, split, 1);
+	blob_get(env, NULL, split, BLOB_COUNT, 0);
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+blob_fixed(void)
+{
+	void *env = sp_env();
+	t( env != NULL );
+	t( sp_setstring(env, "sophia.path", st_r.conf->sophia_dir, 0) == 0 );
+	t( sp_setint(env, "scheduler.threads", 0) == 0 );
+	t( sp_setstring(env, "db", "test", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "key", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme.key", "u32,key(0)", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "value", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme.value", "u32", 0) == 0 );
+	t( sp_setint(env, "db.test.compaction.blob_threshold", 1024) == 0 );
+	t( sp_open(env) == -1 );
+	t( sp_destroy(env) == 0 );
+}
+
+stgroup *blob_group(void)
+{
+	stgroup *group = st_group("blob");
+	st_groupadd(group, st_test("separate", blob_separate));
+	st_groupadd(group, st_test("snapshot", blob_snapshot));
+	st_groupadd(group, st_test("gc", blob_gc));
+	st_groupadd(group, st_test("split", blob_split));
+	st_groupadd(group, st_test("fixed", blob_fixed));
+	return group;
+}
@@ -0,0 +1,175 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <sophia.h>
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+#include <libsv.h>
+#include <libsd.h>
+#include <libst.h>
+
+static void*
+bloom_env(int bits)
+{
+	void *env = sp_env();
+	t( env != NULL );
+	t( sp_setstring(env, "sophia.path", st_r.conf->sophia_dir, 0) == 0 );
+	t( sp_setint(env, "scheduler.threads", 0) == 0 );
+	t( sp_setstring(env, "log.path", st_r.conf->log_dir, 0) == 0 );
+	t( sp_setstring(env, "db", "test", 0) == 0 );
+	t( sp_setint(env, "db.test.compaction.cache", 0) == 0 );
+	t( sp_setint(env, "db.test.compaction.bloom_bits", bits) == 0 );
+	t( sp_setstring(env, "db.test.path", st_r.conf->db_dir, 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "key", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme.key", "u32,key(0)", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "value", 0) == 0 );
+	t( sp_setint(env, "db.test.sync", 0) == 0 );
+	t( sp_open(env) == 0 );
+	return env;
+}
+
+static void
+bloom_fill(void *env, void *db)
+{
+	/* even keys only */
+	uint32_t key = 0;
+	while (key < 2000) {
+		void *o = sp_document(db);
+		t( o != NULL );
+		t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+		t( sp_setstring(o, "value", &key, sizeof(key)) == 0 );
+		t( sp_set(db, o) == 0 );
+		key += 2;
+	}
+	t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+}
+
+static int
+bloom_get(void *db, uint32_t key)
+{
+	void *o = sp_document(db);
+	t( o != NULL );
+	t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+	o = sp_get(db, o);
+	if (o == NULL)
+		return 0;
+	t( *(uint32_t*)sp_getstring(o, "value", NULL) == key );
+	sp_destroy(o);
+	return 1;
+}
+
+static void
+bloom_miss(void)
+{
+	void *env = bloom_env(10);
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	bloom_fill(env, db);
+
+	int64_t read_disk = sp_getint(env, "db.test.index.read_disk");
+	uint32_t key = 1;
+	while (key < 2000) {
+		t( bloom_get(db, key) == 0 );
+		key += 2;
+	}
+	int64_t skip  = sp_getint(env, "db.test.stat.get_bloom_skip");
+	int64_t false_positive = sp_getint(env, "db.test.stat.get_bloom_false");
+	t( skip + false_positive == 1000 );
+	/* ~1% expected with 10 bits per key */
+	t( false_positive < 100 );
+	t( sp_getint(env, "db.test.index.read_disk") - read_disk == false_positive );
+
+	key = 0;
+	while (key < 2000) {
+		t( bloom_get(db, key) == 1 );
+		key += 2;
+	}
+	t( sp_getint(env, "db.test.stat.get_bloom_skip") == skip );
+	t( sp_getint(env, "db.test.stat.get_bloom_false") == false_positive );
+
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+bloom_delete(void)
+{
+	void *env = bloom_env(10);
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	bloom_fill(env, db);
+
+	uint32_t key = 0;
+	while (key < 2000) {
+		void *o = sp_document(db);
+		t( o != NULL );
+		t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+		t( sp_delete(db, o) == 0 );
+		key += 4;
+	}
+	t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+
+	key = 0;
+	while (key < 2000) {
+		t( bloom_get(db, key) == ((key % 4) != 0) );
+		key += 2;
+	}
+
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+bloom_recover(void)
+{
+	void *env = bloom_env(10);
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	bloom_fill(env, db);
+	t( sp_destroy(env) == 0 );
+
+	env = bloom_env(10);
+	db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	uint32_t key = 0;
+	while (key < 2000) {
+		t( bloom_get(db, key) == ((key % 2) == 0) );
+		key++;
+	}
+	t( sp_getint(env, "db.test.stat.get_bloom_skip") > 0 );
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+bloom_disabled(void)
+{
+	void *env = bloom_env(0);
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	bloom_fill(env, db);
+
+	uint32_t key = 0;
+	while (key < 2000) {
+		t( bloom_get(db, key) == ((key % 2) == 0) );
+		key++;
+	}
+	t( sp_getint(env, "db.test.stat.get_bloom_skip") == 0 );
+	t( sp_getint(env, "db.test.stat.get_bloom_false") == 0 );
+
+	t( sp_destroy(env) == 0 );
+}
+
+stgroup *bloom_group(void)
+{
+	stgroup *group = st_group("bloom");
+	st_groupadd(group, st_test("miss", bloom_miss));
+	st_groupadd(group, st_test("delete", bloom_delete));
+	st_groupadd(group, st_test("recover", bloom_recover));
+	st_groupadd(group, st_test("disabled", bloom_disabled));
+	return group;
+}
@@ -112,10 +112,225 @@ compact_test_directio(void)
 	t( sp_destroy(env) == 0 );
 }
 
+static void*
+compact_subcompaction_env(int subcompactions, int pipeline,
+                          char *compression, int direct_io)
+{
+	void *env = sp_env();
+	t( env != NULL );
+	t( sp_setstring(env, "sophia.path", st_r.conf->sophia_dir, 0) == 0 );
+	t( sp_setint(env, "scheduler.threads", 0) == 0 );
+	t( sp_setstring(env, "log.path", st_r.conf->log_dir, 0) == 0 );
+	t( sp_setint(env, "log.sync", 0) == 0 );
+	t( sp_setint(env, "log.rotate_sync", 0) == 0 );
+	t( sp_setstring(env, "db", "test", 0) == 0 );
+	t( sp_setint(env, "db.test.compaction.cache", 0) == 0 );
+	t( sp_setstring(env, "db.test.path", st_r.conf->db_dir, 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "key", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme.key", "u32,key(0)", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "value", 0) == 0 );
+	t( sp_setint(env, "db.test.sync", 0) == 0 );
+	t( sp_setint(env, "db.test.compaction.node_size", 256 * 1024) == 0 );
+	t( sp_setint(env, "db.test.compaction.page_size", 1024) == 0 );
+	t( sp_setint(env, "db.test.compaction.subcompactions", subcompactions) == 0 );
+	t( sp_setint(env, "db.test.compaction.pipeline", pipeline) == 0 );
+	if (compression)
+		t( sp_setstring(env, "db.test.compression", compression, 0) == 0 );
+	if (direct_io) {
+		t( sp_setint(env, "db.test.mmap", 0) == 0 );
+		t( sp_setint(env, "db.test.direct_io", 1) == 0 );
+	}
+	t( sp_open(env) == 0 );
+	return env;
+}
+
+static void
+compact_subcompaction_set(void *env, uint32_t count, uint32_t step, uint32_t value)
+{
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	uint32_t key = 0;
+	while (key < count) {
+		uint32_t v = key + value;
+		void *o = sp_document(db);
+		t( o != NULL );
+		t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+		t( sp_setstring(o, "value", &v, sizeof(v)) == 0 );
+		t( sp_set(db, o) == 0 );
+		key += step;
+	}
+	t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+}
+
+static void
+compact_subcompaction_check(void *env, uint32_t count, uint32_t value)
+{
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	void *c = sp_cursor(env);
+	t( c != NULL );
+	void *o = sp_document(db);
+	uint32_t key = 0;
+	while ((o = sp_get(c, o))) {
+		t( *(uint32_t*)sp_getstring(o, "key", NULL) == key );
+		t( *(uint32_t*)sp_getstring(o, "value", NULL) == key + value );
+		key++;
+	}
+	t( key == count );
+	t( sp_destroy(c) == 0 );
+}
+
+static void
+compact_subcompaction_run(int direct_io)
+{
+	/* create a single node, which covers the whole
+	 * key range */
+	void *env = compact_subcompaction_env(4, 0, NULL, direct_io);
+	compact_subcompaction_set(env, 100000, 50, 0);
+	t( sp_getint(env, "db.test.index.node_count") == 1 );
+
+	/* node stream is much larger than node_size, it
+	 * is split by page boundaries and merged by four
+	 * threads */
+	compact_subcompaction_set(env, 100000, 1, 7);
+	int64_t nodes = sp_getint(env, "db.test.index.node_count");
+	t( nodes > 4 );
+	compact_subcompaction_check(env, 100000, 7);
+	t( sp_destroy(env) == 0 );
+
+	env = compact_subcompaction_env(4, 0, NULL, direct_io);
+	t( sp_getint(env, "db.test.index.node_count") == nodes );
+	compact_subcompaction_check(env, 100000, 7);
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+compact_subcompaction(void)
+{
+	compact_subcompaction_run(0);
+}
+
+static void
+compact_subcompaction_directio(void)
+{
+	compact_subcompaction_run(1);
+}
+
+static void
+compact_subcompaction_error(void)
+{
+	void *env = compact_subcompaction_env(4, 0, NULL, 0);
+	compact_subcompaction_set(env, 100000, 50, 0);
+	t( sp_getint(env, "db.test.index.node_count") == 1 );
+
+	/* results of the first ranges are already joined
+	 * when the last one fails */
+	t( sp_setint(env, "debug.error_injection.si_compaction_5", 1) == 0 );
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	uint32_t key = 0;
+	while (key < 100000) {
+		uint32_t v = key + 7;
+		void *o = sp_document(db);
+		t( o != NULL );
+		t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+		t( sp_setstring(o, "value", &v, sizeof(v)) == 0 );
+		t( sp_set(db, o) == 0 );
+		key++;
+	}
+	t( sp_setint(env, "db.test.compaction.compact", 0) == -1 );
+	t( sp_destroy(env) == 0 );
+
+	/* recover the node and replay the log */
+	env = compact_subcompaction_env(4, 0, NULL, 0);
+	t( sp_getint(env, "db.test.index.node_count") == 1 );
+	compact_subcompaction_check(env, 100000, 7);
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+compact_pipeline_run(int subcompactions, char *compression, int direct_io)
+{
+	void *env = compact_subcompaction_env(subcompactions, 2, compression, direct_io);
+	compact_subcompaction_set(env, 100000, 1, 0);
+	compact_subcompaction_check(env, 100000, 0);
+	/* merge with the existing nodes */
+	compact_subcompaction_set(env, 100000, 1, 3);
+	int64_t nodes = sp_getint(env, "db.test.index.node_count");
+	t( nodes > 1 );
+	compact_subcompaction_check(env, 100000, 3);
+	t( sp_destroy(env) == 0 );
+
+	env = compact_subcompaction_env(subcompactions, 2, compression, direct_io);
+	t( sp_getint(env, "db.test.index.node_count") == nodes );
+	compact_subcompaction_check(env, 100000, 3);
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+compact_pipeline(void)
+{
+	compact_pipeline_run(1, NULL, 0);
+	rmrf(st_r.conf->sophia_dir);
+	rmrf(st_r.conf->log_dir);
+	rmrf(st_r.conf->db_dir);
+	compact_pipeline_run(1, "lz4", 0);
+}
+
+static void
+compact_pipeline_directio(void)
+{
+	compact_pipeline_run(1, "zstd", 1);
+}
+
+static void
+compact_pipeline_subcompaction(void)
+{
+	compact_pipeline_run(4, "lz4", 0);
+}
+
+static void
+compact_io_limit(void)
+{
+	void *env = compact_subcompaction_env(1, 0, NULL, 0);
+	t( sp_getint(env, "scheduler.io_limit") == 0 );
+	t( sp_getint(env, "scheduler.io_throttle") == 0 );
+	compact_subcompaction_set(env, 20000, 1, 0);
+	int64_t written = sp_getint(env, "scheduler.io_written");
+	t( written > 0 );
+	t( sp_getint(env, "scheduler.io_throttle") == 0 );
+
+	/* limit writes to a fraction of a second */
+	t( sp_setint(env, "scheduler.io_limit", written * 5) == 0 );
+	t( sp_setint(env, "scheduler.io_burst", 4096) == 0 );
+	t( sp_getint(env, "scheduler.io_limit") == written * 5 );
+	t( sp_getint(env, "scheduler.io_burst") == 4096 );
+	compact_subcompaction_set(env, 20000, 1, 1);
+	t( sp_getint(env, "scheduler.io_written") > written );
+	t( sp_getint(env, "scheduler.io_throttle") > 0 );
+	t( sp_getint(env, "scheduler.io_throttle_wait") > 50000 );
+	compact_subcompaction_check(env, 20000, 1);
+
+	t( sp_setint(env, "scheduler.io_limit", -1) == -1 );
+	t( sp_setint(env, "scheduler.io_limit", 0) == 0 );
+	int64_t throttle = sp_getint(env, "scheduler.io_throttle");
+	compact_subcompaction_set(env, 20000, 1, 2);
+	t( sp_getint(env, "scheduler.io_throttle") == throttle );
+	compact_subcompaction_check(env, 20000, 2);
+	t( sp_destroy(env) == 0 );
+}
+
 stgroup *compact_group(void)
 {
 	stgroup *group = st_group("compact");
 	st_groupadd(group, st_test("test", compact_test));
 	st_groupadd(group, st_test("test_direct_io", compact_test_directio));
+	st_groupadd(group, st_test("subcompaction", compact_subcompaction));
+	st_groupadd(group, st_test("subcompaction_direct_io", compact_subcompaction_directio));
+	st_groupadd(group, st_test("subcompaction_error", compact_subcompaction_error));
+	st_groupadd(group, st_test("pipeline", compact_pipeline));
+	st_groupadd(group, st_test("pipeline_direct_io", compact_pipeline_directio));
+	st_groupadd(group, st_test("pipeline_subcompaction", compact_pipeline_subcompaction));
+	st_groupadd(group, st_test("io_limit", compact_io_limit));
 	return group;
 }
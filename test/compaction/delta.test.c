@@ -0,0 +1,273 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <sophia.h>
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+#include <libsv.h>
+#include <libsd.h>
+#include <libst.h>
+
+#define DELTA_COUNT 2000
+
+static void
+delta_db(void *env, char *name, int delta, int prefix, char *compression,
+         int mmap)
+{
+	char path[64];
+	t( sp_setstring(env, "db", name, 0) == 0 );
+	snprintf(path, sizeof(path), "db.%s.scheme", name);
+	t( sp_setstring(env, path, "key", 0) == 0 );
+	t( sp_setstring(env, path, "value", 0) == 0 );
+	snprintf(path, sizeof(path), "db.%s.scheme.key", name);
+	t( sp_setstring(env, path, "string,key(0)", 0) == 0 );
+	snprintf(path, sizeof(path), "db.%s.sync", name);
+	t( sp_setint(env, path, 0) == 0 );
+	snprintf(path, sizeof(path), "db.%s.mmap", name);
+	t( sp_setint(env, path, mmap) == 0 );
+	snprintf(path, sizeof(path), "db.%s.compression", name);
+	t( sp_setstring(env, path, compression, 0) == 0 );
+	snprintf(path, sizeof(path), "db.%s.compaction.cache", name);
+	t( sp_setint(env, path, 0) == 0 );
+	snprintf(path, sizeof(path), "db.%s.compaction.page_size", name);
+	t( sp_setint(env, path, 1024) == 0 );
+	snprintf(path, sizeof(path), "db.%s.compaction.page_delta", name);
+	t( sp_setint(env, path, delta) == 0 );
+	snprintf(path, sizeof(path), "db.%s.compaction.page_prefix", name);
+	t( sp_setint(env, path, prefix) == 0 );
+}
+
+static void*
+delta_env(char *compression, int mmap, int prefix)
+{
+	void *env = sp_env();
+	t( env != NULL );
+	t( sp_setstring(env, "sophia.path", st_r.conf->sophia_dir, 0) == 0 );
+	t( sp_setint(env, "scheduler.threads", 0) == 0 );
+	t( sp_setstring(env, "log.path", st_r.conf->log_dir, 0) == 0 );
+	t( sp_setint(env, "log.sync", 0) == 0 );
+	t( sp_setint(env, "log.rotate_sync", 0) == 0 );
+	delta_db(env, "test", 1, prefix, compression, mmap);
+	delta_db(env, "ref", 0, prefix, compression, mmap);
+	t( sp_open(env) == 0 );
+	return env;
+}
+
+static int
+delta_key(char *key, uint32_t id)
+{
+	/* keys share long prefixes with the neighbours */
+	return snprintf(key, 64, "/usr/share/doc/package-%04d/file-%02d",
+	                id / 16, id % 16);
+}
+
+static void
+delta_set(void *env, char *name, uint32_t from, uint32_t to)
+{
+	void *db = sp_getobject(env, name);
+	t( db != NULL );
+	uint32_t id = from;
+	while (id < to) {
+		char key[64];
+		int size = delta_key(key, id);
+		void *o = sp_document(db);
+		t( o != NULL );
+		t( sp_setstring(o, "key", key, size) == 0 );
+		t( sp_setstring(o, "value", &id, sizeof(id)) == 0 );
+		t( sp_set(db, o) == 0 );
+		id++;
+	}
+}
+
+static void
+delta_check(void *env, char *name)
+{
+	void *db = sp_getobject(env, name);
+	t( db != NULL );
+	void *c = sp_cursor(env);
+	t( c != NULL );
+	void *o = sp_document(db);
+	uint32_t id = 0;
+	while ((o = sp_get(c, o))) {
+		char key[64];
+		int size = delta_key(key, id);
+		int key_size = 0;
+		char *ptr = sp_getstring(o, "key", &key_size);
+		t( key_size == size );
+		t( memcmp(ptr, key, size) == 0 );
+		t( *(uint32_t*)sp_getstring(o, "value", NULL) == id );
+		id++;
+	}
+	t( id == DELTA_COUNT );
+	t( sp_destroy(c) == 0 );
+
+	id = 0;
+	while (id < DELTA_COUNT) {
+		char key[64];
+		int size = delta_key(key, id);
+		o = sp_document(db);
+		t( o != NULL );
+		t( sp_setstring(o, "key", key, size) == 0 );
+		o = sp_get(db, o);
+		t( o != NULL );
+		t( *(uint32_t*)sp_getstring(o, "value", NULL) == id );
+		sp_destroy(o);
+		id += 7;
+	}
+}
+
+static void
+delta_run(char *compression, int mmap, int prefix)
+{
+	void *env = delta_env(compression, mmap, prefix);
+	delta_set(env, "db.test", 0, DELTA_COUNT / 2);
+	delta_set(env, "db.ref",  0, DELTA_COUNT / 2);
+	t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+	t( sp_setint(env, "db.ref.compaction.compact", 0) == 0 );
+
+	/* merge with the encoded pages */
+	delta_set(env, "db.test", DELTA_COUNT / 2, DELTA_COUNT);
+	delta_set(env, "db.ref",  DELTA_COUNT / 2, DELTA_COUNT);
+	t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+	t( sp_setint(env, "db.ref.compaction.compact", 0) == 0 );
+	delta_check(env, "db.test");
+	delta_check(env, "db.ref");
+
+	int64_t size = sp_getint(env, "db.test.index.size");
+	int64_t size_ref = sp_getint(env, "db.ref.index.size");
+	t( size < size_ref );
+	t( sp_getint(env, "db.test.index.size_uncompressed") ==
+	   sp_getint(env, "db.ref.index.size_uncompressed") );
+	t( sp_destroy(env) == 0 );
+
+	env = delta_env(compression, mmap, prefix);
+	delta_check(env, "db.test");
+	delta_check(env, "db.ref");
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+delta_page(void)
+{
+	delta_run("none", 0, 0);
+}
+
+static void
+delta_mmap(void)
+{
+	delta_run("none", 1, 0);
+}
+
+static void
+delta_compression(void)
+{
+	delta_run("lz4", 0, 0);
+}
+
+static void
+delta_compression_mmap(void)
+{
+	delta_run("zstd", 1, 0);
+}
+
+static void
+delta_prefix(void)
+{
+	delta_run("none", 0, 1);
+}
+
+static void
+delta_prefix_mmap(void)
+{
+	delta_run("none", 1, 1);
+}
+
+static void
+delta_prefix_compression(void)
+{
+	delta_run("lz4", 0, 1);
+}
+
+static void
+delta_normalize(void)
+{
+	void *env = sp_env();
+	t( env != NULL );
+	t( sp_setstring(env, "sophia.path", st_r.conf->sophia_dir, 0) == 0 );
+	t( sp_setint(env, "scheduler.threads", 0) == 0 );
+	t( sp_setstring(env, "log.path", st_r.conf->log_dir, 0) == 0 );
+	t( sp_setstring(env, "db", "test", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "a", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "b", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme.a", "u32,key(0)", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme.b", "u32,key(1)", 0) == 0 );
+	t( sp_setint(env, "db.test.sync", 0) == 0 );
+	t( sp_setint(env, "db.test.compaction.page_size", 1024) == 0 );
+	t( sp_setint(env, "db.test.compaction.page_delta", 1) == 0 );
+	t( sp_setint(env, "db.test.key_normalize", 1) == 0 );
+	t( sp_open(env) == 0 );
+
+	void *db = sp_getobject(env, "db.test");
+	uint32_t a, b;
+	for (a = 0; a < 4; a++) {
+		for (b = 0; b < 500; b++) {
+			void *o = sp_document(db);
+			t( sp_setstring(o, "a", &a, sizeof(a)) == 0 );
+			t( sp_setstring(o, "b", &b, sizeof(b)) == 0 );
+			t( sp_set(db, o) == 0 );
+		}
+	}
+	t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+
+	void *c = sp_cursor(env);
+	t( c != NULL );
+	void *o = sp_document(db);
+	uint32_t n = 0;
+	while ((o = sp_get(c, o))) {
+		t( *(uint32_t*)sp_getstring(o, "a", NULL) == n / 500 );
+		t( *(uint32_t*)sp_getstring(o, "b", NULL) == n % 500 );
+		n++;
+	}
+	t( n == 2000 );
+	t( sp_destroy(c) == 0 );
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+delta_scheme(void)
+{
+	/* fixed size keys are not encoded */
+	void *env = sp_env();
+	t( env != NULL );
+	t( sp_setstring(env, "sophia.path", st_r.conf->sophia_dir, 0) == 0 );
+	t( sp_setint(env, "scheduler.threads", 0) == 0 );
+	t( sp_setstring(env, "log.path", st_r.conf->log_dir, 0) == 0 );
+	t( sp_setstring(env, "db", "test", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "key", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme.key", "u32,key(0)", 0) == 0 );
+	t( sp_setint(env, "db.test.compaction.page_delta", 1) == 0 );
+	t( sp_open(env) == -1 );
+	t( sp_destroy(env) == 0 );
+}
+
+stgroup *delta_group(void)
+{
+	stgroup *group = st_group("delta");
+	st_groupadd(group, st_test("page", delta_page));
+	st_groupadd(group, st_test("mmap", delta_mmap));
+	st_groupadd(group, st_test("compression", delta_compression));
+	st_groupadd(group, st_test("compression_mmap", delta_compression_mmap));
+	st_groupadd(group, st_test("prefix", delta_prefix));
+	st_groupadd(group, st_test("prefix_mmap", delta_prefix_mmap));
+	st_groupadd(group, st_test("prefix_compression", delta_prefix_compression));
+	st_groupadd(group, st_test("normalize", delta_normalize));
+	st_groupadd(group, st_test("scheme", delta_scheme));
+	return group;
+}
@@ -227,11 +227,92 @@ log_recover1(void)
 	t( sp_destroy(env) == 0 );
 }
 
+static void*
+log_async_env(void)
+{
+	void *env = sp_env();
+	t( env != NULL );
+	t( sp_setstring(env, "sophia.path", st_r.conf->sophia_dir, 0) == 0 );
+	t( sp_setint(env, "scheduler.threads", 0) == 0 );
+	t( sp_setstring(env, "log.path", st_r.conf->log_dir, 0) == 0 );
+	t( sp_setint(env, "log.async", 1) == 0 );
+	t( sp_setint(env, "log.async_interval", 100000) == 0 );
+	t( sp_setstring(env, "db", "test", 0) == 0 );
+	t( sp_setstring(env, "db.test.path", st_r.conf->db_dir, 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "key", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme.key", "u32,key(0)", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "value", 0) == 0 );
+	t( sp_setint(env, "db.test.sync", 0) == 0 );
+	t( sp_open(env) == 0 );
+	return env;
+}
+
+static void
+log_async(void)
+{
+	void *env = log_async_env();
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+
+	int key = 0;
+	while (key < 20) {
+		void *o = sp_document(db);
+		t( o != NULL );
+		t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+		t( sp_setstring(o, "value", &key, sizeof(key)) == 0 );
+		t( sp_set(db, o) == 0 );
+		key++;
+	}
+	int64_t lsn = sp_getint(env, "metric.lsn");
+	t( sp_getint(env, "metric.lsn_durable") < lsn );
+	t( sp_setint(env, "log.wait", lsn) == 0 );
+	t( sp_getint(env, "metric.lsn_durable") == lsn );
+
+	/* flushed on rotation and shutdown */
+	while (key < 40) {
+		void *o = sp_document(db);
+		t( o != NULL );
+		t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+		t( sp_setstring(o, "value", &key, sizeof(key)) == 0 );
+		t( sp_set(db, o) == 0 );
+		key++;
+	}
+	t( sp_setint(env, "log.rotate", 0) == 0 );
+	t( sp_getint(env, "metric.lsn_durable") == 40 );
+	while (key < 60) {
+		void *o = sp_document(db);
+		t( o != NULL );
+		t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+		t( sp_setstring(o, "value", &key, sizeof(key)) == 0 );
+		t( sp_set(db, o) == 0 );
+		key++;
+	}
+	t( sp_destroy(env) == 0 );
+
+	env = log_async_env();
+	db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	t( sp_getint(env, "metric.lsn_durable") == 60 );
+	key = 0;
+	while (key < 60) {
+		void *o = sp_document(db);
+		t( o != NULL );
+		t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+		o = sp_get(db, o);
+		t( o != NULL );
+		t( *(int*)sp_getstring(o, "value", NULL) == key );
+		sp_destroy(o);
+		key++;
+	}
+	t( sp_destroy(env) == 0 );
+}
+
 stgroup *log_group(void)
 {
 	stgroup *group = st_group("log");
 	st_groupadd(group, st_test("gc", log_gc));
 	st_groupadd(group, st_test("recover0", log_recover0));
 	st_groupadd(group, st_test("recover1", log_recover1));
+	st_groupadd(group, st_test("async", log_async));
 	return group;
 }
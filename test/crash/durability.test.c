@@ -846,6 +846,11 @@ durability_gc0(void)
 	t( exists(st_r.conf->db_dir, "00000000000000000001.db") == 1 );
 	t( touch(st_r.conf->db_dir, "00000000000000000002.db.gc") == 0 );
 
+	/* file is unknown to manifest, scan directory */
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/manifest", st_r.conf->db_dir);
+	t( unlink(path) == 0 );
+
 	/* recover */
 	env = sp_env();
 	t( env != NULL );
@@ -871,6 +876,201 @@ durability_gc0(void)
 	t( exists(st_r.conf->db_dir, "00000000000000000002.db") == 0 );
 }
 
+static int durability_manifest_mismatch = 0;
+
+static void
+durability_manifest_log(char *trace, void *arg ssunused)
+{
+	if (strstr(trace, "does not match"))
+		durability_manifest_mismatch++;
+}
+
+static void*
+durability_manifest_env(void)
+{
+	void *env = sp_env();
+	t( env != NULL );
+	t( sp_setstring(env, "sophia.path", st_r.conf->sophia_dir, 0) == 0 );
+	t( sp_setstring(env, "sophia.on_log", (char*)(uintptr_t)durability_manifest_log, 0) == 0 );
+	t( sp_setint(env, "scheduler.threads", 0) == 0 );
+	t( sp_setstring(env, "log.path", st_r.conf->log_dir, 0) == 0 );
+	t( sp_setint(env, "log.sync", 0) == 0 );
+	t( sp_setint(env, "log.rotate_sync", 0) == 0 );
+	t( sp_setstring(env, "db", "test", 0) == 0 );
+	t( sp_setint(env, "db.test.compaction.cache", 0) == 0 );
+	t( sp_setstring(env, "db.test.path", st_r.conf->db_dir, 0) == 0 );
+	t( sp_setint(env, "db.test.sync", 0) == 0 );
+	t( sp_setint(env, "db.test.compaction.node_size", 4096) == 0 );
+	t( sp_setint(env, "db.test.compaction.page_size", 1024) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "key", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme.key", "u32,key(0)", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "value", 0) == 0 );
+	return env;
+}
+
+static void
+durability_manifest_check(void *env, int count)
+{
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	void *o = sp_document(db);
+	t( sp_setstring(o, "order", ">=", 0) == 0 );
+	void *c = sp_cursor(env);
+	t( c != NULL );
+	int i = 0;
+	while ((o = sp_get(c, o))) {
+		t( *(int*)sp_getstring(o, "key", NULL) == i );
+		i++;
+	}
+	t( i == count );
+	t( sp_destroy(c) == 0 );
+}
+
+static void
+durability_manifest0(void)
+{
+	durability_manifest_mismatch = 0;
+	void *env = durability_manifest_env();
+	t( sp_open(env) == 0 );
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	int i = 0;
+	while (i < 1000) {
+		void *o = sp_document(db);
+		t( sp_setstring(o, "key", &i, sizeof(i)) == 0 );
+		t( sp_setstring(o, "value", &i, sizeof(i)) == 0 );
+		t( sp_set(db, o) == 0 );
+		i++;
+	}
+	t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+	t( sp_getint(env, "db.test.index.node_count") > 1 );
+	t( sp_destroy(env) == 0 );
+	t( exists(st_r.conf->db_dir, "manifest") == 1 );
+
+	/* recover from manifest */
+	env = durability_manifest_env();
+	t( sp_open(env) == 0 );
+	durability_manifest_check(env, 1000);
+	t( sp_destroy(env) == 0 );
+	t( durability_manifest_mismatch == 0 );
+}
+
+static void
+durability_manifest1(void)
+{
+	durability_manifest_mismatch = 0;
+	void *env = durability_manifest_env();
+	t( sp_open(env) == 0 );
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	int i = 0;
+	while (i < 1000) {
+		void *o = sp_document(db);
+		t( sp_setstring(o, "key", &i, sizeof(i)) == 0 );
+		t( sp_setstring(o, "value", &i, sizeof(i)) == 0 );
+		t( sp_set(db, o) == 0 );
+		i++;
+	}
+	t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+	t( sp_destroy(env) == 0 );
+
+	/* corrupt manifest tail */
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/manifest", st_r.conf->db_dir);
+	FILE *f = fopen(path, "a");
+	t( f != NULL );
+	t( fwrite("garbage", 1, 7, f) == 7 );
+	fclose(f);
+
+	/* recover by directory scan */
+	env = durability_manifest_env();
+	t( sp_open(env) == 0 );
+	durability_manifest_check(env, 1000);
+	t( sp_destroy(env) == 0 );
+	t( durability_manifest_mismatch == 1 );
+
+	/* manifest is rewritten */
+	env = durability_manifest_env();
+	t( sp_open(env) == 0 );
+	durability_manifest_check(env, 1000);
+	t( sp_destroy(env) == 0 );
+	t( durability_manifest_mismatch == 1 );
+}
+
+static void
+durability_manifest_set(void *db, int from, int to)
+{
+	int i = from;
+	while (i < to) {
+		void *o = sp_document(db);
+		t( sp_setstring(o, "key", &i, sizeof(i)) == 0 );
+		t( sp_setstring(o, "value", &i, sizeof(i)) == 0 );
+		t( sp_set(db, o) == 0 );
+		i++;
+	}
+}
+
+static void
+durability_manifest2(void)
+{
+	durability_manifest_mismatch = 0;
+	void *env = durability_manifest_env();
+	t( sp_open(env) == 0 );
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	durability_manifest_set(db, 0, 1000);
+	t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+
+	/* compaction is interrupted after manifest update */
+	durability_manifest_set(db, 1000, 2000);
+	t( sp_setint(env, "debug.error_injection.si_compaction_4", 1) == 0 );
+	t( sp_setint(env, "db.test.compaction.compact", 0) == -1 );
+	t( sp_destroy(env) == 0 );
+
+	/* recover by directory scan */
+	env = durability_manifest_env();
+	t( sp_open(env) == 0 );
+	durability_manifest_check(env, 2000);
+	t( sp_destroy(env) == 0 );
+	t( durability_manifest_mismatch == 1 );
+
+	env = durability_manifest_env();
+	t( sp_open(env) == 0 );
+	durability_manifest_check(env, 2000);
+	t( sp_destroy(env) == 0 );
+	t( durability_manifest_mismatch == 1 );
+}
+
+static void
+durability_manifest3(void)
+{
+	durability_manifest_mismatch = 0;
+	void *env = durability_manifest_env();
+	t( sp_open(env) == 0 );
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	durability_manifest_set(db, 0, 1000);
+	t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+	t( sp_setint(env, "log.rotate", 0) == 0 );
+	t( sp_setint(env, "log.gc", 0) == 0 );
+	t( sp_destroy(env) == 0 );
+
+	/* node files are not opened during recovery */
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/00000000000000000002.db",
+	         st_r.conf->db_dir);
+	t( unlink(path) == 0 );
+	env = durability_manifest_env();
+	t( sp_open(env) == 0 );
+	t( durability_manifest_mismatch == 0 );
+	db = sp_getobject(env, "db.test");
+	void *o = sp_document(db);
+	int key = 0;
+	t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+	t( sp_get(db, o) == NULL );
+	sp_destroy(env);
+}
+
 stgroup *durability_group(void)
 {
 	stgroup *group = st_group("durability");
@@ -885,5 +1085,9 @@ stgroup *durability_group(void)
 	st_groupadd(group, st_test("compact_case6", durability_compact6));
 	st_groupadd(group, st_test("compact_case7", durability_compact7));
 	st_groupadd(group, st_test("gc0", durability_gc0));
+	st_groupadd(group, st_test("manifest_case0", durability_manifest0));
+	st_groupadd(group, st_test("manifest_case1", durability_manifest1));
+	st_groupadd(group, st_test("manifest_case2", durability_manifest2));
+	st_groupadd(group, st_test("manifest_case3", durability_manifest3));
 	return group;
 }
@@ -0,0 +1,161 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <sophia.h>
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+#include <libsv.h>
+#include <libsd.h>
+#include <libst.h>
+
+#define RECOVER_BENCH_DB    4
+#define RECOVER_BENCH_COUNT 50000
+
+static void*
+recover_bench_env(int threads)
+{
+	void *env = sp_env();
+	t( env != NULL );
+	t( sp_setstring(env, "sophia.path", st_r.conf->sophia_dir, 0) == 0 );
+	t( sp_setint(env, "scheduler.threads", 0) == 0 );
+	t( sp_setstring(env, "log.path", st_r.conf->log_dir, 0) == 0 );
+	t( sp_setint(env, "log.sync", 0) == 0 );
+	t( sp_setint(env, "log.rotate_sync", 0) == 0 );
+	t( sp_setint(env, "log.recover_threads", threads) == 0 );
+	int i = 0;
+	while (i < RECOVER_BENCH_DB) {
+		char name[32];
+		char path[64];
+		snprintf(name, sizeof(name), "test%d", i);
+		t( sp_setstring(env, "db", name, 0) == 0 );
+		snprintf(path, sizeof(path), "db.%s.scheme", name);
+		t( sp_setstring(env, path, "key", 0) == 0 );
+		snprintf(path, sizeof(path), "db.%s.scheme.key", name);
+		t( sp_setstring(env, path, "u32,key(0)", 0) == 0 );
+		snprintf(path, sizeof(path), "db.%s.scheme", name);
+		t( sp_setstring(env, path, "value", 0) == 0 );
+		snprintf(path, sizeof(path), "db.%s.scheme.value", name);
+		t( sp_setstring(env, path, "u32", 0) == 0 );
+		snprintf(path, sizeof(path), "db.%s.sync", name);
+		t( sp_setint(env, path, 0) == 0 );
+		i++;
+	}
+	return env;
+}
+
+static void*
+recover_bench_db(void *env, int id)
+{
+	char path[32];
+	snprintf(path, sizeof(path), "db.test%d", id);
+	void *db = sp_getobject(env, path);
+	t( db != NULL );
+	return db;
+}
+
+static void
+recover_bench_fill(void)
+{
+	void *env = recover_bench_env(1);
+	t( sp_open(env) == 0 );
+	void *db[RECOVER_BENCH_DB];
+	int i = 0;
+	while (i < RECOVER_BENCH_DB) {
+		db[i] = recover_bench_db(env, i);
+		i++;
+	}
+	/* interleave databases in multi-statement transactions,
+	 * overwrite and delete some of the keys */
+	uint32_t key = 0;
+	while (key < RECOVER_BENCH_COUNT) {
+		void *tx = sp_begin(env);
+		t( tx != NULL );
+		i = 0;
+		while (i < RECOVER_BENCH_DB) {
+			uint32_t value = key + i;
+			void *o = sp_document(db[i]);
+			t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+			t( sp_setstring(o, "value", &value, sizeof(value)) == 0 );
+			t( sp_set(tx, o) == 0 );
+			i++;
+		}
+		t( sp_commit(tx) == 0 );
+		if (key > 0 && (key % 10) == 0) {
+			uint32_t prev = key - 1;
+			void *o = sp_document(db[key % RECOVER_BENCH_DB]);
+			t( sp_setstring(o, "key", &prev, sizeof(prev)) == 0 );
+			t( sp_delete(db[key % RECOVER_BENCH_DB], o) == 0 );
+		}
+		key++;
+	}
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+recover_bench_check(void *env, int id)
+{
+	void *db = recover_bench_db(env, id);
+	uint32_t key = 0;
+	while (key < RECOVER_BENCH_COUNT) {
+		void *o = sp_document(db);
+		t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+		o = sp_get(db, o);
+		uint32_t next = key + 1;
+		int deleted = (next < RECOVER_BENCH_COUNT) && (next % 10) == 0 &&
+		              (int)(next % RECOVER_BENCH_DB) == id;
+		if (deleted) {
+			t( o == NULL );
+		} else {
+			t( o != NULL );
+			t( *(uint32_t*)sp_getstring(o, "value", NULL) == key + id );
+			sp_destroy(o);
+		}
+		key++;
+	}
+}
+
+static void
+recover_bench_run(int threads)
+{
+	void *env = recover_bench_env(threads);
+	uint64_t start = ss_utime();
+	t( sp_open(env) == 0 );
+	uint64_t time_us = ss_utime() - start;
+	if (time_us == 0)
+		time_us = 1;
+	int i = 0;
+	while (i < RECOVER_BENCH_DB) {
+		recover_bench_check(env, i);
+		i++;
+	}
+	t( sp_destroy(env) == 0 );
+	if (! st_r.verbose)
+		return;
+	uint64_t records = (uint64_t)RECOVER_BENCH_COUNT * RECOVER_BENCH_DB;
+	uint64_t rps = records * 1000000 / time_us;
+	printf("\n    (recover) threads: %2d rps: %" PRIu64, threads, rps);
+	fflush(NULL);
+}
+
+static void
+recover_bench(void)
+{
+	recover_bench_fill();
+	recover_bench_run(1);
+	recover_bench_run(2);
+	recover_bench_run(4);
+}
+
+stgroup *recover_bench_group(void)
+{
+	stgroup *group = st_group("recover_bench");
+	st_groupadd(group, st_test("test0", recover_bench));
+	return group;
+}
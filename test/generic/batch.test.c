@@ -0,0 +1,311 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <sophia.h>
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+#include <libsv.h>
+#include <libsd.h>
+#include <libst.h>
+
+static void*
+batch_env(void)
+{
+	void *env = sp_env();
+	t( env != NULL );
+	t( sp_setstring(env, "sophia.path", st_r.conf->sophia_dir, 0) == 0 );
+	t( sp_setint(env, "scheduler.threads", 0) == 0 );
+	t( sp_setstring(env, "log.path", st_r.conf->log_dir, 0) == 0 );
+	t( sp_setstring(env, "db", "test", 0) == 0 );
+	t( sp_setstring(env, "db.test.path", st_r.conf->db_dir, 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "key", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme.key", "u32,key(0)", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "value", 0) == 0 );
+	t( sp_setint(env, "db.test.sync", 0) == 0 );
+	t( sp_setstring(env, "db", "test2", 0) == 0 );
+	t( sp_setstring(env, "db.test2.path", st_r.conf->db_dir, 0) == 0 );
+	t( sp_setstring(env, "db.test2.scheme", "key", 0) == 0 );
+	t( sp_setstring(env, "db.test2.scheme.key", "u32,key(0)", 0) == 0 );
+	t( sp_setstring(env, "db.test2.scheme", "value", 0) == 0 );
+	t( sp_setint(env, "db.test2.sync", 0) == 0 );
+	t( sp_open(env) == 0 );
+	return env;
+}
+
+static void
+batch_get(void *db, uint32_t key, int exists, uint32_t value)
+{
+	void *o = sp_document(db);
+	t( o != NULL );
+	t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+	o = sp_get(db, o);
+	if (! exists) {
+		t( o == NULL );
+		return;
+	}
+	t( o != NULL );
+	t( *(uint32_t*)sp_getstring(o, "value", NULL) == value );
+	sp_destroy(o);
+}
+
+static void
+batch_set(void *batch, void *db, uint32_t key, uint32_t value)
+{
+	void *o = sp_document(db);
+	t( o != NULL );
+	t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+	t( sp_setstring(o, "value", &value, sizeof(value)) == 0 );
+	t( sp_set(batch, o) == 0 );
+}
+
+static void
+batch_commit(void)
+{
+	rmrf(st_r.conf->sophia_dir);
+	rmrf(st_r.conf->log_dir);
+	rmrf(st_r.conf->db_dir);
+	void *env = batch_env();
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+
+	void *batch = sp_batch(env);
+	t( batch != NULL );
+	uint32_t key = 0;
+	while (key < 1000) {
+		batch_set(batch, db, key, key);
+		key++;
+	}
+	/* not visible before commit */
+	batch_get(db, 0, 0, 0);
+	int64_t lsn = sp_getint(env, "metric.lsn");
+	t( sp_commit(batch) == 0 );
+	t( sp_getint(env, "metric.lsn") == lsn + 1 );
+	t( sp_getint(env, "db.test.index.count") == 1000 );
+
+	key = 0;
+	while (key < 1000) {
+		batch_get(db, key, 1, key);
+		key++;
+	}
+	t( sp_destroy(env) == 0 );
+
+	/* recover */
+	env = batch_env();
+	db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	key = 0;
+	while (key < 1000) {
+		batch_get(db, key, 1, key);
+		key++;
+	}
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+batch_multi_db(void)
+{
+	rmrf(st_r.conf->sophia_dir);
+	rmrf(st_r.conf->log_dir);
+	rmrf(st_r.conf->db_dir);
+	void *env = batch_env();
+	void *db = sp_getobject(env, "db.test");
+	void *db2 = sp_getobject(env, "db.test2");
+	t( db != NULL );
+	t( db2 != NULL );
+
+	void *batch = sp_batch(env);
+	t( batch != NULL );
+	batch_set(batch, db, 1, 1);
+	batch_set(batch, db2, 1, 2);
+	batch_set(batch, db, 2, 3);
+	batch_set(batch, db2, 2, 4);
+	void *o = sp_document(db);
+	uint32_t key = 7;
+	t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+	t( sp_delete(batch, o) == 0 );
+	t( sp_commit(batch) == 0 );
+
+	batch_get(db, 1, 1, 1);
+	batch_get(db, 2, 1, 3);
+	batch_get(db2, 1, 1, 2);
+	batch_get(db2, 2, 1, 4);
+	batch_get(db, 7, 0, 0);
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+batch_duplicate(void)
+{
+	rmrf(st_r.conf->sophia_dir);
+	rmrf(st_r.conf->log_dir);
+	rmrf(st_r.conf->db_dir);
+	void *env = batch_env();
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+
+	void *batch = sp_batch(env);
+	t( batch != NULL );
+	batch_set(batch, db, 1, 1);
+	batch_set(batch, db, 1, 2);
+	batch_set(batch, db, 1, 3);
+	void *o = sp_document(db);
+	uint32_t key = 2;
+	t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+	t( sp_delete(batch, o) == 0 );
+	batch_set(batch, db, 2, 4);
+	t( sp_commit(batch) == 0 );
+	t( sp_getint(env, "db.test.index.count") == 2 );
+
+	batch_get(db, 1, 1, 3);
+	batch_get(db, 2, 1, 4);
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+batch_rollback(void)
+{
+	rmrf(st_r.conf->sophia_dir);
+	rmrf(st_r.conf->log_dir);
+	rmrf(st_r.conf->db_dir);
+	void *env = batch_env();
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+
+	void *batch = sp_batch(env);
+	t( batch != NULL );
+	batch_set(batch, db, 1, 1);
+	batch_set(batch, db, 2, 2);
+	t( sp_destroy(batch) == 0 );
+	batch_get(db, 1, 0, 0);
+	batch_get(db, 2, 0, 0);
+
+	/* empty batch */
+	batch = sp_batch(env);
+	t( batch != NULL );
+	t( sp_commit(batch) == 0 );
+	t( sp_getint(env, "db.test.index.count") == 0 );
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+batch_conflict(void)
+{
+	rmrf(st_r.conf->sophia_dir);
+	rmrf(st_r.conf->log_dir);
+	rmrf(st_r.conf->db_dir);
+	void *env = batch_env();
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+
+	void *tx = sp_begin(env);
+	t( tx != NULL );
+	batch_set(tx, db, 1, 1);
+
+	/* key is locked by the active transaction */
+	void *batch = sp_batch(env);
+	t( batch != NULL );
+	batch_set(batch, db, 1, 2);
+	batch_set(batch, db, 2, 2);
+	t( sp_commit(batch) == 1 );
+	batch_get(db, 2, 0, 0);
+
+	t( sp_commit(tx) == 0 );
+	batch_get(db, 1, 1, 1);
+
+	/* no conflict with a transaction which started later */
+	tx = sp_begin(env);
+	t( tx != NULL );
+	batch_set(tx, db, 3, 1);
+	batch = sp_batch(env);
+	t( batch != NULL );
+	batch_set(batch, db, 1, 2);
+	t( sp_commit(batch) == 0 );
+	t( sp_commit(tx) == 0 );
+	batch_get(db, 1, 1, 2);
+	batch_get(db, 3, 1, 1);
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+batch_memory_limit(void)
+{
+	rmrf(st_r.conf->sophia_dir);
+	rmrf(st_r.conf->log_dir);
+	rmrf(st_r.conf->db_dir);
+	void *env = batch_env();
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	t( sp_setint(env, "memory.limit", 64 * 1024) == 0 );
+	t( sp_setint(env, "memory.stall_max", 0) == 0 );
+
+	/* no background threads, batch commit fails
+	 * once the limit is reached */
+	uint32_t key = 0;
+	int64_t used = 0;
+	int rc = 0;
+	while (key < 100000) {
+		void *batch = sp_batch(env);
+		t( batch != NULL );
+		uint32_t i = 0;
+		while (i < 100) {
+			batch_set(batch, db, key + i, key + i);
+			i++;
+		}
+		used = sp_getint(env, "memory.used");
+		rc = sp_commit(batch);
+		if (rc == -1)
+			break;
+		t( rc == 0 );
+		key += 100;
+	}
+	t( rc == -1 );
+	t( key > 0 );
+	t( used >= 64 * 1024 );
+	t( sp_getint(env, "memory.stall_error") == 1 );
+	batch_get(db, key, 0, 0);
+
+	/* deletes are not limited */
+	void *batch = sp_batch(env);
+	t( batch != NULL );
+	void *o = sp_document(db);
+	uint32_t id = 0;
+	t( sp_setstring(o, "key", &id, sizeof(id)) == 0 );
+	t( sp_delete(batch, o) == 0 );
+	t( sp_commit(batch) == 0 );
+	batch_get(db, 0, 0, 0);
+
+	/* compaction releases memory, batch is retried */
+	int n = 0;
+	while (sp_getint(env, "memory.used") >= 64 * 1024 && n < 100) {
+		t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+		n++;
+	}
+	t( sp_getint(env, "memory.used") < 64 * 1024 );
+	batch = sp_batch(env);
+	t( batch != NULL );
+	batch_set(batch, db, key, key);
+	t( sp_commit(batch) == 0 );
+	batch_get(db, key, 1, key);
+	batch_get(db, 1, 1, 1);
+	t( sp_getint(env, "memory.stall_error") == 1 );
+	t( sp_destroy(env) == 0 );
+}
+
+stgroup *batch_group(void)
+{
+	stgroup *group = st_group("batch");
+	st_groupadd(group, st_test("commit", batch_commit));
+	st_groupadd(group, st_test("multi_db", batch_multi_db));
+	st_groupadd(group, st_test("duplicate", batch_duplicate));
+	st_groupadd(group, st_test("rollback", batch_rollback));
+	st_groupadd(group, st_test("conflict", batch_conflict));
+	st_groupadd(group, st_test("memory_limit", batch_memory_limit));
+	return group;
+}
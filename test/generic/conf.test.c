@@ -26,7 +26,7 @@ conf_version(void)
 	free(s);
 	s = sp_getstring(env, "sophia.version_storage", NULL);
 	t( s != NULL );
-	t( strcmp(s, "2.2") == 0 );
+	t( strcmp(s, "2.3") == 0 );
 	free(s);
 	t( sp_destroy(env) == 0 );
 }
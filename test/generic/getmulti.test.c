@@ -0,0 +1,210 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <sophia.h>
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+#include <libsv.h>
+#include <libsd.h>
+#include <libst.h>
+
+static void*
+getmulti_env(void *upsert)
+{
+	rmrf(st_r.conf->sophia_dir);
+	rmrf(st_r.conf->log_dir);
+	rmrf(st_r.conf->db_dir);
+	void *env = sp_env();
+	t( env != NULL );
+	t( sp_setstring(env, "sophia.path", st_r.conf->sophia_dir, 0) == 0 );
+	t( sp_setint(env, "scheduler.threads", 0) == 0 );
+	t( sp_setstring(env, "log.path", st_r.conf->log_dir, 0) == 0 );
+	t( sp_setstring(env, "db", "test", 0) == 0 );
+	t( sp_setstring(env, "db.test.path", st_r.conf->db_dir, 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "key", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme.key", "u32,key(0)", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "value", 0) == 0 );
+	t( sp_setint(env, "db.test.sync", 0) == 0 );
+	t( sp_setint(env, "db.test.compaction.cache", 0) == 0 );
+	if (upsert)
+		t( sp_setstring(env, "db.test.upsert", upsert, 0) == 0 );
+	t( sp_open(env) == 0 );
+	return env;
+}
+
+static void
+getmulti_fill(void *db, uint32_t count)
+{
+	uint32_t key = 0;
+	while (key < count) {
+		void *o = sp_document(db);
+		t( o != NULL );
+		t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+		t( sp_setstring(o, "value", &key, sizeof(key)) == 0 );
+		t( sp_set(db, o) == 0 );
+		key++;
+	}
+}
+
+static void
+getmulti_keys(void *db, void **keys, uint32_t *list, int count)
+{
+	int i = 0;
+	while (i < count) {
+		keys[i] = sp_document(db);
+		t( keys[i] != NULL );
+		t( sp_setstring(keys[i], "key", &list[i], sizeof(uint32_t)) == 0 );
+		i++;
+	}
+}
+
+static void
+getmulti_check(void **keys, uint32_t *list, int count, uint32_t max)
+{
+	int i = 0;
+	while (i < count) {
+		if (list[i] >= max) {
+			t( keys[i] == NULL );
+		} else {
+			t( keys[i] != NULL );
+			t( *(uint32_t*)sp_getstring(keys[i], "key", NULL) == list[i] );
+			t( *(uint32_t*)sp_getstring(keys[i], "value", NULL) == list[i] );
+			sp_destroy(keys[i]);
+		}
+		i++;
+	}
+}
+
+static void
+getmulti_memory(void)
+{
+	void *env = getmulti_env(NULL);
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	getmulti_fill(db, 100);
+
+	uint32_t list[] = { 42, 7, 150, 99, 0, 7, 100, 3 };
+	void *keys[8];
+	getmulti_keys(db, keys, list, 8);
+	t( sp_getmulti(db, keys, 8) == 0 );
+	getmulti_check(keys, list, 8, 100);
+	t( sp_getint(env, "db.test.index.read_disk") == 0 );
+
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+getmulti_disk(void)
+{
+	void *env = getmulti_env(NULL);
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	getmulti_fill(db, 1000);
+	t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+
+	uint32_t list[] = { 999, 500, 1, 1500, 250, 500, 0, 777, 1000, 13 };
+	void *keys[10];
+	getmulti_keys(db, keys, list, 10);
+	int64_t read_disk = sp_getint(env, "db.test.index.read_disk");
+	t( sp_getmulti(db, keys, 10) == 0 );
+	/* every page is read only once */
+	t( sp_getint(env, "db.test.index.read_disk") - read_disk == 1 );
+	getmulti_check(keys, list, 10, 1000);
+
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+getmulti_disk_memory(void)
+{
+	void *env = getmulti_env(NULL);
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	getmulti_fill(db, 500);
+	t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+
+	/* update part of the keys in memory, delete others */
+	uint32_t key = 0;
+	while (key < 500) {
+		void *o = sp_document(db);
+		t( o != NULL );
+		t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+		if (key % 2) {
+			t( sp_delete(db, o) == 0 );
+		} else {
+			t( sp_setstring(o, "value", &key, sizeof(key)) == 0 );
+			t( sp_set(db, o) == 0 );
+		}
+		key += 5;
+	}
+
+	uint32_t list[] = { 5, 10, 11, 20, 12, 15, 499 };
+	void *keys[7];
+	getmulti_keys(db, keys, list, 7);
+	t( sp_getmulti(db, keys, 7) == 0 );
+	/* deleted */
+	list[0] = 500;
+	list[5] = 500;
+	getmulti_check(keys, list, 7, 500);
+
+	t( sp_destroy(env) == 0 );
+}
+
+static int
+getmulti_operator(int count,
+                  char **src,    uint32_t *src_size,
+                  char **upsert, uint32_t *upsert_size,
+                  char **result, uint32_t *result_size,
+                  void *arg)
+{
+	(void)count;
+	(void)src;
+	(void)src_size;
+	(void)arg;
+	result_size[1] = upsert_size[1];
+	result[1] = malloc(upsert_size[1]);
+	memcpy(result[1], upsert[1], upsert_size[1]);
+	return 0;
+}
+
+static void
+getmulti_upsert(void)
+{
+	void *env = getmulti_env(getmulti_operator);
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	getmulti_fill(db, 100);
+	t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+
+	uint32_t key = 50;
+	void *o = sp_document(db);
+	t( o != NULL );
+	t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+	t( sp_setstring(o, "value", &key, sizeof(key)) == 0 );
+	t( sp_upsert(db, o) == 0 );
+
+	uint32_t list[] = { 50, 3, 200 };
+	void *keys[3];
+	getmulti_keys(db, keys, list, 3);
+	t( sp_getmulti(db, keys, 3) == 0 );
+	getmulti_check(keys, list, 3, 100);
+
+	t( sp_destroy(env) == 0 );
+}
+
+stgroup *getmulti_group(void)
+{
+	stgroup *group = st_group("getmulti");
+	st_groupadd(group, st_test("memory", getmulti_memory));
+	st_groupadd(group, st_test("disk", getmulti_disk));
+	st_groupadd(group, st_test("disk_memory", getmulti_disk_memory));
+	st_groupadd(group, st_test("upsert", getmulti_upsert));
+	return group;
+}
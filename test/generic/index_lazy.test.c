@@ -0,0 +1,283 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <sophia.h>
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+#include <libsv.h>
+#include <libsd.h>
+#include <libst.h>
+
+#define INDEX_LAZY_COUNT 2000
+
+static void*
+index_lazy_env(int lazy, int cache, int bloom)
+{
+	void *env = sp_env();
+	t( env != NULL );
+	t( sp_setstring(env, "sophia.path", st_r.conf->sophia_dir, 0) == 0 );
+	t( sp_setint(env, "scheduler.threads", 0) == 0 );
+	t( sp_setstring(env, "log.path", st_r.conf->log_dir, 0) == 0 );
+	t( sp_setint(env, "log.sync", 0) == 0 );
+	t( sp_setint(env, "log.rotate_sync", 0) == 0 );
+	t( sp_setstring(env, "db", "test", 0) == 0 );
+	t( sp_setstring(env, "db.test.path", st_r.conf->db_dir, 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "key", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme.key", "u32,key(0)", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "value", 0) == 0 );
+	t( sp_setint(env, "db.test.sync", 0) == 0 );
+	t( sp_setint(env, "db.test.compaction.cache", 0) == 0 );
+	t( sp_setint(env, "db.test.compaction.node_size", 4096) == 0 );
+	t( sp_setint(env, "db.test.compaction.page_size", 1024) == 0 );
+	t( sp_setint(env, "db.test.index_lazy", lazy) == 0 );
+	t( sp_setint(env, "db.test.index_cache", cache) == 0 );
+	t( sp_setint(env, "db.test.compaction.bloom_bits", bloom) == 0 );
+	t( sp_open(env) == 0 );
+	return env;
+}
+
+static void
+index_lazy_set(void *env, uint32_t value)
+{
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	uint32_t key = 0;
+	while (key < INDEX_LAZY_COUNT) {
+		uint32_t v = key + value;
+		void *o = sp_document(db);
+		t( o != NULL );
+		t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+		t( sp_setstring(o, "value", &v, sizeof(v)) == 0 );
+		t( sp_set(db, o) == 0 );
+		key++;
+	}
+	t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+}
+
+static void
+index_lazy_fill(int bloom)
+{
+	rmrf(st_r.conf->sophia_dir);
+	rmrf(st_r.conf->log_dir);
+	rmrf(st_r.conf->db_dir);
+	void *env = index_lazy_env(0, 0, bloom);
+	index_lazy_set(env, 0);
+	t( sp_getint(env, "db.test.index.node_count") > 1 );
+	/* drop compacted log, so it is not replayed */
+	t( sp_setint(env, "log.rotate", 0) == 0 );
+	t( sp_setint(env, "log.gc", 0) == 0 );
+	t( sp_getint(env, "log.files") == 1 );
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+index_lazy_get(void *env, uint32_t value)
+{
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	uint32_t key = 0;
+	while (key < INDEX_LAZY_COUNT) {
+		void *o = sp_document(db);
+		t( o != NULL );
+		t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+		o = sp_get(db, o);
+		t( o != NULL );
+		t( *(uint32_t*)sp_getstring(o, "value", NULL) == key + value );
+		sp_destroy(o);
+		key++;
+	}
+}
+
+static void
+index_lazy_cursor(void *env, uint32_t value)
+{
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	void *c = sp_cursor(env);
+	t( c != NULL );
+	void *o = sp_document(db);
+	uint32_t key = 0;
+	while ((o = sp_get(c, o))) {
+		t( *(uint32_t*)sp_getstring(o, "key", NULL) == key );
+		t( *(uint32_t*)sp_getstring(o, "value", NULL) == key + value );
+		key++;
+	}
+	t( key == INDEX_LAZY_COUNT );
+	t( sp_destroy(c) == 0 );
+}
+
+static void
+index_lazy_open(void)
+{
+	index_lazy_fill(10);
+
+	/* node set is recovered from manifest, page indexes
+	 * are loaded on first access and kept */
+	void *env = index_lazy_env(0, 0, 10);
+	t( sp_getint(env, "db.test.index.index_memory_used") == 0 );
+	index_lazy_get(env, 0);
+	int64_t used = sp_getint(env, "db.test.index.index_memory_used");
+	t( used > 0 );
+	t( sp_destroy(env) == 0 );
+
+	env = index_lazy_env(1, 0, 10);
+	t( sp_getint(env, "db.test.index.index_memory_used") == 0 );
+	index_lazy_get(env, 0);
+	t( sp_getint(env, "db.test.index.index_memory_used") == used );
+	index_lazy_cursor(env, 0);
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+index_lazy_evict(void)
+{
+	index_lazy_fill(10);
+
+	void *env = index_lazy_env(0, 0, 10);
+	index_lazy_get(env, 0);
+	int64_t used = sp_getint(env, "db.test.index.index_memory_used");
+	t( sp_getint(env, "db.test.index.node_count") > 2 );
+	t( sp_destroy(env) == 0 );
+
+	/* keep a single node index loaded */
+	env = index_lazy_env(1, 1, 10);
+	int pass = 0;
+	while (pass < 2) {
+		index_lazy_get(env, 0);
+		index_lazy_cursor(env, 0);
+		int64_t current = sp_getint(env, "db.test.index.index_memory_used");
+		t( current > 0 );
+		t( current < used );
+		pass++;
+	}
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+index_lazy_compaction(void)
+{
+	index_lazy_fill(10);
+
+	void *env = index_lazy_env(1, 1, 10);
+	index_lazy_set(env, 1);
+	index_lazy_get(env, 1);
+	index_lazy_cursor(env, 1);
+	t( sp_destroy(env) == 0 );
+
+	env = index_lazy_env(1, 0, 10);
+	index_lazy_cursor(env, 1);
+	index_lazy_get(env, 1);
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+index_lazy_downgrade_db(char *path)
+{
+	/* rewrite node index header in the storage
+	 * version 2.2 format */
+	int fd = open(path, O_RDWR);
+	t( fd != -1 );
+	struct stat st;
+	t( fstat(fd, &st) == 0 );
+	char *file = malloc(st.st_size);
+	t( file != NULL );
+	t( pread(fd, file, st.st_size, 0) == st.st_size );
+	sdindexheader *h =
+		(sdindexheader*)(file + st.st_size - sizeof(sdindexheader));
+	t( h->version.b == SR_VERSION_STORAGE_B );
+	t( h->bloom == 0 );
+	t( h->blob == 0 );
+	t( (char*)h - h->align - h->size - h->total == file );
+	h->version.b = '2';
+	h->crc = ss_crcs(st_r.crc, h, SD_INDEXHEADER_V22, 0);
+	int size = SD_INDEXHEADER_V22;
+	t( pwrite(fd, h, size, (char*)h - file) == size );
+	t( ftruncate(fd, ((char*)h - file) + size) == 0 );
+	t( close(fd) == 0 );
+	free(file);
+}
+
+static void
+index_lazy_downgrade_log(char *path)
+{
+	int fd = open(path, O_RDWR);
+	t( fd != -1 );
+	srversion version;
+	t( pread(fd, &version, sizeof(version), 0) == sizeof(version) );
+	t( version.b == SR_VERSION_STORAGE_B );
+	version.b = '2';
+	t( pwrite(fd, &version, sizeof(version), 0) == sizeof(version) );
+	t( close(fd) == 0 );
+}
+
+static void
+index_lazy_downgrade(char *dir, char *ext, void (*downgrade)(char*))
+{
+	DIR *d = opendir(dir);
+	t( d != NULL );
+	int count = 0;
+	struct dirent *de;
+	while ((de = readdir(d))) {
+		int len = strlen(de->d_name);
+		int ext_len = strlen(ext);
+		if (len < ext_len || strcmp(de->d_name + len - ext_len, ext) != 0)
+			continue;
+		char path[1024];
+		snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+		downgrade(path);
+		count++;
+	}
+	t( closedir(d) == 0 );
+	t( count > 0 );
+}
+
+static void
+index_lazy_storage_v22(void)
+{
+	/* storage version 2.2 has no bloom filter, value
+	 * log usage and manifest */
+	index_lazy_fill(0);
+	index_lazy_downgrade(st_r.conf->db_dir, ".db", index_lazy_downgrade_db);
+	index_lazy_downgrade(st_r.conf->log_dir, ".log", index_lazy_downgrade_log);
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/manifest", st_r.conf->db_dir);
+	t( unlink(path) == 0 );
+
+	void *env = index_lazy_env(1, 0, 10);
+	index_lazy_get(env, 0);
+	index_lazy_cursor(env, 0);
+	t( sp_destroy(env) == 0 );
+
+	/* older page indexes are reloaded from manifest */
+	env = index_lazy_env(1, 1, 10);
+	index_lazy_get(env, 0);
+	index_lazy_cursor(env, 0);
+	t( sp_destroy(env) == 0 );
+
+	env = index_lazy_env(0, 0, 10);
+	index_lazy_get(env, 0);
+	index_lazy_set(env, 1);
+	index_lazy_get(env, 1);
+	t( sp_destroy(env) == 0 );
+
+	env = index_lazy_env(1, 0, 10);
+	index_lazy_cursor(env, 1);
+	t( sp_destroy(env) == 0 );
+}
+
+stgroup *index_lazy_group(void)
+{
+	stgroup *group = st_group("index_lazy");
+	st_groupadd(group, st_test("open", index_lazy_open));
+	st_groupadd(group, st_test("evict", index_lazy_evict));
+	st_groupadd(group, st_test("compaction", index_lazy_compaction));
+	st_groupadd(group, st_test("storage_v22", index_lazy_storage_v22));
+	return group;
+}
@@ -0,0 +1,530 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <sophia.h>
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+#include <libsv.h>
+#include <libsd.h>
+#include <libst.h>
+
+static void*
+memtable_env(char *memtable, int threads)
+{
+	rmrf(st_r.conf->sophia_dir);
+	rmrf(st_r.conf->log_dir);
+	rmrf(st_r.conf->db_dir);
+	void *env = sp_env();
+	t( env != NULL );
+	t( sp_setstring(env, "sophia.path", st_r.conf->sophia_dir, 0) == 0 );
+	t( sp_setint(env, "scheduler.threads", threads) == 0 );
+	t( sp_setstring(env, "log.path", st_r.conf->log_dir, 0) == 0 );
+	t( sp_setstring(env, "db", "test", 0) == 0 );
+	t( sp_setstring(env, "db.test.path", st_r.conf->db_dir, 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "key", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme.key", "u32,key(0)", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "value", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme.value", "u32", 0) == 0 );
+	t( sp_setint(env, "db.test.sync", 0) == 0 );
+	t( sp_setint(env, "db.test.compaction.cache", 0) == 0 );
+	t( sp_setint(env, "db.test.compaction.page_size", 1024) == 0 );
+	t( sp_setint(env, "db.test.compaction.node_size", 32 * 1024) == 0 );
+	t( sp_setstring(env, "db.test.memtable", memtable, 0) == 0 );
+	t( sp_open(env) == 0 );
+	return env;
+}
+
+static void
+memtable_setto(void *dest, void *db, uint32_t key, uint32_t value)
+{
+	void *o = sp_document(db);
+	t( o != NULL );
+	t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+	t( sp_setstring(o, "value", &value, sizeof(value)) == 0 );
+	t( sp_set(dest, o) == 0 );
+}
+
+static void
+memtable_set(void *db, uint32_t key, uint32_t value)
+{
+	memtable_setto(db, db, key, value);
+}
+
+static int
+memtable_getfrom(void *dest, void *db, uint32_t key, uint32_t *value)
+{
+	void *o = sp_document(db);
+	t( o != NULL );
+	t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+	o = sp_get(dest, o);
+	if (o == NULL)
+		return 0;
+	*value = *(uint32_t*)sp_getstring(o, "value", NULL);
+	sp_destroy(o);
+	return 1;
+}
+
+static int
+memtable_get(void *db, uint32_t key, uint32_t *value)
+{
+	return memtable_getfrom(db, db, key, value);
+}
+
+static void
+memtable_unknown(void)
+{
+	rmrf(st_r.conf->sophia_dir);
+	rmrf(st_r.conf->log_dir);
+	rmrf(st_r.conf->db_dir);
+	void *env = sp_env();
+	t( env != NULL );
+	t( sp_setstring(env, "sophia.path", st_r.conf->sophia_dir, 0) == 0 );
+	t( sp_setstring(env, "db", "test", 0) == 0 );
+	t( sp_setstring(env, "db.test.memtable", "avl", 0) == 0 );
+	t( sp_open(env) == -1 );
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+memtable_default(void)
+{
+	rmrf(st_r.conf->sophia_dir);
+	void *env = sp_env();
+	t( env != NULL );
+	t( sp_setstring(env, "sophia.path", st_r.conf->sophia_dir, 0) == 0 );
+	t( sp_setstring(env, "db", "test", 0) == 0 );
+	char *v = sp_getstring(env, "db.test.memtable", NULL);
+	t( strcmp(v, "rbtree") == 0 );
+	free(v);
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+memtable_get_compact(void)
+{
+	void *env = memtable_env("skiplist", 0);
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+
+	uint32_t count = 5000;
+	uint32_t j = 0;
+	while (j < count) {
+		memtable_set(db, (j * 7919) % count, j);
+		j++;
+	}
+	/* update and delete */
+	j = 0;
+	while (j < count) {
+		memtable_set(db, j, j + 1);
+		j += 2;
+	}
+	j = 1;
+	while (j < count) {
+		void *o = sp_document(db);
+		t( sp_setstring(o, "key", &j, sizeof(j)) == 0 );
+		t( sp_delete(db, o) == 0 );
+		j += 4;
+	}
+
+	int pass = 0;
+	while (pass < 2) {
+		j = 0;
+		while (j < count) {
+			uint32_t value;
+			int rc = memtable_get(db, j, &value);
+			if ((j % 4) == 1) {
+				t( rc == 0 );
+			} else {
+				t( rc == 1 );
+				if ((j % 2) == 0)
+					t( value == j + 1 );
+			}
+			j++;
+		}
+		/* move memory index to disk, node split
+		 * redistributes the skiplist */
+		t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+		t( sp_getint(env, "db.test.index.node_count") > 1 );
+		pass++;
+	}
+	t( sp_getint(env, "db.test.index.memory_used") == 0 );
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+memtable_cursor(void)
+{
+	void *env = memtable_env("skiplist", 0);
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+
+	uint32_t count = 1000;
+	uint32_t j = 0;
+	while (j < count) {
+		memtable_set(db, (j * 7919) % count, j);
+		j++;
+	}
+
+	void *c = sp_cursor(env);
+	t( c != NULL );
+	void *o = sp_document(db);
+	t( sp_setstring(o, "order", ">=", 0) == 0 );
+	j = 0;
+	while ((o = sp_get(c, o))) {
+		t( *(uint32_t*)sp_getstring(o, "key", NULL) == j );
+		j++;
+	}
+	t( j == count );
+	t( sp_destroy(c) == 0 );
+
+	c = sp_cursor(env);
+	t( c != NULL );
+	o = sp_document(db);
+	t( sp_setstring(o, "order", "<", 0) == 0 );
+	j = 500;
+	t( sp_setstring(o, "key", &j, sizeof(j)) == 0 );
+	while ((o = sp_get(c, o))) {
+		j--;
+		t( *(uint32_t*)sp_getstring(o, "key", NULL) == j );
+	}
+	t( j == 0 );
+	t( sp_destroy(c) == 0 );
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+memtable_transaction(void)
+{
+	void *env = memtable_env("skiplist", 0);
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+
+	memtable_set(db, 7, 0);
+	void *tx = sp_begin(env);
+	t( tx != NULL );
+	memtable_setto(tx, db, 7, 1);
+	uint32_t value;
+	t( memtable_getfrom(tx, db, 7, &value) == 1 );
+	t( value == 1 );
+	t( memtable_get(db, 7, &value) == 1 );
+	t( value == 0 );
+	t( sp_commit(tx) == 0 );
+	t( memtable_get(db, 7, &value) == 1 );
+	t( value == 1 );
+
+	tx = sp_begin(env);
+	t( tx != NULL );
+	memtable_setto(tx, db, 7, 2);
+	t( sp_destroy(tx) == 0 );
+	t( memtable_get(db, 7, &value) == 1 );
+	t( value == 1 );
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+memtable_arena_run(int arena)
+{
+	rmrf(st_r.conf->sophia_dir);
+	rmrf(st_r.conf->log_dir);
+	rmrf(st_r.conf->db_dir);
+	void *env = sp_env();
+	t( env != NULL );
+	t( sp_setstring(env, "sophia.path", st_r.conf->sophia_dir, 0) == 0 );
+	t( sp_setint(env, "scheduler.threads", 0) == 0 );
+	t( sp_setstring(env, "log.path", st_r.conf->log_dir, 0) == 0 );
+	t( sp_setstring(env, "db", "test", 0) == 0 );
+	t( sp_setstring(env, "db.test.path", st_r.conf->db_dir, 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "key", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme.key", "u32,key(0)", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "value", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme.value", "u32", 0) == 0 );
+	t( sp_setint(env, "db.test.sync", 0) == 0 );
+	t( sp_setint(env, "db.test.compaction.page_size", 1024) == 0 );
+	t( sp_setint(env, "db.test.compaction.node_size", 32 * 1024) == 0 );
+	t( sp_setint(env, "db.test.memtable_arena", arena) == 0 );
+	t( sp_open(env) == 0 );
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+
+	uint32_t count = 3000;
+	uint32_t j = 0;
+	while (j < count) {
+		memtable_set(db, j, j);
+		j++;
+	}
+	t( sp_getint(env, "db.test.stat.documents") == count );
+	int64_t used = sp_getint(env, "memory.used");
+	t( used >= count * 8 );
+	/* compaction releases memory index in one shot */
+	t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+	t( sp_getint(env, "db.test.stat.documents") == 0 );
+	t( sp_getint(env, "db.test.index.node_count") > 1 );
+
+	/* node split redistributes updates into new nodes */
+	j = 0;
+	while (j < count) {
+		memtable_set(db, j, j + 1);
+		j++;
+	}
+	j = 0;
+	while (j < count) {
+		uint32_t value;
+		t( memtable_get(db, j, &value) == 1 );
+		t( value == j + 1 );
+		j++;
+	}
+	while (sp_getint(env, "db.test.index.memory_used") > 0)
+		t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+	t( sp_getint(env, "db.test.stat.documents") == 0 );
+	/* memory limit accounts arena chunks, only the
+	 * current chunk is left */
+	if (arena > 0)
+		t( sp_getint(env, "memory.used") <= arena + 64 );
+	else
+		t( sp_getint(env, "memory.used") == 0 );
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+memtable_arena(void)
+{
+	memtable_arena_run(0);
+	memtable_arena_run(512);
+	memtable_arena_run(256 * 1024);
+}
+
+#define MEMTABLE_KEYS 2000
+
+static void*
+memtable_reader(void *arg)
+{
+	ssthread *self = arg;
+	void *db = self->arg;
+	uint32_t seed = (uint32_t)(uintptr_t)self;
+	int i = 0;
+	while (i < 20000) {
+		seed = seed * 1103515245 + 12345;
+		uint32_t key = (seed >> 8) % MEMTABLE_KEYS;
+		uint32_t value;
+		t( memtable_get(db, key, &value) == 1 );
+		t( value >= key );
+		i++;
+	}
+	return NULL;
+}
+
+static void
+memtable_multithread(void)
+{
+	void *env = memtable_env("skiplist", 1);
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+
+	uint32_t j = 0;
+	while (j < MEMTABLE_KEYS) {
+		memtable_set(db, j, j);
+		j++;
+	}
+	ssthreadpool p;
+	ss_threadpool_init(&p);
+	t( ss_threadpool_new(&p, &st_r.a, 3, memtable_reader, db) == 0 );
+	/* concurrent updates and background compaction */
+	int round = 0;
+	while (round < 10) {
+		j = 0;
+		while (j < MEMTABLE_KEYS) {
+			memtable_set(db, j, j + round);
+			j++;
+		}
+		round++;
+	}
+	t( ss_threadpool_shutdown(&p, &st_r.a) == 0 );
+
+	j = 0;
+	while (j < MEMTABLE_KEYS) {
+		uint32_t value;
+		t( memtable_get(db, j, &value) == 1 );
+		t( value == j + 9 );
+		j++;
+	}
+	t( sp_destroy(env) == 0 );
+}
+
+static int
+memtable_tryset(void *db, uint32_t key, uint32_t value)
+{
+	void *o = sp_document(db);
+	t( o != NULL );
+	t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+	t( sp_setstring(o, "value", &value, sizeof(value)) == 0 );
+	return sp_set(db, o);
+}
+
+static void
+memtable_memory_limit(void)
+{
+	void *env = memtable_env("rbtree", 0);
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	t( sp_setint(env, "memory.limit", -1) == -1 );
+	t( sp_setint(env, "memory.limit_wm", 0) == -1 );
+	t( sp_setint(env, "memory.limit_wm", 101) == -1 );
+	t( sp_setint(env, "memory.limit", 64 * 1024) == 0 );
+	t( sp_setint(env, "memory.stall_max", 0) == 0 );
+
+	/* no background threads, writer fails once
+	 * the limit is reached */
+	uint32_t j = 0;
+	while (j < 100000) {
+		if (memtable_tryset(db, j, j) == -1)
+			break;
+		j++;
+	}
+	t( j > 0 );
+	t( j < 100000 );
+	t( sp_getint(env, "memory.used") >= 64 * 1024 );
+	t( sp_getint(env, "memory.stall") == 1 );
+	t( sp_getint(env, "memory.stall_error") == 1 );
+
+	/* compaction releases memory, writes are retried */
+	int n = 0;
+	while (sp_getint(env, "memory.used") >= 64 * 1024 && n < 100) {
+		t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+		n++;
+	}
+	t( sp_getint(env, "memory.used") < 64 * 1024 );
+	t( memtable_tryset(db, j, j) == 0 );
+	j++;
+
+	/* disable limit */
+	t( sp_setint(env, "memory.limit", 0) == 0 );
+	uint32_t count = j + 10000;
+	while (j < count) {
+		memtable_set(db, j, j);
+		j++;
+	}
+	j = 0;
+	while (j < count) {
+		uint32_t value;
+		t( memtable_get(db, j, &value) == 1 );
+		t( value == j );
+		j++;
+	}
+	t( sp_getint(env, "memory.stall_error") == 1 );
+	t( sp_destroy(env) == 0 );
+}
+
+typedef struct {
+	void *db;
+	uint32_t count;
+	int done;
+} memtablewriter;
+
+static void*
+memtable_writer(void *arg)
+{
+	ssthread *self = arg;
+	memtablewriter *w = self->arg;
+	uint32_t j = 0;
+	while (j < w->count) {
+		memtable_set(w->db, j, j);
+		j++;
+	}
+	ss_atomic_store(&w->done, 1);
+	return NULL;
+}
+
+static void
+memtable_multithread_write(void)
+{
+	void *env = memtable_env("skiplist", 2);
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+
+	/* concurrent writers, readers and background
+	 * compaction of the same nodes */
+	memtablewriter w = {
+		.db    = db,
+		.count = MEMTABLE_KEYS * 10,
+		.done  = 0
+	};
+	uint32_t j = 0;
+	while (j < MEMTABLE_KEYS) {
+		memtable_set(db, j, j);
+		j++;
+	}
+	ssthreadpool p;
+	ss_threadpool_init(&p);
+	t( ss_threadpool_new(&p, &st_r.a, 4, memtable_writer, &w) == 0 );
+	t( ss_threadpool_new(&p, &st_r.a, 2, memtable_reader, db) == 0 );
+	t( ss_threadpool_shutdown(&p, &st_r.a) == 0 );
+
+	j = 0;
+	while (j < w.count) {
+		uint32_t value;
+		t( memtable_get(db, j, &value) == 1 );
+		t( value == j );
+		j++;
+	}
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+memtable_memory_limit_stall(void)
+{
+	void *env = memtable_env("skiplist", 0);
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	t( sp_setint(env, "memory.limit", 128 * 1024) == 0 );
+	t( sp_setint(env, "memory.stall_max", 60000) == 0 );
+
+	/* no background threads: writer is stalled once it
+	 * reaches the limit, compaction is run only after that */
+	memtablewriter w = {
+		.db    = db,
+		.count = 50000,
+		.done  = 0
+	};
+	ssthreadpool p;
+	ss_threadpool_init(&p);
+	t( ss_threadpool_new(&p, &st_r.a, 1, memtable_writer, &w) == 0 );
+	while (sp_getint(env, "memory.stall") == 0)
+		ss_sleep(1000000);
+	while (! ss_atomic_load(&w.done))
+		t( sp_setint(env, "scheduler.run", 0) != -1 );
+	t( ss_threadpool_shutdown(&p, &st_r.a) == 0 );
+
+	t( sp_getint(env, "memory.stall") > 0 );
+	t( sp_getint(env, "memory.stall_error") == 0 );
+	uint32_t j = 0;
+	while (j < w.count) {
+		uint32_t value;
+		t( memtable_get(db, j, &value) == 1 );
+		t( value == j );
+		j++;
+	}
+	t( sp_destroy(env) == 0 );
+}
+
+stgroup *memtable_group(void)
+{
+	stgroup *group = st_group("memtable");
+	st_groupadd(group, st_test("unknown", memtable_unknown));
+	st_groupadd(group, st_test("default", memtable_default));
+	st_groupadd(group, st_test("get_compact", memtable_get_compact));
+	st_groupadd(group, st_test("cursor", memtable_cursor));
+	st_groupadd(group, st_test("transaction", memtable_transaction));
+	st_groupadd(group, st_test("arena", memtable_arena));
+	st_groupadd(group, st_test("multithread", memtable_multithread));
+	st_groupadd(group, st_test("multithread_write", memtable_multithread_write));
+	st_groupadd(group, st_test("memory_limit", memtable_memory_limit));
+	st_groupadd(group, st_test("memory_limit_stall", memtable_memory_limit_stall));
+	return group;
+}
@@ -0,0 +1,197 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <sophia.h>
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+#include <libsv.h>
+#include <libsd.h>
+#include <libst.h>
+
+static struct {
+	char *ptr;
+	int   size;
+} normalize_str[] = {
+	{ "",         0 },
+	{ "\0",       1 },
+	{ "\0\0",     2 },
+	{ "a",        1 },
+	{ "a\0",      2 },
+	{ "a\0b",     3 },
+	{ "ab",       2 },
+	{ "b",        1 },
+	{ "\xff",     1 },
+	{ "\xff\0",   2 }
+};
+
+#define NORMALIZE_STR   (int)(sizeof(normalize_str) / sizeof(normalize_str[0]))
+#define NORMALIZE_COUNT (4 * 4 * NORMALIZE_STR)
+
+static void
+normalize_db(void *env, char *name, int normalize)
+{
+	char path[64];
+	t( sp_setstring(env, "db", name, 0) == 0 );
+	snprintf(path, sizeof(path), "db.%s.scheme", name);
+	t( sp_setstring(env, path, "a", 0) == 0 );
+	t( sp_setstring(env, path, "b", 0) == 0 );
+	t( sp_setstring(env, path, "c", 0) == 0 );
+	t( sp_setstring(env, path, "value", 0) == 0 );
+	snprintf(path, sizeof(path), "db.%s.scheme.a", name);
+	t( sp_setstring(env, path, "u32,key(0)", 0) == 0 );
+	snprintf(path, sizeof(path), "db.%s.scheme.b", name);
+	t( sp_setstring(env, path, "u64_rev,key(1)", 0) == 0 );
+	snprintf(path, sizeof(path), "db.%s.scheme.c", name);
+	t( sp_setstring(env, path, "string,key(2)", 0) == 0 );
+	snprintf(path, sizeof(path), "db.%s.scheme.value", name);
+	t( sp_setstring(env, path, "u32", 0) == 0 );
+	snprintf(path, sizeof(path), "db.%s.sync", name);
+	t( sp_setint(env, path, 0) == 0 );
+	snprintf(path, sizeof(path), "db.%s.compaction.cache", name);
+	t( sp_setint(env, path, 0) == 0 );
+	snprintf(path, sizeof(path), "db.%s.key_normalize", name);
+	t( sp_setint(env, path, normalize) == 0 );
+}
+
+static void*
+normalize_env(int normalize)
+{
+	void *env = sp_env();
+	t( env != NULL );
+	t( sp_setstring(env, "sophia.path", st_r.conf->sophia_dir, 0) == 0 );
+	t( sp_setint(env, "scheduler.threads", 0) == 0 );
+	t( sp_setstring(env, "log.path", st_r.conf->log_dir, 0) == 0 );
+	normalize_db(env, "test", normalize);
+	normalize_db(env, "ref", 0);
+	t( sp_open(env) == 0 );
+	return env;
+}
+
+typedef struct {
+	uint32_t a;
+	uint64_t b;
+} normalizekey;
+
+static void*
+normalize_key(void *db, normalizekey *k, uint32_t id)
+{
+	/* document references the key parts until set */
+	k->a = id % 4;
+	k->b = ((id / 4) % 4) * 0x0100000001ULL;
+	int c = id / 16;
+	void *o = sp_document(db);
+	t( o != NULL );
+	t( sp_setstring(o, "a", &k->a, sizeof(k->a)) == 0 );
+	t( sp_setstring(o, "b", &k->b, sizeof(k->b)) == 0 );
+	t( sp_setstring(o, "c", normalize_str[c].ptr, normalize_str[c].size) == 0 );
+	return o;
+}
+
+static void
+normalize_set(void *env, uint32_t from, uint32_t to)
+{
+	void *db  = sp_getobject(env, "db.test");
+	void *ref = sp_getobject(env, "db.ref");
+	normalizekey k;
+	uint32_t id = from;
+	while (id < to) {
+		/* spread the keys across the key space */
+		uint32_t key = (id * 7) % NORMALIZE_COUNT;
+		void *o = normalize_key(db, &k, key);
+		t( sp_setstring(o, "value", &key, sizeof(key)) == 0 );
+		t( sp_set(db, o) == 0 );
+		o = normalize_key(ref, &k, key);
+		t( sp_setstring(o, "value", &key, sizeof(key)) == 0 );
+		t( sp_set(ref, o) == 0 );
+		id++;
+	}
+}
+
+static void
+normalize_check(void *env, char *order)
+{
+	/* normalized order must match the scheme order */
+	void *db  = sp_getobject(env, "db.test");
+	void *ref = sp_getobject(env, "db.ref");
+	void *c = sp_cursor(env);
+	t( c != NULL );
+	void *c_ref = sp_cursor(env);
+	t( c_ref != NULL );
+	void *o = sp_document(db);
+	t( sp_setstring(o, "order", order, 0) == 0 );
+	void *o_ref = sp_document(ref);
+	t( sp_setstring(o_ref, "order", order, 0) == 0 );
+	int count = 0;
+	while ((o_ref = sp_get(c_ref, o_ref))) {
+		o = sp_get(c, o);
+		t( o != NULL );
+		uint32_t value = *(uint32_t*)sp_getstring(o, "value", NULL);
+		t( value == *(uint32_t*)sp_getstring(o_ref, "value", NULL) );
+		count++;
+	}
+	t( sp_get(c, o) == NULL );
+	t( count == NORMALIZE_COUNT );
+	t( sp_destroy(c) == 0 );
+	t( sp_destroy(c_ref) == 0 );
+
+	normalizekey k;
+	uint32_t key = 0;
+	while (key < NORMALIZE_COUNT) {
+		o = sp_get(db, normalize_key(db, &k, key));
+		t( o != NULL );
+		t( *(uint32_t*)sp_getstring(o, "value", NULL) == key );
+		sp_destroy(o);
+		key++;
+	}
+}
+
+static void
+normalize_order(void)
+{
+	void *env = normalize_env(1);
+	normalize_set(env, 0, NORMALIZE_COUNT / 2);
+	t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+	t( sp_setint(env, "db.ref.compaction.compact", 0) == 0 );
+	normalize_set(env, NORMALIZE_COUNT / 2, NORMALIZE_COUNT);
+	normalize_check(env, ">=");
+	normalize_check(env, "<=");
+	t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+	t( sp_setint(env, "db.ref.compaction.compact", 0) == 0 );
+	normalize_check(env, ">=");
+	normalize_check(env, "<=");
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+normalize_recover(void)
+{
+	void *env = normalize_env(1);
+	normalize_set(env, 0, NORMALIZE_COUNT);
+	t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+	t( sp_destroy(env) == 0 );
+
+	/* mode is saved with the scheme */
+	env = normalize_env(0);
+	char *v = sp_getstring(env, "db.test.scheme._key", NULL);
+	t( v != NULL );
+	t( strcmp(v, "string,normalized") == 0 );
+	free(v);
+	normalize_check(env, ">");
+	normalize_check(env, "<");
+	t( sp_destroy(env) == 0 );
+}
+
+stgroup *normalize_group(void)
+{
+	stgroup *group = st_group("normalize");
+	st_groupadd(group, st_test("order", normalize_order));
+	st_groupadd(group, st_test("recover", normalize_recover));
+	return group;
+}
@@ -0,0 +1,210 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <sophia.h>
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+#include <libsv.h>
+#include <libsd.h>
+#include <libst.h>
+
+static void*
+page_cache_env(char *compression, int page_size, int mmap, int delta)
+{
+	rmrf(st_r.conf->sophia_dir);
+	rmrf(st_r.conf->log_dir);
+	rmrf(st_r.conf->db_dir);
+	void *env = sp_env();
+	t( env != NULL );
+	t( sp_setstring(env, "sophia.path", st_r.conf->sophia_dir, 0) == 0 );
+	t( sp_setint(env, "scheduler.threads", 0) == 0 );
+	t( sp_setstring(env, "log.path", st_r.conf->log_dir, 0) == 0 );
+	t( sp_setstring(env, "db", "test", 0) == 0 );
+	t( sp_setstring(env, "db.test.path", st_r.conf->db_dir, 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "key", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme.key", "u32,key(0)", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "value", 0) == 0 );
+	t( sp_setint(env, "db.test.sync", 0) == 0 );
+	t( sp_setint(env, "db.test.mmap", mmap) == 0 );
+	t( sp_setint(env, "db.test.key_normalize", delta) == 0 );
+	t( sp_setint(env, "db.test.compaction.cache", 0) == 0 );
+	t( sp_setint(env, "db.test.compaction.page_size", page_size) == 0 );
+	t( sp_setint(env, "db.test.compaction.page_delta", delta) == 0 );
+	t( sp_setstring(env, "db.test.compression", compression, 0) == 0 );
+	t( sp_open(env) == 0 );
+	return env;
+}
+
+static void
+page_cache_fill(void *env, void *db, uint32_t count)
+{
+	uint32_t key = 0;
+	while (key < count) {
+		void *o = sp_document(db);
+		t( o != NULL );
+		t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+		t( sp_setstring(o, "value", &key, sizeof(key)) == 0 );
+		t( sp_set(db, o) == 0 );
+		key++;
+	}
+	t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+}
+
+static void
+page_cache_get(void *db, uint32_t count)
+{
+	uint32_t key = 0;
+	while (key < count) {
+		void *o = sp_document(db);
+		t( o != NULL );
+		t( sp_setstring(o, "key", &key, sizeof(key)) == 0 );
+		o = sp_get(db, o);
+		t( o != NULL );
+		t( *(uint32_t*)sp_getstring(o, "value", NULL) == key );
+		sp_destroy(o);
+		key++;
+	}
+}
+
+static void
+page_cache_disabled(void)
+{
+	void *env = page_cache_env("lz4", 1024, 0, 0);
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	page_cache_fill(env, db, 1000);
+	page_cache_get(db, 1000);
+	t( sp_getint(env, "cache.limit") == 0 );
+	t( sp_getint(env, "cache.hit") == 0 );
+	t( sp_getint(env, "cache.miss") == 0 );
+	t( sp_getint(env, "cache.pages") == 0 );
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+page_cache_hit(void)
+{
+	void *env = page_cache_env("lz4", 1024, 0, 0);
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	t( sp_setint(env, "cache.limit", 1024 * 1024) == 0 );
+	page_cache_fill(env, db, 1000);
+
+	int64_t pages = sp_getint(env, "db.test.index.page_count");
+	t( pages > 1 );
+	page_cache_get(db, 1000);
+	int64_t read_disk = sp_getint(env, "db.test.index.read_disk");
+	t( read_disk == pages );
+	t( sp_getint(env, "cache.miss") == pages );
+	t( sp_getint(env, "cache.pages") == pages );
+	t( sp_getint(env, "cache.hit") == 1000 - pages );
+
+	/* every page is cached now */
+	page_cache_get(db, 1000);
+	t( sp_getint(env, "db.test.index.read_disk") == read_disk );
+	t( sp_getint(env, "cache.miss") == pages );
+	t( sp_getint(env, "cache.hit") == 2000 - pages );
+	t( sp_getint(env, "cache.evict") == 0 );
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+page_cache_evict(void)
+{
+	void *env = page_cache_env("none", 1024, 0, 0);
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	t( sp_setint(env, "cache.limit", 4096) == 0 );
+	page_cache_fill(env, db, 1000);
+	page_cache_get(db, 1000);
+	page_cache_get(db, 1000);
+	t( sp_getint(env, "cache.evict") > 0 );
+	t( sp_getint(env, "cache.used") <= 4096 );
+
+	/* shrink */
+	t( sp_setint(env, "cache.limit", 0) == 0 );
+	t( sp_getint(env, "cache.used") == 0 );
+	t( sp_getint(env, "cache.pages") == 0 );
+	page_cache_get(db, 1000);
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+page_cache_cursor(void)
+{
+	void *env = page_cache_env("zstd", 1024, 0, 0);
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	t( sp_setint(env, "cache.limit", 1024 * 1024) == 0 );
+	page_cache_fill(env, db, 1000);
+
+	int pass = 0;
+	while (pass < 2) {
+		void *c = sp_cursor(env);
+		t( c != NULL );
+		void *o = sp_document(db);
+		uint32_t key = 0;
+		while ((o = sp_get(c, o))) {
+			t( *(uint32_t*)sp_getstring(o, "key", NULL) == key );
+			key++;
+		}
+		t( key == 1000 );
+		t( sp_destroy(c) == 0 );
+		pass++;
+	}
+	t( sp_getint(env, "cache.hit") > 0 );
+	page_cache_get(db, 1000);
+	t( sp_destroy(env) == 0 );
+}
+
+static void
+page_cache_mmap(void)
+{
+	/* uncompressed pages are read from the mapping
+	 * directly and bypass the cache */
+	void *env = page_cache_env("none", 1024, 1, 0);
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	t( sp_setint(env, "cache.limit", 1024 * 1024) == 0 );
+	page_cache_fill(env, db, 1000);
+	page_cache_get(db, 1000);
+	t( sp_getint(env, "cache.miss") == 0 );
+	t( sp_getint(env, "cache.pages") == 0 );
+	t( sp_destroy(env) == 0 );
+
+	/* delta encoded pages are expanded once and cached */
+	env = page_cache_env("none", 1024, 1, 1);
+	db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	t( sp_setint(env, "cache.limit", 1024 * 1024) == 0 );
+	page_cache_fill(env, db, 1000);
+
+	int64_t pages = sp_getint(env, "db.test.index.page_count");
+	t( pages > 1 );
+	page_cache_get(db, 1000);
+	t( sp_getint(env, "cache.miss") == pages );
+	t( sp_getint(env, "cache.pages") == pages );
+	t( sp_getint(env, "cache.hit") == 1000 - pages );
+	page_cache_get(db, 1000);
+	t( sp_getint(env, "cache.miss") == pages );
+	t( sp_getint(env, "cache.hit") == 2000 - pages );
+	t( sp_destroy(env) == 0 );
+}
+
+stgroup *page_cache_group(void)
+{
+	stgroup *group = st_group("page_cache");
+	st_groupadd(group, st_test("disabled", page_cache_disabled));
+	st_groupadd(group, st_test("hit", page_cache_hit));
+	st_groupadd(group, st_test("evict", page_cache_evict));
+	st_groupadd(group, st_test("cursor", page_cache_cursor));
+	st_groupadd(group, st_test("mmap", page_cache_mmap));
+	return group;
+}
@@ -67,9 +67,89 @@ profiler_count(void)
 	t( sp_destroy(env) == 0 );
 }
 
+#define PROFILER_THREADS 4
+#define PROFILER_KEYS    2000
+
+static void*
+profiler_stat_thread(void *arg)
+{
+	ssthread *self = arg;
+	void *db = self->arg;
+	uint32_t i = 0;
+	while (i < PROFILER_KEYS) {
+		void *o = sp_document(db);
+		t( sp_setstring(o, "key", &i, sizeof(i)) == 0 );
+		t( sp_setstring(o, "value", &i, sizeof(i)) == 0 );
+		t( sp_set(db, o) == 0 );
+		o = sp_document(db);
+		t( sp_setstring(o, "key", &i, sizeof(i)) == 0 );
+		o = sp_get(db, o);
+		t( o != NULL );
+		sp_destroy(o);
+		i++;
+	}
+	return NULL;
+}
+
+static void
+profiler_stat(void)
+{
+	void *env = sp_env();
+	t( env != NULL );
+	t( sp_setstring(env, "sophia.path", st_r.conf->sophia_dir, 0) == 0 );
+	t( sp_setint(env, "scheduler.threads", 0) == 0 );
+	t( sp_setstring(env, "log.path", st_r.conf->log_dir, 0) == 0 );
+	t( sp_setstring(env, "db", "test", 0) == 0 );
+	t( sp_setstring(env, "db.test.path", st_r.conf->db_dir, 0) == 0 );
+	t( sp_setint(env, "db.test.sync", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "key", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme.key", "u32,key(0)", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "value", 0) == 0 );
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	t( sp_open(env) == 0 );
+
+	ssthreadpool p;
+	ss_threadpool_init(&p);
+	t( ss_threadpool_new(&p, &st_r.a, PROFILER_THREADS,
+	                     profiler_stat_thread, db) == 0 );
+	t( ss_threadpool_shutdown(&p, &st_r.a) == 0 );
+
+	/* no updates are lost by concurrent writers */
+	int total = PROFILER_THREADS * PROFILER_KEYS;
+	t( sp_getint(env, "db.test.stat.set") == total );
+	t( sp_getint(env, "db.test.stat.get") == total );
+	t( sp_getint(env, "db.test.stat.documents") == total );
+	char *v = sp_getstring(env, "db.test.stat.set_latency", NULL);
+	t( v != NULL );
+	t( strcmp(v, "0 0 0.0") != 0 );
+	free(v);
+
+	/* latency percentiles */
+	int64_t p50 = sp_getint(env, "db.test.stat.get_latency_p50");
+	int64_t p99 = sp_getint(env, "db.test.stat.get_latency_p99");
+	int64_t p999 = sp_getint(env, "db.test.stat.get_latency_p999");
+	t( p50 <= p99 && p99 <= p999 );
+	t( sp_getint(env, "db.test.stat.set_latency_p999") > 0 );
+	t( sp_setint(env, "db.test.stat.latency_reset", 0) == 0 );
+	t( sp_getint(env, "db.test.stat.get_latency_p999") == 0 );
+	t( sp_getint(env, "db.test.stat.set_latency_p999") == 0 );
+	t( sp_getint(env, "db.test.stat.get") == total );
+
+	void *tx = sp_begin(env);
+	t( tx != NULL );
+	t( sp_commit(tx) == 0 );
+	t( sp_getint(env, "transaction.latency_p50") >= 0 );
+	t( sp_setint(env, "transaction.latency_reset", 0) == 0 );
+	t( sp_getint(env, "transaction.latency_p999") == 0 );
+
+	t( sp_destroy(env) == 0 );
+}
+
 stgroup *profiler_group(void)
 {
 	stgroup *group = st_group("profiler");
 	st_groupadd(group, st_test("count", profiler_count));
+	st_groupadd(group, st_test("stat", profiler_stat));
 	return group;
 }
@@ -261,6 +261,110 @@ mt_multi_stmt_conflict1(void)
 	t( sp_destroy(env) == 0 );
 }
 
+typedef struct {
+	void *env;
+	void *db0;
+	void *db1;
+	int done;
+	int errors;
+} mtvisibility;
+
+static inline int
+mt_visibility_get(void *db)
+{
+	void *o = sp_document(db);
+	assert(o != NULL);
+	sp_setstring(o, "key", "key", 4);
+	o = sp_get(db, o);
+	if (o == NULL)
+		return -1;
+	int v = *(int*)sp_getstring(o, "value", NULL);
+	sp_destroy(o);
+	return v;
+}
+
+static inline void *visibility_writer_thread(void *arg)
+{
+	ssthread *self = arg;
+	mtvisibility *m = self->arg;
+	int i = 0;
+	while (i < 20000) {
+		void *tx = sp_begin(m->env);
+		assert(tx != NULL);
+		void *o = sp_document(m->db0);
+		sp_setstring(o, "key", "key", 4);
+		sp_setstring(o, "value", &i, sizeof(i));
+		int rc = sp_set(tx, o);
+		assert(rc == 0);
+		o = sp_document(m->db1);
+		sp_setstring(o, "key", "key", 4);
+		sp_setstring(o, "value", &i, sizeof(i));
+		rc = sp_set(tx, o);
+		assert(rc == 0);
+		rc = sp_commit(tx);
+		assert(rc == 0);
+		i++;
+	}
+	ss_atomic_store(&m->done, 1);
+	return NULL;
+}
+
+static inline void *visibility_reader_thread(void *arg)
+{
+	ssthread *self = arg;
+	mtvisibility *m = self->arg;
+	while (! ss_atomic_load(&m->done)) {
+		/* index of db0 is updated first, both keys
+		 * must become visible at once */
+		int v0 = mt_visibility_get(m->db0);
+		int v1 = mt_visibility_get(m->db1);
+		if (v1 < v0)
+			ss_atomic_add(&m->errors, 1);
+	}
+	return NULL;
+}
+
+static void
+mt_multi_stmt_visibility(void)
+{
+	void *env = sp_env();
+	t( env != NULL );
+	t( sp_setstring(env, "sophia.path", st_r.conf->sophia_dir, 0) == 0 );
+	t( sp_setint(env, "scheduler.threads", 0) == 0 );
+	t( sp_setstring(env, "log.path", st_r.conf->log_dir, 0) == 0 );
+	t( sp_setint(env, "log.rotate_sync", 0) == 0 );
+	t( sp_setint(env, "log.sync", 0) == 0 );
+	t( sp_setstring(env, "db", "test", 0) == 0 );
+	t( sp_setstring(env, "db.test.path", st_r.conf->db_dir, 0) == 0 );
+	t( sp_setint(env, "db.test.sync", 0) == 0 );
+	t( sp_setstring(env, "db", "test2", 0) == 0 );
+	t( sp_setstring(env, "db.test2.path", st_r.conf->db_dir, 0) == 0 );
+	t( sp_setint(env, "db.test2.sync", 0) == 0 );
+	mtvisibility m = {
+		.env  = env,
+		.db0  = sp_getobject(env, "db.test"),
+		.db1  = sp_getobject(env, "db.test2"),
+		.done   = 0,
+		.errors = 0
+	};
+	t( m.db0 != NULL );
+	t( m.db1 != NULL );
+	t( sp_open(env) == 0 );
+
+	ssthreadpool readers;
+	ss_threadpool_init(&readers);
+	t( ss_threadpool_new(&readers, &st_r.a, 2, visibility_reader_thread, &m) == 0 );
+	ssthreadpool p;
+	ss_threadpool_init(&p);
+	t( ss_threadpool_new(&p, &st_r.a, 1, visibility_writer_thread, &m) == 0 );
+	t( ss_threadpool_shutdown(&p, &st_r.a) == 0 );
+	t( ss_threadpool_shutdown(&readers, &st_r.a) == 0 );
+	t( m.errors == 0 );
+	t( mt_visibility_get(m.db0) == 19999 );
+	t( mt_visibility_get(m.db1) == 19999 );
+	t( sp_destroy(env) == 0 );
+}
+
 stgroup *multithread_group(void)
 {
 	stgroup *group = st_group("mt");
@@ -268,5 +372,6 @@ stgroup *multithread_group(void)
 	st_groupadd(group, st_test("multi_stmt", mt_multi_stmt));
 	st_groupadd(group, st_test("multi_stmt_conflict0", mt_multi_stmt_conflict0));
 	st_groupadd(group, st_test("multi_stmt_conflict1", mt_multi_stmt_conflict1));
+	st_groupadd(group, st_test("multi_stmt_visibility", mt_multi_stmt_visibility));
 	return group;
 }
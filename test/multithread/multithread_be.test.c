@@ -182,12 +182,70 @@ mt_set_expire(void)
 	t( sp_destroy(env) == 0 );
 }
 
+static void
+mt_wakeup(void)
+{
+	void *env = sp_env();
+	t( env != NULL );
+	t( sp_setstring(env, "sophia.path", st_r.conf->sophia_dir, 0) == 0 );
+	t( sp_setint(env, "scheduler.threads", 2) == 0 );
+	t( sp_setstring(env, "log.path", st_r.conf->log_dir, 0) == 0 );
+	t( sp_setstring(env, "db", "test", 0) == 0 );
+	t( sp_setstring(env, "db.test.path", st_r.conf->db_dir, 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "key", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme.key", "u32,key(0)", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "value", 0) == 0 );
+	t( sp_setint(env, "db.test.sync", 0) == 0 );
+	t( sp_setint(env, "db.test.compaction.cache", 64 * 1024) == 0 );
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	t( sp_open(env) == 0 );
+
+	/* idle workers are woken up by the writer, once
+	 * node crosses memory watermark */
+	char value[100];
+	memset(value, 0, sizeof(value));
+	int pass = 0;
+	while (pass < 3) {
+		uint32_t i = 0;
+		while (i < 2000) {
+			uint32_t k = pass * 2000 + i;
+			void *o = sp_document(db);
+			t( o != NULL );
+			t( sp_setstring(o, "key", &k, sizeof(k)) == 0 );
+			t( sp_setstring(o, "value", value, sizeof(value)) == 0 );
+			t( sp_set(db, o) == 0 );
+			i++;
+		}
+		int wait = 0;
+		while (sp_getint(env, "db.test.index.memory_used") >= 64 * 1024 &&
+		       wait < 5000) {
+			usleep(1000);
+			wait++;
+		}
+		t( sp_getint(env, "db.test.index.memory_used") < 64 * 1024 );
+		pass++;
+	}
+	uint32_t k = 0;
+	while (k < 3 * 2000) {
+		void *o = sp_document(db);
+		t( o != NULL );
+		t( sp_setstring(o, "key", &k, sizeof(k)) == 0 );
+		o = sp_get(db, o);
+		t( o != NULL );
+		sp_destroy(o);
+		k++;
+	}
+	t( sp_destroy(env) == 0 );
+}
+
 stgroup *multithread_be_group(void)
 {
 	stgroup *group = st_group("mt_backend");
 	st_groupadd(group, st_test("set_delete_get", mt_set_delete_get));
 	st_groupadd(group, st_test("set_get_kv_multipart", mt_set_get_kv_multipart));
 	st_groupadd(group, st_test("set_expire", mt_set_expire));
+	st_groupadd(group, st_test("wakeup", mt_wakeup));
 	return group;
 }
 
@@ -0,0 +1,199 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <sophia.h>
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+#include <libso.h>
+#include <libsv.h>
+#include <libsw.h>
+#include <libsd.h>
+#include <libsi.h>
+#include <libsx.h>
+#include <libsy.h>
+#include <libsc.h>
+#include <libse.h>
+#include <libst.h>
+
+#define MT_SCALE_OPS  64000
+#define MT_SCALE_KEYS 10000
+#define MT_SCALE_SYNC_OPS 4000
+
+static int mt_scale_threads[] = { 1, 2, 4, 8, 16, 32 };
+
+typedef struct {
+	void *db;
+	int   ops;
+	int   seq;
+} mtscale;
+
+static inline int
+mt_scale_id(mtscale *s) {
+	return __sync_fetch_and_add(&s->seq, 1);
+}
+
+static void*
+mt_scale_env(int sync)
+{
+	void *env = sp_env();
+	t( env != NULL );
+	t( sp_setstring(env, "sophia.path", st_r.conf->sophia_dir, 0) == 0 );
+	t( sp_setint(env, "scheduler.threads", 0) == 0 );
+	t( sp_setstring(env, "log.path", st_r.conf->log_dir, 0) == 0 );
+	t( sp_setint(env, "log.rotate_sync", 0) == 0 );
+	t( sp_setint(env, "log.sync", sync) == 0 );
+	t( sp_setstring(env, "db", "test", 0) == 0 );
+	t( sp_setstring(env, "db.test.path", st_r.conf->db_dir, 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "key", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme.key", "u32,key(0)", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme", "value", 0) == 0 );
+	t( sp_setstring(env, "db.test.scheme.value", "u32", 0) == 0 );
+	t( sp_setint(env, "db.test.sync", 0) == 0 );
+	t( sp_open(env) == 0 );
+	return env;
+}
+
+static void
+mt_scale_report(char *name, int threads, int ops, uint64_t time_us)
+{
+	if (! st_r.verbose)
+		return;
+	if (time_us == 0)
+		time_us = 1;
+	uint64_t rps = (uint64_t)ops * 1000000 / time_us;
+	printf("\n    (%s) threads: %2d rps: %" PRIu64, name, threads, rps);
+	fflush(NULL);
+}
+
+static inline void *mt_scale_set_thread(void *arg)
+{
+	ssthread *self = arg;
+	mtscale *s = self->arg;
+	uint32_t key = mt_scale_id(s) * s->ops;
+	uint32_t end = key + s->ops;
+	while (key < end) {
+		void *o = sp_document(s->db);
+		assert(o != NULL);
+		sp_setstring(o, "key", &key, sizeof(key));
+		sp_setstring(o, "value", &key, sizeof(key));
+		int rc = sp_set(s->db, o);
+		assert(rc == 0);
+		(void)rc;
+		key++;
+	}
+	return NULL;
+}
+
+static inline void *mt_scale_get_thread(void *arg)
+{
+	ssthread *self = arg;
+	mtscale *s = self->arg;
+	uint32_t seed = mt_scale_id(s) * 7919 + 1;
+	int i = 0;
+	while (i < s->ops) {
+		seed = seed * 1103515245 + 12345;
+		uint32_t key = (seed >> 16) % MT_SCALE_KEYS;
+		void *o = sp_document(s->db);
+		assert(o != NULL);
+		sp_setstring(o, "key", &key, sizeof(key));
+		o = sp_get(s->db, o);
+		assert(o != NULL);
+		assert(*(uint32_t*)sp_getstring(o, "value", NULL) == key);
+		sp_destroy(o);
+		i++;
+	}
+	return NULL;
+}
+
+static void
+mt_scale_run(void *db, int threads, int ops, ssthreadf f)
+{
+	mtscale arg = {
+		.db  = db,
+		.ops = ops / threads,
+		.seq = 0
+	};
+	ssthreadpool p;
+	ss_threadpool_init(&p);
+	t( ss_threadpool_new(&p, &st_r.a, threads, f, &arg) == 0 );
+	t( ss_threadpool_shutdown(&p, &st_r.a) == 0 );
+}
+
+static void
+mt_scale_setof(char *name, int sync, int ops)
+{
+	unsigned int i = 0;
+	while (i < sizeof(mt_scale_threads) / sizeof(int)) {
+		int threads = mt_scale_threads[i];
+		rmrf(st_r.conf->sophia_dir);
+		rmrf(st_r.conf->log_dir);
+		rmrf(st_r.conf->db_dir);
+		void *env = mt_scale_env(sync);
+		void *db = sp_getobject(env, "db.test");
+		t( db != NULL );
+		uint64_t start = ss_utime();
+		mt_scale_run(db, threads, ops, mt_scale_set_thread);
+		mt_scale_report(name, threads, ops, ss_utime() - start);
+		int count = (ops / threads) * threads;
+		t( sp_getint(env, "db.test.index.count") == count );
+		t( sp_destroy(env) == 0 );
+		i++;
+	}
+}
+
+static void
+mt_scale_set(void)
+{
+	mt_scale_setof("set", 0, MT_SCALE_OPS);
+}
+
+static void
+mt_scale_set_sync(void)
+{
+	/* every commit waits for the log sync,
+	 * concurrent commits share a single fdatasync */
+	mt_scale_setof("set_sync", 1, MT_SCALE_SYNC_OPS);
+}
+
+static void
+mt_scale_get(void)
+{
+	void *env = mt_scale_env(0);
+	void *db = sp_getobject(env, "db.test");
+	t( db != NULL );
+	uint32_t key = 0;
+	while (key < MT_SCALE_KEYS) {
+		void *o = sp_document(db);
+		t( o != NULL );
+		sp_setstring(o, "key", &key, sizeof(key));
+		sp_setstring(o, "value", &key, sizeof(key));
+		t( sp_set(db, o) == 0 );
+		key++;
+	}
+	t( sp_setint(env, "db.test.compaction.compact", 0) == 0 );
+	unsigned int i = 0;
+	while (i < sizeof(mt_scale_threads) / sizeof(int)) {
+		int threads = mt_scale_threads[i];
+		uint64_t start = ss_utime();
+		mt_scale_run(db, threads, MT_SCALE_OPS, mt_scale_get_thread);
+		mt_scale_report("get", threads, MT_SCALE_OPS, ss_utime() - start);
+		i++;
+	}
+	t( sp_destroy(env) == 0 );
+}
+
+stgroup *multithread_scale_group(void)
+{
+	stgroup *group = st_group("mt_scale");
+	st_groupadd(group, st_test("set", mt_scale_set));
+	st_groupadd(group, st_test("set_sync", mt_scale_set_sync));
+	st_groupadd(group, st_test("get", mt_scale_get));
+	return group;
+}
@@ -20,6 +20,7 @@ extern stgroup *ss_a_group(void);
 extern stgroup *ss_order_group(void);
 extern stgroup *ss_rq_group(void);
 extern stgroup *ss_ht_group(void);
+extern stgroup *ss_hist_group(void);
 extern stgroup *ss_zstdfilter_group(void);
 extern stgroup *ss_lz4filter_group(void);
 
@@ -33,6 +34,7 @@ extern stgroup *sr_conf_group(void);
 extern stgroup *sv_v_group(void);
 extern stgroup *sv_index_group(void);
 extern stgroup *sv_indexiter_group(void);
+extern stgroup *sv_skiplist_group(void);
 extern stgroup *sv_mergeiter_group(void);
 extern stgroup *sv_writeiter_group(void);
 extern stgroup *sw_group(void);
@@ -58,7 +60,13 @@ extern stgroup *backup_group(void);
 extern stgroup *prefix_group(void);
 extern stgroup *transaction_md_group(void);
 extern stgroup *transaction_misc_group(void);
+extern stgroup *batch_group(void);
+extern stgroup *getmulti_group(void);
 extern stgroup *cursor_cache_group(void);
+extern stgroup *page_cache_group(void);
+extern stgroup *index_lazy_group(void);
+extern stgroup *normalize_group(void);
+extern stgroup *memtable_group(void);
 extern stgroup *cursor_md_group(void);
 extern stgroup *upsert_group(void);
 extern stgroup *secondary_index_group(void);
@@ -70,6 +78,9 @@ extern stgroup *github_group(void);
 extern stgroup *log_group(void);
 extern stgroup *compact_group(void);
 extern stgroup *compact_delete_group(void);
+extern stgroup *bloom_group(void);
+extern stgroup *blob_group(void);
+extern stgroup *delta_group(void);
 extern stgroup *gc_group(void);
 extern stgroup *expire_group(void);
 
@@ -83,12 +94,14 @@ extern stgroup *durability_group(void);
 extern stgroup *oom_group(void);
 extern stgroup *io_group(void);
 extern stgroup *recover_loop_group(void);
+extern stgroup *recover_bench_group(void);
 
 /* multithread */
 extern stgroup *multithread_group(void);
 extern stgroup *multithread_upsert_group(void);
 extern stgroup *multithread_be_group(void);
 extern stgroup *multithread_be_multipass_group(void);
+extern stgroup *multithread_scale_group(void);
 
 /* memory */
 extern stgroup *leak_group(void);
@@ -183,6 +196,7 @@ main(int argc, char *argv[])
 	st_planadd(plan, ss_order_group());
 	st_planadd(plan, ss_rq_group());
 	st_planadd(plan, ss_ht_group());
+	st_planadd(plan, ss_hist_group());
 	st_planadd(plan, ss_zstdfilter_group());
 	st_planadd(plan, ss_lz4filter_group());
 	st_planadd(plan, sr_conf_group());
@@ -190,6 +204,7 @@ main(int argc, char *argv[])
 	st_planadd(plan, sv_v_group());
 	st_planadd(plan, sv_index_group());
 	st_planadd(plan, sv_indexiter_group());
+	st_planadd(plan, sv_skiplist_group());
 	st_planadd(plan, sv_mergeiter_group());
 	st_planadd(plan, sv_writeiter_group());
 	st_planadd(plan, sw_group());
@@ -222,7 +237,13 @@ main(int argc, char *argv[])
 	st_planadd(plan, prefix_group());
 	st_planadd(plan, transaction_md_group());
 	st_planadd(plan, transaction_misc_group());
+	st_planadd(plan, batch_group());
+	st_planadd(plan, getmulti_group());
 	st_planadd(plan, cursor_cache_group());
+	st_planadd(plan, page_cache_group());
+	st_planadd(plan, index_lazy_group());
+	st_planadd(plan, normalize_group());
+	st_planadd(plan, memtable_group());
 	st_planadd(plan, cursor_md_group());
 	st_planadd(plan, upsert_group());
 	st_planadd(plan, secondary_index_group());
@@ -248,6 +269,9 @@ main(int argc, char *argv[])
 	st_planadd(plan, log_group());
 	st_planadd(plan, compact_group());
 	st_planadd(plan, compact_delete_group());
+	st_planadd(plan, bloom_group());
+	st_planadd(plan, blob_group());
+	st_planadd(plan, delta_group());
 	st_planadd(plan, gc_group());
 	st_planadd(plan, expire_group());
 	st_suiteadd(&st_r.suite, plan);
@@ -273,6 +297,7 @@ main(int argc, char *argv[])
 	st_planadd(plan, oom_group());
 	st_planadd(plan, io_group());
 	st_planadd(plan, recover_loop_group());
+	st_planadd(plan, recover_bench_group());
 	st_suiteadd(&st_r.suite, plan);
 
 	(void)full;
@@ -313,6 +338,7 @@ main(int argc, char *argv[])
 	st_planadd(plan, multithread_be_group());
 	st_planadd(plan, multithread_upsert_group());
 	st_planadd(plan, multithread_group());
+	st_planadd(plan, multithread_scale_group());
 	st_suiteadd(&st_r.suite, plan);
 
 	plan = st_plan("multithread_3x_run");
@@ -100,6 +100,8 @@ void st_scene_rt(stscene *s ssunused)
 	        &st_r.scheme,
 	        &st_r.injection,
 	        &st_r.stat,
+	        NULL, /* rate */
+	        NULL, /* quota */
 	        st_r.crc,
 	        NULL);
 
@@ -36,7 +36,7 @@ sd_build_empty(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 	sd_buildend(&b, &st_r.r);
 	sdpageheader *h = sd_buildheader(&b);
 	t( h->count == 0 );
@@ -48,7 +48,7 @@ sd_build_page0(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 	int i = 7;
 	int j = 8;
 	int k = 15;
@@ -92,11 +92,11 @@ sd_build_compression_zstd(void)
 	sscrcf crc = ss_crc32c_function();
 	sr r;
 	sr_init(&r, NULL, &log, &error, &a, &a, &vfs, &seq,
-	        NULL, &cmp, &ij, &stat, crc, NULL);
+	        NULL, &cmp, &ij, &stat, NULL, NULL, crc, NULL);
 
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &r, 1, 1, &ss_zstdfilter) == 0);
+	t( sd_buildbegin(&b, &r, 1, 0, 0, 1, &ss_zstdfilter) == 0);
 	int i = 7;
 	int j = 8;
 	int k = 15;
@@ -142,11 +142,11 @@ sd_build_compression_lz4(void)
 	sscrcf crc = ss_crc32c_function();
 	sr r;
 	sr_init(&r, NULL, &log, &error, &a, &a, &vfs, &seq,
-	        NULL, &cmp, &ij, &stat, crc, NULL);
+	        NULL, &cmp, &ij, &stat, NULL, NULL, crc, NULL);
 
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &r, 1, 1, &ss_zstdfilter) == 0);
+	t( sd_buildbegin(&b, &r, 1, 0, 0, 1, &ss_zstdfilter) == 0);
 	int i = 7;
 	int j = 8;
 	int k = 15;
@@ -163,6 +163,85 @@ sd_build_compression_lz4(void)
 	sf_schemefree(&cmp, &a);
 }
 
+static void
+sd_build_delta_page(sr *r, int prefix)
+{
+	sdbuild b;
+	sd_buildinit(&b);
+	t( sd_buildbegin(&b, r, 1, 1, prefix, 0, NULL) == 0);
+	char *keys[] = { "", "prefix", "prefix", "prefix_a", "prefix_ab", "q" };
+	int i = 0;
+	for (; i < 6; i++) {
+		sfv pv[8];
+		memset(pv, 0, sizeof(pv));
+		pv[0].pointer = keys[i];
+		pv[0].size = strlen(keys[i]);
+		pv[1].pointer = (char*)&i;
+		pv[1].size = sizeof(i);
+		svv *v = sv_vbuild(r, pv);
+		sf_lsnset(r->scheme, sv_vpointer(v), i);
+		sd_buildadd(&b, r, sv_vpointer(v), 0);
+		sv_vunref(r, v);
+	}
+	t( sd_buildend(&b, r) == 0 );
+	sdpageheader *h = sd_buildheader(&b);
+	t( h->count == 6 );
+	t( h->flags & SD_PAGEDELTA );
+	t( !!(h->flags & SD_PAGEPREFIX) == prefix );
+	t( h->size < h->sizeorigin );
+
+	/* expand back to the regular page layout */
+	ssbuf buf;
+	ss_bufinit(&buf);
+	t( sd_pagedelta_decode(h, r, b.c.s + sizeof(sdpageheader), h->size, &buf) == 0 );
+	t( ss_bufused(&buf) == (int)(sizeof(sdpageheader) + h->sizeorigin) );
+	t( memcmp(buf.s + sizeof(sdpageheader), b.m.s + sizeof(sdpageheader),
+	          ss_bufused(&b.m) - sizeof(sdpageheader)) == 0 );
+	t( memcmp(buf.s + ss_bufused(&b.m), b.v.s, ss_bufused(&b.v)) == 0 );
+
+	/* truncated page */
+	t( sd_pagedelta_decode(h, r, b.c.s + sizeof(sdpageheader), h->size - 1, &buf) == -1 );
+
+	ss_buffree(&buf, r->a);
+	sd_buildfree(&b, r);
+}
+
+static void
+sd_build_delta(void)
+{
+	ssa a;
+	ss_aopen(&a, &ss_stda);
+	ssvfs vfs;
+	ss_vfsinit(&vfs, &ss_stdvfs);
+	sfscheme cmp;
+	sf_schemeinit(&cmp);
+	sffield *field = sf_fieldnew(&a, "key");
+	t( sf_fieldoptions(field, &a, "string,key(0)") == 0 );
+	t( sf_schemeadd(&cmp, &a, field) == 0 );
+	field = sf_fieldnew(&a, "value");
+	t( sf_fieldoptions(field, &a, "string") == 0 );
+	t( sf_schemeadd(&cmp, &a, field) == 0 );
+	t( sf_schemevalidate(&cmp, &a) == 0 );
+	ssinjection ij;
+	memset(&ij, 0, sizeof(ij));
+	srstat stat;
+	memset(&stat, 0, sizeof(stat));
+	srlog log;
+	sr_loginit(&log);
+	srerror error;
+	sr_errorinit(&error, &log);
+	srseq seq;
+	sr_seqinit(&seq);
+	sscrcf crc = ss_crc32c_function();
+	sr r;
+	sr_init(&r, NULL, &log, &error, &a, &a, &vfs, &seq,
+	        NULL, &cmp, &ij, &stat, NULL, NULL, crc, NULL);
+
+	sd_build_delta_page(&r, 0);
+	sd_build_delta_page(&r, 1);
+	sf_schemefree(&cmp, &a);
+}
+
 stgroup *sd_build_group(void)
 {
 	stgroup *group = st_group("sdbuild");
@@ -170,5 +249,6 @@ stgroup *sd_build_group(void)
 	st_groupadd(group, st_test("page0", sd_build_page0));
 	st_groupadd(group, st_test("compression_zstd", sd_build_compression_zstd));
 	st_groupadd(group, st_test("compression_lz4", sd_build_compression_lz4));
+	st_groupadd(group, st_test("delta", sd_build_delta));
 	return group;
 }
@@ -36,7 +36,7 @@ sd_pageiter_lte_empty(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 	sd_buildend(&b, &st_r.r);
 
 	ssbuf buf;
@@ -63,7 +63,7 @@ sd_pageiter_lte_eq0(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 8;
@@ -112,7 +112,7 @@ sd_pageiter_lte_minmax0(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 8;
@@ -153,7 +153,7 @@ sd_pageiter_lte_mid0(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 9;
@@ -202,7 +202,7 @@ sd_pageiter_lte_iterate0(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 9;
@@ -251,7 +251,7 @@ sd_pageiter_lte_iterate1(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 9;
@@ -301,7 +301,7 @@ sd_pageiter_lte_dup_iterate0(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 9;
@@ -390,7 +390,7 @@ sd_pageiter_lte_dup_mid(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 9;
@@ -457,7 +457,7 @@ sd_pageiter_lt_eq(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 8;
@@ -506,7 +506,7 @@ sd_pageiter_lt_minmax(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 8;
@@ -547,7 +547,7 @@ sd_pageiter_lt_mid(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 9;
@@ -596,7 +596,7 @@ sd_pageiter_lt_iterate0(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 9;
@@ -645,7 +645,7 @@ sd_pageiter_lt_iterate1(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 9;
@@ -690,7 +690,7 @@ sd_pageiter_lt_dup_mid(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 9;
@@ -755,7 +755,7 @@ sd_pageiter_gte_eq0(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 8;
@@ -804,7 +804,7 @@ sd_pageiter_gte_minmax0(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 8;
@@ -846,7 +846,7 @@ sd_pageiter_gte_mid0(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 9;
@@ -902,7 +902,7 @@ sd_pageiter_gte_mid1(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 9;
@@ -951,7 +951,7 @@ sd_pageiter_gte_iterate0(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 9;
@@ -1000,7 +1000,7 @@ sd_pageiter_gte_iterate1(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 9;
@@ -1050,7 +1050,7 @@ sd_pageiter_gte_dup_iterate0(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 9;
@@ -1132,7 +1132,7 @@ sd_pageiter_gte_dup_mid(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 9;
@@ -1199,7 +1199,7 @@ sd_pageiter_gt_eq(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 8;
@@ -1249,7 +1249,7 @@ sd_pageiter_gt_minmax(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 8;
@@ -1291,7 +1291,7 @@ sd_pageiter_gt_mid(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 9;
@@ -1340,7 +1340,7 @@ sd_pageiter_gt_iterate0(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 9;
@@ -1389,7 +1389,7 @@ sd_pageiter_gt_iterate1(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 9;
@@ -1434,7 +1434,7 @@ sd_pageiter_gt_dup_mid(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int i = 7;
 	int j = 9;
@@ -1494,6 +1494,69 @@ sd_pageiter_gt_dup_mid(void)
 	ss_buffree(&buf, &st_r.a);
 }
 
+static void
+sd_pageiter_prefix_build(sdbuild *b, ssbuf *buf, int prefix)
+{
+	sd_buildinit(b);
+	t( sd_buildbegin(b, &st_r.r, 1, 0, prefix, 0, NULL) == 0);
+	int i = 0;
+	for (; i < 100; i += 2) {
+		addv(b, &st_r.r, 200 + i, 0, &i);
+		if ((i % 10) == 0)
+			addv(b, &st_r.r, 100 + i, SVDUP, &i);
+	}
+	sd_buildend(b, &st_r.r);
+	ss_bufinit(buf);
+	t( sd_commitpage(b, &st_r.r, buf) == 0 );
+}
+
+static void
+sd_pageiter_prefix_search(void)
+{
+	sdbuild b, b_ref;
+	ssbuf buf, buf_ref;
+	sd_pageiter_prefix_build(&b, &buf, 1);
+	sd_pageiter_prefix_build(&b_ref, &buf_ref, 0);
+	sdpage page, page_ref;
+	sd_pageinit(&page, (sdpageheader*)buf.s);
+	sd_pageinit(&page_ref, (sdpageheader*)buf_ref.s);
+	t( page.h->flags & SD_PAGEPREFIX );
+	t( page.h->count == page_ref.h->count );
+	t( page.h->sizeorigin == page_ref.h->sizeorigin +
+	   sizeof(uint64_t) * page.h->count );
+
+	/* search must match the page without prefixes */
+	ssorder orders[] = { SS_LT, SS_LTE, SS_GT, SS_GTE };
+	int o = 0;
+	for (; o < 4; o++) {
+		int i = -1;
+		for (; i <= 100; i++) {
+			svv *key = st_svv(&st_r.g, &st_r.gc, 0, 0, i, 0, 0);
+			ssiter it, it_ref;
+			ss_iterinit(sd_pageiter, &it);
+			ss_iterinit(sd_pageiter, &it_ref);
+			int rc = ss_iteropen(sd_pageiter, &it, &st_r.r, &page,
+			                     orders[o], sv_vpointer(key));
+			t( rc == ss_iteropen(sd_pageiter, &it_ref, &st_r.r, &page_ref,
+			                     orders[o], sv_vpointer(key)) );
+			while (ss_iteratorhas(&it_ref)) {
+				t( ss_iteratorhas(&it) );
+				char *v = ss_iteratorof(&it);
+				char *v_ref = ss_iteratorof(&it_ref);
+				t( sf_compare(st_r.r.scheme, v, v_ref) == 0 );
+				t( sf_lsn(st_r.r.scheme, v) == sf_lsn(st_r.r.scheme, v_ref) );
+				ss_iteratornext(&it);
+				ss_iteratornext(&it_ref);
+			}
+			t( ss_iteratorhas(&it) == 0 );
+		}
+	}
+	sd_buildfree(&b, &st_r.r);
+	sd_buildfree(&b_ref, &st_r.r);
+	ss_buffree(&buf, &st_r.a);
+	ss_buffree(&buf_ref, &st_r.a);
+}
+
 stgroup *sd_pageiter_group(void)
 {
 	stgroup *group = st_group("sdpageiter");
@@ -1525,5 +1588,6 @@ stgroup *sd_pageiter_group(void)
 	st_groupadd(group, st_test("gt_iterate0", sd_pageiter_gt_iterate0));
 	st_groupadd(group, st_test("gt_iterate1", sd_pageiter_gt_iterate1));
 	st_groupadd(group, st_test("gt_dup_mid", sd_pageiter_gt_dup_mid));
+	st_groupadd(group, st_test("prefix", sd_pageiter_prefix_search));
 	return group;
 }
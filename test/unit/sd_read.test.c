@@ -36,7 +36,7 @@ sd_read_gt0(void)
 {
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int key = 7;
 	addv(&b, &st_r.r, 3, 0, &key);
@@ -63,7 +63,7 @@ sd_read_gt0(void)
 	ss_fileinit(&f, &st_r.vfs);
 	t( ss_filenew(&f, "./0000.db", 0) == 0 );
 	t( sd_writepage(&st_r.r, &f, NULL, &b) == 0 );
-	t( sd_buildindex_end(&bi, &st_r.r, 0, f.size) == 0 );
+	t( sd_buildindex_end(&bi, &st_r.r, 0, 0, f.size) == 0 );
 	t( sd_indexcopy_buf(&index, &st_r.r, &bi.v, &bi.m) == 0 );
 	t( sd_writeindex(&st_r.r, &f, &io, &index) == 0 );
 
@@ -141,7 +141,7 @@ sd_read_gt1(void)
 
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 
 	int key = 7;
 	addv(&b, &st_r.r, 3, 0, &key);
@@ -164,7 +164,7 @@ sd_read_gt1(void)
 	t( rc == 0 );
 	sd_buildreset(&b);
 
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 	key = 10;
 	addv(&b, &st_r.r, 6, 0, &key);
 	key = 11;
@@ -179,7 +179,7 @@ sd_read_gt1(void)
 	t( rc == 0 );
 	sd_buildreset(&b);
 
-	t( sd_buildbegin(&b, &st_r.r, 1, 0, NULL) == 0);
+	t( sd_buildbegin(&b, &st_r.r, 1, 0, 0, 0, NULL) == 0);
 	key = 15;
 	addv(&b, &st_r.r, 9, 0, &key);
 	key = 18;
@@ -194,7 +194,7 @@ sd_read_gt1(void)
 	t( rc == 0 );
 	sd_buildreset(&b);
 
-	t( sd_buildindex_end(&bi, &st_r.r, 0, f.size) == 0 );
+	t( sd_buildindex_end(&bi, &st_r.r, 0, 0, f.size) == 0 );
 	t( sd_indexcopy_buf(&index, &st_r.r, &bi.v, &bi.m) == 0 );
 	t( sd_writeindex(&st_r.r, &f, &io, &index) == 0 );
 
@@ -313,11 +313,11 @@ sd_read_gt0_compression_lz4(void)
 	sscrcf crc = ss_crc32c_function();
 	sr r;
 	sr_init(&r, NULL, &log, &error, &a, &a, &vfs, &seq,
-	        NULL, &cmp, &ij, &stat, crc, NULL);
+	        NULL, &cmp, &ij, &stat, NULL, NULL, crc, NULL);
 
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &r, 1, 1, &ss_lz4filter) == 0);
+	t( sd_buildbegin(&b, &r, 1, 0, 0, 1, &ss_lz4filter) == 0);
 
 	int key = 7;
 	addv(&b, &r, 3, 0, &key);
@@ -344,7 +344,7 @@ sd_read_gt0_compression_lz4(void)
 	ss_fileinit(&f, &vfs);
 	t( ss_filenew(&f, "./0000.db", 0) == 0 );
 	t( sd_writepage(&r, &f, NULL, &b) == 0 );
-	t( sd_buildindex_end(&bi, &r, 0, f.size) == 0 );
+	t( sd_buildindex_end(&bi, &r, 0, 0, f.size) == 0 );
 	t( sd_indexcopy_buf(&index, &st_r.r, &bi.v, &bi.m) == 0 );
 	t( sd_writeindex(&r, &f, &io, &index) == 0 );
 
@@ -443,7 +443,7 @@ sd_read_gt1_compression_lz4(void)
 	sscrcf crc = ss_crc32c_function();
 	sr r;
 	sr_init(&r, NULL, &log, &error, &a, &a, &vfs, &seq,
-	        NULL, &cmp, &ij, &stat, crc, NULL);
+	        NULL, &cmp, &ij, &stat, NULL, NULL, crc, NULL);
 
 	ssfile f;
 	ss_fileinit(&f, &vfs);
@@ -451,7 +451,7 @@ sd_read_gt1_compression_lz4(void)
 
 	sdbuild b;
 	sd_buildinit(&b);
-	t( sd_buildbegin(&b, &r, 1, 1, &ss_lz4filter) == 0);
+	t( sd_buildbegin(&b, &r, 1, 0, 0, 1, &ss_lz4filter) == 0);
 
 	int key = 7;
 	addv(&b, &r, 3, 0, &key);
@@ -477,7 +477,7 @@ sd_read_gt1_compression_lz4(void)
 	t( rc == 0 );
 	sd_buildreset(&b);
 
-	t( sd_buildbegin(&b, &r, 1, 1, &ss_lz4filter) == 0);
+	t( sd_buildbegin(&b, &r, 1, 0, 0, 1, &ss_lz4filter) == 0);
 	key = 10;
 	addv(&b, &r, 6, 0, &key);
 	key = 11;
@@ -492,7 +492,7 @@ sd_read_gt1_compression_lz4(void)
 	t( rc == 0 );
 	sd_buildreset(&b);
 
-	t( sd_buildbegin(&b, &r, 1, 1, &ss_lz4filter) == 0);
+	t( sd_buildbegin(&b, &r, 1, 0, 0, 1, &ss_lz4filter) == 0);
 	key = 15;
 	addv(&b, &r, 9, 0, &key);
 	key = 18;
@@ -507,7 +507,7 @@ sd_read_gt1_compression_lz4(void)
 	t( rc == 0 );
 	sd_buildreset(&b);
 
-	t( sd_buildindex_end(&bi, &r, 0, f.size) == 0 );
+	t( sd_buildindex_end(&bi, &r, 0, 0, f.size) == 0 );
 	t( sd_indexcopy_buf(&index, &st_r.r, &bi.v, &bi.m) == 0 );
 	t( sd_writeindex(&r, &f, &io, &index) == 0 );
 
@@ -62,9 +62,382 @@ sf_scheme_saveload(void)
 	ss_buffree(&buf, &st_r.a);
 }
 
+static void
+sf_scheme_field(sfscheme *s, char *name, char *options)
+{
+	sffield *field = sf_fieldnew(&st_r.a, name);
+	t( field != NULL );
+	t( sf_fieldoptions(field, &st_r.a, options) == 0);
+	t( sf_schemeadd(s, &st_r.a, field) == 0);
+}
+
+static int
+sf_scheme_value(sffield *f, char *buf)
+{
+	switch (f->type) {
+	case SS_STRING:
+	case SS_STRINGREV: {
+		int size = rand() % 4;
+		int i = 0;
+		while (i < size) {
+			buf[i] = 'a' + rand() % 3;
+			i++;
+		}
+		return size;
+	}
+	default:
+		if (f->lsn || f->flags)
+			return 0;
+		memset(buf, 0, f->fixed_size);
+		*(uint8_t*)buf = rand() % 8;
+		return f->fixed_size;
+	}
+}
+
+static char*
+sf_scheme_doc(sfscheme *s)
+{
+	char data[8][8];
+	sfv v[8];
+	t( s->fields_count <= 8 );
+	int i = 0;
+	while (i < s->fields_count) {
+		v[i].pointer = data[i];
+		v[i].size = sf_scheme_value(s->fields[i], data[i]);
+		i++;
+	}
+	char *doc = malloc(sf_writesize(s, v));
+	t( doc != NULL );
+	sf_write(s, v, doc);
+	return doc;
+}
+
+static int
+sf_scheme_cmp(char *a, int asz, char *b, int bsz, void *arg ssunused)
+{
+	int size = (asz < bsz) ? asz : bsz;
+	int rc = memcmp(a, b, size);
+	if (rc == 0)
+		return (asz == bsz) ? 0 : ((asz < bsz) ? -1 : 1);
+	return rc > 0 ? 1 : -1;
+}
+
+static void
+sf_scheme_compare_test(char *key_a, char *key_b, char *value, int value_first,
+                       sfcmpf cmp, int generic)
+{
+	sfscheme s;
+	sf_schemeinit(&s);
+	if (value_first)
+		sf_scheme_field(&s, "value", value);
+	sf_scheme_field(&s, "key_a", key_a);
+	if (key_b)
+		sf_scheme_field(&s, "key_b", key_b);
+	if (! value_first)
+		sf_scheme_field(&s, "value", value);
+	if (cmp)
+		sf_schemeset_comparator(&s, cmp);
+	t( sf_schemevalidate(&s, &st_r.a) == 0 );
+	t( (s.compare == sf_compare_generic) == generic );
+
+	/* specialized kernel must follow the generic order */
+	char *docs[64];
+	int i = 0;
+	while (i < 64) {
+		docs[i] = sf_scheme_doc(&s);
+		i++;
+	}
+	i = 0;
+	while (i < 64) {
+		int j = 0;
+		while (j < 64) {
+			t( sf_compare(&s, docs[i], docs[j]) ==
+			   sf_compare_generic(&s, docs[i], docs[j]) );
+			uint64_t a = sf_prefix(&s, docs[i]);
+			uint64_t b = sf_prefix(&s, docs[j]);
+			if (a != b)
+				t( sf_compare(&s, docs[i], docs[j]) == ((a < b) ? -1 : 1) );
+			j++;
+		}
+		i++;
+	}
+	i = 0;
+	while (i < 64) {
+		free(docs[i]);
+		i++;
+	}
+	sf_schemefree(&s, &st_r.a);
+}
+
+static void
+sf_scheme_compare(void)
+{
+	sf_scheme_compare_test("u32,key(0)", NULL, "string", 0, NULL, 0);
+	sf_scheme_compare_test("u32_rev,key(0)", NULL, "u32", 0, NULL, 0);
+	sf_scheme_compare_test("u64,key(0)", NULL, "string", 1, NULL, 0);
+	sf_scheme_compare_test("u64_rev,key(0)", NULL, "string", 0, NULL, 0);
+	sf_scheme_compare_test("string,key(0)", NULL, "string", 0, NULL, 0);
+	sf_scheme_compare_test("u32,key(0)", "u16_rev,key(1)", "string", 0, NULL, 0);
+	sf_scheme_compare_test("u8,key(0)", "u64,key(1)", "u32", 1, NULL, 0);
+	/* generic path */
+	sf_scheme_compare_test("string,key(0)", NULL, "string", 1, NULL, 1);
+	sf_scheme_compare_test("string_rev,key(0)", NULL, "u32", 0, NULL, 1);
+	sf_scheme_compare_test("string,key(0)", "u32,key(1)", "u32", 0, NULL, 1);
+	sf_scheme_compare_test("string,key(0)", NULL, "string", 0, sf_scheme_cmp, 1);
+}
+
+static int
+sf_scheme_sign(int rc)
+{
+	if (rc == 0)
+		return 0;
+	return (rc > 0) ? 1 : -1;
+}
+
+static void
+sf_scheme_normalize(void)
+{
+	sfscheme ref, s;
+	sf_schemeinit(&ref);
+	sf_schemeinit(&s);
+	char *fields[][2] = {
+		{ "a",     "u32,key(0)"     },
+		{ "b",     "u16_rev,key(1)" },
+		{ "c",     "string,key(2)"  },
+		{ "value", "string"         }
+	};
+	int i = 0;
+	while (i < 4) {
+		sf_scheme_field(&ref, fields[i][0], fields[i][1]);
+		sf_scheme_field(&s, fields[i][0], fields[i][1]);
+		i++;
+	}
+	t( sf_schemenormalize(&s, &st_r.a) == 0 );
+	t( sf_schemenormalize(&s, &st_r.a) == -1 );
+	t( sf_schemevalidate(&ref, &st_r.a) == 0 );
+	t( sf_schemevalidate(&s, &st_r.a) == 0 );
+	t( s.compare != sf_compare_generic );
+
+	/* memcmp of the normalized keys must follow the
+	 * scheme order */
+	char data[64][4][8];
+	char *docs[64];
+	char *docs_ref[64];
+	i = 0;
+	while (i < 64) {
+		sfv v[8];
+		memset(v, 0, sizeof(v));
+		int j = 0;
+		while (j < ref.fields_count) {
+			v[j].pointer = data[i][j];
+			v[j].size = sf_scheme_value(ref.fields[j], data[i][j]);
+			/* zero bytes must be escaped */
+			if (ref.fields[j]->type == SS_STRING && v[j].size > 1)
+				data[i][j][rand() % v[j].size] = rand() % 2;
+			j++;
+		}
+		docs_ref[i] = malloc(sf_writesize(&ref, v));
+		t( docs_ref[i] != NULL );
+		sf_write(&ref, v, docs_ref[i]);
+		docs[i] = malloc(sf_writesize(&s, v));
+		t( docs[i] != NULL );
+		sf_write(&s, v, docs[i]);
+		i++;
+	}
+	i = 0;
+	while (i < 64) {
+		int j = 0;
+		while (j < 64) {
+			t( sf_scheme_sign(sf_compare(&s, docs[i], docs[j])) ==
+			   sf_scheme_sign(sf_compare(&ref, docs_ref[i], docs_ref[j])) );
+			uint64_t a = sf_prefix(&s, docs[i]);
+			uint64_t b = sf_prefix(&s, docs[j]);
+			if (a != b)
+				t( sf_compare(&s, docs[i], docs[j]) == ((a < b) ? -1 : 1) );
+			j++;
+		}
+		i++;
+	}
+	i = 0;
+	while (i < 64) {
+		free(docs[i]);
+		free(docs_ref[i]);
+		i++;
+	}
+	sf_schemefree(&ref, &st_r.a);
+	sf_schemefree(&s, &st_r.a);
+
+	/* order is defined by the encoding */
+	sf_schemeinit(&s);
+	sf_scheme_field(&s, "key", "string,key(0)");
+	t( sf_schemenormalize(&s, &st_r.a) == 0 );
+	sf_schemeset_comparator(&s, sf_scheme_cmp);
+	t( sf_schemevalidate(&s, &st_r.a) == -1 );
+	sf_schemefree(&s, &st_r.a);
+}
+
+static void
+sf_scheme_prefix_test(char *key)
+{
+	sfscheme s;
+	sf_schemeinit(&s);
+	sf_scheme_field(&s, "key", key);
+	sf_scheme_field(&s, "value", "string");
+	t( sf_schemevalidate(&s, &st_r.a) == 0 );
+
+	/* keys around the prefix size with common parts */
+	char data[64][12];
+	char *docs[64];
+	int i = 0;
+	while (i < 64) {
+		sfv v[4];
+		memset(v, 0, sizeof(v));
+		v[0].pointer = data[i];
+		v[0].size = rand() % sizeof(data[i]);
+		int j = 0;
+		while (j < (int)v[0].size) {
+			data[i][j] = (rand() % 4) ? 'a' : 0;
+			j++;
+		}
+		docs[i] = malloc(sf_writesize(&s, v));
+		t( docs[i] != NULL );
+		sf_write(&s, v, docs[i]);
+		i++;
+	}
+	i = 0;
+	while (i < 64) {
+		int j = 0;
+		while (j < 64) {
+			uint64_t a = sf_prefix(&s, docs[i]);
+			uint64_t b = sf_prefix(&s, docs[j]);
+			int rc = sf_compare(&s, docs[i], docs[j]);
+			if (a != b)
+				t( rc == ((a < b) ? -1 : 1) );
+			j++;
+		}
+		i++;
+	}
+	i = 0;
+	while (i < 64) {
+		free(docs[i]);
+		i++;
+	}
+	sf_schemefree(&s, &st_r.a);
+}
+
+static void
+sf_scheme_prefix(void)
+{
+	sf_scheme_prefix_test("string,key(0)");
+	sf_scheme_prefix_test("string_rev,key(0)");
+}
+
+#define SF_SCHEME_BENCH_COUNT  100000
+#define SF_SCHEME_BENCH_LOOKUP 1000000
+
+static uint64_t
+sf_scheme_bench_run(sfscheme *s, char **docs, char **keys)
+{
+	uint64_t start = ss_utime();
+	int i = 0;
+	while (i < SF_SCHEME_BENCH_LOOKUP) {
+		char *key = keys[i % SF_SCHEME_BENCH_COUNT];
+		int min = 0;
+		int max = SF_SCHEME_BENCH_COUNT - 1;
+		while (max >= min) {
+			int mid = min + (max - min) / 2;
+			int rc = sf_compare(s, docs[mid], key);
+			if (rc == 0)
+				break;
+			if (rc < 0)
+				min = mid + 1;
+			else
+				max = mid - 1;
+		}
+		t( max >= min );
+		i++;
+	}
+	uint64_t time_us = ss_utime() - start;
+	if (time_us == 0)
+		time_us = 1;
+	return (uint64_t)SF_SCHEME_BENCH_LOOKUP * 1000000 / time_us;
+}
+
+static void
+sf_scheme_bench_of(char *key, char *name)
+{
+	sfscheme s;
+	sf_schemeinit(&s);
+	sf_scheme_field(&s, "key", key);
+	sf_scheme_field(&s, "value", "string");
+	t( sf_schemevalidate(&s, &st_r.a) == 0 );
+	t( s.compare != sf_compare_generic );
+
+	/* ordered documents and lookup keys */
+	char **docs = malloc(sizeof(char*) * SF_SCHEME_BENCH_COUNT);
+	t( docs != NULL );
+	char **keys = malloc(sizeof(char*) * SF_SCHEME_BENCH_COUNT);
+	t( keys != NULL );
+	int i = 0;
+	while (i < SF_SCHEME_BENCH_COUNT) {
+		char sz[32];
+		uint64_t u64 = i;
+		sfv v[4];
+		memset(v, 0, sizeof(v));
+		if (s.fields[0]->type == SS_STRING) {
+			v[0].pointer = sz;
+			v[0].size = snprintf(sz, sizeof(sz), "key:%010d", i);
+		} else {
+			v[0].pointer = (char*)&u64;
+			v[0].size = sizeof(u64);
+		}
+		docs[i] = malloc(sf_writesize(&s, v));
+		t( docs[i] != NULL );
+		sf_write(&s, v, docs[i]);
+		i++;
+	}
+	i = 0;
+	while (i < SF_SCHEME_BENCH_COUNT) {
+		keys[i] = docs[rand() % SF_SCHEME_BENCH_COUNT];
+		i++;
+	}
+
+	sfcomparef compare = s.compare;
+	s.compare = sf_compare_generic;
+	uint64_t generic = sf_scheme_bench_run(&s, docs, keys);
+	s.compare = compare;
+	uint64_t specialized = sf_scheme_bench_run(&s, docs, keys);
+	if (st_r.verbose) {
+		printf("\n    (compare) %-6s generic: %" PRIu64 " lookups/sec, "
+		       "specialized: %" PRIu64 " lookups/sec", name,
+		       generic, specialized);
+		fflush(NULL);
+	}
+
+	i = 0;
+	while (i < SF_SCHEME_BENCH_COUNT) {
+		free(docs[i]);
+		i++;
+	}
+	free(docs);
+	free(keys);
+	sf_schemefree(&s, &st_r.a);
+}
+
+static void
+sf_scheme_compare_bench(void)
+{
+	sf_scheme_bench_of("u64,key(0)", "u64");
+	sf_scheme_bench_of("string,key(0)", "string");
+}
+
 stgroup *sf_scheme_group(void)
 {
 	stgroup *group = st_group("sfscheme");
 	st_groupadd(group, st_test("save_load", sf_scheme_saveload));
+	st_groupadd(group, st_test("compare", sf_scheme_compare));
+	st_groupadd(group, st_test("compare_bench", sf_scheme_compare_bench));
+	st_groupadd(group, st_test("normalize", sf_scheme_normalize));
+	st_groupadd(group, st_test("prefix", sf_scheme_prefix));
 	return group;
 }
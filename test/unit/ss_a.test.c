@@ -39,10 +39,66 @@ ssa_realloc(void)
 	ss_aclose(&a);
 }
 
+static void
+ssa_arena(void)
+{
+	ssa a;
+	uint64_t used = 0;
+	ss_aopen(&a, &ss_arenaa, &st_r.a, 1024, &used);
+	t( ss_arenaa_size(&a) == 0 );
+	char *list[1000];
+	int i = 0;
+	while (i < 1000) {
+		char *buf = ss_malloc(&a, 10);
+		t( buf != NULL );
+		t( ((uintptr_t)buf & 7) == 0 );
+		memset(buf, 'x', 10);
+		list[i] = buf;
+		i++;
+	}
+	/* large allocation */
+	char *buf = ss_malloc(&a, 4000);
+	t( buf != NULL );
+	memset(buf, 'x', 4000);
+	t( ss_arenaa_size(&a) >= 1000 * 16 + 4000 );
+	t( used == ss_arenaa_size(&a) );
+	ss_free(&a, buf);
+	t( ss_arenaa_size(&a) < 1000 * 24 + 4000 );
+	i = 0;
+	while (i < 1000) {
+		ss_free(&a, list[i]);
+		i++;
+	}
+	/* current chunk is kept until close */
+	t( ss_arenaa_size(&a) > 0 );
+	t( ss_arenaa_size(&a) <= 1024 + 64 );
+	t( used == ss_arenaa_size(&a) );
+	ss_aclose(&a);
+	t( ss_arenaa_size(&a) == 0 );
+	t( used == 0 );
+}
+
+static void
+ssa_arena_close(void)
+{
+	ssa a;
+	ss_aopen(&a, &ss_arenaa, &st_r.a, 1024, NULL);
+	char *buf = ss_malloc(&a, 10);
+	t( buf != NULL );
+	/* chunk outlives the arena until the last free */
+	ss_aclose(&a);
+	t( ss_arenaa_size(&a) > 0 );
+	memset(buf, 'x', 10);
+	ss_free(&a, buf);
+	t( ss_arenaa_size(&a) == 0 );
+}
+
 stgroup *ss_a_group(void)
 {
 	stgroup *group = st_group("ssa");
 	st_groupadd(group, st_test("malloc", ssa_malloc));
 	st_groupadd(group, st_test("realloc", ssa_realloc));
+	st_groupadd(group, st_test("arena", ssa_arena));
+	st_groupadd(group, st_test("arena_close", ssa_arena_close));
 	return group;
 }
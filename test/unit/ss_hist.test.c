@@ -0,0 +1,81 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <sophia.h>
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+#include <libsv.h>
+#include <libso.h>
+#include <libst.h>
+
+static void
+ss_hist_index(void)
+{
+	t( ss_histindex(0) == 0 );
+	t( ss_histindex(15) == 15 );
+	t( ss_histindex(16) == 16 );
+	t( ss_histindex(31) == 31 );
+	t( ss_histindex(32) == 32 );
+	t( ss_histindex(33) == 32 );
+	t( ss_histindex(UINT32_MAX) == SS_HIST_BUCKETS - 1 );
+	t( ss_histvalue(SS_HIST_BUCKETS - 1) == UINT32_MAX );
+
+	/* every value is inside of its bucket range */
+	uint32_t v = 1;
+	while (v < 100000000) {
+		int i = ss_histindex(v);
+		t( ss_histvalue(i) >= v );
+		t( ss_histvalue(i - 1) < v );
+		/* relative error */
+		t( (ss_histvalue(i) - v) <= v / SS_HIST_SUB );
+		v = v * 3 + 1;
+	}
+}
+
+static void
+ss_hist_percentile(void)
+{
+	sshist h;
+	ss_histinit(&h);
+	sshist p;
+	ss_histcopy(&p, &h);
+	t( p.count == 0 );
+	t( p.p50 == 0 );
+
+	uint32_t i = 1;
+	while (i <= 1000) {
+		ss_histadd(&h, i);
+		i++;
+	}
+	ss_histcopy(&p, &h);
+	t( p.count == 1000 );
+	t( p.p50 >= 500 && p.p50 < 500 + 500 / SS_HIST_SUB );
+	t( p.p99 >= 990 && p.p99 < 990 + 990 / SS_HIST_SUB );
+	t( p.p999 >= 999 && p.p999 < 999 + 999 / SS_HIST_SUB );
+
+	/* outlier */
+	ss_histadd(&h, 10000000000ULL);
+	ss_histcopy(&p, &h);
+	t( p.count == 1001 );
+	t( p.p999 < 2000 );
+
+	ss_histreset(&h);
+	ss_histcopy(&p, &h);
+	t( p.count == 0 );
+	t( p.p99 == 0 );
+}
+
+stgroup *ss_hist_group(void)
+{
+	stgroup *group = st_group("sshist");
+	st_groupadd(group, st_test("index", ss_hist_index));
+	st_groupadd(group, st_test("percentile", ss_hist_percentile));
+	return group;
+}
@@ -29,7 +29,7 @@ static void
 sv_index_replace0(void)
 {
 	svindex i;
-	t( sv_indexinit(&i) == 0 );
+	t( sv_indexinit(&i, SV_INDEXRB) == 0 );
 
 	uint32_t key = 7;
 	svv *h = st_svv(&st_r.g, NULL, 0, 0, key, NULL, 0);
@@ -18,7 +18,7 @@ static void
 sv_indexiter_lte_empty(void)
 {
 	svindex i;
-	t( sv_indexinit(&i) == 0 );
+	t( sv_indexinit(&i, SV_INDEXRB) == 0 );
 
 	ssiter it;
 	ss_iterinit(sv_indexiter, &it);
@@ -33,7 +33,7 @@ static void
 sv_indexiter_lte_eq(void)
 {
 	svindex i;
-	t( sv_indexinit(&i) == 0 );
+	t( sv_indexinit(&i, SV_INDEXRB) == 0 );
 
 	int keya = 7;
 	int keyb = 5;
@@ -71,7 +71,7 @@ static void
 sv_indexiter_lt_eq(void)
 {
 	svindex i;
-	t( sv_indexinit(&i) == 0 );
+	t( sv_indexinit(&i, SV_INDEXRB) == 0 );
 
 	int keya = 7;
 	int keyb = 5;
@@ -109,7 +109,7 @@ static void
 sv_indexiter_gte_empty(void)
 {
 	svindex i;
-	t( sv_indexinit(&i) == 0 );
+	t( sv_indexinit(&i, SV_INDEXRB) == 0 );
 
 	svv *key = st_svv(&st_r.g, NULL, 0, 0, 7, NULL, 0);
 	ssiter it;
@@ -127,7 +127,7 @@ static void
 sv_indexiter_gte_eq(void)
 {
 	svindex i;
-	t( sv_indexinit(&i) == 0 );
+	t( sv_indexinit(&i, SV_INDEXRB) == 0 );
 
 	int keya = 7;
 	int keyb = 5;
@@ -165,7 +165,7 @@ static void
 sv_indexiter_gt_eq(void)
 {
 	svindex i;
-	t( sv_indexinit(&i) == 0 );
+	t( sv_indexinit(&i, SV_INDEXRB) == 0 );
 
 	int keya = 7;
 	int keyb = 5;
@@ -203,7 +203,7 @@ static void
 sv_indexiter_iterate0(void)
 {
 	svindex i;
-	t( sv_indexinit(&i) == 0 );
+	t( sv_indexinit(&i, SV_INDEXRB) == 0 );
 
 	int keyb = 3;
 	int keya = 7;
@@ -256,7 +256,7 @@ static void
 sv_indexiter_iterate1(void)
 {
 	svindex i;
-	t( sv_indexinit(&i) == 0 );
+	t( sv_indexinit(&i, SV_INDEXRB) == 0 );
 
 	int j = 0;
 	while (j < 16) {
@@ -0,0 +1,206 @@
+
+/*
+ * sophia database
+ * sphia.org
+ *
+ * Copyright (c) Dmitry Simonenko
+ * BSD License
+*/
+
+#include <sophia.h>
+#include <libss.h>
+#include <libsf.h>
+#include <libsr.h>
+#include <libsv.h>
+#include <libst.h>
+
+static inline uint32_t
+sv_skiplist_key(svv *v) {
+	return *(uint32_t*)sf_field(st_r.r.scheme, 0, sv_vpointer(v), &st_r.size);
+}
+
+static void
+sv_skiplist_iterate(void)
+{
+	svindex i;
+	t( sv_indexinit(&i, SV_INDEXSKIPLIST) == 0 );
+
+	uint32_t j = 0;
+	while (j < 1000) {
+		uint32_t key = (j * 7919) % 1000;
+		svv *v = st_svv(&st_r.g, NULL, j, 0, key, NULL, 0);
+		t( sv_indexset(&i, &st_r.r, v) == 0 );
+		j++;
+	}
+	t( i.count == 1000 );
+
+	ssiter it;
+	ss_iterinit(sv_indexiter, &it);
+	ss_iteropen(sv_indexiter, &it, &st_r.r, &i, SS_GTE, NULL);
+	j = 0;
+	while (ss_iteratorhas(&it)) {
+		svv *v = sv_vv(ss_iteratorof(&it));
+		t( sv_skiplist_key(v) == j );
+		ss_iteratornext(&it);
+		j++;
+	}
+	t( j == 1000 );
+
+	ss_iterinit(sv_indexiter, &it);
+	ss_iteropen(sv_indexiter, &it, &st_r.r, &i, SS_LTE, NULL);
+	j = 1000;
+	while (ss_iteratorhas(&it)) {
+		svv *v = sv_vv(ss_iteratorof(&it));
+		t( sv_skiplist_key(v) == j - 1 );
+		ss_iteratornext(&it);
+		j--;
+	}
+	t( j == 0 );
+
+	sv_indexfree(&i, &st_r.r);
+}
+
+static void
+sv_skiplist_position(void)
+{
+	svindex i;
+	t( sv_indexinit(&i, SV_INDEXSKIPLIST) == 0 );
+
+	uint32_t j = 0;
+	while (j < 100) {
+		svv *v = st_svv(&st_r.g, NULL, j, 0, j * 2, NULL, 0);
+		t( sv_indexset(&i, &st_r.r, v) == 0 );
+		j++;
+	}
+	svv *key = st_svv(&st_r.g, &st_r.gc, 0, 0, 50, NULL, 0);
+	svv *key_miss = st_svv(&st_r.g, &st_r.gc, 0, 0, 51, NULL, 0);
+
+	ssiter it;
+	ss_iterinit(sv_indexiter, &it);
+	t( ss_iteropen(sv_indexiter, &it, &st_r.r, &i, SS_GTE, sv_vpointer(key)) == 1 );
+	t( sv_skiplist_key(sv_vv(ss_iteratorof(&it))) == 50 );
+	t( ss_iteropen(sv_indexiter, &it, &st_r.r, &i, SS_GT, sv_vpointer(key)) == 1 );
+	t( sv_skiplist_key(sv_vv(ss_iteratorof(&it))) == 52 );
+	t( ss_iteropen(sv_indexiter, &it, &st_r.r, &i, SS_LTE, sv_vpointer(key)) == 1 );
+	t( sv_skiplist_key(sv_vv(ss_iteratorof(&it))) == 50 );
+	t( ss_iteropen(sv_indexiter, &it, &st_r.r, &i, SS_LT, sv_vpointer(key)) == 1 );
+	t( sv_skiplist_key(sv_vv(ss_iteratorof(&it))) == 48 );
+
+	t( ss_iteropen(sv_indexiter, &it, &st_r.r, &i, SS_GTE, sv_vpointer(key_miss)) == 0 );
+	t( sv_skiplist_key(sv_vv(ss_iteratorof(&it))) == 52 );
+	t( ss_iteropen(sv_indexiter, &it, &st_r.r, &i, SS_LTE, sv_vpointer(key_miss)) == 0 );
+	t( sv_skiplist_key(sv_vv(ss_iteratorof(&it))) == 50 );
+
+	svindexpos pos;
+	t( sv_indexget(&i, &st_r.r, &pos, key) != NULL );
+	t( sv_indexget(&i, &st_r.r, &pos, key_miss) == NULL );
+
+	sv_indexfree(&i, &st_r.r);
+}
+
+static void
+sv_skiplist_versions(void)
+{
+	svindex i;
+	t( sv_indexinit(&i, SV_INDEXSKIPLIST) == 0 );
+
+	uint32_t key = 7;
+	svv *a = st_svv(&st_r.g, NULL, 1, 0, key, NULL, 0);
+	svv *b = st_svv(&st_r.g, NULL, 3, 0, key, NULL, 0);
+	svv *c = st_svv(&st_r.g, NULL, 2, 0, key, NULL, 0);
+	t( sv_indexset(&i, &st_r.r, a) == 0 );
+	t( sv_indexset(&i, &st_r.r, b) == 0 );
+	t( sv_indexset(&i, &st_r.r, c) == 0 );
+	t( i.count == 3 );
+
+	svindexpos pos;
+	t( sv_indexget(&i, &st_r.r, &pos, a) == b );
+	t( b->next == c );
+	t( c->next == a );
+	t( (sv_vflags(b, &st_r.r) & SVDUP) == 0 );
+	t( (sv_vflags(c, &st_r.r) & SVDUP) > 0 );
+	t( (sv_vflags(a, &st_r.r) & SVDUP) > 0 );
+	t( sv_vvisible(b, &st_r.r, 2) == c );
+
+	sv_indexfree(&i, &st_r.r);
+}
+
+#define SV_SKIPLIST_THREADS 4
+#define SV_SKIPLIST_KEYS    4000
+
+static svskiplist *sv_skiplist_shared;
+static svv *sv_skiplist_values[SV_SKIPLIST_KEYS];
+static int sv_skiplist_thread_id;
+
+static void*
+sv_skiplist_thread(void *arg)
+{
+	ssthread *self = arg;
+	(void)self;
+	int id = __sync_fetch_and_add(&sv_skiplist_thread_id, 1);
+	int j = id;
+	while (j < SV_SKIPLIST_KEYS) {
+		t( sv_skiplist_set(sv_skiplist_shared, &st_r.r, sv_skiplist_values[j]) == 0 );
+		j += SV_SKIPLIST_THREADS;
+	}
+	return NULL;
+}
+
+static void
+sv_skiplist_concurrent(void)
+{
+	sv_skiplist_shared = sv_skiplist_new(&st_r.r);
+	t( sv_skiplist_shared != NULL );
+	sv_skiplist_thread_id = 0;
+	int j = 0;
+	while (j < SV_SKIPLIST_KEYS) {
+		uint32_t key = (j * 7919) % SV_SKIPLIST_KEYS;
+		sv_skiplist_values[j] = st_svv(&st_r.g, NULL, j, 0, key, NULL, 0);
+		j++;
+	}
+
+	ssthreadpool p;
+	ss_threadpool_init(&p);
+	t( ss_threadpool_new(&p, &st_r.a, SV_SKIPLIST_THREADS,
+	                     sv_skiplist_thread, NULL) == 0 );
+	t( ss_threadpool_shutdown(&p, &st_r.a) == 0 );
+
+	/* every level is ordered and the bottom level
+	 * contains all keys */
+	int level = 0;
+	while (level < SV_SKIPLIST_HEIGHT) {
+		int count = 0;
+		svskipnode *prev = NULL;
+		svskipnode *n = sv_skiplist_shared->head[level];
+		while (n) {
+			t( n->height > (uint32_t)level );
+			if (prev)
+				t( sv_skiplist_key(prev->v) < sv_skiplist_key(n->v) );
+			if (level == 0)
+				t( sv_skiplist_key(n->v) == (uint32_t)count );
+			prev = n;
+			n = n->next[level];
+			count++;
+		}
+		if (level == 0)
+			t( count == SV_SKIPLIST_KEYS );
+		level++;
+	}
+
+	svskipnode *n = sv_skiplist_min(sv_skiplist_shared);
+	while (n) {
+		sv_vfree(&st_r.r, n->v);
+		n = n->next[0];
+	}
+	sv_skiplist_free(sv_skiplist_shared, &st_r.r);
+}
+
+stgroup *sv_skiplist_group(void)
+{
+	stgroup *group = st_group("svskiplist");
+	st_groupadd(group, st_test("iterate", sv_skiplist_iterate));
+	st_groupadd(group, st_test("position", sv_skiplist_position));
+	st_groupadd(group, st_test("versions", sv_skiplist_versions));
+	st_groupadd(group, st_test("concurrent", sv_skiplist_concurrent));
+	return group;
+}
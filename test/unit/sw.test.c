@@ -103,10 +103,87 @@ sw_begin_rollback(void)
 	t( sw_managershutdown(&lp) == 0 );
 }
 
+static void
+sw_begin_commit_sync(void)
+{
+	swmanager lp;
+	t( sw_managerinit(&lp, &st_r.r) == 0 );
+	swconf *conf = sw_conf(&lp);
+	conf->path     = strdup(st_r.conf->log_dir);
+	conf->enable   = 1;
+	conf->rotatewm = 1000;
+	conf->sync_on_write = 1;
+	t( sw_manageropen(&lp) == 0 );
+	t( sw_managerrotate(&lp) == 0 );
+
+	svlog log;
+	sv_loginit(&log, &st_r.r, 1);
+	sv_loginit_index(&log, 0, &st_r.r);
+
+	alloclogv(&log, &st_r.r, 0, 0, 7);
+
+	swtx ltx;
+	t( sw_begin(&lp, &ltx, 0, 0) == 0 );
+	t( sw_write(&ltx, &log) == 0 );
+	t( sw_commit(&ltx) == 0 );
+	t( lp.lsn_written == ltx.lsn );
+	t( lp.lsn_synced < ltx.lsn );
+
+	t( sw_syncwait(&lp, ltx.lsn) == 0 );
+	t( lp.lsn_synced == ltx.lsn );
+	t( lp.sync_leader == 0 );
+	t( sw_syncwait(&lp, ltx.lsn) == 0 );
+
+	freelog(&log, &st_r.r);
+	t( sw_managershutdown(&lp) == 0 );
+}
+
+static void
+sw_begin_commit_async(void)
+{
+	swmanager lp;
+	t( sw_managerinit(&lp, &st_r.r) == 0 );
+	swconf *conf = sw_conf(&lp);
+	conf->path     = strdup(st_r.conf->log_dir);
+	conf->enable   = 1;
+	conf->rotatewm = 1000;
+	conf->async    = 1;
+	conf->async_interval = 100000;
+	t( sw_manageropen(&lp) == 0 );
+	t( sw_managerrotate(&lp) == 0 );
+
+	svlog log;
+	sv_loginit(&log, &st_r.r, 1);
+	sv_loginit_index(&log, 0, &st_r.r);
+
+	alloclogv(&log, &st_r.r, 0, 0, 7);
+
+	sw *l = sscast(lp.list.prev, sw, link);
+	uint64_t size = l->file.size;
+
+	swtx ltx;
+	t( sw_begin(&lp, &ltx, 0, 0) == 0 );
+	t( sw_write(&ltx, &log) == 0 );
+	t( sw_commit(&ltx) == 0 );
+	t( l->file.size == size );
+	t( ss_bufused(&lp.async) > 0 );
+	t( sw_managerdurable(&lp) < ltx.lsn );
+
+	t( sw_syncwait(&lp, ltx.lsn) == 0 );
+	t( sw_managerdurable(&lp) == ltx.lsn );
+	t( l->file.size > size );
+	t( ss_bufused(&lp.async) == 0 );
+
+	freelog(&log, &st_r.r);
+	t( sw_managershutdown(&lp) == 0 );
+}
+
 stgroup *sw_group(void)
 {
 	stgroup *group = st_group("sw");
 	st_groupadd(group, st_test("begin_commit", sw_begin_commit));
 	st_groupadd(group, st_test("begin_rollback", sw_begin_rollback));
+	st_groupadd(group, st_test("begin_commit_sync", sw_begin_commit_sync));
+	st_groupadd(group, st_test("begin_commit_async", sw_begin_commit_async));
 	return group;
 }